@@ -217,6 +217,31 @@ namespace embree
     return x | (y << 1) | (z << 2);
   }
 
+  /*! bit interleave operation for 64 bit codes with 21 bits per dimension */
+  __forceinline uint64 bitInterleave64(const uint64 xin, const uint64 yin, const uint64 zin)
+  {
+    uint64 x = xin & 0x1FFFFF, y = yin & 0x1FFFFF, z = zin & 0x1FFFFF;
+    x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+    x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+    x = (x | (x <<  8)) & 0x100F00F00F00F00FULL;
+    x = (x | (x <<  4)) & 0x10C30C30C30C30C3ULL;
+    x = (x | (x <<  2)) & 0x1249249249249249ULL;
+
+    y = (y | (y << 32)) & 0x001F00000000FFFFULL;
+    y = (y | (y << 16)) & 0x001F0000FF0000FFULL;
+    y = (y | (y <<  8)) & 0x100F00F00F00F00FULL;
+    y = (y | (y <<  4)) & 0x10C30C30C30C30C3ULL;
+    y = (y | (y <<  2)) & 0x1249249249249249ULL;
+
+    z = (z | (z << 32)) & 0x001F00000000FFFFULL;
+    z = (z | (z << 16)) & 0x001F0000FF0000FFULL;
+    z = (z | (z <<  8)) & 0x100F00F00F00F00FULL;
+    z = (z | (z <<  4)) & 0x10C30C30C30C30C3ULL;
+    z = (z | (z <<  2)) & 0x1249249249249249ULL;
+
+    return x | (y << 1) | (z << 2);
+  }
+
 #if _WIN32
   __forceinline double drand48() {
     return double(rand())/double(RAND_MAX);
@@ -354,6 +354,16 @@ namespace embree
     return _mm_loadu_ps((float*)a); 
   }
 
+  /*! loads 4 unsigned bytes and converts them to floats without normalization */
+  __forceinline ssef load4f_uint8( const unsigned char* const ptr ) {
+#if defined (__SSE4_1__)
+    return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(const int*)ptr)));
+#else
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)ptr),zero),zero));
+#endif
+  }
+
   __forceinline void storeu4f ( void* ptr, const ssef& v ) {
     _mm_storeu_ps((float*)ptr,v);
   }
@@ -55,11 +55,31 @@ namespace embree
     VirtualFree((char*)ptr+bytesNew,bytesOld-bytesNew,MEM_DECOMMIT);
   }
 
+  void os_reset(void* ptr, size_t bytes) {
+    VirtualAlloc(ptr,bytes,MEM_RESET,PAGE_READWRITE);
+  }
+
   void os_free(void* ptr, size_t bytes) {
     if (bytes == 0) return;
     VirtualFree(ptr,0,MEM_RELEASE);
   }
 
+  void* os_map_file(const char* filename, size_t offset, size_t bytes)
+  {
+    HANDLE file = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    HANDLE mapping = CreateFileMappingA(file,NULL,PAGE_WRITECOPY,0,0,NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return NULL;
+    void* ptr = MapViewOfFile(mapping,FILE_MAP_COPY,DWORD((unsigned long long)offset >> 32),DWORD(offset),bytes);
+    CloseHandle(mapping);
+    return ptr;
+  }
+
+  void os_unmap_file(void* ptr, size_t bytes) {
+    if (ptr) UnmapViewOfFile(ptr);
+  }
+
   double getSeconds() {
     LARGE_INTEGER freq, val;
     QueryPerformanceFrequency(&freq);
@@ -77,11 +97,52 @@ namespace embree
 
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
 #include <string.h>
 
+#if defined(__USE_NUMA__)
+#include <numa.h>
+#endif
+
 namespace embree
 {
+  /*! maps memory and applies the huge page and NUMA settings */
+  static char* os_map(size_t bytes, int flags)
+  {
+    const size_t hugePageSize = 2*1024*1024;
+    bool hugepages = os_hugepages() && !(flags & MAP_HUGETLB) && bytes >= hugePageSize;
+
+    /* over allocate to align the region to huge pages */
+    size_t bytesMapped = bytes;
+    if (hugepages) bytesMapped = bytes+hugePageSize;
+    
+    char* ptr = (char*) mmap(0, bytesMapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (ptr == NULL || ptr == MAP_FAILED) throw std::bad_alloc();
+
+    if (hugepages) 
+    {
+      /* unmap unaligned head and tail */
+      char* begin = (char*) (((size_t)ptr+hugePageSize-1) & ~(hugePageSize-1));
+      char* end   = (char*) (((size_t)begin+bytes+4095) & ~size_t(4095));
+      if (begin > ptr) munmap(ptr,begin-ptr);
+      if (ptr+bytesMapped > end) munmap(end,ptr+bytesMapped-end);
+      ptr = begin;
+
+      /* request transparent huge pages */
+#if defined(MADV_HUGEPAGE)
+      madvise(ptr,bytes,MADV_HUGEPAGE);
+#endif
+    }
+
+#if defined(__USE_NUMA__)
+    if (os_numa_policy() == NUMA_INTERLEAVE && numa_available() != -1)
+      numa_interleave_memory(ptr,bytes,numa_all_nodes_ptr);
+#endif
+    return ptr;
+  }
+
   void* os_malloc(size_t bytes)
   {
     int flags = MAP_PRIVATE | MAP_ANON;
@@ -93,9 +154,7 @@ namespace embree
       bytes = (bytes+4095)&(-4096);
     }
 #endif
-    char* ptr = (char*) mmap(0, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
-    if (ptr == NULL || ptr == MAP_FAILED) throw std::bad_alloc();
-    return ptr;
+    return os_map(bytes,flags);
   }
 
   void* os_reserve(size_t bytes)
@@ -109,9 +168,7 @@ namespace embree
       bytes = (bytes+4095)&(-4096);
     }
 #endif
-    char* ptr = (char*) mmap(0, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
-    if (ptr == NULL || ptr == MAP_FAILED) throw std::bad_alloc();
-    return ptr;
+    return os_map(bytes,flags);
   }
 
   void os_commit (void* ptr, size_t bytes) {
@@ -129,6 +186,10 @@ namespace embree
     os_free((char*)ptr+bytesNew,bytesOld-bytesNew);
   }
 
+  void os_reset(void* ptr, size_t bytes) {
+    madvise(ptr,bytes,MADV_DONTNEED);
+  }
+
   void os_free(void* ptr, size_t bytes) 
   {
     if (bytes == 0)
@@ -146,6 +207,20 @@ namespace embree
     }
   }
 
+  void* os_map_file(const char* filename, size_t offset, size_t bytes)
+  {
+    int fd = open(filename,O_RDONLY);
+    if (fd == -1) return NULL;
+    void* ptr = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+    close(fd);
+    if (ptr == MAP_FAILED) return NULL;
+    return ptr;
+  }
+
+  void os_unmap_file(void* ptr, size_t bytes) {
+    if (ptr) munmap(ptr,bytes);
+  }
+
 #if defined(__MIC__)
 
   static double getFrequencyInMHz()
@@ -193,6 +268,23 @@ namespace embree
 
 namespace embree
 {
+  static bool g_os_hugepages = false;
+  static NumaPolicy g_os_numa_policy = NUMA_DEFAULT;
+
+  void os_configure(bool hugepages, NumaPolicy policy) 
+  {
+    g_os_hugepages = hugepages;
+    g_os_numa_policy = policy;
+  }
+
+  bool os_hugepages() {
+    return g_os_hugepages;
+  }
+
+  NumaPolicy os_numa_policy() {
+    return g_os_numa_policy;
+  }
+
   void* alignedMalloc(size_t size, size_t align)
   {
     if (size == 0) return NULL;
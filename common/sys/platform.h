@@ -289,13 +289,31 @@ namespace embree
   void* alignedMalloc(size_t size, size_t align = 64);
   void alignedFree(const void* ptr);
 
+  /*! placement of pages allocated from the OS on NUMA nodes */
+  enum NumaPolicy 
+  { 
+    NUMA_DEFAULT,       //!< placement chosen by the OS
+    NUMA_INTERLEAVE,    //!< pages get interleaved over all NUMA nodes
+    NUMA_FIRST_TOUCH    //!< pages get first touched by the threads using them
+  };
+
+  /*! configures huge pages and NUMA placement of pages allocated from the OS */
+  void os_configure(bool hugepages, NumaPolicy policy);
+  bool os_hugepages();
+  NumaPolicy os_numa_policy();
+
   /*! allocates pages directly from OS */
   void* os_malloc (size_t bytes);
   void* os_reserve(size_t bytes);
   void  os_commit (void* ptr, size_t bytes);
   void  os_shrink (void* ptr, size_t bytesNew, size_t bytesOld);
+  void  os_reset  (void* ptr, size_t bytes);
   void  os_free   (void* ptr, size_t bytes);
 
+  /*! maps a range of a file copy-on-write into memory, returns NULL on failure */
+  void* os_map_file  (const char* filename, size_t offset, size_t bytes);
+  void  os_unmap_file(void* ptr, size_t bytes);
+
   /*! returns performance counter in seconds */
   double getSeconds();
 }
@@ -16,6 +16,7 @@
 
 #include "taskscheduler.h"
 #include "taskscheduler_sys.h"
+#include "taskscheduler_stealing.h"
 #if defined(__MIC__)
 #include "taskscheduler_mic.h"
 #endif
@@ -41,18 +42,24 @@ namespace embree
   
   TaskScheduler* TaskScheduler::instance = NULL;
 
-  void TaskScheduler::create(size_t numThreads)
+  void TaskScheduler::create(size_t numThreads, TYPE type)
   {
     if (instance)
       throw std::runtime_error("Embree threads already running.");
 
+    /* work stealing scheduler with per thread task queues */
+    if (type == STEALING)
+      instance = new TaskSchedulerStealing;
+
     /* enable fast pthreads tasking system */
+    else {
 #if defined(__MIC__)
-    instance = new TaskSchedulerMIC; 
-    //instance = new TaskSchedulerSys; 
+      instance = new TaskSchedulerMIC; 
+      //instance = new TaskSchedulerSys; 
 #else
-    instance = new TaskSchedulerSys; 
+      instance = new TaskSchedulerSys; 
 #endif
+    }
 
 #if 1
     instance->createThreads(numThreads);
@@ -101,11 +108,6 @@ namespace embree
     instance->wait(threadIndex,threadCount,&event);
   }
 
-
-  void TaskScheduler::waitForEvent(Event* event) {
-    instance->wait(0,instance->getNumThreads(),event);
-  }
-
   void TaskScheduler::destroy() 
   {
     if (instance) {
@@ -141,6 +143,7 @@ namespace embree
     thread2event = (ThreadEvent*) alignedMalloc(numThreads*sizeof(ThreadEvent));
 
     memset(thread2event,0,numThreads*sizeof(ThreadEvent));
+    allocThreadData(numThreads);
 
     /* generate all threads */
     for (size_t t=0; t<numThreads; t++) {
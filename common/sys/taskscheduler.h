@@ -36,6 +36,9 @@ namespace embree
     /*! Task queues */
     enum QUEUE { GLOBAL_FRONT, GLOBAL_BACK };
 
+    /*! Task scheduler implementations */
+    enum TYPE { DEFAULT, STEALING };
+
 #define TASK_RUN_FUNCTION(Class,name)                                   \
     void name(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* taskGroup); \
     static void _##name(void* This, size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* taskGroup) { \
@@ -140,7 +143,7 @@ namespace embree
     static TaskScheduler* instance;
     
     /*! creates the threads */
-    static void create(size_t numThreads = 0);
+    static void create(size_t numThreads = 0, TYPE type = DEFAULT);
 
     /*! returns the number of threads used */
     static size_t getNumThreads();
@@ -160,15 +163,15 @@ namespace embree
 
     /*! returns ISPC event of the thread */
     static Event* getISPCEvent(ssize_t threadIndex);
-
-    /*! waits for an event out of a task */
-    static void waitForEvent(Event* event); // use only from main thread !!!
     
   protected:
 
     /*! creates all threads */
     void createThreads(size_t numThreads);
 
+    /*! allocates per thread data before the threads get started */
+    virtual void allocThreadData(size_t numThreads) {}
+
     /*! thread function */
     static void threadFunction(void* thread);
 
@@ -0,0 +1,263 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "taskscheduler_stealing.h"
+#include "tasklogger.h"
+
+namespace embree
+{
+  bool TaskSchedulerStealing::TaskDeque::push(Task* task)
+  {
+    const atomic_t b = bottom;
+    const atomic_t t = top;
+    if (b-t >= (atomic_t)DEQUE_SIZE) return false;
+    tasks[b&(DEQUE_SIZE-1)] = task;
+
+    /* full barrier publishes the task before later loads */
+    atomic_xchg(&bottom,b+1);
+    return true;
+  }
+
+  TaskScheduler::Task* TaskSchedulerStealing::TaskDeque::pop()
+  {
+    /* reserve the bottom task, full barrier orders the load of top */
+    const atomic_t b = bottom-1;
+    atomic_xchg(&bottom,b);
+    const atomic_t t = top;
+
+    /* deque was empty */
+    if (t > b) {
+      bottom = b+1;
+      return NULL;
+    }
+
+    /* more than one task left, no conflict with thieves possible */
+    Task* task = tasks[b&(DEQUE_SIZE-1)];
+    if (t < b) return task;
+
+    /* last task, race against thieves */
+    if (atomic_cmpxchg(&top,t,t+1) != t) task = NULL;
+    bottom = b+1;
+    return task;
+  }
+
+  TaskScheduler::Task* TaskSchedulerStealing::TaskDeque::steal()
+  {
+    const atomic_t t = top;
+    __memory_barrier();
+    const atomic_t b = bottom;
+    if (t >= b) return NULL;
+
+    Task* task = tasks[t&(DEQUE_SIZE-1)];
+    __memory_barrier();
+    if (atomic_cmpxchg(&top,t,t+1) != t) return NULL;
+    return task;
+  }
+
+  TaskSchedulerStealing::TaskSchedulerStealing()
+    : deques(NULL), numDeques(0), begin(0), end(0), tasks(1024) {}
+
+  TaskSchedulerStealing::~TaskSchedulerStealing() {
+    alignedFree(deques); deques = NULL;
+  }
+
+  void TaskSchedulerStealing::allocThreadData(size_t numThreads)
+  {
+    alignedFree(deques);
+    numDeques = numThreads;
+    deques = (TaskDeque*) alignedMalloc(numThreads*sizeof(TaskDeque));
+    for (size_t i=0; i<numThreads; i++)
+      new (&deques[i]) TaskDeque(unsigned(2*i+1));
+  }
+
+  void TaskSchedulerStealing::add(ssize_t threadIndex, QUEUE queue, Task* task)
+  {
+    if (task->event) 
+      task->event->inc();
+
+    push(threadIndex,queue,task);
+  }
+
+  void TaskSchedulerStealing::push(ssize_t threadIndex, QUEUE queue, Task* task)
+  {
+    /* every published task holds one reference that prevents its completion */
+    task->completed++;
+
+    /* worker threads push to their own deque, the queue is ignored as
+     * the owner always continues with the most recently added task
+     * and thieves take the oldest one */
+    if (threadIndex >= 0 && threadIndex < (ssize_t)numDeques && deques[threadIndex].push(task)) 
+    {
+      if (numSleeping > 0) {
+        mutex.lock();
+        condition.broadcast();
+        mutex.unlock();
+      }
+      return;
+    }
+
+    /* tasks from outside and overflowing tasks go to the global queue */
+    mutex.lock();
+
+    /*! resize array if too small */
+    if (end-begin == tasks.size())
+    {
+      size_t s0 = 1*tasks.size();
+      size_t s1 = 2*tasks.size();
+      tasks.resize(s1);
+      for (size_t i=begin; i!=end; i++)
+        tasks[i&(s1-1)] = tasks[i&(s0-1)];
+    }
+
+    /*! insert task to correct end of list */
+    switch (queue) {
+    case GLOBAL_FRONT: { size_t i = (--begin)&(tasks.size()-1); tasks[i] = task; break; }
+    case GLOBAL_BACK : { size_t i = (end++  )&(tasks.size()-1); tasks[i] = task; break; }
+    default          : mutex.unlock(); throw std::runtime_error("invalid task queue");
+    }
+
+    condition.broadcast();
+    mutex.unlock();
+  }
+
+  TaskScheduler::Task* TaskSchedulerStealing::get(size_t threadIndex, size_t threadCount)
+  {
+    /* continue with the most recent task of this thread */
+    TaskDeque& deque = deques[threadIndex];
+    if (Task* task = deque.pop()) 
+      return task;
+
+    /* take task from the global queue */
+    if (end != begin) 
+    {
+      Task* task = NULL;
+      mutex.lock();
+      if (end != begin) {
+        size_t i = (--end)&(tasks.size()-1);
+        task = tasks[i]; tasks[i] = NULL;
+      }
+      mutex.unlock();
+      if (task) return task;
+    }
+
+    /* steal a task, starting at a random victim */
+    deque.seed = 1103515245*deque.seed + 12345;
+    const size_t start = (deque.seed >> 16) % numDeques;
+    for (size_t i=0; i<numDeques; i++) 
+    {
+      const size_t victim = (start+i) % numDeques;
+      if (victim == threadIndex) continue;
+      if (Task* task = deques[victim].steal())
+        return task;
+    }
+    return NULL;
+  }
+
+  void TaskSchedulerStealing::execute(size_t threadIndex, size_t threadCount, Task* task)
+  {
+    /* release the reference of a task whose elements are all started */
+    const ssize_t elt = --task->started;
+    if (elt < 0) {
+      if (--task->completed == 0) complete(threadIndex,threadCount,task);
+      return;
+    }
+
+    /* publish the remaining elements such that other threads can steal them */
+    if (elt > 0) push(threadIndex,GLOBAL_BACK,task);
+
+    /* run the task */
+    thread2event[threadIndex].event = task->event; 
+    if (task->run) {
+      size_t taskID = TaskLogger::beginTask(threadIndex,task->name,elt);
+      task->run(task->runData,threadIndex,threadCount,elt,task->elts,task->event);
+      TaskLogger::endTask(threadIndex,taskID);
+    }
+
+    /* release the executed element and the reference of the published task */
+    if ((task->completed -= 2) == 0)
+      complete(threadIndex,threadCount,task);
+  }
+
+  void TaskSchedulerStealing::complete(size_t threadIndex, size_t threadCount, Task* task)
+  {
+    TaskScheduler::Event* event = task->event;
+    if (task->complete) {
+      size_t taskID = TaskLogger::beginTask(threadIndex,task->name,0);
+      task->complete(task->completeData,threadIndex,threadCount,task->event); // may delete the task
+      TaskLogger::endTask(threadIndex,taskID);
+    }
+    if (event) event->dec();
+  }
+
+  bool TaskSchedulerStealing::work(size_t threadIndex, size_t threadCount)
+  {
+    Task* task = get(threadIndex,threadCount);
+    if (task == NULL) return false;
+    execute(threadIndex,threadCount,task);
+    return true;
+  }
+
+  void TaskSchedulerStealing::wait(size_t threadIndex, size_t threadCount, Event* event)
+  {
+    event->dec();
+    while (!event->triggered()) {
+      if (!work(threadIndex,threadCount)) 
+        __pause();
+    }
+  }
+
+  bool TaskSchedulerStealing::hasTasks() const
+  {
+    if (end != begin) return true;
+    for (size_t i=0; i<numDeques; i++)
+      if (!deques[i].empty()) return true;
+    return false;
+  }
+
+  void TaskSchedulerStealing::sleep()
+  {
+    mutex.lock();
+    numSleeping++; // full barrier before checking the deques
+    while (!hasTasks() && !terminateThreads)
+      condition.wait(mutex);
+    numSleeping--;
+    mutex.unlock();
+  }
+
+  void TaskSchedulerStealing::run(size_t threadIndex, size_t threadCount)
+  {
+    size_t attempts = 0;
+    while (!terminateThreads)
+    {
+      if (work(threadIndex,threadCount)) {
+        attempts = 0;
+        continue;
+      }
+
+      /* spin for a while before going to sleep */
+      if (++attempts < MAX_STEAL_ATTEMPTS) __pause();
+      else { sleep(); attempts = 0; }
+    }
+  }
+
+  void TaskSchedulerStealing::terminate() 
+  {
+    mutex.lock();
+    terminateThreads = true;
+    condition.broadcast(); 
+    mutex.unlock();
+  }
+}
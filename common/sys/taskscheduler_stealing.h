@@ -0,0 +1,123 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "taskscheduler.h"
+#include "sys/sync/mutex.h"
+#include "sys/sync/condition.h"
+
+namespace embree
+{
+  /*! Task scheduler using one Chase-Lev work stealing deque per
+   *  thread. Tasks added by worker threads go to the deque of that
+   *  thread, idle threads steal from the deques of other threads. Only
+   *  tasks added from outside the worker threads go through a global
+   *  queue that is protected by a mutex. */
+  class __hidden TaskSchedulerStealing : public TaskScheduler
+  {
+  public:
+
+    /*! maximal number of tasks per deque, needs to be power of two */
+    static const size_t DEQUE_SIZE = 4096;
+
+    /*! number of failed steal attempts before a thread goes to sleep */
+    static const size_t MAX_STEAL_ATTEMPTS = 1024;
+
+    /*! Work stealing deque of a single thread. Only the owning thread
+     *  pushes and pops at the bottom, other threads steal at the top. */
+    struct __aligned(64) TaskDeque
+    {
+      TaskDeque (unsigned seed) : top(0), bottom(0), seed(seed) {}
+
+      /*! pushes a task to the bottom, fails if the deque is full */
+      bool push(Task* task);
+
+      /*! pops the most recently pushed task from the bottom */
+      Task* pop();
+
+      /*! steals the oldest task from the top */
+      Task* steal();
+
+      /*! checks if the deque contains tasks */
+      __forceinline bool empty() const { return top >= bottom; }
+
+    public:
+      volatile atomic_t top;          //!< index of oldest task, modified by thieves
+      char align0[64-sizeof(atomic_t)];
+      volatile atomic_t bottom;       //!< index after newest task, modified by owner
+      unsigned seed;                  //!< random seed of owner to select steal victims
+      char align1[64-sizeof(atomic_t)-sizeof(unsigned)];
+      Task* volatile tasks[DEQUE_SIZE]; //!< ring buffer of tasks
+    };
+
+    /*! construction */
+    TaskSchedulerStealing();
+
+    /*! destruction */
+    ~TaskSchedulerStealing();
+
+  private:
+
+    /*! allocates the task deques */
+    void allocThreadData(size_t numThreads);
+
+    /*! adds a task to the deque of the calling thread or the global queue */
+    void add(ssize_t threadIndex, QUEUE queue, Task* task);
+
+    /*! waits for an event out of a task */
+    void wait(size_t threadIndex, size_t threadCount, Event* event);
+
+    /*! processes next task, returns false if no task was found */
+    bool work(size_t threadIndex, size_t threadCount);
+
+    /*! thread function */
+    void run(size_t threadIndex, size_t threadCount);
+
+    /*! sets the terminate thread variable */
+    void terminate();
+
+  private:
+
+    /*! publishes a task that has unstarted elements left */
+    void push(ssize_t threadIndex, QUEUE queue, Task* task);
+
+    /*! takes a task from the own deque, the global queue, or steals one */
+    Task* get(size_t threadIndex, size_t threadCount);
+
+    /*! executes the next element of a task */
+    void execute(size_t threadIndex, size_t threadCount, Task* task);
+
+    /*! finishes a task when all its elements got completed */
+    void complete(size_t threadIndex, size_t threadCount, Task* task);
+
+    /*! checks if any queue contains tasks */
+    bool hasTasks() const;
+
+    /*! puts the calling thread to sleep until new tasks get added */
+    void sleep();
+
+  private:
+    TaskDeque* deques;           //!< one deque per thread
+    size_t numDeques;            //!< number of deques
+
+    MutexSys mutex;              //!< mutex to protect global queue and sleeping
+    ConditionSys condition;      //!< condition to wake up sleeping threads
+    AtomicCounter numSleeping;   //!< number of sleeping threads
+    volatile size_t begin,end;   //!< current range of tasks in global queue
+    std::vector<Task*> tasks;    //!< global queue of tasks added from outside
+  };
+}
@@ -33,6 +33,12 @@
 #  define RTCORE_ALIGN(...) __attribute__((aligned(__VA_ARGS__)))
 #endif
 
+/*! maximal nesting depth of instances reported in the ray */
+#define RTC_MAX_INSTANCE_LEVELS 4
+
+/*! maximal number of motion blur time steps of a geometry */
+#define RTC_MAX_TIME_STEPS 16
+
 #include "rtcore_scene.h"
 #include "rtcore_geometry.h"
 #include "rtcore_geometry_user.h"
@@ -46,6 +46,13 @@ enum RTCGeometryFlags
   RTC_GEOMETRY_DYNAMIC    = 2,    //!< specifies dynamic geometry with arbitrary motion (BVH refit not possible)
 };
 
+/*! \brief Supported types of curve geometry. */
+enum RTCCurveType
+{
+  RTC_CURVE_RIBBON = 0,    //!< flat ribbon that always faces the ray, the geometry normal is the curve tangent
+  RTC_CURVE_ROUND  = 1,    //!< round tube around the curve, the geometry normal is the surface normal of the tube
+};
+
 /*! Intersection filter function for single rays. */
 typedef void (*RTCFilterFunc)(void* ptr,           /*!< pointer to user data */
                               RTCRay& ray          /*!< intersection to filter */);
@@ -72,29 +79,67 @@ typedef void (*RTCFilterFunc16)(const void* valid, /*!< pointer to valid mask */
   will typically transform the ray with the inverse of the provided
   transformation and continue traversing the ray through the provided
   scene. If any geometry is hit, the instance ID (instID) member of
-  the ray will get set to the geometry ID of the instance. */
+  the ray will get set to the geometry ID of the instance. The
+  instantiated scene can itself contain instances. For a hit inside
+  such nested instances, instID identifies the instance in the scene
+  the ray got traced through and subInstID[i] the instance of the
+  next deeper level, terminated by -1. Levels deeper than
+  RTC_MAX_INSTANCE_LEVELS are not reported. A scene cannot
+  instantiate itself, directly or through other instances. */
 RTCORE_API unsigned rtcNewInstance (RTCScene target,                  //!< the scene the instance belongs to
                                     RTCScene source                   //!< the scene to instantiate
   );
 
-/*! \brief Sets transformation of the instance */
+/*! \brief Creates a new motion blurred scene instance. The
+  transformation of each time step (1 for normal instances, and 2 up
+  to RTC_MAX_TIME_STEPS for motion blur) is set with rtcSetTransform2.
+  The time steps are evenly distributed over the time range [0,1] and
+  the transformation gets linearly interpolated between neighbouring
+  time steps at the time of the ray. Linear interpolation does not
+  preserve rotations: the instance shrinks in between time steps that
+  rotate against each other, and a rotation by 180 degrees passes
+  through a singular transformation. Rays that hit such a singular
+  blend use the transformation of the nearest time step. Use more
+  time steps to keep the rotation between neighbouring time steps
+  small. */
+RTCORE_API unsigned rtcNewInstance2 (RTCScene target,                  //!< the scene the instance belongs to
+                                     RTCScene source,                  //!< the scene to instantiate
+                                     size_t numTimeSteps = 1           //!< number of motion blur time steps
+  );
+
+/*! \brief Sets transformation of the instance. For motion blurred
+  instances this sets the transformation of the first time step. */
 RTCORE_API void rtcSetTransform (RTCScene scene,                          //!< scene handle
                                  unsigned geomID,                         //!< ID of geometry
                                  RTCMatrixType layout,                    //!< layout of transformation matrix
                                  const float* xfm                         //!< transformation matrix
                                  );
 
+/*! \brief Sets transformation of some time step of the instance */
+RTCORE_API void rtcSetTransform2 (RTCScene scene,                         //!< scene handle
+                                  unsigned geomID,                        //!< ID of geometry
+                                  RTCMatrixType layout,                   //!< layout of transformation matrix
+                                  const float* xfm,                       //!< transformation matrix
+                                  size_t timeStep = 0                     //!< time step to set the transformation for
+                                  );
+
 /*! \brief Creates a new triangle mesh. The number of triangles
   (numTriangles), number of vertices (numVertices), and number of time
-  steps (1 for normal meshes, and 2 for linear motion blur), have to
-  get specified. The triangle indices can be set be mapping and
-  writing to the index buffer (RTC_INDEX_BUFFER) and the triangle
-  vertices can be set by mapping and writing into the vertex buffer
-  (RTC_VERTEX_BUFFER). In case of linear motion blur, two vertex
-  buffers have to get filled (RTC_VERTEX_BUFFER0, RTC_VERTEX_BUFFER1),
-  one for each time step. The index buffer has the default layout of
-  three 32 bit integer indices for each triangle. An index points to
-  the ith vertex. The vertex buffer stores single precision x,y,z
+  steps (1 for normal meshes, and 2 up to RTC_MAX_TIME_STEPS for
+  linear motion blur), have to get specified. The triangle indices can
+  be set be mapping and writing to the index buffer (RTC_INDEX_BUFFER)
+  and the triangle vertices can be set by mapping and writing into the
+  vertex buffer (RTC_VERTEX_BUFFER). In case of motion blur, one
+  vertex buffer has to get filled for each time step
+  (RTC_VERTEX_BUFFER0+t for time step t). The time steps are evenly
+  distributed over the time range [0,1] and the vertices get linearly
+  interpolated between neighbouring time steps. A motion blur mesh
+  with N time steps moves linearly in each of its N-1 time segments.
+  The least common multiple of the time segments of all motion blur
+  meshes of a scene may not exceed RTC_MAX_TIME_STEPS-1, otherwise
+  creating the mesh fails with RTC_INVALID_OPERATION. The index buffer has
+  the default layout of three 32 bit integer indices for each
+  triangle. An index points to the ith vertex. The vertex buffer stores single precision x,y,z
   floating point coordinates aligned to 16 bytes. The value of the 4th
   float used for alignment can be arbitrary. */
 RTCORE_API unsigned rtcNewTriangleMesh (RTCScene scene,                    //!< the scene the mesh belongs to
@@ -106,13 +151,16 @@ RTCORE_API unsigned rtcNewTriangleMesh (RTCScene scene,                    //!<
 
 /*! \brief Creates a new set of cubic bezier curves. The number of
   curves (numCurves), number of vertices (numVertices), and number of
-  time steps (1 for normal curves, and 2 for linear motion blur), have
-  to get specified at construction time. Further, the curve index
-  buffer (RTC_INDEX_BUFFER) and the curve vertex buffer
-  (RTC_VERTEX_BUFFER) have to get set by mapping and writing to the
-  appropiate buffers. In case of linear motion blur, two vertex
-  buffers have to get filled (RTC_VERTEX_BUFFER0, RTC_VERTEX_BUFFER1),
-  one for each time step. The index buffer has the default layout of a
+  time steps (1 for normal curves, and 2 up to RTC_MAX_TIME_STEPS for
+  linear motion blur), have to get specified at construction
+  time. Further, the curve index buffer (RTC_INDEX_BUFFER) and the
+  curve vertex buffer (RTC_VERTEX_BUFFER) have to get set by mapping
+  and writing to the appropiate buffers. In case of motion blur, one
+  vertex buffer has to get filled for each time step
+  (RTC_VERTEX_BUFFER0+t for time step t). The time steps are evenly
+  distributed over the time range [0,1] and the control points and
+  radii get linearly interpolated between neighbouring time
+  steps. The index buffer has the default layout of a
   single 32 bit integer index for each curve, that references the
   start vertex of the curve. The vertex buffer stores 4 control points
   per curve, each such control point consists of a single precision
@@ -124,6 +172,20 @@ RTCORE_API unsigned rtcNewBezierCurves (RTCScene scene,                    //!<
                                                  size_t numTimeSteps = 1            //!< number of motion blur time steps
   );
 
+/*! \brief Creates a new set of cubic bezier curves of some curve
+  type. Curves created with rtcNewBezierCurves are ribbons
+  (RTC_CURVE_RIBBON), round curves (RTC_CURVE_ROUND) get intersected
+  as tubes of the curve radius. Both curve types are supported by all
+  hair acceleration structures (hairaccel), thus round curves are
+  never intersected as ribbons. */
+RTCORE_API unsigned rtcNewBezierCurves2 (RTCScene scene,                   //!< the scene the curves belong to
+                                         RTCGeometryFlags flags,           //!< geometry flags
+                                         RTCCurveType type,                //!< type of the curves
+                                         size_t numCurves,                 //!< number of curves
+                                         size_t numVertices,               //!< number of vertices
+                                         size_t numTimeSteps = 1           //!< number of motion blur time steps
+  );
+
 /*! \brief Sets 32 bit ray mask. */
 RTCORE_API void rtcSetMask (RTCScene scene, unsigned geomID, int mask);
 
@@ -48,6 +48,7 @@ public:
   int   geomID;        //!< geometry ID
   int   primID;        //!< primitive ID
   int   instID;        //!< instance ID
+  int   subInstID[RTC_MAX_INSTANCE_LEVELS-1]; //!< IDs of the nested instances below instID, terminated by -1
 };
 
 /*! Ray structure for packets of 4 rays. */
@@ -81,6 +82,7 @@ public:
   int   geomID[4];  //!< geometry ID
   int   primID[4];  //!< primitive ID
   int   instID[4];  //!< instance ID
+  int   subInstID[RTC_MAX_INSTANCE_LEVELS-1][4]; //!< IDs of the nested instances below instID, terminated by -1
 };
 
 /*! Ray structure for packets of 8 rays. */
@@ -114,6 +116,7 @@ public:
   int   geomID[8];  //!< geometry ID
   int   primID[8];  //!< primitive ID
   int   instID[8];  //!< instance ID
+  int   subInstID[RTC_MAX_INSTANCE_LEVELS-1][8]; //!< IDs of the nested instances below instID, terminated by -1
 };
 
 /*! \brief Ray structure for packets of 16 rays. */
@@ -147,6 +150,54 @@ public:
   int   geomID[16];  //!< geometry ID
   int   primID[16];  //!< primitive ID
   int   instID[16];  //!< instance ID
+  int   subInstID[RTC_MAX_INSTANCE_LEVELS-1][16]; //!< IDs of the nested instances below instID, terminated by -1
+};
+
+/*! \brief Ray structure for streams of rays in SOA layout. 
+
+  Each member points to an array that stores the respective component
+  of all rays of the stream. Consecutive elements of each array are
+  spaced by the stride passed to rtcIntersectNp and rtcOccludedNp. */
+struct RTCRayNp
+{
+  /* ray data */
+public:
+  float* orgx;  //!< x coordinate of ray origin
+  float* orgy;  //!< y coordinate of ray origin
+  float* orgz;  //!< z coordinate of ray origin
+  
+  float* dirx;  //!< x coordinate of ray direction
+  float* diry;  //!< y coordinate of ray direction
+  float* dirz;  //!< z coordinate of ray direction
+  
+  float* tnear; //!< Start of ray segment 
+  float* tfar;  //!< End of ray segment (set to hit distance)
+
+  float* time;  //!< Time of this ray for motion blur
+  int*   mask;  //!< Used to mask out objects during traversal
+  
+  /* hit data */
+public:
+  float* Ngx;   //!< x coordinate of geometry normal
+  float* Ngy;   //!< y coordinate of geometry normal
+  float* Ngz;   //!< z coordinate of geometry normal
+  
+  float* u;     //!< Barycentric u coordinate of hit
+  float* v;     //!< Barycentric v coordinate of hit
+  
+  int*   geomID;  //!< geometry ID
+  int*   primID;  //!< primitive ID
+  int*   instID;  //!< instance ID
+  int*   subInstID[RTC_MAX_INSTANCE_LEVELS-1]; //!< IDs of the nested instances below instID, optional
+
+public:
+
+  /*! The nested instance IDs are an optional output. They are only
+   *  written for the levels whose array got set, all levels are
+   *  disabled by default. */
+  RTCRayNp () {
+    for (int i=0; i<RTC_MAX_INSTANCE_LEVELS-1; i++) subInstID[i] = 0;
+  }
 };
 
 /*! @} */
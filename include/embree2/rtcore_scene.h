@@ -25,6 +25,7 @@ struct RTCRay;
 struct RTCRay4;
 struct RTCRay8;
 struct RTCRay16;
+struct RTCRayNp;
 
 /*! scene flags */
 enum RTCSceneFlags 
@@ -38,6 +39,7 @@ enum RTCSceneFlags
   RTC_SCENE_COHERENT   = (1 << 9),    //!< optimize data structures for coherent rays
   RTC_SCENE_INCOHERENT = (1 << 10),    //!< optimize data structures for in-coherent rays (enabled by default)
   RTC_SCENE_HIGH_QUALITY = (1 << 11),  //!< create higher quality data structures
+  RTC_SCENE_PROGRESSIVE = (1 << 12),   //!< build acceleration structures of meshes while the scene is still getting loaded
 
   /* traversal algorithm flags */
   RTC_SCENE_ROBUST     = (1 << 16)     //!< use more robust traversal algorithms
@@ -55,6 +57,9 @@ enum RTCAlgorithmFlags
 /*! \brief Defines an opaque scene type */
 typedef struct __RTCScene {}* RTCScene;
 
+/*! Type of the function called when an asynchronous commit finished. */
+typedef void (*RTCCommitFunc)(void* userPtr, RTCScene scene);
+
 /*! Creates a new scene. */
 RTCORE_API RTCScene rtcNewScene (RTCSceneFlags flags, RTCAlgorithmFlags aflags);
 
@@ -63,6 +68,40 @@ RTCORE_API RTCScene rtcNewScene (RTCSceneFlags flags, RTCAlgorithmFlags aflags);
  *  rays. */
 RTCORE_API void rtcCommit (RTCScene scene);
 
+/*! Commits the geometry of the scene asynchronously. The function
+ *  returns immediately and the acceleration structure gets built in
+ *  the background. Once the build finished, the new acceleration
+ *  structure becomes active and the commit function gets called
+ *  (from some Embree thread) with the user pointer and scene. For
+ *  scenes committed before, rays can get traced during the build and
+ *  see the previous acceleration structure, which stays valid until
+ *  the next commit of the scene starts. Ray queries that still
+ *  traverse the previous acceleration structure have to finish
+ *  before the next commit gets started, as that commit rebuilds into
+ *  it. For this, the scene builds
+ *  into a second set of acceleration structures, which doubles its
+ *  memory consumption. Geometries must not get modified until the
+ *  commit function got called. The commit function may commit or
+ *  delete the scene again. Errors of the build get reported by
+ *  the next rtcCommit or rtcCommitAsync of the scene. */
+RTCORE_API void rtcCommitAsync (RTCScene scene, RTCCommitFunc func, void* userPtr);
+
+/*! Stores the acceleration structure of a committed static scene into
+ *  a file. Scenes whose acceleration structures keep pointers into
+ *  the vertex arrays of curves cannot get stored, for these the
+ *  RTC_INVALID_OPERATION error is set. */
+RTCORE_API void rtcSaveScene (RTCScene scene, const char* filename);
+
+/*! Commits the scene by memory mapping the acceleration structure
+ *  stored with rtcSaveScene, instead of building it. The scene has to
+ *  contain the same geometries (number of primitives, vertices, and
+ *  flags) and has to be created with the same flags as the stored
+ *  scene. If the file is missing or does not match the scene the
+ *  RTC_INVALID_OPERATION error is set and the scene stays uncommitted,
+ *  thus the application can fall back to rtcCommit. Changes to the
+ *  vertex positions are not detected. */
+RTCORE_API void rtcLoadScene (RTCScene scene, const char* filename);
+
 /*! Intersects a single ray with the scene. The ray has to be aligned
  *  to 16 bytes. This function can only be called for scenes with the
  *  RTC_INTERSECT1 flag set. */
@@ -113,6 +152,37 @@ RTCORE_API void rtcOccluded8 (const void* valid, RTCScene scene, RTCRay8& ray);
  *  instructions. */
 RTCORE_API void rtcOccluded16 (const void* valid, RTCScene scene, RTCRay16& ray);
 
+/*! Intersects a stream of N rays in AOS layout with the scene. The
+ *  rays are spaced by stride bytes, which has to be at least
+ *  sizeof(RTCRay), and each ray has to be aligned to 16 bytes. The
+ *  rays are internally regrouped by direction octant and origin into
+ *  ray packets of the widest size enabled for the scene, thus the
+ *  scene has to be created with at least one of the RTC_INTERSECT1,
+ *  RTC_INTERSECT4, RTC_INTERSECT8, or RTC_INTERSECT16 flags. */
+RTCORE_API void rtcIntersectN (RTCScene scene, RTCRay* rays, size_t N, size_t stride);
+
+/*! Intersects a stream of N rays in SOA layout with the scene. The
+ *  elements of each component array are spaced by stride bytes,
+ *  which is sizeof(float) for densely packed arrays. Rays are
+ *  regrouped into packets in the same way as for rtcIntersectN. The
+ *  IDs of nested instances are only written to the subInstID arrays
+ *  that are not NULL, the constructor of RTCRayNp sets all of them to
+ *  NULL. */
+RTCORE_API void rtcIntersectNp (RTCScene scene, const RTCRayNp& rays, size_t N, size_t stride);
+
+/*! Tests if a stream of N rays in AOS layout is occluded by the
+ *  scene. The rays are spaced by stride bytes, which has to be at
+ *  least sizeof(RTCRay), and each ray has to be aligned to 16
+ *  bytes. Rays are regrouped into packets in the same way as for
+ *  rtcIntersectN. */
+RTCORE_API void rtcOccludedN (RTCScene scene, RTCRay* rays, size_t N, size_t stride);
+
+/*! Tests if a stream of N rays in SOA layout is occluded by the
+ *  scene. The elements of each component array are spaced by stride
+ *  bytes. Rays are regrouped into packets in the same way as for
+ *  rtcIntersectN. */
+RTCORE_API void rtcOccludedNp (RTCScene scene, const RTCRayNp& rays, size_t N, size_t stride);
+
 /*! Deletes the scene. All contained geometry get also destroyed. */
 RTCORE_API void rtcDeleteScene (RTCScene scene);
 
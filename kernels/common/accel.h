@@ -24,6 +24,18 @@ namespace embree
   class Bounded : public RefCount {
   public:
     Bounded () : bounds(empty) {}
+
+    /*! writes the data structure at the current position of the
+     *  file, returns false if the data structure cannot be stored */
+    virtual bool store (FILE* file) { return false; }
+
+    /*! restores the data structure from a range of a file written
+     *  by store, returns false if the data does not match */
+    virtual bool restore (const char* filename, size_t offset, size_t bytes) { return false; }
+
+    /*! releases the data of a restored data structure */
+    virtual void unmap () {}
+
   public:
     BBox3fa bounds;
   };
@@ -153,6 +165,9 @@ namespace embree
     
     /*! build accel */
     virtual void build (size_t threadIndex, size_t threadCount) = 0;
+
+    /*! builds the acceleration structure of a single geometry ahead of the next build */
+    virtual void prebuild (size_t threadIndex, size_t threadCount, size_t geomID) {}
     
     /*! Intersects a single ray with the scene. */
     __forceinline void intersect (RTCRay& ray) {
@@ -45,6 +45,26 @@ namespace embree
       bounds = accel->bounds;
     }
 
+    void prebuild (size_t threadIndex, size_t threadCount, size_t geomID) {
+      if (builder) builder->prebuild(threadIndex,threadCount,geomID);
+    }
+
+    bool store (FILE* file) {
+      return accel->store(file);
+    }
+
+    bool restore (const char* filename, size_t offset, size_t bytes) 
+    {
+      if (!accel->restore(filename,offset,bytes)) return false;
+      bounds = accel->bounds;
+      return true;
+    }
+
+    void unmap () {
+      accel->unmap();
+      bounds = accel->bounds;
+    }
+
   private:
     Bounded* accel;
     Builder* builder;
@@ -73,30 +73,51 @@ namespace embree
     }
   }
 
-  void AccelN::occluded4 (const void* valid, void* ptr, RTCRay4& ray) 
+  /*! Removes rays that got occluded by an acceleration structure
+   *  from the valid mask, returns true if any ray is still active. The
+   *  geomID of a ray is only checked after tracing it, as it is an
+   *  output field and may contain anything before. */
+  template<int N, typename Ray>
+  __forceinline bool maskOccluded(int* valid, const Ray& ray)
+  {
+    int active = 0;
+    for (size_t j=0; j<N; j++) {
+      if (ray.geomID[j] == 0) valid[j] = 0;
+      active |= valid[j];
+    }
+    return active != 0;
+  }
+
+  void AccelN::occluded4 (const void* valid_i, void* ptr, RTCRay4& ray) 
   {
     AccelN* This = (AccelN*)ptr;
+    __aligned(16) int valid[4];
+    memcpy(valid,valid_i,sizeof(valid));
     for (size_t i=0; i<This->M; i++) {
       This->validAccels[i]->occluded4(valid,ray);
-      // FIXME: exit if already hit something
+      if (!maskOccluded<4>(valid,ray)) break;
     }
   }
 
-  void AccelN::occluded8 (const void* valid, void* ptr, RTCRay8& ray) 
+  void AccelN::occluded8 (const void* valid_i, void* ptr, RTCRay8& ray) 
   {
     AccelN* This = (AccelN*)ptr;
+    __aligned(32) int valid[8];
+    memcpy(valid,valid_i,sizeof(valid));
     for (size_t i=0; i<This->M; i++) {
       This->validAccels[i]->occluded8(valid,ray);
-      // FIXME: exit if already hit something
+      if (!maskOccluded<8>(valid,ray)) break;
     }
   }
 
-  void AccelN::occluded16 (const void* valid, void* ptr, RTCRay16& ray) 
+  void AccelN::occluded16 (const void* valid_i, void* ptr, RTCRay16& ray) 
   {
     AccelN* This = (AccelN*)ptr;
+    __aligned(64) int valid[16];
+    memcpy(valid,valid_i,sizeof(valid));
     for (size_t i=0; i<This->M; i++) {
       This->validAccels[i]->occluded16(valid,ray);
-      // FIXME: exit if already hit something
+      if (!maskOccluded<16>(valid,ray)) break;
     }
   }
 
@@ -119,10 +140,23 @@ namespace embree
   void AccelN::build (size_t threadIndex, size_t threadCount) 
   {
     /* build all acceleration structures */
+    for (size_t i=0; i<N; i++) 
+      accels[i]->build(threadIndex,threadCount);
+
+    select();
+  }
+
+  void AccelN::prebuild (size_t threadIndex, size_t threadCount, size_t geomID) 
+  {
+    for (size_t i=0; i<N; i++) 
+      accels[i]->prebuild(threadIndex,threadCount,geomID);
+  }
+
+  void AccelN::select ()
+  {
     M = 0;
     for (size_t i=0; i<N; i++) 
     {
-      accels[i]->build(threadIndex,threadCount);
       if (accels[i]->bounds.empty()) continue;
       validAccels[M++] = accels[i];
     }
@@ -45,6 +45,10 @@ namespace embree
     void print(size_t ident);
     void immutable();
     void build (size_t threadIndex, size_t threadCount);
+    void prebuild (size_t threadIndex, size_t threadCount, size_t geomID);
+
+    /*! selects the non-empty acceleration structures and the intersectors to use */
+    void select ();
 
   public:
     Accel* accels[16];
@@ -15,45 +15,129 @@
 // ======================================================================== //
 
 #include "alloc.h"
+#include "stat.h"
 
 namespace embree
 {
   Alloc Alloc::global;
 
-  Alloc::Alloc () {
-    blocks.reserve(1024);
+  /*! increments the tag of the stack top and sets a new top block */
+  static __forceinline atomic_t retag(atomic_t top, atomic_t id, size_t idBits) {
+    return atomic_t((((size_t(top) >> idBits)+1) << idBits) | size_t(id));
+  }
+
+  Alloc::Alloc () 
+    : numRegions(0), next(0), committed(0), available(0), released(0) 
+  {
+    for (size_t i=0; i<maxRegions; i++) 
+      regions[i] = NULL;
   }
 
   Alloc::~Alloc () {
+    for (size_t i=0; i<numRegions; i++)
+      os_free(regions[i],size_t(regionBlocks)*size_t(blockSize));
   }
 
   size_t Alloc::size() const {
-    return size_t(blockSize)*blocks.size();
+    return size_t(blockSize)*size_t(committed);
+  }
+
+  atomic_t Alloc::id(void* ptr) const 
+  {
+    const size_t regionBytes = size_t(regionBlocks)*size_t(blockSize);
+    for (size_t r=0; r<numRegions; r++) {
+      if ((char*)ptr < regions[r] || (char*)ptr >= regions[r]+regionBytes) continue;
+      return atomic_t(r*size_t(regionBlocks) + size_t((char*)ptr-regions[r])/size_t(blockSize))+1;
+    }
+    throw std::runtime_error("block not allocated by this pool");
   }
 
   void Alloc::clear()
   {
-    Lock<MutexSys> lock(mutex);
-    for (size_t i=0; i<blocks.size(); i++)
-      alignedFree(blocks[i]);
-    blocks.clear();
+    atomic_t first = popAll(available);
+    if (first == 0) return;
+
+    /* release all but the first page of each block that holds the link */
+    atomic_t last = first;
+    for (atomic_t i=first; i; i=link(i)) {
+      os_reset(block(i)+4096,blockSize-4096);
+      last = i;
+    }
+    push(released,first,last);
   }
   
   void* Alloc::malloc() 
   {
-    Lock<MutexSys> lock(mutex);
-    if (blocks.size()) {
-      void* ptr = blocks.back();
-      blocks.pop_back();
-      return ptr;
+    /* reuse returned block, preferring blocks whose memory is still committed */
+    atomic_t i = pop(available);
+    if (i == 0) i = pop(released);
+    if (i) {
+      STAT(Stat::get().alloc.blocks++);
+      STAT(Stat::get().alloc.reused++);
+      return block(i);
     }
-    return alignedMalloc(blockSize,64);
+
+    /* take next block from bump pointer */
+    size_t j = atomic_add(&next,1);
+    if (unlikely(j >= size_t(maxRegions)*size_t(regionBlocks))) throw std::runtime_error("out of memory");
+    if (unlikely(j >= size_t(committed))) commit(j);
+    STAT(Stat::get().alloc.blocks++);
+    return block(j+1);
   }
   
   void Alloc::free(void* ptr) 
   {
+    atomic_t i = id(ptr);
+    push(available,i,i);
+  }
+
+  void Alloc::commit(size_t i)
+  {
+    STAT(uint64 t0 = __rdtsc());
     Lock<MutexSys> lock(mutex);
-    blocks.push_back(ptr);
+    while (size_t(committed) <= i) 
+    {
+      /* reserve a new address region when the last one is full */
+      const size_t r = size_t(committed)/size_t(regionBlocks);
+      if (r >= numRegions) {
+        regions[r] = (char*) os_reserve(size_t(regionBlocks)*size_t(blockSize));
+        numRegions = r+1;
+      }
+      const size_t j = size_t(committed)%size_t(regionBlocks);
+      os_commit(regions[r]+j*size_t(blockSize),size_t(slabBlocks)*size_t(blockSize));
+      committed += slabBlocks;
+      STAT(Stat::get().alloc.slabs++);
+    }
+    STAT(Stat::get().alloc.waits++);
+    STAT(Stat::get().alloc.waitCycles += __rdtsc()-t0);
+  }
+
+  void Alloc::push(volatile atomic_t& stack, atomic_t first, atomic_t last)
+  {
+    while (true) {
+      atomic_t top = stack;
+      link(last) = top & idMask;
+      if (atomic_cmpxchg(&stack,top,retag(top,first,idBits)) == top) return;
+    }
+  }
+
+  atomic_t Alloc::pop(volatile atomic_t& stack)
+  {
+    while (true) {
+      atomic_t top = stack;
+      atomic_t i = top & idMask;
+      if (i == 0) return 0;
+      atomic_t nextID = link(i) & idMask; // may be stale, the tag detects this case
+      if (atomic_cmpxchg(&stack,top,retag(top,nextID,idBits)) == top) return i;
+    }
   }
-}
 
+  atomic_t Alloc::popAll(volatile atomic_t& stack)
+  {
+    while (true) {
+      atomic_t top = stack;
+      if ((top & idMask) == 0) return 0;
+      if (atomic_cmpxchg(&stack,top,retag(top,0,idBits)) == top) return top & idMask;
+    }
+  }
+}
@@ -25,10 +25,25 @@
 
 namespace embree
 {
+  /*! Touches each page of a newly handed out block when pages get
+   *  placed by first touch, such that the pages end up on the NUMA
+   *  node of the thread that uses the block. */
+  __forceinline void firstTouch(void* ptr, size_t bytes)
+  {
+    if (likely(os_numa_policy() != NUMA_FIRST_TOUCH)) return;
+    for (size_t i=0; i<bytes; i+=4096) 
+      ((volatile char*)ptr)[i] = 0;
+  }
+
   /*! Global memory pool. Node, triangle, and intermediary build data
-      is allocated from this memory pool and returned to it. The pool
-      does not return memory to the operating system unless the clear function
-      is called. */
+      is allocated from this memory pool and returned to it. Blocks
+      are handed out from reserved address regions through an atomic
+      bump pointer, a new region gets reserved when the last one is
+      full. Returned blocks are kept in a lock free stack. The
+      physical memory of returned blocks is given back to the
+      operating system when the clear function is called, released
+      blocks are kept in a second stack such that each block gets only
+      released once. */
   class Alloc
   {
   public:
@@ -37,6 +52,20 @@ namespace embree
     //enum { blockSize = 512*4096 };
     enum { blockSize = 16*4096 };
     //enum { blockSize = 4*4096 };
+
+    /*! Number of blocks committed at once. */
+    enum { slabBlocks = 64 };
+
+    /*! Number of blocks of each reserved address region and
+     *  maximal number of regions. On 32 bit platforms the regions
+     *  cover the entire address space. */
+#if defined(__MIC__)
+    enum { regionBlocks = 8*1024, maxRegions = 4096 };
+#elif defined(__X86_64__)
+    enum { regionBlocks = 16*1024, maxRegions = 4096 };
+#else
+    enum { regionBlocks = 1024, maxRegions = 63 };
+#endif
     
     /*! single allocator object */
     static Alloc global;
@@ -50,7 +79,7 @@ namespace embree
     /*! returns size of memory pool */
     size_t size() const;
     
-    /*! frees all available memory */
+    /*! returns the memory of all blocks returned since the last call to the OS */
     void clear();
     
     /*! allocates a memory block */
@@ -58,20 +87,65 @@ namespace embree
     
     /*! frees a memory block */
     void free(void* ptr);
+
+  private:
+
+    /*! block IDs are stored in the lower bits of the stack top, the upper bits contain a tag to avoid the ABA problem */
+    static const size_t idBits = 4*sizeof(atomic_t);
+    static const atomic_t idMask = (atomic_t(1) << idBits)-1;
+
+    /*! converts between block IDs and pointers, ID 0 is invalid */
+    __forceinline char* block(atomic_t id) const { 
+      const size_t i = size_t(id)-1;
+      return regions[i/size_t(regionBlocks)] + (i%size_t(regionBlocks))*size_t(blockSize); 
+    }
+    atomic_t id(void* ptr) const;
+
+    /*! link to the next block stored inside available blocks */
+    __forceinline atomic_t& link(atomic_t id) const { return *(atomic_t*)block(id); }
+
+    /*! pushes a linked list of blocks to a stack of blocks */
+    void push(volatile atomic_t& stack, atomic_t first, atomic_t last);
+
+    /*! pops a block from a stack of blocks */
+    atomic_t pop(volatile atomic_t& stack);
+
+    /*! pops all blocks from a stack of blocks */
+    atomic_t popAll(volatile atomic_t& stack);
+
+    /*! reserves address regions and commits slabs up to the specified block */
+    void commit(size_t i);
     
   private:
-    MutexSys mutex;                 //<! Mutex to protect access to blocks vector
-    std::vector<void*> blocks;      //<! list of available memory blocks
+    MutexSys mutex;                     //<! Mutex to protect reserving and committing memory
+    char* volatile regions[maxRegions]; //<! reserved address regions
+    volatile size_t numRegions;         //<! number of reserved address regions
+    atomic_t next;                      //<! next block of the bump pointer
+    volatile atomic_t committed;        //<! number of committed blocks
+    volatile atomic_t available;        //<! top of stack of returned blocks
+    volatile atomic_t released;         //<! top of stack of returned blocks whose memory got released
   };
 
   /*! Base class for a each memory allocator. Allocates from blocks of the 
-    Alloc class and returns these blocks on destruction. */
+    Alloc class and returns these blocks on destruction. Threads
+    allocate from the current block by atomically bumping its offset,
+    the thread that finds the block full installs a new block. */
   class AllocatorBase 
   {
+    /*! memory block with header */
+    struct Block 
+    {
+      enum { dataSize = Alloc::blockSize-64 };
+      Block* next;                  //!< next used block
+      atomic_t cur;                 //!< current location inside the block
+      char align[64-sizeof(Block*)-sizeof(atomic_t)];
+      char data[dataSize];          //!< data of the block
+    };
+
   public:
 
     /*! Default constructor. */
-    AllocatorBase () : ptr(NULL), cur(0), end(0) {
+    AllocatorBase () : cur(NULL), used(NULL), numBlocks(0) {
     }
     
     /*! Returns all allocated blocks to Alloc class. */
@@ -82,40 +156,63 @@ namespace embree
     /*! clears the allocator */
     void clear () 
     {
-      for (size_t i=0; i<blocks.size(); i++) {
-        Alloc::global.free(blocks[i]); 
+      Block* block = used;
+      while (block) {
+        Block* next = block->next;
+        Alloc::global.free(block); 
+        block = next;
       }
-      ptr = NULL;
-      cur = end = 0;
-      blocks.resize(0);
+      cur = used = NULL;
+      numBlocks = 0;
     }
 
     /*! returns number of bytes allocated */
     size_t bytes () {
-      return blocks.size() * Alloc::blockSize;
+      return numBlocks * Alloc::blockSize;
     }
 
     /*! Allocates some number of bytes. */
     void* malloc(size_t bytes) 
     {
-      Lock<MutexSys> lock(mutex);
-      cur += bytes;
-      if (cur <= end) return &ptr[cur - bytes];
-      ptr = (char*) Alloc::global.malloc();
-      blocks.push_back(ptr);
-      cur = 0;
-      end = Alloc::blockSize;
-      assert(bytes<=Alloc::blockSize);
-      cur += bytes;
-      return &ptr[cur - bytes];
+      assert(bytes <= Block::dataSize);
+      while (true) 
+      {
+        Block* block = cur;
+        if (likely(block != NULL)) {
+          size_t i = atomic_add(&block->cur,bytes);
+          if (likely(i+bytes <= Block::dataSize)) return &block->data[i];
+        }
+        refill(block);
+      }
     }
-    
+
   private:
-    MutexSys mutex;                  //!< mutex to protect access to this class
-    char*  ptr;                      //!< pointer to memory block
-    size_t cur;                      //!< Current location of the allocator.
-    size_t end;                      //!< End of the memory block.
-    std::vector<void*> blocks;       //!< available memory blocks
+
+    /*! replaces the full current block by a new block */
+    void refill(Block* full)
+    {
+      Block* block = (Block*) Alloc::global.malloc();
+      block->cur = 0;
+      
+      /* another thread was faster */
+      if (atomic_cmpxchg_ptr(&cur,full,block) != full) {
+        Alloc::global.free(block);
+        return;
+      }
+
+      /* link block into list of used blocks */
+      while (true) {
+        Block* first = used;
+        block->next = first;
+        if (atomic_cmpxchg_ptr(&used,first,block) == first) break;
+      }
+      atomic_add(&numBlocks,1);
+    }
+
+  private:
+    Block* volatile cur;             //!< current block to allocate from
+    Block* volatile used;            //!< list of all used blocks
+    atomic_t numBlocks;              //!< number of used blocks
   };
 
   /*! This class implements an efficient multi-threaded memory
@@ -208,12 +305,15 @@ namespace embree
 
   public:
 
-     /*! each thread handles block of that many bytes locally */
+     /*! each thread handles blocks of at least that many bytes locally */
     enum { allocBlockSize = 4096 };
 
+     /*! maximal size of the blocks each thread handles locally */
+    enum { maxAllocBlockSize = 64*4096 };
+
     /*! Allocator default construction. */
     LinearAllocatorPerThread () 
-      : ptr(NULL), cur(0), end(0), bytesAllocated(0)
+      : ptr(NULL), cur(0), end(0), bytesAllocated(0), blockSize(allocBlockSize)
     {
       thread = new ThreadAllocator[getNumberOfLogicalThreads()];
       ptr = NULL;
@@ -249,7 +349,8 @@ namespace embree
     {
       clear();
       const size_t numThreads = getNumberOfLogicalThreads();
-      bytes = max(bytes,size_t(allocBlockSize*numThreads));
+      initBlockSize(bytes);
+      bytes = max(bytes,blockSize*numThreads);
       if (bytes != size_t(end)) {
         if (ptr) os_free(ptr,end);
         ptr = (char*) os_reserve(bytes);
@@ -262,14 +363,17 @@ namespace embree
     {
       clear();
       const size_t numThreads = getNumberOfLogicalThreads();
-      size_t bytesReserved = max(bytesReserve,size_t(allocBlockSize*numThreads));
+      initBlockSize(bytesAllocate);
+      size_t bytesReserved = max(bytesReserve,blockSize*numThreads);
       if (bytesReserved != size_t(end) || bytesAllocate != bytesAllocated) 
       {
         bytesAllocated = bytesAllocate;
         if (ptr) os_free(ptr,end);
         ptr = (char*) os_reserve(bytesReserved);
         os_commit(ptr,bytesAllocated);
-        memset(ptr,0,bytesAllocated);
+        /* in first touch mode the builder threads touch their blocks first, see firstTouch */
+        if (os_numa_policy() != NUMA_FIRST_TOUCH)
+          memset(ptr,0,bytesAllocated);
         end = bytesReserved;
       }
     }
@@ -278,6 +382,7 @@ namespace embree
     void init_malloc (size_t bytes) 
     {
       clear();
+      blockSize = allocBlockSize;
       if (bytes != size_t(end)) {
         if (ptr) os_free(ptr,end);
         ptr = (char*) os_malloc(bytes);
@@ -292,6 +397,18 @@ namespace embree
 
   private:
 
+    /*! Selects the size of the thread local blocks based on the
+     *  expected size of the data structure, such that large builds
+     *  access the shared bump pointer rarely while the memory wasted
+     *  at the end of the thread local blocks stays small. */
+    void initBlockSize(size_t bytes)
+    {
+      const size_t numThreads = getNumberOfLogicalThreads();
+      size_t size = bytes/(64*numThreads);
+      size = min(max(size,size_t(allocBlockSize)),size_t(maxAllocBlockSize));
+      blockSize = size/allocBlockSize*allocBlockSize;
+    }
+
     /*! Allocates some number of bytes. */
     void* malloc(size_t bytes) 
     {
@@ -317,10 +434,12 @@ namespace embree
       {
         cur += bytes + ((align - cur) & (align-1));
         if (likely(cur <= end)) return &ptr[cur - bytes];
-        ptr = (char*) alloc->malloc(allocBlockSize);
+        const size_t blockSize = alloc->blockSize;
+        ptr = (char*) alloc->malloc(blockSize);
+        firstTouch(ptr,blockSize);
         cur = 0;
-        end = allocBlockSize;
-        if (bytes > allocBlockSize) 
+        end = blockSize;
+        if (bytes > blockSize) 
           throw std::runtime_error("allocated block is too large");
         cur += bytes;
         return &ptr[cur - bytes];
@@ -344,6 +463,7 @@ namespace embree
     atomic_t cur;              //!< Current location of the allocator.
     atomic_t end;              //!< End of the memory block.
     atomic_t bytesAllocated;
+    size_t blockSize;          //!< size of thread local blocks
   };
 
   class __aligned(64) GlobalAllocator
@@ -362,6 +482,7 @@ namespace embree
       {
         if (unlikely(begin+bytes > end)) {
           begin = (char*) global.malloc(blockSize); 
+          firstTouch(begin,blockSize);
           end = begin+blockSize;
         }
         
@@ -399,7 +520,8 @@ namespace embree
       bytesReserved = bytesReserve;
       
       os_commit(data,bytesAllocate);
-      memset(data,0,bytesAllocate);
+      if (os_numa_policy() != NUMA_FIRST_TOUCH)
+        memset(data,0,bytesAllocate);
       bytesAllocated = bytesAllocate;
       
       next = 0;
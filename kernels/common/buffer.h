@@ -59,6 +59,11 @@ namespace embree
       return mapped; 
     }
 
+    /*! checks if the buffer got allocated or shared */
+    __forceinline bool isSpecified() const {
+      return ptr != NULL; 
+    }
+
   protected:
     char* ptr;       //!< pointer to buffer data
     size_t bytes;    //!< size of buffer in bytes
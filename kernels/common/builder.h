@@ -24,6 +24,9 @@ namespace embree
   public:
     Builder () : needAllThreads(false) {}
     virtual void build(size_t threadIndex, size_t threadCount) = 0;
+
+    /*! builds the acceleration structure of a single geometry ahead of the next build */
+    virtual void prebuild(size_t threadIndex, size_t threadCount, size_t geomID) {}
   public:
     bool needAllThreads;
   };
@@ -39,6 +39,16 @@ namespace embree
     /*! calculates the bounding box of specified primitive of specified group */
     virtual void bounds(size_t group, size_t begin, size_t end, BBox3fa* bounds_o) const {}
 
+    /*! calculates the bounding box of specified primitive of specified group over the time range [time0,time1] */
+    virtual const BBox3fa bounds(size_t group, size_t prim, float time0, float time1) const { 
+      return bounds(group,prim); 
+    }
+
+    /*! returns the number of motion blur time steps of specified group */
+    virtual size_t timeSteps(size_t group) const { 
+      return 1; 
+    }
+
     /*! splits a clipped primitive into two clipped primitives */
     virtual void split (const PrimRef& prim, int dim, float pos, PrimRef& left_o, PrimRef& right_o) const { 
       throw std::runtime_error("split not implemented"); 
@@ -61,8 +61,13 @@ namespace embree
   extern std::string g_hair_accel;
   extern std::string g_builder;
   extern std::string g_traverser;
+  extern std::string g_scheduler;
   extern int g_scene_flags;
   extern size_t g_benchmark;
+  extern size_t g_refit_budget;
+  extern size_t g_presplits;
+  extern size_t g_morton_bits;
+  extern size_t g_restructure_passes;
 
   /*! records an error */
   void recordError(RTCError error);
@@ -76,6 +81,7 @@ namespace embree
   __forceinline bool isCoherent  (RTCSceneFlags flags) { return flags & RTC_SCENE_COHERENT; }
   __forceinline bool isIncoherent(RTCSceneFlags flags) { return flags & RTC_SCENE_INCOHERENT; }
   __forceinline bool isHighQuality(RTCSceneFlags flags) { return flags & RTC_SCENE_HIGH_QUALITY; }
+  __forceinline bool isProgressive(RTCSceneFlags flags) { return flags & RTC_SCENE_PROGRESSIVE; }
 
   /*! CPU features */
   static const int SSE   = CPU_FEATURE_SSE; 
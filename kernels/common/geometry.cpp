@@ -20,7 +20,7 @@
 namespace embree
 {
   Geometry::Geometry (Scene* parent, GeometryTy type, size_t numPrimitives, RTCGeometryFlags flags) 
-    : parent(parent), type(type), numPrimitives(numPrimitives), id(0), flags(flags), state(ENABLING),
+    : parent(parent), type(type), numPrimitives(numPrimitives), id(0), flags(flags), state(ENABLING), modCounter(1),
       intersectionFilter1(NULL), occlusionFilter1(NULL),
       intersectionFilter4(NULL), occlusionFilter4(NULL), ispcIntersectionFilter4(NULL), ispcOcclusionFilter4(NULL), 
       intersectionFilter8(NULL), occlusionFilter8(NULL), ispcIntersectionFilter8(NULL), ispcOcclusionFilter8(NULL), 
@@ -41,10 +41,12 @@ namespace embree
       break;
     case DISABLING: 
       state = MODIFIED;
+      modCounter++;
       enabling();
       break;
     case DISABLED: 
       state = ENABLING;
+      modCounter++;
       enabling();
       break;
     case ERASING:
@@ -56,11 +58,14 @@ namespace embree
   {
     switch (state) {
     case ENABLING:
+      modCounter++;
       break;
     case ENABLED:
       state = MODIFIED;
+      modCounter++;
       break;
     case MODIFIED:
+      modCounter++;
       break;
     case DISABLING: 
       break;
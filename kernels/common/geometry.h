@@ -150,8 +150,8 @@ namespace embree
     /*! instances only */
   public:
     
-    /*! Sets transformation of the instance */
-    virtual void setTransform(AffineSpace3fa& transform) {
+    /*! Sets transformation of some time step of the instance */
+    virtual void setTransform(AffineSpace3fa& transform, size_t timeStep) {
       recordError(RTC_INVALID_OPERATION); 
     };
 
@@ -215,6 +215,7 @@ namespace embree
     unsigned id;       //!< internal geometry ID
     RTCGeometryFlags flags;    //!< flags of geometry
     State state;       //!< state of the geometry 
+    size_t modCounter; //!< incremented whenever the geometry needs to get rebuilt
     void* userPtr;     //!< user pointer
 
   public:
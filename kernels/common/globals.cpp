@@ -38,6 +38,8 @@ namespace embree
 
   avxf coeff0[4];
   avxf coeff1[4];
+  avxf bezier_coeff0[4][4];
+  avxf bezier_coeff1[4][4];
 
   void init_globals()
   {
@@ -59,5 +61,24 @@ namespace embree
       coeff1[2] = 3.0f * t1* t1 * t0;
       coeff1[3] = t1 * t1 * t1;
     }
+
+    /* start and end points of the 2^depth segments of a curve subdivided depth times */
+    for (size_t depth=0; depth<4; depth++)
+    {
+      const float dt = 1.0f/float(1 << depth);
+      const avxf t1 = avxf(step)*dt;
+      const avxf t0 = 1.0f-t1;
+      bezier_coeff0[depth][0] = t0 * t0 * t0;
+      bezier_coeff0[depth][1] = 3.0f * t1* t0 * t0;
+      bezier_coeff0[depth][2] = 3.0f * t1* t1 * t0;
+      bezier_coeff0[depth][3] = t1 * t1 * t1;
+
+      const avxf s1 = t1+avxf(dt);
+      const avxf s0 = 1.0f-s1;
+      bezier_coeff1[depth][0] = s0 * s0 * s0;
+      bezier_coeff1[depth][1] = 3.0f * s1* s0 * s0;
+      bezier_coeff1[depth][2] = 3.0f * s1* s1 * s0;
+      bezier_coeff1[depth][3] = s1 * s1 * s1;
+    }
   }
 }
@@ -50,6 +50,7 @@ namespace embree
     mic_i geomID;   //!< geometry ID
     mic_i primID;   //!< primitive ID
     mic_i instID;   //!< instance ID
+    mic_i subInstID[RTC_MAX_INSTANCE_LEVELS-1]; //!< IDs of nested instances below instID
   };
 
   /*! Outputs ray to stream. */
@@ -49,6 +49,7 @@ namespace embree
     ssei geomID;    //!< geometry ID
     ssei primID;    //!< primitive ID
     ssei instID;    //!< instance ID
+    ssei subInstID[RTC_MAX_INSTANCE_LEVELS-1]; //!< IDs of nested instances below instID
   };
 
   /*! Outputs ray to stream. */
@@ -50,6 +50,7 @@ namespace embree
     avxi geomID;    //!< geometry ID
     avxi primID;    //!< primitive ID
     avxi instID;    //!< instance ID
+    avxi subInstID[RTC_MAX_INSTANCE_LEVELS-1]; //!< IDs of nested instances below instID
   };
 
   /*! Outputs ray to stream. */
@@ -0,0 +1,195 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "raystream.h"
+#include "scene.h"
+
+namespace embree
+{
+  /*! number of rays that get sorted together */
+  static const size_t RAY_STREAM_BLOCK_SIZE = 1024;
+
+  /*! number of bits per axis used to quantize the ray origin */
+  static const size_t RAY_STREAM_ORIGIN_BITS = 10;
+
+  /*! selects the packet size to use for tracing streams */
+  static size_t streamPacketSize(const Scene* scene)
+  {
+#if defined(__TARGET_XEON_PHI__)
+    if (scene->aflags & RTC_INTERSECT16) return 16;
+#endif
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+    if ((scene->aflags & RTC_INTERSECT8) && has_feature(AVX)) return 8;
+#endif
+#if !defined(__MIC__)
+    if (scene->aflags & RTC_INTERSECT4) return 4;
+#endif
+    if (scene->aflags & RTC_INTERSECT1) return 1;
+    return 0;
+  }
+
+  /*! sorts a block of rays by direction octant and morton code of the ray origin */
+  template<typename RayStream>
+  static void sortRays(const Scene* scene, const RayStream& stream, size_t begin, size_t end, unsigned* ids_o)
+  {
+    /* quantize ray origins relative to the scene bounds */
+    const float maxCoord = float((1 << RAY_STREAM_ORIGIN_BITS)-1);
+    const BBox3fa bounds = scene->bounds;
+    const Vec3fa lower = bounds.empty() ? Vec3fa(zero) : bounds.lower;
+    const Vec3fa diag  = bounds.empty() ? Vec3fa(zero) : bounds.upper-bounds.lower;
+    const float scaleX = diag.x > 0.0f ? maxCoord/diag.x : 0.0f;
+    const float scaleY = diag.y > 0.0f ? maxCoord/diag.y : 0.0f;
+    const float scaleZ = diag.z > 0.0f ? maxCoord/diag.z : 0.0f;
+
+    /* sort key: 3 bits octant, 30 bits morton code, 16 bits ray index */
+    uint64 keys[RAY_STREAM_BLOCK_SIZE];
+    for (size_t i=begin; i<end; i++)
+    {
+      const Vec3fa org = stream.org(i);
+      const Vec3fa dir = stream.dir(i);
+      const unsigned octant = (dir.x < 0.0f ? 1 : 0) | (dir.y < 0.0f ? 2 : 0) | (dir.z < 0.0f ? 4 : 0);
+      const unsigned x = (unsigned) clamp((org.x-lower.x)*scaleX,0.0f,maxCoord);
+      const unsigned y = (unsigned) clamp((org.y-lower.y)*scaleY,0.0f,maxCoord);
+      const unsigned z = (unsigned) clamp((org.z-lower.z)*scaleZ,0.0f,maxCoord);
+      const uint64 code = (uint64(octant) << 3*RAY_STREAM_ORIGIN_BITS) | uint64(bitInterleave(x,y,z));
+      keys[i-begin] = (code << 16) | uint64(i-begin);
+    }
+    std::sort(keys,keys+(end-begin));
+
+    for (size_t i=0; i<end-begin; i++)
+      ids_o[i] = begin + unsigned(keys[i] & 0xFFFF);
+  }
+
+  /*! calls the packet traversal of the scene */
+  __forceinline void tracePacket(Scene* scene, const int* valid, RTCRay4& ray, bool occluded)
+  {
+    STAT(size_t cnt=0; for (size_t i=0; i<4; i++) cnt += valid[i] == -1;);
+    if (occluded) { STAT3(shadow.travs,1,cnt,4); scene->occluded4(valid,ray); }
+    else          { STAT3(normal.travs,1,cnt,4); scene->intersect4(valid,ray); }
+  }
+
+  __forceinline void tracePacket(Scene* scene, const int* valid, RTCRay8& ray, bool occluded)
+  {
+    STAT(size_t cnt=0; for (size_t i=0; i<8; i++) cnt += valid[i] == -1;);
+    if (occluded) { STAT3(shadow.travs,1,cnt,8); scene->occluded8(valid,ray); }
+    else          { STAT3(normal.travs,1,cnt,8); scene->intersect8(valid,ray); }
+  }
+
+  __forceinline void tracePacket(Scene* scene, const int* valid, RTCRay16& ray, bool occluded)
+  {
+    STAT(size_t cnt=0; for (size_t i=0; i<16; i++) cnt += valid[i] == -1;);
+    if (occluded) { STAT3(shadow.travs,1,cnt,16); scene->occluded16(valid,ray); }
+    else          { STAT3(normal.travs,1,cnt,16); scene->intersect16(valid,ray); }
+  }
+
+  /*! traces the sorted rays in packets of K rays */
+  template<typename RTCRayK, size_t K, typename RayStream>
+  static void tracePackets(Scene* scene, const RayStream& stream, const unsigned* ids, size_t num, bool occluded)
+  {
+    for (size_t i=0; i<num; i+=K)
+    {
+      /* gather rays, inactive slots get a copy of the first ray */
+      const size_t n = min(K,num-i);
+      __aligned(64) int valid[K];
+      RTCRayK ray;
+      for (size_t k=0; k<K; k++) {
+        valid[k] = k < n ? -1 : 0;
+        stream.gather(ids[i+(k < n ? k : 0)],ray,k);
+      }
+
+      tracePacket(scene,valid,ray,occluded);
+
+      /* scatter results of active rays */
+      if (occluded) for (size_t k=0; k<n; k++) stream.scatterOcclusion(ids[i+k],ray,k);
+      else          for (size_t k=0; k<n; k++) stream.scatter(ids[i+k],ray,k);
+    }
+  }
+
+  /*! traces the sorted rays one by one */
+  template<typename RayStream>
+  static void traceSingle(Scene* scene, const RayStream& stream, const unsigned* ids, size_t num, bool occluded)
+  {
+    for (size_t i=0; i<num; i++)
+    {
+      RTCRay ray;
+      stream.gather(ids[i],ray);
+      if (occluded) {
+        STAT3(shadow.travs,1,1,1);
+        scene->occluded(ray);
+        stream.scatterOcclusion(ids[i],ray);
+      } else {
+        STAT3(normal.travs,1,1,1);
+        scene->intersect(ray);
+        stream.scatter(ids[i],ray);
+      }
+    }
+  }
+
+  template<typename RayStream>
+  static void traceStream(Scene* scene, const RayStream& stream, size_t N, bool occluded)
+  {
+    const size_t K = streamPacketSize(scene);
+    if (K == 0) {
+      if (VERBOSE) std::cerr << "Embree: no traversal algorithm enabled for ray streams" << std::endl;
+      recordError(RTC_INVALID_OPERATION);
+      return;
+    }
+
+    unsigned ids[RAY_STREAM_BLOCK_SIZE];
+    for (size_t begin=0; begin<N; begin+=RAY_STREAM_BLOCK_SIZE)
+    {
+      const size_t end = min(begin+RAY_STREAM_BLOCK_SIZE,N);
+      const size_t num = end-begin;
+
+      /* single rays do not benefit from sorting */
+      if (K == 1) {
+        for (size_t i=0; i<num; i++) ids[i] = begin+i;
+        traceSingle(scene,stream,ids,num,occluded);
+        continue;
+      }
+
+      sortRays(scene,stream,begin,end,ids);
+      switch (K) {
+#if !defined(__MIC__)
+      case 4 : tracePackets<RTCRay4,4>(scene,stream,ids,num,occluded); break;
+#endif
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+      case 8 : tracePackets<RTCRay8,8>(scene,stream,ids,num,occluded); break;
+#endif
+#if defined(__TARGET_XEON_PHI__)
+      case 16: tracePackets<RTCRay16,16>(scene,stream,ids,num,occluded); break;
+#endif
+      default: traceSingle(scene,stream,ids,num,occluded); break;
+      }
+    }
+  }
+
+  void intersectStream (Scene* scene, const RayStreamAOS& stream, size_t N) {
+    traceStream(scene,stream,N,false);
+  }
+
+  void intersectStream (Scene* scene, const RayStreamSOA& stream, size_t N) {
+    traceStream(scene,stream,N,false);
+  }
+
+  void occludedStream (Scene* scene, const RayStreamAOS& stream, size_t N) {
+    traceStream(scene,stream,N,true);
+  }
+
+  void occludedStream (Scene* scene, const RayStreamSOA& stream, size_t N) {
+    traceStream(scene,stream,N,true);
+  }
+}
@@ -0,0 +1,223 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "default.h"
+#include "embree2/rtcore_ray.h"
+
+namespace embree
+{
+  class Scene;
+
+  /*! Stream of rays stored in AOS layout. */
+  struct RayStreamAOS
+  {
+    __forceinline RayStreamAOS (RTCRay* rays, size_t stride)
+      : rays((char*)rays), stride(stride) {}
+
+    /*! returns the i'th ray of the stream */
+    __forceinline RTCRay& get(size_t i) const {
+      return *(RTCRay*)(rays + i*stride);
+    }
+
+    __forceinline Vec3fa org(size_t i) const { const RTCRay& ray = get(i); return Vec3fa(ray.org[0],ray.org[1],ray.org[2]); }
+    __forceinline Vec3fa dir(size_t i) const { const RTCRay& ray = get(i); return Vec3fa(ray.dir[0],ray.dir[1],ray.dir[2]); }
+
+    /*! copies the i'th ray of the stream into slot k of a ray packet */
+    template<typename RTCRayK>
+    __forceinline void gather(size_t i, RTCRayK& ray_o, size_t k) const
+    {
+      const RTCRay& ray_i = get(i);
+      ray_o.orgx[k] = ray_i.org[0];
+      ray_o.orgy[k] = ray_i.org[1];
+      ray_o.orgz[k] = ray_i.org[2];
+      ray_o.dirx[k] = ray_i.dir[0];
+      ray_o.diry[k] = ray_i.dir[1];
+      ray_o.dirz[k] = ray_i.dir[2];
+      ray_o.tnear[k] = ray_i.tnear;
+      ray_o.tfar[k] = ray_i.tfar;
+      ray_o.time[k] = ray_i.time;
+      ray_o.mask[k] = ray_i.mask;
+      ray_o.Ngx[k] = ray_i.Ng[0];
+      ray_o.Ngy[k] = ray_i.Ng[1];
+      ray_o.Ngz[k] = ray_i.Ng[2];
+      ray_o.u[k] = ray_i.u;
+      ray_o.v[k] = ray_i.v;
+      ray_o.geomID[k] = ray_i.geomID;
+      ray_o.primID[k] = ray_i.primID;
+      ray_o.instID[k] = ray_i.instID;
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+        ray_o.subInstID[l][k] = ray_i.subInstID[l];
+    }
+
+    /*! copies the hit of slot k of a ray packet back into the i'th ray of the stream */
+    template<typename RTCRayK>
+    __forceinline void scatter(size_t i, const RTCRayK& ray_i, size_t k) const
+    {
+      RTCRay& ray_o = get(i);
+      ray_o.tfar = ray_i.tfar[k];
+      ray_o.Ng[0] = ray_i.Ngx[k];
+      ray_o.Ng[1] = ray_i.Ngy[k];
+      ray_o.Ng[2] = ray_i.Ngz[k];
+      ray_o.u = ray_i.u[k];
+      ray_o.v = ray_i.v[k];
+      ray_o.geomID = ray_i.geomID[k];
+      ray_o.primID = ray_i.primID[k];
+      ray_o.instID = ray_i.instID[k];
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+        ray_o.subInstID[l] = ray_i.subInstID[l][k];
+    }
+
+    /*! copies the occlusion result of slot k of a ray packet back into the i'th ray of the stream */
+    template<typename RTCRayK>
+    __forceinline void scatterOcclusion(size_t i, const RTCRayK& ray_i, size_t k) const {
+      get(i).geomID = ray_i.geomID[k];
+    }
+
+    /*! copies rays for single ray traversal */
+    __forceinline void gather (size_t i, RTCRay& ray_o) const { ray_o = get(i); }
+    __forceinline void scatter(size_t i, const RTCRay& ray_i) const { get(i) = ray_i; }
+    __forceinline void scatterOcclusion(size_t i, const RTCRay& ray_i) const { get(i).geomID = ray_i.geomID; }
+
+  private:
+    char* rays;
+    size_t stride;
+  };
+
+  /*! Stream of rays stored in SOA layout. */
+  struct RayStreamSOA
+  {
+    __forceinline RayStreamSOA (const RTCRayNp& rays, size_t stride)
+      : rays(rays), stride(stride) {}
+
+    /*! returns the i'th element of a component array */
+    template<typename T>
+    __forceinline T& at(T* ptr, size_t i) const {
+      return *(T*)((char*)ptr + i*stride);
+    }
+
+    __forceinline Vec3fa org(size_t i) const { return Vec3fa(at(rays.orgx,i),at(rays.orgy,i),at(rays.orgz,i)); }
+    __forceinline Vec3fa dir(size_t i) const { return Vec3fa(at(rays.dirx,i),at(rays.diry,i),at(rays.dirz,i)); }
+
+    /*! copies the i'th ray of the stream into slot k of a ray packet */
+    template<typename RTCRayK>
+    __forceinline void gather(size_t i, RTCRayK& ray_o, size_t k) const
+    {
+      ray_o.orgx[k] = at(rays.orgx,i);
+      ray_o.orgy[k] = at(rays.orgy,i);
+      ray_o.orgz[k] = at(rays.orgz,i);
+      ray_o.dirx[k] = at(rays.dirx,i);
+      ray_o.diry[k] = at(rays.diry,i);
+      ray_o.dirz[k] = at(rays.dirz,i);
+      ray_o.tnear[k] = at(rays.tnear,i);
+      ray_o.tfar[k] = at(rays.tfar,i);
+      ray_o.time[k] = at(rays.time,i);
+      ray_o.mask[k] = at(rays.mask,i);
+      ray_o.Ngx[k] = at(rays.Ngx,i);
+      ray_o.Ngy[k] = at(rays.Ngy,i);
+      ray_o.Ngz[k] = at(rays.Ngz,i);
+      ray_o.u[k] = at(rays.u,i);
+      ray_o.v[k] = at(rays.v,i);
+      ray_o.geomID[k] = at(rays.geomID,i);
+      ray_o.primID[k] = at(rays.primID,i);
+      ray_o.instID[k] = at(rays.instID,i);
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+        ray_o.subInstID[l][k] = rays.subInstID[l] ? at(rays.subInstID[l],i) : -1;
+    }
+
+    /*! copies the hit of slot k of a ray packet back into the i'th ray of the stream */
+    template<typename RTCRayK>
+    __forceinline void scatter(size_t i, const RTCRayK& ray_i, size_t k) const
+    {
+      at(rays.tfar,i) = ray_i.tfar[k];
+      at(rays.Ngx,i) = ray_i.Ngx[k];
+      at(rays.Ngy,i) = ray_i.Ngy[k];
+      at(rays.Ngz,i) = ray_i.Ngz[k];
+      at(rays.u,i) = ray_i.u[k];
+      at(rays.v,i) = ray_i.v[k];
+      at(rays.geomID,i) = ray_i.geomID[k];
+      at(rays.primID,i) = ray_i.primID[k];
+      at(rays.instID,i) = ray_i.instID[k];
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+        if (rays.subInstID[l]) at(rays.subInstID[l],i) = ray_i.subInstID[l][k];
+    }
+
+    /*! copies the occlusion result of slot k of a ray packet back into the i'th ray of the stream */
+    template<typename RTCRayK>
+    __forceinline void scatterOcclusion(size_t i, const RTCRayK& ray_i, size_t k) const {
+      at(rays.geomID,i) = ray_i.geomID[k];
+    }
+
+    /*! copies rays for single ray traversal */
+    __forceinline void gather (size_t i, RTCRay& ray_o) const
+    {
+      ray_o.org[0] = at(rays.orgx,i);
+      ray_o.org[1] = at(rays.orgy,i);
+      ray_o.org[2] = at(rays.orgz,i);
+      ray_o.dir[0] = at(rays.dirx,i);
+      ray_o.dir[1] = at(rays.diry,i);
+      ray_o.dir[2] = at(rays.dirz,i);
+      ray_o.tnear = at(rays.tnear,i);
+      ray_o.tfar = at(rays.tfar,i);
+      ray_o.time = at(rays.time,i);
+      ray_o.mask = at(rays.mask,i);
+      ray_o.Ng[0] = at(rays.Ngx,i);
+      ray_o.Ng[1] = at(rays.Ngy,i);
+      ray_o.Ng[2] = at(rays.Ngz,i);
+      ray_o.u = at(rays.u,i);
+      ray_o.v = at(rays.v,i);
+      ray_o.geomID = at(rays.geomID,i);
+      ray_o.primID = at(rays.primID,i);
+      ray_o.instID = at(rays.instID,i);
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+        ray_o.subInstID[l] = rays.subInstID[l] ? at(rays.subInstID[l],i) : -1;
+    }
+
+    __forceinline void scatter(size_t i, const RTCRay& ray_i) const
+    {
+      at(rays.tfar,i) = ray_i.tfar;
+      at(rays.Ngx,i) = ray_i.Ng[0];
+      at(rays.Ngy,i) = ray_i.Ng[1];
+      at(rays.Ngz,i) = ray_i.Ng[2];
+      at(rays.u,i) = ray_i.u;
+      at(rays.v,i) = ray_i.v;
+      at(rays.geomID,i) = ray_i.geomID;
+      at(rays.primID,i) = ray_i.primID;
+      at(rays.instID,i) = ray_i.instID;
+      for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+        if (rays.subInstID[l]) at(rays.subInstID[l],i) = ray_i.subInstID[l];
+    }
+
+    __forceinline void scatterOcclusion(size_t i, const RTCRay& ray_i) const {
+      at(rays.geomID,i) = ray_i.geomID;
+    }
+
+  private:
+    RTCRayNp rays;
+    size_t stride;
+  };
+
+  /*! Intersects a stream of rays with the scene. The rays are sorted
+   *  by direction octant and origin and traced in packets of the
+   *  widest packet size enabled for the scene. */
+  void intersectStream (Scene* scene, const RayStreamAOS& stream, size_t N);
+  void intersectStream (Scene* scene, const RayStreamSOA& stream, size_t N);
+
+  /*! Tests a stream of rays for occlusion. */
+  void occludedStream (Scene* scene, const RayStreamAOS& stream, size_t N);
+  void occludedStream (Scene* scene, const RayStreamSOA& stream, size_t N);
+}
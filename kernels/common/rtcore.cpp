@@ -24,6 +24,7 @@
 #include "common/alloc.h"
 #include "embree2/rtcore.h"
 #include "common/scene.h"
+#include "common/raystream.h"
 #include "sys/taskscheduler.h"
 #include "sys/thread.h"
 
@@ -66,6 +67,7 @@ namespace embree
   void BVH4MBRegister();
   void BVH16iRegister();
 #if defined(__TARGET_AVX__)
+  void BVH8Register();
   void BVH4HairRegister();
 #endif
 
@@ -81,10 +83,15 @@ namespace embree
   std::string g_hair_accel = "default";    //!< hair acceleration structure to use
   std::string g_builder = "default";      //!< builder to use
   std::string g_traverser = "default";    //!< traverser to use
+  std::string g_scheduler = "default";    //!< task scheduler to use
   int g_scene_flags = -1;       //!< scene flags to use
   size_t g_verbose = 0;                   //!< verbosity of output
   size_t g_numThreads = 0;                //!< number of threads to use in builders
   size_t g_benchmark = 0;
+  size_t g_refit_budget = 0;              //!< time in microseconds to spend on optimizing the refitted BVHs of each commit
+  size_t g_presplits = 0;                 //!< additional primitive references in percent used to pre-split primitives
+  size_t g_morton_bits = 32;              //!< number of bits of the morton codes used by the morton builders
+  size_t g_restructure_passes = 0;        //!< number of treelet restructuring passes applied after morton builds
 
   /* error flag */
   static tls_t g_error = NULL;
@@ -162,10 +169,18 @@ namespace embree
     g_tri_accel = "default";
     g_builder = "default";
     g_traverser = "default";
+    g_scheduler = "default";
     g_scene_flags = -1;
     g_verbose = 0;
     g_numThreads = 0;
     g_benchmark = 0;
+    g_refit_budget = 0;
+    g_presplits = 0;
+    g_morton_bits = 32;
+    g_restructure_passes = 0;
+
+    bool hugepages = false;
+    std::string numa = "default";
 
     if (cfg != NULL) 
     {
@@ -215,6 +230,18 @@ namespace embree
           if (parseSymbol (cfg,'=',pos))
             g_traverser = parseIdentifier (cfg,pos);
         }
+        else if (tok == "scheduler") {
+          if (parseSymbol (cfg,'=',pos))
+            g_scheduler = parseIdentifier (cfg,pos);
+        }
+        else if (tok == "hugepages") {
+          if (parseSymbol (cfg,'=',pos))
+            hugepages = parseInt (cfg,pos);
+        }
+        else if (tok == "numa") {
+          if (parseSymbol (cfg,'=',pos))
+            numa = parseIdentifier (cfg,pos);
+        }
         else if (tok == "verbose") {
           if (parseSymbol (cfg,'=',pos))
             g_verbose = parseInt (cfg,pos);
@@ -223,6 +250,22 @@ namespace embree
           if (parseSymbol (cfg,'=',pos))
             g_benchmark = parseInt (cfg,pos);
         }
+        else if (tok == "refitbudget") {
+          if (parseSymbol (cfg,'=',pos))
+            g_refit_budget = parseInt (cfg,pos);
+        }
+        else if (tok == "presplits") {
+          if (parseSymbol (cfg,'=',pos))
+            g_presplits = parseInt (cfg,pos);
+        }
+        else if (tok == "mortonbits") {
+          if (parseSymbol (cfg,'=',pos))
+            g_morton_bits = parseInt (cfg,pos);
+        }
+        else if (tok == "restructure") {
+          if (parseSymbol (cfg,'=',pos))
+            g_restructure_passes = parseInt (cfg,pos);
+        }
         else if (tok == "flags") {
           g_scene_flags = 0;
           if (parseSymbol (cfg,'=',pos)) {
@@ -234,6 +277,7 @@ namespace embree
               else if (flag == "coherent") g_scene_flags |= RTC_SCENE_COHERENT;
               else if (flag == "incoherent") g_scene_flags |= RTC_SCENE_INCOHERENT;
               else if (flag == "high_quality") g_scene_flags |= RTC_SCENE_HIGH_QUALITY;
+              else if (flag == "progressive") g_scene_flags |= RTC_SCENE_PROGRESSIVE;
               else if (flag == "robust") g_scene_flags |= RTC_SCENE_ROBUST;
             } while (parseSymbol (cfg,',',pos));
           }
@@ -258,6 +302,14 @@ namespace embree
     }
 #endif
 
+    /* configure memory allocation */
+    NumaPolicy numaPolicy = NUMA_DEFAULT;
+    if      (numa == "default"   ) numaPolicy = NUMA_DEFAULT;
+    else if (numa == "interleave") numaPolicy = NUMA_INTERLEAVE;
+    else if (numa == "firsttouch") numaPolicy = NUMA_FIRST_TOUCH;
+    else throw std::runtime_error("unknown NUMA policy "+numa);
+    os_configure(hugepages,numaPolicy);
+
     g_error = createTls();
 
     init_globals();
@@ -276,6 +328,8 @@ namespace embree
 #endif
 
 #if defined(__TARGET_AVX__)
+    if (has_feature(AVX))
+      BVH8Register();
     BVH4HairRegister();
 #endif
 
@@ -289,9 +343,16 @@ namespace embree
       PRINT(g_tri_accel);
       PRINT(g_builder);
       PRINT(g_traverser);
+      PRINT(g_scheduler);
+      PRINT(hugepages);
+      PRINT(numa);
     }
 
-    TaskScheduler::create(g_numThreads);
+    TaskScheduler::TYPE scheduler = TaskScheduler::DEFAULT;
+    if      (g_scheduler == "default" ) scheduler = TaskScheduler::DEFAULT;
+    else if (g_scheduler == "stealing") scheduler = TaskScheduler::STEALING;
+    else throw std::runtime_error("unknown task scheduler "+g_scheduler);
+    TaskScheduler::create(g_numThreads,scheduler);
 
     CATCH_END;
   }
@@ -390,6 +451,35 @@ namespace embree
     ((Scene*)scene)->build();
     CATCH_END;
   }
+
+  RTCORE_API void rtcCommitAsync (RTCScene scene, RTCCommitFunc func, void* userPtr) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcCommitAsync);
+    VERIFY_HANDLE(scene);
+    ((Scene*)scene)->buildAsync(func,userPtr);
+    CATCH_END;
+  }
+
+  RTCORE_API void rtcSaveScene (RTCScene scene, const char* filename) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcSaveScene);
+    VERIFY_HANDLE(scene);
+    VERIFY_HANDLE(filename);
+    ((Scene*)scene)->store(filename);
+    CATCH_END;
+  }
+
+  RTCORE_API void rtcLoadScene (RTCScene scene, const char* filename) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcLoadScene);
+    VERIFY_HANDLE(scene);
+    VERIFY_HANDLE(filename);
+    ((Scene*)scene)->restore(filename);
+    CATCH_END;
+  }
   
   RTCORE_API void rtcIntersect (RTCScene scene, RTCRay& ray) 
   {
@@ -483,12 +573,47 @@ namespace embree
 #endif
   }
   
+  RTCORE_API void rtcIntersectN (RTCScene scene, RTCRay* rays, size_t N, size_t stride) 
+  {
+    TRACE(rtcIntersectN);
+    if (stride < sizeof(RTCRay)) {
+      if (VERBOSE) std::cerr << "Embree: invalid ray stride" << std::endl;
+      recordError(RTC_INVALID_ARGUMENT);
+      return;
+    }
+    intersectStream((Scene*)scene,RayStreamAOS(rays,stride),N);
+  }
+
+  RTCORE_API void rtcIntersectNp (RTCScene scene, const RTCRayNp& rays, size_t N, size_t stride) 
+  {
+    TRACE(rtcIntersectNp);
+    intersectStream((Scene*)scene,RayStreamSOA(rays,stride),N);
+  }
+
+  RTCORE_API void rtcOccludedN (RTCScene scene, RTCRay* rays, size_t N, size_t stride) 
+  {
+    TRACE(rtcOccludedN);
+    if (stride < sizeof(RTCRay)) {
+      if (VERBOSE) std::cerr << "Embree: invalid ray stride" << std::endl;
+      recordError(RTC_INVALID_ARGUMENT);
+      return;
+    }
+    occludedStream((Scene*)scene,RayStreamAOS(rays,stride),N);
+  }
+
+  RTCORE_API void rtcOccludedNp (RTCScene scene, const RTCRayNp& rays, size_t N, size_t stride) 
+  {
+    TRACE(rtcOccludedNp);
+    occludedStream((Scene*)scene,RayStreamSOA(rays,stride),N);
+  }
+  
   RTCORE_API void rtcDeleteScene (RTCScene scene) 
   {
     CATCH_BEGIN;
     TRACE(rtcDeleteScene);
     VERIFY_HANDLE(scene);
     delete (Scene*) scene;
+    Alloc::global.clear(); // return memory of freed blocks to the OS
     CATCH_END;
   }
 
@@ -498,15 +623,32 @@ namespace embree
     TRACE(rtcNewInstance);
     VERIFY_HANDLE(target);
     VERIFY_HANDLE(source);
-    return ((Scene*) target)->newInstance((Scene*) source);
+    return ((Scene*) target)->newInstance((Scene*) source,1);
     CATCH_END;
     return -1;
   }
 
-  RTCORE_API void rtcSetTransform (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm) 
+  RTCORE_API unsigned rtcNewInstance2 (RTCScene target, RTCScene source, size_t numTimeSteps) 
   {
     CATCH_BEGIN;
+    TRACE(rtcNewInstance2);
+    VERIFY_HANDLE(target);
+    VERIFY_HANDLE(source);
+    return ((Scene*) target)->newInstance((Scene*) source,numTimeSteps);
+    CATCH_END;
+    return -1;
+  }
+
+  RTCORE_API void rtcSetTransform (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm) 
+  {
     TRACE(rtcSetTransform);
+    rtcSetTransform2(scene,geomID,layout,xfm,0);
+  }
+
+  RTCORE_API void rtcSetTransform2 (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm, size_t timeStep) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcSetTransform2);
     VERIFY_HANDLE(scene);
     VERIFY_GEOMID(geomID);
     VERIFY_HANDLE(xfm);
@@ -539,7 +681,7 @@ namespace embree
       ERROR("Unknown matrix type");
       break;
     }
-    ((Scene*) scene)->get_locked(geomID)->setTransform(transform);
+    ((Scene*) scene)->get_locked(geomID)->setTransform(transform,timeStep);
 
     CATCH_END;
   }
@@ -569,7 +711,17 @@ namespace embree
     CATCH_BEGIN;
     TRACE(rtcNewBezierCurves);
     VERIFY_HANDLE(scene);
-    return ((Scene*)scene)->newBezierCurves(flags,numCurves,numVertices,numTimeSteps);
+    return ((Scene*)scene)->newBezierCurves(flags,RTC_CURVE_RIBBON,numCurves,numVertices,numTimeSteps);
+    CATCH_END;
+    return -1;
+  }
+
+  RTCORE_API unsigned rtcNewBezierCurves2 (RTCScene scene, RTCGeometryFlags flags, RTCCurveType type, size_t numCurves, size_t numVertices, size_t numTimeSteps) 
+  {
+    CATCH_BEGIN;
+    TRACE(rtcNewBezierCurves2);
+    VERIFY_HANDLE(scene);
+    return ((Scene*)scene)->newBezierCurves(flags,type,numCurves,numVertices,numTimeSteps);
     CATCH_END;
     return -1;
   }
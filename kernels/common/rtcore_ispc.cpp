@@ -114,10 +114,18 @@ namespace embree
     return rtcNewInstance(target,source);
   }
   
+  extern "C" unsigned ispcNewInstance2 (RTCScene target, RTCScene source, size_t numTimeSteps) {
+    return rtcNewInstance2(target,source,numTimeSteps);
+  }
+  
   extern "C" void ispcSetTransform (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm) {
     return rtcSetTransform(scene,geomID,layout,xfm);
   }
   
+  extern "C" void ispcSetTransform2 (RTCScene scene, unsigned geomID, RTCMatrixType layout, const float* xfm, size_t timeStep) {
+    return rtcSetTransform2(scene,geomID,layout,xfm,timeStep);
+  }
+  
   extern "C" unsigned ispcNewUserGeometry (RTCScene scene, size_t numItems) {
     return rtcNewUserGeometry(scene,numItems);
   }
@@ -129,6 +137,10 @@ namespace embree
   extern "C" unsigned ispcNewBezierCurves (RTCScene scene, RTCGeometryFlags flags, size_t numCurves, size_t numVertices, size_t numTimeSteps) {
     return rtcNewBezierCurves(scene,flags,numCurves,numVertices,numTimeSteps);
   }
+
+  extern "C" unsigned ispcNewBezierCurves2 (RTCScene scene, RTCGeometryFlags flags, RTCCurveType type, size_t numCurves, size_t numVertices, size_t numTimeSteps) {
+    return rtcNewBezierCurves2(scene,flags,type,numCurves,numVertices,numTimeSteps);
+  }
   
   extern "C" void ispcSetRayMask (RTCScene scene, unsigned geomID, int mask) {
     rtcSetMask(scene,geomID,mask);
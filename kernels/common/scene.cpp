@@ -22,6 +22,7 @@
 #include "bvh4/bvh4.h"
 #include "bvh4i/bvh4i.h"
 #include "bvh8i/bvh8i.h"
+#include "bvh8/bvh8.h"
 #include "bvh4mb/bvh4mb.h"
 #else
 #include "xeonphi/bvh4i/bvh4i.h"
@@ -36,18 +37,23 @@ namespace embree
   };
 
   Scene::Scene (RTCSceneFlags sflags, RTCAlgorithmFlags aflags)
-    : flags(sflags), aflags(aflags), numMappedBuffers(0), is_build(false), needTriangles(false), needVertices(false),
+    : accels(new AccelN), shadowAccels(NULL), flags(sflags), aflags(aflags), numMappedBuffers(0), is_build(false), needTriangles(false), needVertices(false),
       numTriangleMeshes(0), numTriangleMeshes2(0), numCurves(0), numCurves2(0), numUserGeometries(0),
-      flat_triangle_source_1(this,1), flat_triangle_source_2(this,2), bezier_source_1(this,1)
+      flat_triangle_source_1(this,1), flat_triangle_source_2(this,2), bezier_source_1(this,1), bezier_source_2(this,2),
+      asyncBuild(false), asyncError(RTC_NO_ERROR), commitFunc(NULL), commitUserPtr(NULL)
   {
     if (g_scene_flags != -1)
       flags = (RTCSceneFlags) g_scene_flags;
 
     geometries.reserve(128);
+    createAccels(accels);
+  }
 
+  void Scene::createAccels (AccelN* accels)
+  {
 #if defined(__MIC__)
 
-    accels.add(BVH4mb::BVH4mbTriangle1ObjectSplitBinnedSAH(this));
+    accels->add(BVH4mb::BVH4mbTriangle1ObjectSplitBinnedSAH(this));
 
     if (g_tri_accel == "default" || g_tri_accel == "bvh4i")   
       {
@@ -56,143 +62,165 @@ namespace embree
 	    if (isStatic())
 	      {
 		if (g_verbose >= 1) std::cout << "STATIC BUILDER MODE" << std::endl;
-		accels.add(BVH4i::BVH4iTriangle1ObjectSplitBinnedSAH(this));
+		accels->add(BVH4i::BVH4iTriangle1ObjectSplitBinnedSAH(this));
 	      }
 	    else
 	      {
 		if (g_verbose >= 1) std::cout << "DYNAMIC BUILDER MODE" << std::endl;
-		accels.add(BVH4i::BVH4iTriangle1ObjectSplitMorton(this));
+		accels->add(BVH4i::BVH4iTriangle1ObjectSplitMorton(this));
 	      }
 	  }
 	else
 	  {
 	    if (g_builder == "sah" || g_builder == "bvh4i" || g_builder == "bvh4i.sah") {
-	      accels.add(BVH4i::BVH4iTriangle1ObjectSplitBinnedSAH(this));
+	      accels->add(BVH4i::BVH4iTriangle1ObjectSplitBinnedSAH(this));
 	    }
 	    else if (g_builder == "fast" || g_builder == "morton") {
-	      accels.add(BVH4i::BVH4iTriangle1ObjectSplitMorton(this));
+	      accels->add(BVH4i::BVH4iTriangle1ObjectSplitMorton(this));
 	    }
 	    else if (g_builder == "fast_enhanced" || g_builder == "morton.enhanced") {
-	      accels.add(BVH4i::BVH4iTriangle1ObjectSplitEnhancedMorton(this));
+	      accels->add(BVH4i::BVH4iTriangle1ObjectSplitEnhancedMorton(this));
 	    }
 	    else if (g_builder == "high_quality" || g_builder == "presplits") {
-	      accels.add(BVH4i::BVH4iTriangle1PreSplitsBinnedSAH(this));
+	      accels->add(BVH4i::BVH4iTriangle1PreSplitsBinnedSAH(this));
 	    }
 	    else throw std::runtime_error("unknown builder "+g_builder+" for BVH4i<Triangle1>");
 	  }
       }
     // else if (g_tri_accel == "bvh4mb") {
-    //   accels.add(BVH4mb::BVH4mbTriangle1ObjectSplitBinnedSAH(this));
+    //   accels->add(BVH4mb::BVH4mbTriangle1ObjectSplitBinnedSAH(this));
     // }
     else if (g_tri_accel == "bvh16i") {
-      accels.add(BVH16i::BVH16iTriangle1ObjectSplitBinnedSAH(this));
+      accels->add(BVH16i::BVH16iTriangle1ObjectSplitBinnedSAH(this));
     }
     else throw std::runtime_error("unknown accel "+g_tri_accel);
 
-    accels.add(BVH4i::BVH4iVirtualGeometryBinnedSAH(this));
+    accels->add(BVH4i::BVH4iVirtualGeometryBinnedSAH(this));
 
 #else
 
-    /* create default acceleration structure */
+    /* create default acceleration structure, progressive scenes use two level structures */
     if (g_tri_accel == "default") 
     {
-      if (isStatic()) {
+      if (isStatic() && !isProgressive()) {
         int mode =  4*(int)isCoherent() + 2*(int)isCompact() + 1*(int)isRobust();
         switch (mode) {
         case /*0b000*/ 0: 
 #if defined (__TARGET_AVX__)
           if (has_feature(AVX2) && aflags == RTC_INTERSECT1) 
           {
-            if (isHighQuality()) accels.add(BVH4::BVH4Triangle8SpatialSplit(this)); 
-            else                 accels.add(BVH4::BVH4Triangle8ObjectSplit(this)); 
+            if (isHighQuality()) accels->add(BVH8::BVH8Triangle8SpatialSplit(this)); 
+            else                 accels->add(BVH8::BVH8Triangle8ObjectSplit(this)); 
+          }
+          else if (has_feature(AVX))
+          {
+            if (isHighQuality()) accels->add(BVH8::BVH8Triangle4SpatialSplit(this)); 
+            else                 accels->add(BVH8::BVH8Triangle4ObjectSplit(this)); 
           }
           else 
 #endif
           {
-            if (isHighQuality()) accels.add(BVH4::BVH4Triangle4SpatialSplit(this));
-            else                 accels.add(BVH4::BVH4Triangle4ObjectSplit(this)); 
+            if (isHighQuality()) accels->add(BVH4::BVH4Triangle4SpatialSplit(this));
+            else                 accels->add(BVH4::BVH4Triangle4ObjectSplit(this)); 
           }
           break;
 
-        case /*0b001*/ 1: accels.add(BVH4::BVH4Triangle4vObjectSplit(this)); break;
-        case /*0b010*/ 2: accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); break;
-        case /*0b011*/ 3: accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); break;
+        case /*0b001*/ 1: accels->add(BVH4::BVH4Triangle4vObjectSplit(this)); break;
+        case /*0b010*/ 2: accels->add(BVH4::BVH4Triangle4iObjectSplitQuantized(this)); break;
+        case /*0b011*/ 3: accels->add(BVH4::BVH4Triangle4iObjectSplitQuantized(this)); break;
         case /*0b100*/ 4: 
-          if (isHighQuality()) accels.add(BVH4::BVH4Triangle1SpatialSplit(this));
-          else                 accels.add(BVH4::BVH4Triangle1ObjectSplit(this)); 
+          if (isHighQuality()) accels->add(BVH4::BVH4Triangle1SpatialSplit(this));
+          else                 accels->add(BVH4::BVH4Triangle1ObjectSplit(this)); 
           break;
-        case /*0b101*/ 5: accels.add(BVH4::BVH4Triangle1vObjectSplit(this)); break;
-        case /*0b110*/ 6: accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); break;
-        case /*0b111*/ 7: accels.add(BVH4::BVH4Triangle4iObjectSplit(this)); break;
+        case /*0b101*/ 5: accels->add(BVH4::BVH4Triangle1vObjectSplit(this)); break;
+        case /*0b110*/ 6: accels->add(BVH4::BVH4Triangle4iObjectSplitQuantized(this)); break;
+        case /*0b111*/ 7: accels->add(BVH4::BVH4Triangle4iObjectSplitQuantized(this)); break;
         }
-        accels.add(BVH4MB::BVH4MBTriangle1v(this)); 
-        accels.add(new TwoLevelAccel("bvh4",this)); 
+        accels->add(BVH4MB::BVH4MBTriangle1v(this)); 
+#if defined(__TARGET_AVX__)
+        if (has_feature(AVX)) accels->add(new TwoLevelAccel("bvh8",this)); 
+        else
+#endif
+        accels->add(new TwoLevelAccel("bvh4",this)); 
         
 #if defined(__TARGET_AVX__)
         // FIXME:
-        if      (g_hair_accel == "bvh4.bezier1i"   ) accels.add(BVH4::BVH4Bezier1i(this));
-        else if (g_hair_accel == "bvh4hair.bezier1") accels.add(BVH4Hair::BVH4HairBezier1(this));
-        else accels.add(BVH4::BVH4Bezier1i(this));
+        if      (g_hair_accel == "bvh4.bezier1i"   ) accels->add(BVH4::BVH4Bezier1i(this));
+        else if (g_hair_accel == "bvh8.bezier1i"   ) accels->add(BVH8::BVH8Bezier1i(this));
+        else if (g_hair_accel == "bvh4hair.bezier1") accels->add(BVH4Hair::BVH4HairBezier1(this));
+        else if (has_feature(AVX)) accels->add(BVH8::BVH8Bezier1i(this));
+        else accels->add(BVH4::BVH4Bezier1i(this));
+        accels->add(BVH4::BVH4Bezier1iMB(this));
 #endif
       } 
       else 
       {
         int mode =  4*(int)isCoherent() + 2*(int)isCompact() + 1*(int)isRobust();
         switch (mode) {
-        case /*0b000*/ 0: accels.add(BVH4::BVH4BVH4Triangle4ObjectSplit(this)); break;
-        case /*0b001*/ 1: accels.add(BVH4::BVH4BVH4Triangle4vObjectSplit(this)); break;
-        case /*0b010*/ 2: accels.add(BVH4::BVH4BVH4Triangle4vObjectSplit(this)); break;
-        case /*0b011*/ 3: accels.add(BVH4::BVH4BVH4Triangle4vObjectSplit(this)); break;
-        case /*0b100*/ 4: accels.add(BVH4::BVH4BVH4Triangle1ObjectSplit(this)); break;
-        case /*0b101*/ 5: accels.add(BVH4::BVH4BVH4Triangle1vObjectSplit(this)); break;
-        case /*0b110*/ 6: accels.add(BVH4::BVH4BVH4Triangle1vObjectSplit(this)); break;
-        case /*0b111*/ 7: accels.add(BVH4::BVH4BVH4Triangle1vObjectSplit(this)); break;
+        case /*0b000*/ 0: accels->add(BVH4::BVH4BVH4Triangle4ObjectSplit(this)); break;
+        case /*0b001*/ 1: accels->add(BVH4::BVH4BVH4Triangle4vObjectSplit(this)); break;
+        case /*0b010*/ 2: accels->add(BVH4::BVH4BVH4Triangle4vObjectSplit(this)); break;
+        case /*0b011*/ 3: accels->add(BVH4::BVH4BVH4Triangle4vObjectSplit(this)); break;
+        case /*0b100*/ 4: accels->add(BVH4::BVH4BVH4Triangle1ObjectSplit(this)); break;
+        case /*0b101*/ 5: accels->add(BVH4::BVH4BVH4Triangle1vObjectSplit(this)); break;
+        case /*0b110*/ 6: accels->add(BVH4::BVH4BVH4Triangle1vObjectSplit(this)); break;
+        case /*0b111*/ 7: accels->add(BVH4::BVH4BVH4Triangle1vObjectSplit(this)); break;
         }
-        accels.add(BVH4MB::BVH4MBTriangle1v(this));
-        accels.add(new TwoLevelAccel("bvh4",this));
-        accels.add(BVH4::BVH4Bezier1i(this));
+        accels->add(BVH4MB::BVH4MBTriangle1v(this));
+        accels->add(new TwoLevelAccel("bvh4",this));
+        accels->add(BVH4::BVH4Bezier1i(this));
+        accels->add(BVH4::BVH4Bezier1iMB(this));
       }
     }
 
     /* create user specified acceleration structure */
     else
     {
-      if      (g_tri_accel == "bvh4.bvh4.triangle1.morton") accels.add(BVH4::BVH4BVH4Triangle1Morton(this));
-      else if (g_tri_accel == "bvh4.bvh4.triangle1")    accels.add(BVH4::BVH4BVH4Triangle1ObjectSplit(this));
-      else if (g_tri_accel == "bvh4.bvh4.triangle4")    accels.add(BVH4::BVH4BVH4Triangle4ObjectSplit(this));
-      else if (g_tri_accel == "bvh4.bvh4.triangle1v")   accels.add(BVH4::BVH4BVH4Triangle1vObjectSplit(this));
-      else if (g_tri_accel == "bvh4.bvh4.triangle4v")   accels.add(BVH4::BVH4BVH4Triangle4vObjectSplit(this));
-      else if (g_tri_accel == "bvh4.triangle1")         accels.add(BVH4::BVH4Triangle1(this));
-      else if (g_tri_accel == "bvh4.triangle4")         accels.add(BVH4::BVH4Triangle4(this));
+      if      (g_tri_accel == "bvh4.bvh4.triangle1.morton") accels->add(BVH4::BVH4BVH4Triangle1Morton(this));
+      else if (g_tri_accel == "bvh4.bvh4.triangle1")    accels->add(BVH4::BVH4BVH4Triangle1ObjectSplit(this));
+      else if (g_tri_accel == "bvh4.bvh4.triangle4")    accels->add(BVH4::BVH4BVH4Triangle4ObjectSplit(this));
+      else if (g_tri_accel == "bvh4.bvh4.triangle1v")   accels->add(BVH4::BVH4BVH4Triangle1vObjectSplit(this));
+      else if (g_tri_accel == "bvh4.bvh4.triangle4v")   accels->add(BVH4::BVH4BVH4Triangle4vObjectSplit(this));
+      else if (g_tri_accel == "bvh4.triangle1")         accels->add(BVH4::BVH4Triangle1(this));
+      else if (g_tri_accel == "bvh4.triangle4")         accels->add(BVH4::BVH4Triangle4(this));
 #if defined (__TARGET_AVX__)
-      else if (g_tri_accel == "bvh4.triangle8")         accels.add(BVH4::BVH4Triangle8(this));
+      else if (g_tri_accel == "bvh4.triangle8")         accels->add(BVH4::BVH4Triangle8(this));
 #endif
-      else if (g_tri_accel == "bvh4.triangle1v")        accels.add(BVH4::BVH4Triangle1v(this));
-      else if (g_tri_accel == "bvh4.triangle4v")        accels.add(BVH4::BVH4Triangle4v(this));
-      else if (g_tri_accel == "bvh4.triangle4i")        accels.add(BVH4::BVH4Triangle4i(this));
-      else if (g_tri_accel == "bvh4i.triangle1")        accels.add(BVH4i::BVH4iTriangle1(this));
-      else if (g_tri_accel == "bvh4i.triangle4")        accels.add(BVH4i::BVH4iTriangle4(this));
+      else if (g_tri_accel == "bvh4.triangle1v")        accels->add(BVH4::BVH4Triangle1v(this));
+      else if (g_tri_accel == "bvh4.triangle4v")        accels->add(BVH4::BVH4Triangle4v(this));
+      else if (g_tri_accel == "bvh4.triangle4i")        accels->add(BVH4::BVH4Triangle4i(this));
+      else if (g_tri_accel == "bvh4.triangle4i.quantized") accels->add(BVH4::BVH4Triangle4iObjectSplitQuantized(this));
+      else if (g_tri_accel == "bvh4i.triangle1")        accels->add(BVH4i::BVH4iTriangle1(this));
+      else if (g_tri_accel == "bvh4i.triangle4")        accels->add(BVH4i::BVH4iTriangle4(this));
 #if defined (__TARGET_AVX__)
-      else if (g_tri_accel == "bvh4i.triangle8")        accels.add(BVH4i::BVH4iTriangle8(this));
+      else if (g_tri_accel == "bvh4i.triangle8")        accels->add(BVH4i::BVH4iTriangle8(this));
+#endif
+      else if (g_tri_accel == "bvh4i.triangle1.v1")     accels->add(BVH4i::BVH4iTriangle1_v1(this));
+      else if (g_tri_accel == "bvh4i.triangle1.v2")     accels->add(BVH4i::BVH4iTriangle1_v2(this));
+      else if (g_tri_accel == "bvh4i.triangle1.morton") accels->add(BVH4i::BVH4iTriangle1_morton(this));
+      else if (g_tri_accel == "bvh4i.triangle1.morton.enhanced") accels->add(BVH4i::BVH4iTriangle1_morton_enhanced(this));
+#if defined (__TARGET_AVX__)
+      else if (g_tri_accel == "bvh8.triangle4")         accels->add(BVH8::BVH8Triangle4(this));
+      else if (g_tri_accel == "bvh8.triangle8")         accels->add(BVH8::BVH8Triangle8(this));
 #endif
-      else if (g_tri_accel == "bvh4i.triangle1.v1")     accels.add(BVH4i::BVH4iTriangle1_v1(this));
-      else if (g_tri_accel == "bvh4i.triangle1.v2")     accels.add(BVH4i::BVH4iTriangle1_v2(this));
-      else if (g_tri_accel == "bvh4i.triangle1.morton") accels.add(BVH4i::BVH4iTriangle1_morton(this));
-      else if (g_tri_accel == "bvh4i.triangle1.morton.enhanced") accels.add(BVH4i::BVH4iTriangle1_morton_enhanced(this));
 #if !defined(__WIN32__) && defined (__TARGET_AVX__)
-      else if (g_tri_accel == "bvh8i.triangle8")        accels.add(BVH8i::BVH8iTriangle8(this));
+      else if (g_tri_accel == "bvh8i.triangle8")        accels->add(BVH8i::BVH8iTriangle8(this));
 #endif
       else throw std::runtime_error("unknown triangle acceleration structure "+g_tri_accel);
 
-      accels.add(new TwoLevelAccel("default",this));
+      accels->add(new TwoLevelAccel("default",this));
     }
 #endif
   }
   
   Scene::~Scene () 
   {
+    waitAsync();
+    waitPrebuilds();
     for (size_t i=0; i<geometries.size(); i++)
       delete geometries[i];
+    delete accels;
+    delete shadowAccels;
   }
 
   unsigned Scene::newUserGeometry (size_t items) 
@@ -201,11 +229,61 @@ namespace embree
     return geom->id;
   }
   
-  unsigned Scene::newInstance (Scene* scene) {
-    Geometry* geom = new UserGeometryScene::Instance(this,scene);
+  unsigned Scene::newInstance (Scene* scene, size_t numTimeSteps) 
+  {
+    /* instantiating a scene into itself would recurse endlessly during traversal */
+    if (scene == this || scene->instantiates(this)) {
+      recordError(RTC_INVALID_ARGUMENT);
+      return -1;
+    }
+
+    if (numTimeSteps == 0 || numTimeSteps > RTC_MAX_TIME_STEPS) {
+      recordError(RTC_INVALID_OPERATION);
+      return -1;
+    }
+
+    Geometry* geom = new UserGeometryScene::Instance(this,scene,numTimeSteps);
     return geom->id;
   }
 
+  bool Scene::instantiates (const Scene* scene) const
+  {
+    for (size_t i=0; i<geometries.size(); i++) 
+    {
+      const Geometry* geom = geometries[i];
+      if (geom == NULL || geom->type != INSTANCES) continue;
+      const Scene* object = (const Scene*) ((const UserGeometryScene::Instance*) geom)->object;
+      if (object == scene || object->instantiates(scene)) return true;
+    }
+    return false;
+  }
+
+  /*! maximal number of time steps of motion blur geometries, the Xeon Phi kernels only support two time steps */
+#if defined(__MIC__)
+  static const size_t maxTimeSteps = 2;
+#else
+  static const size_t maxTimeSteps = RTC_MAX_TIME_STEPS;
+#endif
+
+  /*! maximal number of time segments of all motion blur meshes of a scene, the motion blur BVH builds one tree per time segment */
+  static const size_t maxTimeSegments = maxTimeSteps-1;
+
+  size_t Scene::timeSegments (size_t numTimeSteps) const
+  {
+    /* least common multiple of the time segments of all motion blur meshes */
+    size_t numSegments = max(numTimeSteps,size_t(2))-1;
+    for (size_t i=0; i<geometries.size(); i++) 
+    {
+      const Geometry* geom = geometries[i];
+      if (geom == NULL || geom->type != TRIANGLE_MESH) continue;
+      const size_t n = max(size_t(((const TriangleMesh*)geom)->numTimeSteps),size_t(2))-1;
+      size_t a = numSegments, b = n;
+      while (b) { const size_t r = a%b; a = b; b = r; }
+      numSegments = numSegments/a*n;
+    }
+    return numSegments;
+  }
+
   unsigned Scene::newTriangleMesh (RTCGeometryFlags gflags, size_t numTriangles, size_t numVertices, size_t numTimeSteps) 
   {
     if (isStatic() && (gflags != RTC_GEOMETRY_STATIC)) {
@@ -213,7 +291,13 @@ namespace embree
       return -1;
     }
 
-    if (numTimeSteps == 0 || numTimeSteps > 2) {
+    if (numTimeSteps == 0 || numTimeSteps > maxTimeSteps) {
+      recordError(RTC_INVALID_OPERATION);
+      return -1;
+    }
+
+    /* the time segments of all motion blur meshes have to fit into maxTimeSegments */
+    if (numTimeSteps > 2 && timeSegments(numTimeSteps) > maxTimeSegments) {
       recordError(RTC_INVALID_OPERATION);
       return -1;
     }
@@ -222,19 +306,24 @@ namespace embree
     return geom->id;
   }
 
-  unsigned Scene::newBezierCurves (RTCGeometryFlags gflags, size_t numCurves, size_t numVertices, size_t numTimeSteps) 
+  unsigned Scene::newBezierCurves (RTCGeometryFlags gflags, RTCCurveType type, size_t numCurves, size_t numVertices, size_t numTimeSteps) 
   {
     if (isStatic() && (gflags != RTC_GEOMETRY_STATIC)) {
       recordError(RTC_INVALID_OPERATION);
       return -1;
     }
 
-    if (numTimeSteps == 0 || numTimeSteps > 2) {
+    if (numTimeSteps == 0 || numTimeSteps > maxTimeSteps) {
       recordError(RTC_INVALID_OPERATION);
       return -1;
     }
+
+    if (type != RTC_CURVE_RIBBON && type != RTC_CURVE_ROUND) {
+      recordError(RTC_INVALID_ARGUMENT);
+      return -1;
+    }
     
-    Geometry* geom = new BezierCurves(this,gflags,numCurves,numVertices,numTimeSteps);
+    Geometry* geom = new BezierCurves(this,gflags,type,numCurves,numVertices,numTimeSteps);
     return geom->id;
   }
 
@@ -262,23 +351,22 @@ namespace embree
     delete geometry;
   }
 
-  void Scene::build (size_t threadIndex, size_t threadCount) {
-    accels.build(threadIndex,threadCount);
+  void Scene::build (size_t threadIndex, size_t threadCount) 
+  {
+    /* all refitted BVHs of the scene share the optimization budget */
+    refitBudget = g_refit_budget;
+
+    /* the background build goes into the shadow acceleration structures */
+    if (shadowAccels) shadowAccels->build(threadIndex,threadCount);
+    else              accels->build(threadIndex,threadCount);
   }
 
   void Scene::task_build(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
     build(threadIndex,threadCount);
   }
 
-  void Scene::build () 
+  void Scene::verify ()
   {
-    Lock<MutexSys> lock(mutex);
-
-    if ((isStatic() && isBuild()) || !ready()) {
-      recordError(RTC_INVALID_OPERATION);
-      return;
-    }
-
     /* verify geometry in debug mode  */
 #if defined(DEBUG)
     for (size_t i=0; i<geometries.size(); i++) {
@@ -290,6 +378,26 @@ namespace embree
       }
     }
 #endif
+  }
+
+  void Scene::build () 
+  {
+    Lock<MutexSys> lock(mutex);
+    waitAsync();
+    waitPrebuilds();
+
+    /* report errors of the last background build */
+    if (asyncError != RTC_NO_ERROR) {
+      recordError(asyncError);
+      asyncError = RTC_NO_ERROR;
+    }
+
+    if ((isStatic() && isBuild()) || !ready()) {
+      recordError(RTC_INVALID_OPERATION);
+      return;
+    }
+
+    verify();
 
     /* spawn build task */
     TaskScheduler::EventSync event;
@@ -297,50 +405,366 @@ namespace embree
     TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_FRONT,&task);
     event.sync();
 
+    finalize();
+  }
+
+  void Scene::buildAsync (RTCCommitFunc func, void* userPtr) 
+  {
+    Lock<MutexSys> lock(mutex);
+    waitAsync();
+    waitPrebuilds();
+
+    /* report errors of the last background build */
+    if (asyncError != RTC_NO_ERROR) {
+      recordError(asyncError);
+      asyncError = RTC_NO_ERROR;
+    }
+
+    if ((isStatic() && isBuild()) || !ready()) {
+      recordError(RTC_INVALID_OPERATION);
+      return;
+    }
+
+    verify();
+
+    /* rays traverse the current acceleration structures during the
+     * build, thus committed scenes get built into a second set */
+    if (isBuild() && shadowAccels == NULL) {
+      shadowAccels = new AccelN;
+      createAccels(shadowAccels);
+    }
+
+    /* spawn build task, the task signals completion itself */
+    commitFunc = func;
+    commitUserPtr = userPtr;
+    {
+      Lock<MutexSys> lock(asyncMutex);
+      asyncBuild = true;
+    }
+    new (&task) TaskScheduler::Task(NULL,NULL,NULL,1,_task_build_async,this,"scene_build_async");
+    TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_FRONT,&task);
+  }
+
+  void Scene::task_build_async(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) 
+  {
+    try {
+      build(threadIndex,threadCount);
+      finalize();
+    } 
+    catch (const std::bad_alloc&) {
+      asyncError = RTC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+      asyncError = RTC_UNKNOWN_ERROR;
+    }
+
+    /* the application may commit or delete the scene from inside
+     * the commit function, thus the build has to be marked as done
+     * before and the scene must not get accessed afterwards */
+    RTCCommitFunc func = commitFunc;
+    void* userPtr = commitUserPtr;
+    {
+      Lock<MutexSys> lock(asyncMutex);
+      asyncBuild = false;
+      asyncCondition.broadcast();
+    }
+    if (func) func(userPtr,(RTCScene)this);
+  }
+
+  void Scene::waitAsync ()
+  {
+    Lock<MutexSys> lock(asyncMutex);
+    while (asyncBuild) asyncCondition.wait(asyncMutex);
+  }
+
+  void Scene::prebuild (Geometry* geometry)
+  {
+    {
+      Lock<MutexSys> lock(prebuildMutex);
+      prebuilding.insert(geometry->id);
+    }
+    PrebuildTask* task = new PrebuildTask(this,geometry->id);
+    new (&task->task) TaskScheduler::Task(NULL,NULL,NULL,1,PrebuildTask::_task_prebuild,task,"scene_prebuild");
+    TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_BACK,&task->task);
+  }
+
+  void Scene::PrebuildTask::task_prebuild(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) 
+  {
+    /* a failed background build leaves the geometry to the next scene build */
+    try {
+      scene->accels->prebuild(threadIndex,threadCount,geomID);
+    } catch (...) {
+    }
+
+    Scene* scene = this->scene;
+    const size_t geomID = this->geomID;
+    delete this;
+    Lock<MutexSys> lock(scene->prebuildMutex);
+    scene->prebuilding.erase(geomID);
+    scene->prebuildCondition.broadcast();
+  }
+
+  void Scene::waitPrebuild (Geometry* geometry)
+  {
+    Lock<MutexSys> lock(prebuildMutex);
+    while (prebuilding.find(geometry->id) != prebuilding.end()) 
+      prebuildCondition.wait(prebuildMutex);
+  }
+
+  void Scene::waitPrebuilds ()
+  {
+    Lock<MutexSys> lock(prebuildMutex);
+    while (!prebuilding.empty()) prebuildCondition.wait(prebuildMutex);
+  }
+
+  void Scene::finalize () 
+  {
     /* make static geometry immutable */
     if (isStatic()) 
     {
-      accels.immutable();
+      accels->immutable();
       for (size_t i=0; i<geometries.size(); i++)
         geometries[i]->immutable();
     }
 
-    /* delete geometry that is scheduled for delete */
+    /* swap in the acceleration structures built in the background */
+    if (shadowAccels) std::swap(accels,shadowAccels);
+
+    /* delete geometry that is scheduled for delete, the shadow
+     * acceleration structures drop it during the next build */
+    std::vector<Geometry*> erased;
     for (size_t i=0; i<geometries.size(); i++) 
     {
       Geometry* geom = geometries[i];
       if (geom == NULL || geom->state != Geometry::ERASING) continue;
-      remove(geom);
+      if (shadowAccels == NULL || std::find(erasing.begin(),erasing.end(),geom) != erasing.end()) remove(geom);
+      else erased.push_back(geom);
     }
+    erasing.swap(erased);
 
     /* update bounds */
-    bounds = accels.bounds;
-    intersectors = accels.intersectors;
+    bounds = accels->bounds;
+    Accel::Intersectors isects = accels->intersectors;
+    const bool recommit = is_build;
     is_build = true;
 
+    /* scenes that can get committed again always dispatch through
+     * AccelN, such that swapping in the acceleration structures built
+     * in the background only changes the pointer passed to the
+     * intersectors */
+    if (!isStatic()) {
+      isects.ptr = accels;
+      isects.intersector1 = Accel::Intersector1(&AccelN::intersect,&AccelN::occluded,"AccelN::intersector1");
+      isects.intersector4 = Accel::Intersector4(&AccelN::intersect4,&AccelN::occluded4,"AccelN::intersector4");
+      isects.intersector8 = Accel::Intersector8(&AccelN::intersect8,&AccelN::occluded8,"AccelN::intersector8");
+      isects.intersector16= Accel::Intersector16(&AccelN::intersect16,&AccelN::occluded16,"AccelN::intersector16");
+    }
+
     /* enable only algorithms choosen by application */
     if ((aflags & RTC_INTERSECT1) == 0) {
-      intersectors.intersector1.intersect = NULL;
-      intersectors.intersector1.occluded = NULL;
+      isects.intersector1.intersect = NULL;
+      isects.intersector1.occluded = NULL;
     }
     if ((aflags & RTC_INTERSECT4) == 0) {
-      intersectors.intersector4.intersect = NULL;
-      intersectors.intersector4.occluded = NULL;
+      isects.intersector4.intersect = NULL;
+      isects.intersector4.occluded = NULL;
     }
     if ((aflags & RTC_INTERSECT8) == 0) {
-      intersectors.intersector8.intersect = NULL;
-      intersectors.intersector8.occluded = NULL;
+      isects.intersector8.intersect = NULL;
+      isects.intersector8.occluded = NULL;
     }
     if ((aflags & RTC_INTERSECT16) == 0) {
-      intersectors.intersector16.intersect = NULL;
-      intersectors.intersector16.occluded = NULL;
+      isects.intersector16.intersect = NULL;
+      isects.intersector16.occluded = NULL;
     }
+    __memory_barrier();
+
+    /* rays may traverse the scene while it gets committed again, thus
+     * only the pointer gets replaced, using a single store */
+    if (recommit && !isStatic()) *(void* volatile*)&intersectors.ptr = accels;
+    else intersectors = isects;
 
     if (g_verbose >= 2) {
       std::cout << "created scene intersector" << std::endl;
-      accels.print(2);
+      accels->print(2);
       std::cout << "selected scene intersector" << std::endl;
       intersectors.print(2);
     }
   }
+
+  /*! header of a file storing the acceleration structures of a scene */
+  struct SceneFileHeader
+  {
+    char magic[8];                 //!< identifies scene files
+    unsigned int version;          //!< version of the file format
+    unsigned int pointerBytes;     //!< size of pointers
+    uint64 signature;              //!< signature of the stored scene
+    uint64 numAccels;              //!< number of acceleration structures
+    uint64 offset[16];             //!< file offset of each acceleration structure
+    uint64 bytes[16];              //!< size of each acceleration structure, 0 if empty
+  };
+
+  static const char sceneFileMagic[8] = "embree";
+  static const unsigned int sceneFileVersion = 2;
+
+  /*! acceleration structures are aligned for memory mapping on all platforms */
+  static const size_t sceneFileAlignment = 64*1024;
+
+  /*! FNV-1a hash of a 64 bit value */
+  static __forceinline uint64 hash(uint64 h, uint64 value) 
+  {
+    for (size_t i=0; i<8; i++) {
+      h ^= (value >> (8*i)) & 0xFF;
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  static uint64 fileTell(FILE* file) 
+  {
+#if defined(_WIN32)
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+  }
+
+  static bool fileSeek(FILE* file, uint64 pos) 
+  {
+#if defined(_WIN32)
+    return _fseeki64(file,pos,SEEK_SET) == 0;
+#else
+    return fseeko(file,pos,SEEK_SET) == 0;
+#endif
+  }
+
+  static uint64 fileSize(FILE* file) 
+  {
+#if defined(_WIN32)
+    if (_fseeki64(file,0,SEEK_END) != 0) return 0;
+#else
+    if (fseeko(file,0,SEEK_END) != 0) return 0;
+#endif
+    return fileTell(file);
+  }
+
+  uint64 Scene::signature () const
+  {
+    uint64 h = 14695981039346656037ull;
+    h = hash(h,flags);
+    h = hash(h,aflags);
+    h = hash(h,accels->N);
+    h = hash(h,geometries.size());
+    for (size_t i=0; i<geometries.size(); i++)
+    {
+      const Geometry* geom = geometries[i];
+      if (geom == NULL) { h = hash(h,(uint64)-1); continue; }
+      h = hash(h,geom->type);
+      h = hash(h,geom->flags);
+      h = hash(h,geom->numPrimitives);
+      h = hash(h,geom->isEnabled());
+      if (geom->type == TRIANGLE_MESH) {
+        const TriangleMesh* mesh = (const TriangleMesh*) geom;
+        h = hash(h,mesh->numVertices);
+        h = hash(h,mesh->numTimeSteps);
+        h = hash(h,mesh->mask);
+      }
+    }
+    return h;
+  }
+
+  void Scene::store (const char* filename) 
+  {
+    Lock<MutexSys> lock(mutex);
+    waitAsync();
+
+    if (!isBuild()) {
+      recordError(RTC_INVALID_OPERATION);
+      return;
+    }
+
+    FILE* file = fopen(filename,"wb");
+    if (file == NULL) {
+      if (VERBOSE) std::cerr << "Embree: cannot open file " << filename << std::endl;
+      recordError(RTC_INVALID_ARGUMENT);
+      return;
+    }
+
+    SceneFileHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,sceneFileMagic,sizeof(header.magic));
+    header.version = sceneFileVersion;
+    header.pointerBytes = sizeof(void*);
+    header.signature = signature();
+    header.numAccels = accels->N;
+
+    /* write all non-empty acceleration structures, the header gets written last */
+    bool ok = accels->N <= sizeof(header.offset)/sizeof(header.offset[0]);
+    uint64 pos = 0;
+    for (size_t i=0; ok && i<accels->N; i++)
+    {
+      if (accels->accels[i]->bounds.empty()) continue;
+      if (pos < sizeof(header)) pos = sizeof(header);
+      header.offset[i] = (pos+sceneFileAlignment-1) & ~(uint64)(sceneFileAlignment-1);
+      ok = fileSeek(file,header.offset[i]) && accels->accels[i]->store(file);
+      pos = fileTell(file);
+      header.bytes[i] = pos-header.offset[i];
+    }
+    ok = ok && fileSeek(file,0) && fwrite(&header,sizeof(header),1,file) == 1;
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok) {
+      if (VERBOSE) std::cerr << "Embree: scene cannot get stored to " << filename << std::endl;
+      ::remove(filename);
+      recordError(RTC_INVALID_OPERATION);
+    }
+  }
+
+  void Scene::restore (const char* filename) 
+  {
+    Lock<MutexSys> lock(mutex);
+    waitAsync();
+    waitPrebuilds();
+
+    if (isBuild() || !ready()) {
+      recordError(RTC_INVALID_OPERATION);
+      return;
+    }
+
+    /* the stored scene has to match the configuration and geometries of this scene */
+    SceneFileHeader header;
+    FILE* file = fopen(filename,"rb");
+    bool ok = file && fread(&header,sizeof(header),1,file) == 1;
+    const uint64 bytesFile = ok ? fileSize(file) : 0;
+    if (file) fclose(file);
+    ok = ok && memcmp(header.magic,sceneFileMagic,sizeof(header.magic)) == 0;
+    ok = ok && header.version == sceneFileVersion && header.pointerBytes == sizeof(void*);
+    ok = ok && header.signature == signature() && header.numAccels == accels->N;
+    ok = ok && accels->N <= sizeof(header.offset)/sizeof(header.offset[0]);
+
+    /* the acceleration structures of a truncated file would get mapped beyond the end of the file */
+    for (size_t i=0; ok && i<accels->N; i++) {
+      if (header.bytes[i] == 0) continue;
+      ok = (header.offset[i] & (sceneFileAlignment-1)) == 0;
+      ok = ok && header.offset[i] <= bytesFile && header.bytes[i] <= bytesFile-header.offset[i];
+    }
+
+    /* map all stored acceleration structures, a failure releases the ones mapped before */
+    size_t numRestored = 0;
+    for (; ok && numRestored<accels->N; numRestored++) {
+      if (header.bytes[numRestored] == 0) continue;
+      ok = accels->accels[numRestored]->restore(filename,header.offset[numRestored],header.bytes[numRestored]);
+    }
+
+    if (!ok) {
+      for (size_t i=0; i<numRestored; i++) 
+        accels->accels[i]->unmap();
+      if (VERBOSE) std::cerr << "Embree: scene cannot get restored from " << filename << std::endl;
+      recordError(RTC_INVALID_OPERATION);
+      return;
+    }
+
+    accels->select();
+    finalize();
+  }
 }
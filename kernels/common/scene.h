@@ -25,6 +25,7 @@
 #include "common/acceln.h"
 #include "geometry.h"
 #include "common/buildsource.h"
+#include "sys/sync/condition.h"
 
 //#define PRE_SUBDIVISION_HACK
 
@@ -46,23 +47,80 @@ namespace embree
     unsigned int newUserGeometry (size_t items);
 
     /*! Creates a new scene instance. */
-    unsigned int newInstance (Scene* scene);
+    unsigned int newInstance (Scene* scene, size_t numTimeSteps);
+
+    /*! Checks if the scene contains instances of some scene, directly or nested. */
+    bool instantiates (const Scene* scene) const;
 
     /*! Creates a new triangle mesh. */
     unsigned int newTriangleMesh (RTCGeometryFlags flags, size_t maxTriangles, size_t maxVertices, size_t numTimeSteps);
 
+    /*! Number of time segments required for all motion blur meshes of the scene and a new mesh with numTimeSteps time steps. */
+    size_t timeSegments (size_t numTimeSteps) const;
+
     /*! Creates a new collection of quadratic bezier curves. */
-    unsigned int newBezierCurves (RTCGeometryFlags flags, size_t maxCurves, size_t maxVertices, size_t numTimeSteps);
+    unsigned int newBezierCurves (RTCGeometryFlags flags, RTCCurveType type, size_t maxCurves, size_t maxVertices, size_t numTimeSteps);
 
     /*! Builds acceleration structure for the scene. */
     void build ();
 
     void build (size_t threadIndex, size_t threadCount);
 
+    /*! Builds acceleration structure for the scene in the background
+     *  and calls the commit function once the build finished. */
+    void buildAsync (RTCCommitFunc func, void* userPtr);
+
+    /*! Waits until a background build of the scene finished. */
+    void waitAsync ();
+
+    /*! Stores the acceleration structures of a committed scene into a file. */
+    void store (const char* filename);
+
+    /*! Commits the scene using the acceleration structures restored from a file. */
+    void restore (const char* filename);
+
     /*! build task */
     TASK_COMPLETE_FUNCTION(Scene,task_build);
+    TASK_COMPLETE_FUNCTION(Scene,task_build_async);
     TaskScheduler::Task task;
 
+    /*! Builds the acceleration structure of a geometry in the background. */
+    void prebuild (Geometry* geometry);
+
+    /*! Waits until the background build of a geometry finished. */
+    void waitPrebuild (Geometry* geometry);
+
+    /*! Waits until all background builds of geometries finished. */
+    void waitPrebuilds ();
+
+  private:
+
+    /*! background build of a single geometry */
+    struct PrebuildTask 
+    {
+      PrebuildTask (Scene* scene, size_t geomID) : scene(scene), geomID(geomID) {}
+      TASK_COMPLETE_FUNCTION(PrebuildTask,task_prebuild);
+      TaskScheduler::Task task;
+      Scene* scene;
+      size_t geomID;
+    };
+
+  private:
+
+    /*! Creates the acceleration structures selected by the scene flags. */
+    void createAccels (AccelN* accels);
+
+    /*! Verifies the geometries in debug mode. */
+    void verify ();
+
+    /*! Makes the built acceleration structures available for tracing rays. */
+    void finalize ();
+
+    /*! Hash of the scene configuration and geometry layout a stored scene has to match. */
+    uint64 signature () const;
+
+  public:
+
     /* return number of geometries */
     __forceinline size_t size() const { return geometries.size(); }
     
@@ -129,6 +187,7 @@ namespace embree
     __forceinline bool isCoherent() const { return embree::isCoherent(flags); }
     __forceinline bool isRobust() const { return embree::isRobust(flags); }
     __forceinline bool isHighQuality() const { return embree::isHighQuality(flags); }
+    __forceinline bool isProgressive() const { return embree::isProgressive(flags); }
 
     /* test if scene got already build */
     __forceinline bool isBuild() const { return is_build; }
@@ -151,7 +210,7 @@ namespace embree
       {
         if (scene->get(group) == NULL || scene->get(group)->type != TRIANGLE_MESH) return 0;
         TriangleMesh* mesh = scene->getTriangleMesh(group);
-        if (mesh == NULL || !mesh->isEnabled() || mesh->numTimeSteps != numTimeSteps) return 0;
+        if (mesh == NULL || !mesh->isEnabled() || (mesh->numTimeSteps > 1) != (numTimeSteps > 1)) return 0;
         if (numVertices) *numVertices = mesh->numVertices;
         return mesh->numTriangles;
       }
@@ -181,6 +240,23 @@ namespace embree
         }
       }
 
+      const BBox3fa bounds(size_t group, size_t prim, float time0, float time1) const 
+      {
+	assert(scene->get(group) != NULL);
+	assert(scene->get(group)->type == TRIANGLE_MESH);
+
+        TriangleMesh* mesh = scene->getTriangleMesh(group);
+        if (mesh == NULL) return empty;
+        return mesh->bounds(prim,time0,time1);
+      }
+
+      size_t timeSteps(size_t group) const 
+      {
+        TriangleMesh* mesh = scene->getTriangleMeshSafe(group);
+        if (mesh == NULL) return 1;
+        return mesh->numTimeSteps;
+      }
+
       const Vec3fa vertex(size_t group, size_t prim, size_t vtxID) const 
       {
 	assert(scene->get(group) != NULL);
@@ -206,7 +282,7 @@ namespace embree
       
     public:
       Scene* scene;
-      size_t numTimeSteps;
+      size_t numTimeSteps;  //!< 1 selects static meshes, 2 selects all motion blur meshes
     };
 
     struct BezierBuildSource : public BuildSource
@@ -227,7 +303,7 @@ namespace embree
       {
         if (scene->get(group) == NULL || scene->get(group)->type != BEZIER_CURVES) return 0;
         BezierCurves* curves = scene->getBezierCurves(group);
-        if (!curves->isEnabled() || curves->numTimeSteps != numTimeSteps) return 0;
+        if (!curves->isEnabled() || (curves->numTimeSteps > 1) != (numTimeSteps > 1)) return 0;
         if (numVertices) *numVertices = curves->numVertices;
 #if defined(PRE_SUBDIVISION_HACK)
         return 8*curves->numCurves;
@@ -251,7 +327,7 @@ namespace embree
 
     public:
       Scene* scene;
-      size_t numTimeSteps;
+      size_t numTimeSteps;  //!< 1 selects static curves, 2 selects all motion blur curves
     };
 
     
@@ -260,8 +336,11 @@ namespace embree
     std::vector<Geometry*> geometries; //!< list of all user geometries
     
   public:
-    AccelN accels;
+    AccelN* accels;                    //!< acceleration structures used for tracing rays
+    AccelN* shadowAccels;              //!< acceleration structures the next commit builds into, if any
+    std::vector<Geometry*> erasing;    //!< erased geometries the shadow acceleration structures still refer to
     atomic_t numMappedBuffers;         //!< number of mapped buffers
+    AtomicCounter refitBudget;         //!< time in microseconds left to optimize refitted BVHs during the current build
     RTCSceneFlags flags;
     RTCAlgorithmFlags aflags;
     bool needTriangles;
@@ -270,6 +349,19 @@ namespace embree
     MutexSys mutex;
     AtomicMutex geometriesMutex;
 
+  private:
+    MutexSys prebuildMutex;            //!< protects the set of running background builds
+    ConditionSys prebuildCondition;    //!< signals that a background build finished
+    std::set<size_t> prebuilding;      //!< IDs of the geometries with running background builds
+
+  private:
+    MutexSys asyncMutex;               //!< protects the state of the background scene build
+    ConditionSys asyncCondition;       //!< signals that the background scene build finished
+    bool asyncBuild;                   //!< set while the scene gets built in the background
+    RTCError asyncError;               //!< error of the last background scene build
+    RTCCommitFunc commitFunc;          //!< function called when the background scene build finished
+    void* commitUserPtr;               //!< user pointer passed to the commit function
+
   public:
     atomic_t numTriangleMeshes;        //!< number of enabled triangle meshes
     atomic_t numTriangleMeshes2;       //!< number of enabled motion blur triangle meshes
@@ -281,6 +373,7 @@ namespace embree
     FlatTriangleAccelBuildSource flat_triangle_source_1;
     FlatTriangleAccelBuildSource flat_triangle_source_2;
     BezierBuildSource bezier_source_1;
+    BezierBuildSource bezier_source_2;
   };
 
   typedef Builder* (*TriangleMeshBuilderFunc)(void* accel, TriangleMesh* mesh, const size_t minLeafSize, const size_t maxLeafSize);
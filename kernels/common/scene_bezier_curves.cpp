@@ -19,19 +19,24 @@
 
 namespace embree
 {
-  BezierCurves::BezierCurves (Scene* parent, RTCGeometryFlags flags, size_t numCurves, size_t numVertices, size_t numTimeSteps) 
+  BezierCurves::BezierCurves (Scene* parent, RTCGeometryFlags flags, RTCCurveType type, size_t numCurves, size_t numVertices, size_t numTimeSteps) 
     : Geometry(parent,BEZIER_CURVES,numCurves,flags), 
-      mask(-1), built(false), numTimeSteps(numTimeSteps),
+      mask(-1), built(false), numTimeSteps(numTimeSteps), type(type),
       numCurves(numCurves), needCurves(false),
       numVertices(numVertices), needVertices(false)
   {
     curves.init(numCurves,sizeof(int));
+    vertices = new BufferT<Vertex>[numTimeSteps];
     for (size_t i=0; i<numTimeSteps; i++) {
       vertices[i].init(numVertices,sizeof(Vertex));
     }
     enabling();
   }
 
+  BezierCurves::~BezierCurves () {
+    delete[] vertices;
+  }
+
   void BezierCurves::enabling() 
   { 
     if (numTimeSteps == 1) atomic_add(&parent->numCurves ,numCurves); 
@@ -104,7 +109,7 @@ namespace embree
 
     /* verify that all vertex accesses are 16 bytes aligned */
 #if defined(__MIC__)
-    if (type == RTC_VERTEX_BUFFER0 || type == RTC_VERTEX_BUFFER1) {
+    if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+RTC_MAX_TIME_STEPS) {
       if (((size_t(ptr) + offset) & 0xF) || (stride & 0xF)) {
         recordError(RTC_INVALID_OPERATION);
         return;
@@ -112,27 +117,19 @@ namespace embree
     }
 #endif
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : 
+    if (type == RTC_INDEX_BUFFER) {
       curves.set(ptr,offset,stride); 
-      break;
-    case RTC_VERTEX_BUFFER0: 
-      vertices[0].set(ptr,offset,stride); 
-      if (numVertices) {
-        /* test if array is properly padded */
-        volatile int w = *((int*)&vertices[0][numVertices-1]+3); // FIXME: is failing hard avoidable?
-      }
-      break;
-    case RTC_VERTEX_BUFFER1: 
-      vertices[1].set(ptr,offset,stride); 
+    }
+    else if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps) {
+      const size_t t = type-RTC_VERTEX_BUFFER0;
+      vertices[t].set(ptr,offset,stride); 
       if (numVertices) {
         /* test if array is properly padded */
-        volatile int w = *((int*)&vertices[1][numVertices-1]+3); // FIXME: is failing hard avoidable?
+        volatile int w = *((int*)&vertices[t][numVertices-1]+3); // FIXME: is failing hard avoidable?
       }
-      break;
-    default: 
-      recordError(RTC_INVALID_ARGUMENT); break;
     }
+    else 
+      recordError(RTC_INVALID_ARGUMENT);
   }
 
   void* BezierCurves::map(RTCBufferType type) 
@@ -142,14 +139,13 @@ namespace embree
       return NULL;
     }
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : return curves.map(parent->numMappedBuffers);
-    case RTC_VERTEX_BUFFER0: return vertices[0].map(parent->numMappedBuffers);
-    case RTC_VERTEX_BUFFER1: return vertices[1].map(parent->numMappedBuffers);
-    default: 
-      recordError(RTC_INVALID_ARGUMENT); 
-      return NULL;
-    }
+    if (type == RTC_INDEX_BUFFER) 
+      return curves.map(parent->numMappedBuffers);
+    if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps) 
+      return vertices[type-RTC_VERTEX_BUFFER0].map(parent->numMappedBuffers);
+
+    recordError(RTC_INVALID_ARGUMENT); 
+    return NULL;
   }
 
   void BezierCurves::unmap(RTCBufferType type) 
@@ -159,12 +155,10 @@ namespace embree
       return;
     }
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : curves.unmap(parent->numMappedBuffers); break;
-    case RTC_VERTEX_BUFFER0: vertices[0].unmap(parent->numMappedBuffers); break;
-    case RTC_VERTEX_BUFFER1: vertices[1].unmap(parent->numMappedBuffers); break;
-    default                : recordError(RTC_INVALID_ARGUMENT); break;
-    }
+    if      (type == RTC_INDEX_BUFFER) curves.unmap(parent->numMappedBuffers);
+    else if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps) 
+      vertices[type-RTC_VERTEX_BUFFER0].unmap(parent->numMappedBuffers);
+    else recordError(RTC_INVALID_ARGUMENT);
   }
 
   void BezierCurves::setUserData (void* ptr, bool ispc) {
@@ -174,11 +168,11 @@ namespace embree
   void BezierCurves::immutable () 
   {
     built = true;
-    bool freeCurves    = !needCurves;
+    bool freeCurves    = !needCurves && numTimeSteps == 1; // motion blur curves look up their control points when intersected
     bool freeVertices  = !(needVertices || parent->needVertices);
     if (freeCurves   ) curves.free();
-    if (freeVertices ) vertices[0].free();
-    if (freeVertices ) vertices[1].free();
+    if (freeVertices ) 
+      for (size_t i=0; i<numTimeSteps; i++) vertices[i].free();
   }
 
   bool BezierCurves::verify () 
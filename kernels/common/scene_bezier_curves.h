@@ -30,7 +30,8 @@ namespace embree
       };
 
     public:
-      BezierCurves (Scene* parent, RTCGeometryFlags flags, size_t numCurves, size_t numVertices, size_t numTimeSteps); 
+      BezierCurves (Scene* parent, RTCGeometryFlags flags, RTCCurveType type, size_t numCurves, size_t numVertices, size_t numTimeSteps); 
+      ~BezierCurves ();
       
     public:
       void setMask (unsigned mask);
@@ -76,16 +77,31 @@ namespace embree
 
       __forceinline const Vec3fa& vertex(size_t i, size_t j = 0) const {
         assert(i < numVertices);
-        assert(j < 2);
+        assert(j < numTimeSteps);
         return (Vec3fa&)vertices[j][i];
       }
 
       __forceinline float radius(size_t i, size_t j = 0) const {
         assert(i < numVertices);
-        assert(j < 2);
+        assert(j < numTimeSteps);
         return vertices[j][i].r;
       }
 
+      /*! returns the time segment between two time steps that contains the specified time */
+      __forceinline size_t timeSegment(float time) const {
+        assert(numTimeSteps > 1);
+        const int segment = (int)floorf(time*float(numTimeSteps-1));
+        return (size_t) clamp(segment,0,int(numTimeSteps)-2);
+      }
+
+      /*! linearly interpolates the control point and its radius
+       *  between the time steps of the specified time segment */
+      __forceinline Vec3fa interpolatedVertex(size_t i, size_t segment, float time) const {
+        const Vec3fa& p0 = vertex(i,segment+0);
+        const Vec3fa& p1 = vertex(i,segment+1);
+        return p0 + (time*float(numTimeSteps-1)-float(segment))*(p1-p0);
+      }
+
       __forceinline unsigned int maxSubdivisionSteps(const float eps, const Vec3fa& p0, const Vec3fa& p1, const Vec3fa& p2, const Vec3fa& p3) const {
 	const Vec3fa d0 = abs(p0 - 2.0f * p1 + p2);
 	const Vec3fa d1 = abs(p1 - 2.0f * p2 + p3);
@@ -96,18 +112,54 @@ namespace embree
 	return (unsigned int)logf(r0);
       }
 
+      /*! Returns the number of subdivision levels (0 to 3) the curve
+       *  gets intersected with. The distance of a cubic bezier curve
+       *  to the polyline of its 2^d subdivided segments is bounded by
+       *  3/4 of the largest second difference of its control points
+       *  divided by 4^d, we subdivide until this bound is a small
+       *  fraction of the smallest radius of the curve. Motion blur
+       *  curves use the largest depth of all their time steps. */
+      __forceinline unsigned int subdivisionDepth(size_t i) const 
+      {
+        const int index = curve(i);
+        float L0 = 0.0f, r = inf;
+        for (size_t j=0; j<numTimeSteps; j++) 
+        {
+          const Vec3fa& p0 = vertex(index+0,j);
+          const Vec3fa& p1 = vertex(index+1,j);
+          const Vec3fa& p2 = vertex(index+2,j);
+          const Vec3fa& p3 = vertex(index+3,j);
+          r = min(r,radius(index+0,j),radius(index+1,j),radius(index+2,j),radius(index+3,j));
+          L0 = max(L0,length(p0 - 2.0f*p1 + p2),length(p1 - 2.0f*p2 + p3));
+        }
+        float err = 0.75f*L0;
+        const float eps = 0.25f*r;
+        unsigned int depth = 0;
+        while (depth < 3 && !(err <= eps)) { err *= 0.25f; depth++; }
+        return depth;
+      }
 
+      /*! bounds of the curve, motion blur curves are bounded over all time steps */
       __forceinline BBox3fa bounds(size_t i) const 
+      {
+        BBox3fa b = empty;
+        for (size_t j=0; j<numTimeSteps; j++) 
+          b.extend(bounds(i,j));
+        return b;
+      }
+
+      /*! bounds of the curve at the specified time step */
+      __forceinline BBox3fa bounds(size_t i, size_t j) const 
       {
         const int index = curve(i);
-        const float r0 = radius(index+0);
-        const float r1 = radius(index+1);
-        const float r2 = radius(index+2);
-        const float r3 = radius(index+3);
-        const Vec3fa& v0 = vertex(index+0);
-        const Vec3fa& v1 = vertex(index+1);
-        const Vec3fa& v2 = vertex(index+2);
-        const Vec3fa& v3 = vertex(index+3);
+        const float r0 = radius(index+0,j);
+        const float r1 = radius(index+1,j);
+        const float r2 = radius(index+2,j);
+        const float r3 = radius(index+3,j);
+        const Vec3fa& v0 = vertex(index+0,j);
+        const Vec3fa& v1 = vertex(index+1,j);
+        const Vec3fa& v2 = vertex(index+2,j);
+        const Vec3fa& v3 = vertex(index+3,j);
 
 #if 0
 	BBox3fa b;
@@ -132,18 +184,26 @@ namespace embree
 
 
       __forceinline BBox3fa subBounds(size_t curveID, size_t segmentID) const 
+      {
+        BBox3fa b = empty;
+        for (size_t j=0; j<numTimeSteps; j++) 
+          b.extend(subBounds(curveID,segmentID,j));
+        return b;
+      }
+
+      __forceinline BBox3fa subBounds(size_t curveID, size_t segmentID, size_t j) const 
       {
 	assert(curveID < numCurves);
 	assert(segmentID < 8);
         const int index = curve(curveID);
-        const float r0 = radius(index+0);
-        const float r1 = radius(index+1);
-        const float r2 = radius(index+2);
-        const float r3 = radius(index+3);
-        const Vec3fa& v0 = vertex(index+0);
-        const Vec3fa& v1 = vertex(index+1);
-        const Vec3fa& v2 = vertex(index+2);
-        const Vec3fa& v3 = vertex(index+3);
+        const float r0 = radius(index+0,j);
+        const float r1 = radius(index+1,j);
+        const float r2 = radius(index+2,j);
+        const float r3 = radius(index+3,j);
+        const Vec3fa& v0 = vertex(index+0,j);
+        const Vec3fa& v1 = vertex(index+1,j);
+        const Vec3fa& v2 = vertex(index+2,j);
+        const Vec3fa& v3 = vertex(index+3,j);
 
 	BBox3fa b(empty);
 	{
@@ -172,20 +232,25 @@ namespace embree
         return enlarge(b,Vec3fa(max(r0,r1,r2,r3)));
       }
 
-      __forceinline bool anyMappedBuffers() const {
-        return curves.isMapped() || vertices[0].isMapped() || vertices[1].isMapped();
+      __forceinline bool anyMappedBuffers() const 
+      {
+        if (curves.isMapped()) return true;
+        for (size_t i=0; i<numTimeSteps; i++)
+          if (vertices[i].isMapped()) return true;
+        return false;
       }
 
     public:
       unsigned mask;                    //!< for masking out geometry
       bool built;                       //!< geometry got built
-      unsigned char numTimeSteps;       //!< number of time steps (1 or 2)
+      unsigned char numTimeSteps;       //!< number of time steps (1 up to RTC_MAX_TIME_STEPS)
+      RTCCurveType type;                //!< ribbon or round curves
 
       BufferT<int> curves;              //!< array of curve indices
       bool needCurves;                  //!< set if curve indices required by acceleration structure
       size_t numCurves;                 //!< number of triangles
 
-      BufferT<Vertex> vertices[2];      //!< vertex array
+      BufferT<Vertex>* vertices;        //!< vertex array for each of the numTimeSteps time steps
       bool needVertices;                //!< set if vertex array required by acceleration structure
       size_t numVertices;               //!< number of vertices
     };
@@ -21,16 +21,21 @@ namespace embree
 {
   TriangleMesh::TriangleMesh (Scene* parent, RTCGeometryFlags flags, size_t numTriangles, size_t numVertices, size_t numTimeSteps)
     : Geometry(parent,TRIANGLE_MESH,numTriangles,flags), 
-      mask(-1), built(false), numTimeSteps(numTimeSteps),
+      mask(-1), built(false), prebuilt(false), numTimeSteps(numTimeSteps),
       numTriangles(numTriangles), needTriangles(false),
       numVertices(numVertices), needVertices(false)
   {
     triangles.init(numTriangles,sizeof(Triangle));
+    vertices = new BufferT<Vec3fa>[numTimeSteps];
     for (size_t i=0; i<numTimeSteps; i++) {
       vertices[i].init(numVertices,sizeof(Vec3fa));
     }
     enabling();
   }
+
+  TriangleMesh::~TriangleMesh () {
+    delete[] vertices;
+  }
   
   void TriangleMesh::enabling() 
   { 
@@ -113,7 +118,7 @@ namespace embree
 
     /* verify that all vertex accesses are 16 bytes aligned */
 #if defined(__MIC__)
-    if (type == RTC_VERTEX_BUFFER0 || type == RTC_VERTEX_BUFFER1) {
+    if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+RTC_MAX_TIME_STEPS) {
       if (((size_t(ptr) + offset) & 0xF) || (stride & 0xF)) {
         recordError(RTC_INVALID_OPERATION);
         return;
@@ -121,27 +126,23 @@ namespace embree
     }
 #endif
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : 
+    cancelPrebuild();
+
+    if (type == RTC_INDEX_BUFFER) {
       triangles.set(ptr,offset,stride); 
-      break;
-    case RTC_VERTEX_BUFFER0: 
-      vertices[0].set(ptr,offset,stride); 
-      if (numVertices) {
-        /* test if array is properly padded */
-        volatile int w = *((int*)&vertices[0][numVertices-1]+3); // FIXME: is failing hard avoidable?
-      }
-      break;
-    case RTC_VERTEX_BUFFER1: 
-      vertices[1].set(ptr,offset,stride); 
+    }
+    else if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps) {
+      const size_t t = type-RTC_VERTEX_BUFFER0;
+      vertices[t].set(ptr,offset,stride); 
       if (numVertices) {
         /* test if array is properly padded */
-        volatile int w = *((int*)&vertices[1][numVertices-1]+3); // FIXME: is failing hard avoidable?
+        volatile int w = *((int*)&vertices[t][numVertices-1]+3); // FIXME: is failing hard avoidable?
       }
-      break;
-    default: 
-      recordError(RTC_INVALID_ARGUMENT); break;
     }
+    else 
+      recordError(RTC_INVALID_ARGUMENT);
+
+    prebuild();
   }
 
   void* TriangleMesh::map(RTCBufferType type) 
@@ -151,14 +152,15 @@ namespace embree
       return NULL;
     }
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : return triangles  .map(parent->numMappedBuffers);
-    case RTC_VERTEX_BUFFER0: return vertices[0].map(parent->numMappedBuffers);
-    case RTC_VERTEX_BUFFER1: return vertices[1].map(parent->numMappedBuffers);
-    default: 
-      recordError(RTC_INVALID_ARGUMENT); 
-      return NULL;
-    }
+    cancelPrebuild();
+
+    if (type == RTC_INDEX_BUFFER) 
+      return triangles.map(parent->numMappedBuffers);
+    if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps) 
+      return vertices[type-RTC_VERTEX_BUFFER0].map(parent->numMappedBuffers);
+
+    recordError(RTC_INVALID_ARGUMENT); 
+    return NULL;
   }
 
   void TriangleMesh::unmap(RTCBufferType type) 
@@ -168,12 +170,29 @@ namespace embree
       return;
     }
 
-    switch (type) {
-    case RTC_INDEX_BUFFER  : triangles  .unmap(parent->numMappedBuffers); break;
-    case RTC_VERTEX_BUFFER0: vertices[0].unmap(parent->numMappedBuffers); break;
-    case RTC_VERTEX_BUFFER1: vertices[1].unmap(parent->numMappedBuffers); break;
-    default                : recordError(RTC_INVALID_ARGUMENT); break;
-    }
+    if      (type == RTC_INDEX_BUFFER) triangles.unmap(parent->numMappedBuffers);
+    else if (type >= RTC_VERTEX_BUFFER0 && type < RTC_VERTEX_BUFFER0+numTimeSteps) 
+      vertices[type-RTC_VERTEX_BUFFER0].unmap(parent->numMappedBuffers);
+    else recordError(RTC_INVALID_ARGUMENT);
+
+    prebuild();
+  }
+
+  void TriangleMesh::prebuild()
+  {
+    if (!parent->isStatic() || !parent->isProgressive() || prebuilt) return;
+    if (numTimeSteps != 1 || numTriangles == 0 || anyMappedBuffers()) return;
+    if (!triangles.isSpecified() || !vertices[0].isSpecified()) return;
+    prebuilt = true;
+    parent->prebuild(this);
+  }
+
+  void TriangleMesh::cancelPrebuild()
+  {
+    if (!prebuilt) return;
+    parent->waitPrebuild(this);
+    prebuilt = false;
+    modCounter++;
   }
 
   void TriangleMesh::setUserData (void* ptr, bool ispc) {
@@ -186,8 +205,8 @@ namespace embree
     bool freeTriangles = !(needTriangles || parent->needTriangles);
     bool freeVertices  = !(needVertices  || parent->needVertices);
     if (freeTriangles) triangles.free();
-    if (freeVertices ) vertices[0].free();
-    if (freeVertices ) vertices[1].free();
+    if (freeVertices ) 
+      for (size_t i=0; i<numTimeSteps; i++) vertices[i].free();
   }
 
   bool TriangleMesh::verify () 
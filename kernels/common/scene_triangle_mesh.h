@@ -32,6 +32,7 @@ namespace embree
 
     public:
       TriangleMesh (Scene* parent, RTCGeometryFlags flags, size_t numTriangles, size_t numVertices, size_t numTimeSteps); 
+      ~TriangleMesh ();
       
     public:
       void setMask (unsigned mask);
@@ -49,6 +50,14 @@ namespace embree
       void enabling();
       void disabling();
 
+    private:
+
+      /*! starts the background build of the mesh in progressive scenes */
+      void prebuild();
+
+      /*! waits for the background build before the mesh gets modified again */
+      void cancelPrebuild();
+
     public:
 
       bool isEmpty () const { 
@@ -75,6 +84,14 @@ namespace embree
         *bounds_o = b;
       }
 
+      const BBox3fa bounds(size_t group, size_t prim, float time0, float time1) const {
+        return bounds(prim,time0,time1);
+      }
+
+      size_t timeSteps(size_t group) const {
+        return numTimeSteps;
+      }
+
       void split (const PrimRef& prim, int dim, float pos, PrimRef& left_o, PrimRef& right_o) const;
 
     public:
@@ -86,10 +103,26 @@ namespace embree
 
       __forceinline const Vec3fa& vertex(size_t i, size_t j = 0) const {
         assert(i < numVertices);
-        assert(j < 2);
+        assert(j < numTimeSteps);
         return vertices[j][i];
       }
 
+      /*! returns the time segment between two time steps that contains the specified time */
+      __forceinline size_t timeSegment(float time) const {
+        assert(numTimeSteps > 1);
+        const int segment = (int)floorf(time*float(numTimeSteps-1));
+        return (size_t) clamp(segment,0,int(numTimeSteps)-2);
+      }
+
+      /*! linearly interpolates the vertex between the time steps of
+       *  the specified time segment, times outside the segment
+       *  extrapolate the motion of the segment */
+      __forceinline Vec3fa interpolatedVertex(size_t i, size_t segment, float time) const {
+        const Vec3fa& p0 = vertex(i,segment+0);
+        const Vec3fa& p1 = vertex(i,segment+1);
+        return p0 + (time*float(numTimeSteps-1)-float(segment))*(p1-p0);
+      }
+
       __forceinline BBox3fa bounds(size_t index) const 
       {
         const Triangle& tri = triangle(index);
@@ -99,20 +132,40 @@ namespace embree
 	return BBox3fa( min(min(v0,v1),v2), max(max(v0,v1),v2) );
       }
 
-      __forceinline bool anyMappedBuffers() const {
-        return triangles.isMapped() || vertices[0].isMapped() || vertices[1].isMapped();
+      /*! bounds of the linearly moving triangle over the time range
+       *  [time0,time1] that has to lie inside a single time segment */
+      __forceinline BBox3fa bounds(size_t index, float time0, float time1) const 
+      {
+        if (numTimeSteps == 1) return bounds(index);
+        const Triangle& tri = triangle(index);
+        const size_t segment = timeSegment(0.5f*(time0+time1));
+        BBox3fa b = empty;
+        for (size_t i=0; i<3; i++) {
+          b.extend(interpolatedVertex(tri.v[i],segment,time0));
+          b.extend(interpolatedVertex(tri.v[i],segment,time1));
+        }
+        return b;
+      }
+
+      __forceinline bool anyMappedBuffers() const 
+      {
+        if (triangles.isMapped()) return true;
+        for (size_t i=0; i<numTimeSteps; i++)
+          if (vertices[i].isMapped()) return true;
+        return false;
       }
 
     public:
       unsigned mask;                    //!< for masking out geometry
       bool built;                       //!< geometry got built
-      unsigned char numTimeSteps;       //!< number of time steps (1 or 2)
+      bool prebuilt;                    //!< background build of geometry got started
+      unsigned char numTimeSteps;       //!< number of time steps (1 up to RTC_MAX_TIME_STEPS)
 
       BufferT<Triangle> triangles;      //!< array of triangles
       bool needTriangles;               //!< set if triangle array required by acceleration structure
       size_t numTriangles;              //!< number of triangles
 
-      BufferT<Vec3fa> vertices[2];      //!< vertex array
+      BufferT<Vec3fa>* vertices;        //!< vertex array for each of the numTimeSteps time steps
       bool needVertices;                //!< set if vertex array required by acceleration structure
       size_t numVertices;               //!< number of vertices
     };
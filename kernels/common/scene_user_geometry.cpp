@@ -157,9 +157,11 @@ namespace embree
   extern AccelSet::Intersector8 InstanceIntersector8;
   extern AccelSet::Intersector16 InstanceIntersector16;
 
-  UserGeometryScene::Instance::Instance (Scene* parent, Accel* object) 
-    : Base(parent,INSTANCES,1), local2world(one), world2local(one), object(object)
+  UserGeometryScene::Instance::Instance (Scene* parent, Accel* object, size_t numTimeSteps) 
+    : Base(parent,INSTANCES,1), world2local(one), numTimeSteps(numTimeSteps), object(object)
   {
+    local2world = (AffineSpace3fa*) alignedMalloc(numTimeSteps*sizeof(AffineSpace3fa));
+    for (size_t i=0; i<numTimeSteps; i++) local2world[i] = one;
     intersectors.ptr = this;
     intersectors.boundsPtr = this;
     boundsFunc = InstanceBoundsFunc;
@@ -168,10 +170,18 @@ namespace embree
     intersectors.intersector8 = InstanceIntersector8; 
     intersectors.intersector16 = InstanceIntersector16;
   }
+
+  UserGeometryScene::Instance::~Instance () {
+    alignedFree(local2world);
+  }
   
-  void UserGeometryScene::Instance::setTransform(AffineSpace3fa& xfm)
+  void UserGeometryScene::Instance::setTransform(AffineSpace3fa& xfm, size_t timeStep)
   {
-    local2world = xfm;
-    world2local = rcp(xfm);
+    if (timeStep >= numTimeSteps) {
+      recordError(RTC_INVALID_ARGUMENT);
+      return;
+    }
+    local2world[timeStep] = xfm;
+    if (timeStep == 0) world2local = rcp(xfm);
   }
 }
@@ -66,13 +66,47 @@ namespace embree
     struct Instance : public Base
     {
     public:
-      Instance (Scene* parent, Accel* object); 
-      virtual void setTransform(AffineSpace3fa& local2world);
+      Instance (Scene* parent, Accel* object, size_t numTimeSteps); 
+      ~Instance ();
+      virtual void setTransform(AffineSpace3fa& local2world, size_t timeStep);
       virtual void build(size_t threadIndex, size_t threadCount) {}
+
+      /*! returns the time segment the time falls into, the time steps are spread evenly over [0,1] */
+      __forceinline size_t timeSegment(float time) const {
+        assert(numTimeSteps > 1);
+        const int segment = (int)floorf(time*float(numTimeSteps-1));
+        return (size_t) clamp(segment,0,int(numTimeSteps)-2);
+      }
+
+      /*! Linearly blending the transformations of two time steps
+       *  shrinks rotations, and a rotation by 180 degrees passes
+       *  through a singular matrix. Blends whose determinant falls
+       *  below this value use the transformation of the nearest time
+       *  step instead. */
+      __forceinline float singularDet(size_t segment) const {
+        return 1E-4f*min(abs(local2world[segment+0].l.det()),abs(local2world[segment+1].l.det()));
+      }
+
+      /*! returns the world to local transformation at the specified
+       *  time, the local to world transformation is linearly
+       *  interpolated between the time steps */
+      __forceinline AffineSpace3fa getWorld2Local(float time) const 
+      {
+        if (likely(numTimeSteps == 1)) return world2local;
+        const size_t segment = timeSegment(time);
+        const float f = time*float(numTimeSteps-1)-float(segment);
+        const AffineSpace3fa& xfm0 = local2world[segment+0];
+        const AffineSpace3fa& xfm1 = local2world[segment+1];
+        const AffineSpace3fa xfm = xfm0 + f*(xfm1-xfm0);
+        if (unlikely(abs(xfm.l.det()) < singularDet(segment)))
+          return rcp(f < 0.5f ? xfm0 : xfm1);
+        return rcp(xfm);
+      }
     
     public:
-      AffineSpace3fa local2world;
-      AffineSpace3fa world2local;
+      AffineSpace3fa* local2world;  //!< transformation from local space to world space of each time step
+      AffineSpace3fa world2local;   //!< inverse transformation of the first time step
+      size_t numTimeSteps;          //!< number of time steps of the transformation
       Accel* object;
     };
   }
@@ -41,6 +41,8 @@ namespace embree
     cout << "    #leaves       = " << float(cntrs.code.normal.trav_leaves      )*1E-6 << "M" << std::endl;
     cout << "    #prims        = " << float(cntrs.code.normal.trav_prims       )*1E-6 << "M" << std::endl;
     cout << "    #prim_hits    = " << float(cntrs.code.normal.trav_prim_hits   )*1E-6 << "M" << std::endl;
+    if (cntrs.code.normal.trav_restarts)
+      cout << "    #restarts     = " << float(cntrs.code.normal.trav_restarts    )*1E-6 << "M" << std::endl;
 
 #if defined(__MIC__)
     size_t normal_box_hits = 0;
@@ -55,6 +57,9 @@ namespace embree
       cout << "    #leaves     = " << float(cntrs.code.shadow.trav_leaves   )*1E-6 << "M" << std::endl;
       cout << "    #prims      = " << float(cntrs.code.shadow.trav_prims    )*1E-6 << "M" << std::endl;
       cout << "    #prim_hits  = " << float(cntrs.code.shadow.trav_prim_hits)*1E-6 << "M" << std::endl;
+      cout << "    #occluded   = " << float(cntrs.code.shadow.trav_occluded )*1E-6 << "M" << std::endl;
+      if (cntrs.code.shadow.trav_restarts)
+        cout << "    #restarts   = " << float(cntrs.code.shadow.trav_restarts )*1E-6 << "M" << std::endl;
 
 #if defined(__MIC__)
       size_t shadow_box_hits = 0;
@@ -93,8 +98,22 @@ namespace embree
       cout << "    #leaves     = " << float(cntrs.all.shadow.trav_leaves)/float(cntrs.all.shadow.travs) << ", " << 100.0f*active_shadow_trav_leaves << "% active" << std::endl;
       cout << "    #prims      = " << float(cntrs.all.shadow.trav_prims  )/float(cntrs.all.shadow.travs) << ", " << 100.0f*active_shadow_trav_prims   << "% active" << std::endl;
       cout << "    #prim_hits  = " << float(cntrs.all.shadow.trav_prim_hits  )/float(cntrs.all.shadow.travs) << ", " << 100.0f*active_shadow_trav_prim_hits   << "% active" << std::endl;
+      if (cntrs.all.shadow.trav_occlusion)
+        cout << "    #nodes per occlusion ray = " << float(cntrs.all.shadow.trav_occlusion_nodes)/float(cntrs.all.shadow.trav_occlusion) << ", " 
+             << 100.0f*float(cntrs.all.shadow.trav_occluded)/float(cntrs.all.shadow.trav_occlusion) << "% occluded" << std::endl;
 
     }
     cout << std::endl;
+
+    /* print allocator statistics */
+    if (cntrs.alloc.blocks) {
+      cout << "--------- ALLOCATOR ---------" << std::endl;
+      cout << "  #blocks         = " << size_t(cntrs.alloc.blocks) << std::endl;
+      cout << "    #reused       = " << size_t(cntrs.alloc.reused) << std::endl;
+      cout << "  #slabs          = " << size_t(cntrs.alloc.slabs) << std::endl;
+      cout << "  #waits          = " << size_t(cntrs.alloc.waits) << std::endl;
+      cout << "    #wait_cycles  = " << float(cntrs.alloc.waitCycles)*1E-6 << "M" << std::endl;
+      cout << std::endl;
+    }
   }
 }
@@ -62,6 +62,10 @@ namespace embree
 	    AtomicCounter trav_leaves;
 	    AtomicCounter trav_prims;
 	    AtomicCounter trav_prim_hits;
+	    AtomicCounter trav_restarts;       //!< number of times a stackless traversal restarted from the root
+	    AtomicCounter trav_occlusion;       //!< number of occlusion traversals
+	    AtomicCounter trav_occlusion_nodes; //!< nodes visited by all occlusion traversals
+	    AtomicCounter trav_occluded;        //!< number of occlusion traversals stopped by an occluder
 #if defined(__MIC__)
 	    AtomicCounter trav_hit_boxes[16+1];
 #endif
@@ -69,6 +73,15 @@ namespace embree
 	  } normal, shadow;
 	} all, active, code;
 
+	/* allocator statistics */
+	struct {
+	  AtomicCounter blocks;       //!< number of blocks handed out
+	  AtomicCounter reused;       //!< number of blocks taken from the available blocks
+	  AtomicCounter slabs;        //!< number of committed slabs
+	  AtomicCounter waits;        //!< number of times a thread waited for a slab
+	  AtomicCounter waitCycles;   //!< cycles spent waiting for slabs
+	} alloc;
+
     };
 
   public:
@@ -0,0 +1,199 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common/default.h"
+#include "sys/taskscheduler.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! 30 bit morton code with 10 bits per dimension and primitive index */
+    struct __aligned(8) MortonID32Bit
+    {
+      typedef unsigned int CodeTy;
+      static const size_t LATTICE_BITS_PER_DIM = 10;
+      static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
+      static const size_t CODE_BITS = 3*LATTICE_BITS_PER_DIM;
+
+      union {
+        struct {
+          unsigned int code;
+          unsigned int index;
+        };
+        int64 all;
+      };
+
+      /*! calculates the morton code of some lattice cell */
+      static __forceinline CodeTy encode(const unsigned int x, const unsigned int y, const unsigned int z) {
+        return bitInterleave(x,y,z);
+      }
+
+      /*! returns the highest bit two codes differ in, or -1 if the codes are equal */
+      static __forceinline int highestDifferentBit(const CodeTy a, const CodeTy b) {
+        return a == b ? -1 : __bsr(int(a^b));
+      }
+
+      __forceinline unsigned int get(const unsigned int shift, const unsigned and_mask) const {
+        return (code >> shift) & and_mask;
+      }
+
+      __forceinline void operator=(const MortonID32Bit& v) {
+        all = v.all;
+      };
+
+      __forceinline friend std::ostream &operator<<(std::ostream &o, const MortonID32Bit& mc) {
+        o << "index " << mc.index << " code = " << mc.code;
+        return o;
+      }
+
+      __forceinline bool operator<(const MortonID32Bit &m) const { return code < m.code; }
+      __forceinline bool operator>(const MortonID32Bit &m) const { return code > m.code; }
+    };
+
+    /*! 63 bit morton code with 21 bits per dimension and primitive index */
+    struct __aligned(8) MortonID64Bit
+    {
+      typedef uint64 CodeTy;
+      static const size_t LATTICE_BITS_PER_DIM = 21;
+      static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
+      static const size_t CODE_BITS = 3*LATTICE_BITS_PER_DIM;
+
+      uint64 code;
+      unsigned int index;
+      unsigned int align;
+
+      /*! calculates the morton code of some lattice cell */
+      static __forceinline CodeTy encode(const unsigned int x, const unsigned int y, const unsigned int z) {
+        return bitInterleave64(x,y,z);
+      }
+
+      /*! returns the highest bit two codes differ in, or -1 if the codes are equal */
+      static __forceinline int highestDifferentBit(const CodeTy a, const CodeTy b)
+      {
+        if (a == b) return -1;
+        const uint64 diff = a^b;
+        const unsigned int hi = (unsigned int)(diff >> 32);
+        if (hi) return 32+__bsr(int(hi));
+        return __bsr(int((unsigned int)diff));
+      }
+
+      __forceinline unsigned int get(const unsigned int shift, const unsigned and_mask) const {
+        return (unsigned int)(code >> shift) & and_mask;
+      }
+
+      __forceinline friend std::ostream &operator<<(std::ostream &o, const MortonID64Bit& mc) {
+        o << "index " << mc.index << " code = " << mc.code;
+        return o;
+      }
+
+      __forceinline bool operator<(const MortonID64Bit &m) const { return code < m.code; }
+      __forceinline bool operator>(const MortonID64Bit &m) const { return code > m.code; }
+    };
+
+    /*! number of code bits sorted in one pass of the radix sort */
+    static const size_t MORTON_RADIX_BITS = 11;
+    static const size_t MORTON_RADIX_BUCKETS = size_t(1) << MORTON_RADIX_BITS;
+    static const size_t MORTON_RADIX_BUCKETS_MASK = MORTON_RADIX_BUCKETS-1;
+    typedef unsigned int MortonRadixCountTy[MORTON_RADIX_BUCKETS];
+
+    /*! Parallel LSD radix sort of morton codes. Has to get invoked by
+     *  all threads of the lock step task scheduler, or with a single
+     *  thread. The first N items of src get sorted into dst, src is
+     *  used as temporary storage and its content gets destroyed. Passes
+     *  that would put all items into one bucket are skipped. */
+    template<typename MortonID>
+      void radixSortMortonCodes(MortonID* __restrict__ src, MortonID* __restrict__ dst, const size_t N,
+                                MortonRadixCountTy* __restrict__ radixCount, const size_t threadID, const size_t numThreads)
+    {
+      const size_t startID = (threadID+0)*N/numThreads;
+      const size_t endID   = (threadID+1)*N/numThreads;
+      const size_t numPasses = (MortonID::CODE_BITS+MORTON_RADIX_BITS-1)/MORTON_RADIX_BITS;
+
+      MortonID* __restrict__ buffer[2] = { src, dst };
+      size_t cur = 0;
+
+      for (size_t b=0; b<numPasses; b++)
+      {
+        const MortonID* __restrict__ in = buffer[cur];
+        MortonID*      __restrict__ out = buffer[cur^1];
+        const unsigned int shift = b * MORTON_RADIX_BITS;
+
+        /* count how many items go into the buckets */
+        for (size_t i=0; i<MORTON_RADIX_BUCKETS; i++)
+          radixCount[threadID][i] = 0;
+
+        for (size_t i=startID; i<endID; i++)
+          radixCount[threadID][in[i].get(shift,MORTON_RADIX_BUCKETS_MASK)]++;
+
+        if (numThreads > 1) LockStepTaskScheduler::syncThreads(threadID,numThreads);
+
+        /* calculate number of items of previous threads and total number of items for each bucket */
+        __aligned(64) unsigned int inner_offset[MORTON_RADIX_BUCKETS];
+        __aligned(64) unsigned int total[MORTON_RADIX_BUCKETS];
+        for (size_t i=0; i<MORTON_RADIX_BUCKETS; i++)
+          inner_offset[i] = 0;
+
+        for (size_t i=0; i<threadID; i++)
+          for (size_t j=0; j<MORTON_RADIX_BUCKETS; j++)
+            inner_offset[j] += radixCount[i][j];
+
+        for (size_t i=0; i<MORTON_RADIX_BUCKETS; i++)
+          total[i] = inner_offset[i];
+
+        for (size_t i=threadID; i<numThreads; i++)
+          for (size_t j=0; j<MORTON_RADIX_BUCKETS; j++)
+            total[j] += radixCount[i][j];
+
+        /* all threads skip the pass if all items fall into the same bucket */
+        bool skip = false;
+        for (size_t i=0; i<MORTON_RADIX_BUCKETS; i++)
+          skip |= total[i] == N;
+
+        if (!skip)
+        {
+          /* calculate start offset of each bucket for this thread */
+          __aligned(64) unsigned int offset[MORTON_RADIX_BUCKETS];
+          offset[0] = 0;
+          for (size_t i=1; i<MORTON_RADIX_BUCKETS; i++)
+            offset[i] = offset[i-1] + total[i-1];
+
+          for (size_t i=0; i<MORTON_RADIX_BUCKETS; i++)
+            offset[i] += inner_offset[i];
+
+          /* copy items into their buckets */
+          for (size_t i=startID; i<endID; i++) {
+            const unsigned int index = in[i].get(shift,MORTON_RADIX_BUCKETS_MASK);
+            out[offset[index]++] = in[i];
+          }
+          cur ^= 1;
+        }
+
+        /* counts get reset and items read by the next pass */
+        if (numThreads > 1 && (b+1 < numPasses || cur == 0))
+          LockStepTaskScheduler::syncThreads(threadID,numThreads);
+      }
+
+      /* copy items to destination if they ended up in the temporary array */
+      if (cur == 0) {
+        for (size_t i=startID; i<endID; i++)
+          dst[i] = src[i];
+      }
+    }
+  }
+}
@@ -0,0 +1,351 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common/default.h"
+#include "sys/taskscheduler.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! Builds a binary cluster tree bottom-up through locally-ordered
+     *  clustering. Each primitive starts as its own cluster and the
+     *  clusters are ordered along the morton curve. In each iteration
+     *  every cluster searches the cluster inside a small window of
+     *  neighbouring clusters it merges with into the smallest bounding
+     *  box, and mutual nearest neighbours get merged. The merged
+     *  cluster takes the place of its first child, thus the clusters
+     *  stay ordered along the curve. The iterations are executed by
+     *  all threads of the lock step task scheduler, or by a single
+     *  thread. The result does not depend on the number of threads. */
+    class PLOCClusterBuilder
+    {
+    public:
+
+      /*! number of neighbouring clusters searched in each direction */
+      static const size_t SEARCH_RADIUS = 16;
+
+      /*! iterations with fewer clusters do not get executed in parallel */
+      static const size_t PARALLEL_THRESHOLD = 4096;
+
+      /*! clusters with up to this number of primitives get gathered without memory allocation */
+      static const size_t SMALL_STACK_SIZE = 16;
+
+      /*! node of the binary cluster tree */
+      struct __aligned(16) Cluster
+      {
+        __forceinline bool isLeaf() const { return numPrimitives == 1; }
+
+      public:
+        BBox3fa bounds;              //!< bounds of all primitives of the cluster
+        unsigned int child[2];       //!< children of inner clusters, leaves store the encoded primitive in child[0]
+        unsigned int numPrimitives;  //!< number of primitives in the cluster
+        unsigned int align;
+      };
+
+    public:
+
+      PLOCClusterBuilder ()
+        : numAllocated(0), clusters(NULL), neighbours(NULL), numClusters(0), nextCluster(0), current(0)
+      {
+        ids[0] = ids[1] = NULL;
+      }
+
+      ~PLOCClusterBuilder () {
+        free();
+      }
+
+      /*! prepares clustering of some number of primitives */
+      void init(const size_t numPrimitives)
+      {
+        if (numPrimitives > numAllocated)
+        {
+          free();
+          numAllocated = numPrimitives;
+          clusters   = (Cluster*)      os_malloc(2*numAllocated*sizeof(Cluster));
+          ids[0]     = (unsigned int*) os_malloc(numAllocated*sizeof(unsigned int));
+          ids[1]     = (unsigned int*) os_malloc(numAllocated*sizeof(unsigned int));
+          neighbours = (unsigned int*) os_malloc(numAllocated*sizeof(unsigned int));
+        }
+        numClusters = nextCluster = numPrimitives;
+        current = 0;
+      }
+
+      /*! Build record of the collapse of the cluster tree into the
+       *  nodes of some morton builder, the primitives of the cluster
+       *  get stored in [begin,end). */
+      template<typename BuildRecord>
+        class __aligned(16) CollapseBuildRecord : public BuildRecord
+      {
+      public:
+        __forceinline void init(const unsigned int _begin, const unsigned int _end, const unsigned int _cluster)
+        {
+          BuildRecord::init(_begin,_end);
+          cluster = _cluster;
+        }
+
+      public:
+        unsigned int cluster;
+      };
+
+      /*! initializes the clusters of the morton sorted primitives of some thread */
+      template<typename MortonBuilder>
+        void setLeaves(const MortonBuilder* builder, const size_t threadID, const size_t numThreads)
+      {
+        const size_t startID = (threadID+0)*builder->numPrimitives/numThreads;
+        const size_t endID   = (threadID+1)*builder->numPrimitives/numThreads;
+
+        for (size_t i=startID; i<endID; i++)
+        {
+          const size_t index  = builder->mortonIndex(i);
+          const size_t primID = index & builder->encodeMask;
+          const size_t geomID = index >> builder->encodeShift;
+          setLeaf(i,builder->scene->getTriangleMesh(geomID)->bounds(primID),index);
+        }
+      }
+
+      /*! Opens the cluster of a build record into up to N children by
+       *  always opening the child with the largest surface area,
+       *  children with up to leafThreshold primitives do not get
+       *  opened. Returns the number of children. */
+      template<typename BuildRecord>
+        size_t open(const BuildRecord& current, BuildRecord* children, const size_t N, const size_t leafThreshold) const
+      {
+        size_t numChildren = 1;
+        children[0] = current;
+
+        do {
+
+          /* find best child with largest bounding box area */
+          int bestChild = -1;
+          float bestArea = neg_inf;
+          for (size_t i=0; i<numChildren; i++)
+          {
+            /* ignore leaves as they cannot get opened */
+            if (children[i].size() <= leafThreshold)
+              continue;
+
+            /* remember child with largest area */
+            const float area = halfArea(clusters[children[i].cluster].bounds);
+            if (area > bestArea) {
+              bestArea = area;
+              bestChild = i;
+            }
+          }
+          if (bestChild == -1) break;
+
+          /*! replace best child by the children of its cluster */
+          const BuildRecord best = children[bestChild];
+          const Cluster& cluster = clusters[best.cluster];
+          const unsigned int center = best.begin + clusters[cluster.child[0]].numPrimitives;
+          __aligned(64) BuildRecord left, right;
+          left.init (best.begin,center,cluster.child[0]);
+          right.init(center,best.end  ,cluster.child[1]);
+
+          /* add new children left and right */
+          left.depth = right.depth = current.depth+1;
+          children[bestChild] = children[numChildren-1];
+          children[numChildren-1] = left;
+          children[numChildren+0] = right;
+          numChildren++;
+
+        } while (numChildren < N);
+
+        return numChildren;
+      }
+
+      /*! initializes the cluster of the i'th primitive along the morton curve */
+      __forceinline void setLeaf(const size_t i, const BBox3fa& bounds, const unsigned int index)
+      {
+        clusters[i].bounds = bounds;
+        clusters[i].child[0] = index;
+        clusters[i].child[1] = 0;
+        clusters[i].numPrimitives = 1;
+        ids[0][i] = i;
+      }
+
+      /*! Merges clusters until a single cluster is left. In parallel
+       *  mode the iterations stop when only few clusters are left, and
+       *  the remaining iterations have to get executed by a single
+       *  thread. */
+      void build(const size_t threadID, const size_t numThreads)
+      {
+        size_t numClusters = this->numClusters;
+        size_t nextCluster = this->nextCluster;
+        size_t current = this->current;
+
+        while (numClusters > 1 && (numThreads == 1 || numClusters >= PARALLEL_THRESHOLD))
+        {
+          const unsigned int* __restrict__ const src = ids[current];
+          unsigned int* __restrict__ const dst = ids[current^1];
+          const size_t startID = (threadID+0)*numClusters/numThreads;
+          const size_t endID   = (threadID+1)*numClusters/numThreads;
+
+          /* find the nearest neighbour of each cluster */
+          for (size_t i=startID; i<endID; i++)
+            neighbours[i] = nearestNeighbour(src,i,numClusters);
+
+          if (numThreads > 1) LockStepTaskScheduler::syncThreads(threadID,numThreads);
+
+          /* count merged and remaining clusters */
+          size_t merged = 0, remaining = 0;
+          for (size_t i=startID; i<endID; i++)
+          {
+            const size_t n = neighbours[i];
+            if (neighbours[n] != i) remaining++;
+            else if (i < n) { merged++; remaining++; }
+          }
+          numMerged[threadID] = merged;
+          numRemaining[threadID] = remaining;
+
+          if (numThreads > 1) LockStepTaskScheduler::syncThreads(threadID,numThreads);
+
+          /* calculate where the clusters of this thread go */
+          size_t mergedOffset = nextCluster, remainingOffset = 0;
+          size_t totalMerged = 0, totalRemaining = 0;
+          for (size_t i=0; i<numThreads; i++) {
+            if (i < threadID) {
+              mergedOffset += numMerged[i];
+              remainingOffset += numRemaining[i];
+            }
+            totalMerged += numMerged[i];
+            totalRemaining += numRemaining[i];
+          }
+
+          /* merge mutual nearest neighbours and compact the clusters */
+          for (size_t i=startID; i<endID; i++)
+          {
+            const size_t n = neighbours[i];
+            if (neighbours[n] != i)
+              dst[remainingOffset++] = src[i];
+            else if (i < n)
+            {
+              Cluster& cluster = clusters[mergedOffset];
+              const Cluster& left  = clusters[src[i]];
+              const Cluster& right = clusters[src[n]];
+              cluster.bounds = merge(left.bounds,right.bounds);
+              cluster.child[0] = src[i];
+              cluster.child[1] = src[n];
+              cluster.numPrimitives = left.numPrimitives + right.numPrimitives;
+              dst[remainingOffset++] = mergedOffset++;
+            }
+          }
+
+          if (numThreads > 1) LockStepTaskScheduler::syncThreads(threadID,numThreads);
+
+          numClusters = totalRemaining;
+          nextCluster += totalMerged;
+          current ^= 1;
+        }
+
+        if (threadID == 0) {
+          this->numClusters = numClusters;
+          this->nextCluster = nextCluster;
+          this->current = current;
+        }
+      }
+
+      /*! stores the encoded primitives of a cluster in depth first order into the morton array, starting at some offset */
+      template<typename MortonID>
+        void gatherPrimitives(const unsigned int cluster, MortonID* __restrict__ const morton, const size_t begin) const
+      {
+        /* the stack never holds more clusters than there are primitives */
+        const size_t numPrimitives = clusters[cluster].numPrimitives;
+        unsigned int stack0[SMALL_STACK_SIZE];
+        std::vector<unsigned int> stack1;
+        unsigned int* stack = stack0;
+        if (numPrimitives > SMALL_STACK_SIZE) {
+          stack1.resize(numPrimitives);
+          stack = &stack1[0];
+        }
+
+        size_t sp = 0, dst = begin;
+        stack[sp++] = cluster;
+        while (sp)
+        {
+          const Cluster& c = clusters[stack[--sp]];
+          if (c.isLeaf()) {
+            morton[dst++].index = c.child[0];
+            continue;
+          }
+          stack[sp++] = c.child[1];
+          stack[sp++] = c.child[0];
+        }
+        assert(dst == begin+numPrimitives);
+      }
+
+      /*! returns the root of the cluster tree */
+      __forceinline unsigned int root() const {
+        assert(numClusters == 1);
+        return ids[current][0];
+      }
+
+    private:
+
+      /*! Returns the cluster inside the search window that gives the
+       *  smallest merged bounds. Ties get resolved towards the lower
+       *  index, which guarantees that at least one pair of clusters
+       *  are mutual nearest neighbours. */
+      __forceinline size_t nearestNeighbour(const unsigned int* __restrict__ const src, const size_t i, const size_t numClusters) const
+      {
+        const BBox3fa bounds = clusters[src[i]].bounds;
+        const size_t begin = i > SEARCH_RADIUS ? i-SEARCH_RADIUS : 0;
+        const size_t end   = min(i+SEARCH_RADIUS+1,numClusters);
+
+        size_t best = i;
+        float bestArea = pos_inf;
+        for (size_t j=begin; j<end; j++)
+        {
+          if (j == i) continue;
+          const float area = halfArea(merge(bounds,clusters[src[j]].bounds));
+          if (best == i || area < bestArea) {
+            best = j;
+            bestArea = area;
+          }
+        }
+        return best;
+      }
+
+      void free()
+      {
+        if (clusters  ) os_free(clusters  ,2*numAllocated*sizeof(Cluster));
+        if (ids[0]    ) os_free(ids[0]    ,numAllocated*sizeof(unsigned int));
+        if (ids[1]    ) os_free(ids[1]    ,numAllocated*sizeof(unsigned int));
+        if (neighbours) os_free(neighbours,numAllocated*sizeof(unsigned int));
+        clusters = NULL; ids[0] = ids[1] = neighbours = NULL;
+        numAllocated = 0;
+      }
+
+    private:
+      size_t numAllocated;               //!< number of primitives memory got allocated for
+
+    public:
+      Cluster* __restrict__ clusters;    //!< nodes of the cluster tree, the first nodes are the leaves in morton order
+
+    private:
+      unsigned int* ids[2];              //!< clusters of the current and the next iteration
+      unsigned int* neighbours;          //!< nearest neighbour of each cluster of the current iteration
+      size_t numClusters;                //!< number of clusters left
+      size_t nextCluster;                //!< next free node of the cluster tree
+      size_t current;                    //!< clusters of the current iteration are stored in ids[current]
+
+      __aligned(64) size_t numMerged[MAX_MIC_THREADS];      //!< number of merged clusters of each thread
+      __aligned(64) size_t numRemaining[MAX_MIC_THREADS];   //!< number of remaining clusters of each thread
+    };
+  }
+}
@@ -35,8 +35,10 @@ namespace embree
   DECLARE_SYMBOL(Accel::Intersector1,BVH4Triangle1vIntersector1Pluecker);
   DECLARE_SYMBOL(Accel::Intersector1,BVH4Triangle4vIntersector1Pluecker);
   DECLARE_SYMBOL(Accel::Intersector1,BVH4Triangle4iIntersector1Pluecker);
+  DECLARE_SYMBOL(Accel::Intersector1,BVH4Triangle4iIntersector1QuantizedPluecker);
   DECLARE_SYMBOL(Accel::Intersector1,BVH4VirtualIntersector1);
 
+  DECLARE_SYMBOL(Accel::Intersector4,BVH4Bezier1iIntersector4Chunk);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle1Intersector4ChunkMoeller);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4Intersector4ChunkMoeller);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle8Intersector4ChunkMoeller);
@@ -46,31 +48,40 @@ namespace embree
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4vIntersector4ChunkPluecker);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4vIntersector4HybridPluecker);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4iIntersector4ChunkPluecker);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH4Triangle4iIntersector4QuantizedPluecker);
   DECLARE_SYMBOL(Accel::Intersector4,BVH4VirtualIntersector4Chunk);
 
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4Bezier1iIntersector8Chunk);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle1Intersector8ChunkMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4Intersector8ChunkMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle8Intersector8ChunkMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4Intersector8HybridMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle8Intersector8HybridMoeller);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4Intersector8TrailMoeller);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle8Intersector8TrailMoeller);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle1vIntersector8ChunkPluecker);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4vIntersector8ChunkPluecker);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4vIntersector8HybridPluecker);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4iIntersector8ChunkPluecker);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4Triangle4iIntersector8QuantizedPluecker);
   DECLARE_SYMBOL(Accel::Intersector8,BVH4VirtualIntersector8Chunk);
 
   DECLARE_TOPLEVEL_BUILDER(BVH4BuilderTopLevelFast);
 
   DECLARE_BUILDER(BVH4BuilderObjectSplit4Fast);
   DECLARE_TRIANGLEMESH_BUILDER(BVH4BuilderObjectSplit4TriangleMeshFast);
+  DECLARE_BUILDER(BVH4BuilderSpatialSplit4Fast);
 
   DECLARE_BUILDER(BVH4BuilderMortonFast);
   DECLARE_TRIANGLEMESH_BUILDER(BVH4BuilderMortonTriangleMeshFast);
 
+  DECLARE_BUILDER(BVH4BuilderPLOCFast);
+
   DECLARE_TRIANGLEMESH_BUILDER(BVH4BuilderRefitObjectSplit4TriangleMeshFast);
 
   Builder* BVH4BuilderObjectSplit1 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
   Builder* BVH4BuilderObjectSplit4 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH4BuilderObjectSplit4Quantized (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
   Builder* BVH4BuilderObjectSplit8 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
   Builder* BVH4BuilderSpatialSplit1 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
   Builder* BVH4BuilderSpatialSplit4 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
@@ -84,9 +95,12 @@ namespace embree
 
     SELECT_SYMBOL_DEFAULT(features,BVH4BuilderObjectSplit4Fast);
     SELECT_SYMBOL_DEFAULT(features,BVH4BuilderObjectSplit4TriangleMeshFast);
+    SELECT_SYMBOL_DEFAULT(features,BVH4BuilderSpatialSplit4Fast);
 
     SELECT_SYMBOL_DEFAULT_SSE41(features,BVH4BuilderMortonFast);
     SELECT_SYMBOL_DEFAULT_SSE41(features,BVH4BuilderMortonTriangleMeshFast);
+
+    SELECT_SYMBOL_DEFAULT_SSE41(features,BVH4BuilderPLOCFast);
     
     SELECT_SYMBOL_DEFAULT(features,BVH4BuilderRefitObjectSplit4TriangleMeshFast);
 
@@ -98,9 +112,11 @@ namespace embree
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle1vIntersector1Pluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4vIntersector1Pluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4iIntersector1Pluecker);
+    SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4iIntersector1QuantizedPluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4VirtualIntersector1);
 
     /* select intersectors4 */
+    SELECT_SYMBOL_AVX_AVX2              (features,BVH4Bezier1iIntersector4Chunk);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4Triangle1Intersector4ChunkMoeller);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4Triangle4Intersector4ChunkMoeller);
     SELECT_SYMBOL_AVX_AVX2              (features,BVH4Triangle8Intersector4ChunkMoeller);
@@ -110,25 +126,31 @@ namespace embree
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4vIntersector4ChunkPluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4vIntersector4HybridPluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4iIntersector4ChunkPluecker);
+    SELECT_SYMBOL_DEFAULT_SSE41_AVX     (features,BVH4Triangle4iIntersector4QuantizedPluecker);
     SELECT_SYMBOL_DEFAULT_SSE41_AVX_AVX2(features,BVH4VirtualIntersector4Chunk);
 
     /* select intersectors8 */
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4Bezier1iIntersector8Chunk);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle1Intersector8ChunkMoeller);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle4Intersector8ChunkMoeller);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle8Intersector8ChunkMoeller);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle4Intersector8HybridMoeller);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle8Intersector8HybridMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle4Intersector8TrailMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4Triangle8Intersector8TrailMoeller);
     SELECT_SYMBOL_AVX     (features,BVH4Triangle1vIntersector8ChunkPluecker);
     SELECT_SYMBOL_AVX     (features,BVH4Triangle4vIntersector8ChunkPluecker);
     SELECT_SYMBOL_AVX     (features,BVH4Triangle4vIntersector8HybridPluecker);
     SELECT_SYMBOL_AVX     (features,BVH4Triangle4iIntersector8ChunkPluecker);
+    SELECT_SYMBOL_AVX     (features,BVH4Triangle4iIntersector8QuantizedPluecker);
     SELECT_SYMBOL_AVX_AVX2(features,BVH4VirtualIntersector8Chunk);
   }
 
   BVH4::BVH4 (const PrimitiveType& primTy, void* geometry)
-  : primTy(primTy), geometry(geometry), root(emptyNode),
+  : primTy(primTy), geometry(geometry), root(emptyNode), quantized(false),
     numPrimitives(0), numVertices(0),
-    nodes(NULL), bytesNodes(0), primitives(NULL), bytesPrimitives(0) 
+    nodes(NULL), bytesNodes(0), primitives(NULL), bytesPrimitives(0), 
+    mapped(NULL), bytesMapped(0)
   {
     alloc = new LinearAllocatorPerThread;
   }
@@ -136,6 +158,7 @@ namespace embree
   BVH4::~BVH4 () {
     if (nodes) os_free(nodes, bytesNodes);
     if (primitives) os_free(primitives, bytesPrimitives);
+    if (mapped) os_unmap_file(mapped, bytesMapped);
     for (size_t i=0; i<objects.size(); i++) delete objects[i];
   }
 
@@ -144,8 +167,8 @@ namespace embree
     Accel::Intersectors intersectors;
     intersectors.ptr = bvh;
     intersectors.intersector1 = BVH4Bezier1iIntersector1;
-    intersectors.intersector4 = NULL;
-    intersectors.intersector8 = NULL;
+    intersectors.intersector4 = BVH4Bezier1iIntersector4Chunk;
+    intersectors.intersector8 = BVH4Bezier1iIntersector8Chunk;
     intersectors.intersector16 = NULL;
     return intersectors;
   }
@@ -183,6 +206,17 @@ namespace embree
     return intersectors;
   }
 
+  Accel::Intersectors BVH4Triangle4IntersectorsTrail(BVH4* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH4Triangle4Intersector1Moeller;
+    intersectors.intersector4 = BVH4Triangle4Intersector4HybridMoeller;
+    intersectors.intersector8 = BVH4Triangle4Intersector8TrailMoeller;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
   Accel::Intersectors BVH4Triangle8IntersectorsChunk(BVH4* bvh)
   {
     Accel::Intersectors intersectors;
@@ -205,6 +239,17 @@ namespace embree
     return intersectors;
   }
 
+  Accel::Intersectors BVH4Triangle8IntersectorsTrail(BVH4* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH4Triangle8Intersector1Moeller;
+    intersectors.intersector4 = BVH4Triangle8Intersector4HybridMoeller;
+    intersectors.intersector8 = BVH4Triangle8Intersector8TrailMoeller;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
   Accel::Intersectors BVH4Triangle1vIntersectors(BVH4* bvh)
   {
     Accel::Intersectors intersectors;
@@ -249,6 +294,17 @@ namespace embree
     return intersectors;
   }
 
+  Accel::Intersectors BVH4Triangle4iIntersectorsQuantized(BVH4* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH4Triangle4iIntersector1QuantizedPluecker;
+    intersectors.intersector4 = BVH4Triangle4iIntersector4QuantizedPluecker;
+    intersectors.intersector8 = BVH4Triangle4iIntersector8QuantizedPluecker;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
   Accel* BVH4::BVH4Bezier1i(Scene* scene)
   { 
     BVH4* accel = new BVH4(SceneBezier1i::type,scene);
@@ -258,6 +314,15 @@ namespace embree
     return new AccelInstance(accel,builder,intersectors);
   }
 
+  Accel* BVH4::BVH4Bezier1iMB(Scene* scene)
+  { 
+    BVH4* accel = new BVH4(SceneBezier1i::type,scene);
+    Accel::Intersectors intersectors = BVH4Bezier1iIntersectors(accel);
+    Builder* builder = BVH4BuilderObjectSplit1(accel,&scene->bezier_source_2,scene,1,inf);
+    scene->needVertices = true;
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
   Accel* BVH4::BVH4Triangle1(Scene* scene)
   { 
     BVH4* accel = new BVH4(SceneTriangle1::type,scene);
@@ -268,6 +333,7 @@ namespace embree
     else if (g_builder == "spatialsplit") builder = BVH4BuilderSpatialSplit1(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "objectsplit" ) builder = BVH4BuilderObjectSplit1(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "morton"      ) builder = BVH4BuilderMortonFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
+    else if (g_builder == "ploc"        ) builder = BVH4BuilderPLOCFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else if (g_builder == "fast"        ) builder = BVH4BuilderObjectSplit4Fast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else throw std::runtime_error("unknown builder "+g_builder+" for BVH4<Triangle1>");
 
@@ -282,6 +348,7 @@ namespace embree
     if      (g_traverser == "default") intersectors = BVH4Triangle4IntersectorsHybrid(accel);
     else if (g_traverser == "chunk"  ) intersectors = BVH4Triangle4IntersectorsChunk(accel);
     else if (g_traverser == "hybrid" ) intersectors = BVH4Triangle4IntersectorsHybrid(accel);
+    else if (g_traverser == "trail"  ) intersectors = BVH4Triangle4IntersectorsTrail(accel);
     else throw std::runtime_error("unknown traverser "+g_traverser+" for BVH4<Triangle4>");
    
     Builder* builder = NULL;
@@ -291,6 +358,7 @@ namespace embree
     else if (g_builder == "objectsplit1") builder = BVH4BuilderObjectSplit1(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "objectsplit4") builder = BVH4BuilderObjectSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "morton"      ) builder = BVH4BuilderMortonFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
+    else if (g_builder == "ploc"        ) builder = BVH4BuilderPLOCFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else if (g_builder == "fast"        ) builder = BVH4BuilderObjectSplit4Fast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else throw std::runtime_error("unknown builder "+g_builder+" for BVH4<Triangle4>");
 
@@ -307,6 +375,7 @@ namespace embree
     if      (g_traverser == "default") intersectors = BVH4Triangle8IntersectorsHybrid(accel);
     else if (g_traverser == "chunk"  ) intersectors = BVH4Triangle8IntersectorsChunk(accel);
     else if (g_traverser == "hybrid" ) intersectors = BVH4Triangle8IntersectorsHybrid(accel);
+    else if (g_traverser == "trail"  ) intersectors = BVH4Triangle8IntersectorsTrail(accel);
     else throw std::runtime_error("unknown traverser "+g_traverser+" for BVH4<Triangle8>");
    
     Builder* builder = NULL;
@@ -329,6 +398,7 @@ namespace embree
     else if (g_builder == "spatialsplit") builder = BVH4BuilderSpatialSplit1(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "objectsplit" ) builder = BVH4BuilderObjectSplit1(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "morton"      ) builder = BVH4BuilderMortonFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
+    else if (g_builder == "ploc"        ) builder = BVH4BuilderPLOCFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else if (g_builder == "fast"        ) builder = BVH4BuilderObjectSplit4Fast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else throw std::runtime_error("unknown builder "+g_builder+" for BVH4<Triangle1v>");
         
@@ -350,6 +420,7 @@ namespace embree
     else if (g_builder == "spatialsplit") builder = BVH4BuilderSpatialSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "objectsplit" ) builder = BVH4BuilderObjectSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "morton"      ) builder = BVH4BuilderMortonFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
+    else if (g_builder == "ploc"        ) builder = BVH4BuilderPLOCFast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else if (g_builder == "fast"        ) builder = BVH4BuilderObjectSplit4Fast(accel,&scene->flat_triangle_source_1,scene,4,inf);
     else throw std::runtime_error("unknown builder "+g_builder+" for BVH4<Triangle4v>");
 
@@ -469,7 +540,7 @@ namespace embree
   Accel* BVH4::BVH4Triangle1SpatialSplit(Scene* scene)
   {
     BVH4* accel = new BVH4(SceneTriangle1::type,scene);
-    Builder* builder = BVH4BuilderSpatialSplit1(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Builder* builder = BVH4BuilderSpatialSplit4Fast(accel,&scene->flat_triangle_source_1,scene,1,inf);
     Accel::Intersectors intersectors = BVH4Triangle1Intersectors(accel);
     return new AccelInstance(accel,builder,intersectors);
   }
@@ -477,7 +548,7 @@ namespace embree
   Accel* BVH4::BVH4Triangle4SpatialSplit(Scene* scene)
   {
     BVH4* accel = new BVH4(SceneTriangle4::type,scene);
-    Builder* builder = BVH4BuilderSpatialSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Builder* builder = BVH4BuilderSpatialSplit4Fast(accel,&scene->flat_triangle_source_1,scene,1,inf);
     Accel::Intersectors intersectors = BVH4Triangle4IntersectorsHybrid(accel);
     return new AccelInstance(accel,builder,intersectors);
   }
@@ -547,6 +618,16 @@ namespace embree
     return new AccelInstance(accel,builder,intersectors);
   }
 
+  Accel* BVH4::BVH4Triangle4iObjectSplitQuantized(Scene* scene)
+  {
+    BVH4* accel = new BVH4(Triangle4iType::type,scene);
+    Builder* builder = BVH4BuilderObjectSplit4Quantized(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Accel::Intersectors intersectors = BVH4Triangle4iIntersectorsQuantized(accel);
+    accel->quantized = true; // the builder converts all nodes, restore needs to know the node type before any build
+    scene->needVertices = true;
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
   Accel* BVH4::BVH4Triangle1ObjectSplit(TriangleMesh* mesh)
   {
     BVH4* accel = new BVH4(TriangleMeshTriangle1::type,mesh->parent);
@@ -603,15 +684,99 @@ namespace embree
     size_t numReservedPrimitives = 1.5*numAllocatedPrimitives;
 #endif
     
-    size_t bytesAllocated = numAllocatedNodes * sizeof(BVH4::Node) + numAllocatedPrimitives * primTy.bytes;
-    size_t bytesReserved  = numReservedNodes * sizeof(BVH4::Node) + numReservedPrimitives * primTy.bytes;
+    /* nodes get allocated from a separate allocator if the builder converts them to quantized nodes or BVH8 nodes */
+    size_t bytesNode = allocTempNodes ? sizeof(BVH4::QuantizedNode) : sizeof(BVH4::Node);
+    size_t bytesAllocated = numAllocatedNodes * bytesNode + numAllocatedPrimitives * primTy.bytes;
+    size_t bytesReserved  = numReservedNodes * bytesNode + numReservedPrimitives * primTy.bytes;
     bytesReserved         = (bytesReserved+blockSize-1)/blockSize*blockSize;
 
+    /* release a previously restored BVH */
+    if (mapped) os_unmap_file(mapped, bytesMapped);
+    mapped = NULL; bytesMapped = 0;
+
     root = emptyNode;
+    quantized = false;
     //alloc->init(numNodes*sizeof(BVH4::Node) + numPrimitives*primTy.bytes);
     alloc->init(bytesAllocated,bytesReserved);
   }
 
+  /*! quantizes the bounds of one dimension of the 4 children */
+  static void quantize(const ssef& lower, const ssef& upper, const BVH4::NodeRef* children, 
+                       float& start, float& scale, unsigned char* qlower, unsigned char* qupper)
+  {
+    float lo = pos_inf, hi = neg_inf;
+    for (size_t i=0; i<4; i++) {
+      if (children[i] == BVH4::emptyNode) continue;
+      lo = min(lo,lower[i]); hi = max(hi,upper[i]);
+    }
+    if (lo > hi) lo = hi = 0.0f;
+
+    /* the step has to be non-zero such that empty children get an
+     * inverted box, and the largest quantized value has to lie above
+     * all upper bounds */
+    start = lo; scale = (hi-lo)/255.0f;
+    if (scale == 0.0f) scale = max(abs(lo),1.0f)*float(ulp);
+    while (lo+255.0f*scale <= hi)
+      scale = max(scale*(1.0f+1.0f/65536.0f),scale+FLT_MIN);
+
+    for (size_t i=0; i<4; i++)
+    {
+      /* empty children get an inverted box */
+      if (children[i] == BVH4::emptyNode) {
+        qlower[i] = 255; qupper[i] = 0;
+        continue;
+      }
+      /* round outwards, dequantized bounds have to stay strictly
+       * outside to remain conservative when dequantized with FMA */
+      int l = clamp((int)floorf((lower[i]-start)/scale),0,255);
+      while (l > 0 && start+float(l)*scale >= lower[i]) l--;
+      int u = clamp((int)ceilf((upper[i]-start)/scale),l,255);
+      while (u < 255 && start+float(u)*scale <= upper[i]) u++;
+      qlower[i] = l; qupper[i] = u;
+    }
+  }
+
+  void BVH4::QuantizedNode::init(const Node& node)
+  {
+    for (size_t i=0; i<4; i++) children[i] = node.children[i];
+    quantize(node.lower_x,node.upper_x,node.children,start.x,scale.x,lower_x,upper_x);
+    quantize(node.lower_y,node.upper_y,node.children,start.y,scale.y,lower_y,upper_y);
+    quantize(node.lower_z,node.upper_z,node.children,start.z,scale.z,lower_z,upper_z);
+  }
+
+  void BVH4::Node::sortForOcclusion()
+  {
+    /* a barrier marks the root of a subtree, not a leaf */
+    bool leaf[4]; float area[4];
+    for (size_t i=0; i<4; i++) {
+      leaf[i] = children[i].isLeaf() && !children[i].isBarrier();
+      area[i] = children[i] != emptyNode ? halfArea(bounds(i)) : neg_inf;
+    }
+
+    /* insertion sort of the 4 children */
+    for (size_t i=1; i<4; i++)
+    {
+      for (size_t j=i; j>0; j--)
+      {
+        if (children[j] == emptyNode) break;
+        const bool before = children[j-1] == emptyNode || (leaf[j] != leaf[j-1] ? leaf[j] : area[j] > area[j-1]);
+        if (!before) break;
+        BVH4::swap(this,j,this,j-1);
+        std::swap(leaf[j],leaf[j-1]);
+        std::swap(area[j],area[j-1]);
+      }
+    }
+  }
+
+  void BVH4::sortForOcclusion(NodeRef node)
+  {
+    if (node.isBarrier() || node.isLeaf()) return;
+    Node* n = node.node();
+    n->sortForOcclusion();
+    for (size_t c=0; c<4; c++)
+      sortForOcclusion(n->child(c));
+  }
+
   void BVH4::clearBarrier(NodeRef& node)
   {
     if (node.isBarrier())
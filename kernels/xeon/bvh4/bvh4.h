@@ -31,8 +31,9 @@ namespace embree
     ALIGNED_CLASS;
   public:
     
-    /*! forward declaration of node type */
+    /*! forward declaration of node types */
     struct Node;
+    struct QuantizedNode;
 
     /*! branching width of the tree */
     static const size_t N = 4;
@@ -101,6 +102,10 @@ namespace embree
       /*! returns node pointer */
       __forceinline       Node* node()       { assert(isNode()); return (      Node*)ptr; }
       __forceinline const Node* node() const { assert(isNode()); return (const Node*)ptr; }
+
+      /*! returns quantized node pointer */
+      __forceinline       QuantizedNode* quantizedNode()       { assert(isNode()); return (      QuantizedNode*)ptr; }
+      __forceinline const QuantizedNode* quantizedNode() const { assert(isNode()); return (const QuantizedNode*)ptr; }
       
       /*! returns leaf pointer */
       __forceinline char* leaf(size_t& num) const {
@@ -159,10 +164,33 @@ namespace embree
         transpose(upper_x,upper_y,upper_z,ssef(zero),bounds0.upper,bounds1.upper,bounds2.upper,bounds3.upper);
       }
 
+      /*! Returns the bounds of all children, the traversal kernels access the bounds of all node types through this interface. */
+      __forceinline void bounds(ssef& lower_x, ssef& upper_x, ssef& lower_y, ssef& upper_y, ssef& lower_z, ssef& upper_z) const 
+      {
+        lower_x = this->lower_x; upper_x = this->upper_x;
+        lower_y = this->lower_y; upper_y = this->upper_y;
+        lower_z = this->lower_z; upper_z = this->upper_z;
+      }
+
+      /*! Byte offset between the lower and upper bounds of a dimension. */
+      enum { boundsStride = sizeof(ssef) };
+
+      /*! Returns 4 bounds of one dimension, ofs is the byte offset of the bounds relative to lower_x. */
+      __forceinline ssef boundsX(size_t ofs) const { return load4f((const char*)&lower_x+ofs); }
+      __forceinline ssef boundsY(size_t ofs) const { return load4f((const char*)&lower_x+ofs); }
+      __forceinline ssef boundsZ(size_t ofs) const { return load4f((const char*)&lower_x+ofs); }
+
+      /*! Returns the node referenced by a node reference. */
+      static __forceinline const Node* get(NodeRef ref) { return ref.node(); }
+
       /*! Returns reference to specified child */
       __forceinline       NodeRef& child(size_t i)       { assert(i<4); return children[i]; }
       __forceinline const NodeRef& child(size_t i) const { assert(i<4); return children[i]; }
 
+      /*! Orders the children for shadow rays: leaves first, then
+       *  larger children before smaller ones, empty children last. */
+      void sortForOcclusion();
+
     public:
       ssef lower_x;           //!< X dimension of lower bounds of all 4 children.
       ssef upper_x;           //!< X dimension of upper bounds of all 4 children.
@@ -173,6 +201,57 @@ namespace embree
       NodeRef children[4];    //!< Pointer to the 4 children (can be a node or leaf)
     };
 
+    /*! BVH4 Node that stores the bounds of its 4 children quantized
+     *  to 8 bits relative to the bounds of the node. A bound is
+     *  dequantized as start+q*scale, the quantization rounds
+     *  conservatively such that the dequantized bounds always enclose
+     *  the original bounds. The node requires 80 instead of 128
+     *  bytes. */
+    struct QuantizedNode
+    {
+      /*! Quantizes the bounds of the children of a node and copies its child references. */
+      void init(const Node& node);
+
+      /*! Dequantizes 4 bounds of one dimension, ofs is the byte offset of the bounds relative to lower_x. */
+      __forceinline ssef bounds(size_t ofs, float start, float scale) const {
+        return madd(load4f_uint8(lower_x+ofs),ssef(scale),ssef(start));
+      }
+
+      /*! Dequantizes the bounds of all children. */
+      __forceinline void bounds(ssef& lower_x, ssef& upper_x, ssef& lower_y, ssef& upper_y, ssef& lower_z, ssef& upper_z) const 
+      {
+        lower_x = bounds( 0,start.x,scale.x); upper_x = bounds( 4,start.x,scale.x);
+        lower_y = bounds( 8,start.y,scale.y); upper_y = bounds(12,start.y,scale.y);
+        lower_z = bounds(16,start.z,scale.z); upper_z = bounds(20,start.z,scale.z);
+      }
+
+      /*! Byte offset between the quantized lower and upper bounds of a dimension. */
+      enum { boundsStride = 4 };
+
+      /*! Dequantizes 4 bounds of one dimension, ofs is the byte offset of the bounds relative to lower_x. */
+      __forceinline ssef boundsX(size_t ofs) const { return bounds(ofs,start.x,scale.x); }
+      __forceinline ssef boundsY(size_t ofs) const { return bounds(ofs,start.y,scale.y); }
+      __forceinline ssef boundsZ(size_t ofs) const { return bounds(ofs,start.z,scale.z); }
+
+      /*! Returns the node referenced by a node reference. */
+      static __forceinline const QuantizedNode* get(NodeRef ref) { return ref.quantizedNode(); }
+
+      /*! Returns reference to specified child */
+      __forceinline       NodeRef& child(size_t i)       { assert(i<4); return children[i]; }
+      __forceinline const NodeRef& child(size_t i) const { assert(i<4); return children[i]; }
+
+    public:
+      NodeRef children[4];      //!< Pointer to the 4 children (can be a node or leaf)
+      Vec3f start;              //!< lower bounds of the node
+      Vec3f scale;              //!< size of one quantization step
+      unsigned char lower_x[4]; //!< X dimension of quantized lower bounds of all 4 children.
+      unsigned char upper_x[4]; //!< X dimension of quantized upper bounds of all 4 children.
+      unsigned char lower_y[4]; //!< Y dimension of quantized lower bounds of all 4 children.
+      unsigned char upper_y[4]; //!< Y dimension of quantized upper bounds of all 4 children.
+      unsigned char lower_z[4]; //!< Z dimension of quantized lower bounds of all 4 children.
+      unsigned char upper_z[4]; //!< Z dimension of quantized upper bounds of all 4 children.
+    };
+
     /*! swap the children of two nodes */
     __forceinline static void swap(Node* a, size_t i, Node* b, size_t j)
     {
@@ -216,6 +295,7 @@ namespace embree
 
     /*! BVH4 instantiations */
     static Accel* BVH4Bezier1i(Scene* scene);
+    static Accel* BVH4Bezier1iMB(Scene* scene);
     static Accel* BVH4Triangle1(Scene* scene);
     static Accel* BVH4Triangle4(Scene* scene);
     static Accel* BVH4Triangle8(Scene* scene);
@@ -238,6 +318,7 @@ namespace embree
     static Accel* BVH4Triangle1vObjectSplit(Scene* scene);
     static Accel* BVH4Triangle4vObjectSplit(Scene* scene);
     static Accel* BVH4Triangle4iObjectSplit(Scene* scene);
+    static Accel* BVH4Triangle4iObjectSplitQuantized(Scene* scene);
 
     static Accel* BVH4Triangle1ObjectSplit(TriangleMesh* mesh);
     static Accel* BVH4Triangle4ObjectSplit(TriangleMesh* mesh);
@@ -251,10 +332,36 @@ namespace embree
     /*! Clears the barrier bits of a subtree. */
     void clearBarrier(NodeRef& node);
 
+    /*! Orders the children of all nodes of a subtree such that the
+     *  children most likely to contain an occluder come first. The
+     *  occlusion kernels visit hit children in this order instead of
+     *  sorting them by distance. Stops at barriers like the tree
+     *  rotations. */
+    static void sortForOcclusion(NodeRef node);
+
+    /*! Stores the BVH at the current position of a file. Node
+     *  references are stored relative to the start of the BVH. */
+    bool store (FILE* file);
+
+    /*! Maps a BVH stored with store into memory and relocates its
+     *  node references. */
+    bool restore (const char* filename, size_t offset, size_t bytes);
+
+    /*! Releases a previously restored BVH. */
+    void unmap ();
+
     Ref<LinearAllocatorPerThread> alloc; // FIXME: why using reference?
 
+    /*! Allocator for nodes that only live until the builder converts them, nodes are allocated from alloc if not set. */
+    Ref<LinearAllocatorPerThread> allocTempNodes;
+
     __forceinline Node* allocNode(size_t thread) {
-      Node* node = (Node*) alloc->malloc(thread,sizeof(Node),1 << 7); node->clear(); return node; // FIXME: why 7 bits alinged, and not 4 bits
+      LinearAllocatorPerThread* a = allocTempNodes ? allocTempNodes.ptr : alloc.ptr;
+      Node* node = (Node*) a->malloc(thread,sizeof(Node),1 << 7); node->clear(); return node; // FIXME: why 7 bits alinged, and not 4 bits
+    }
+
+    __forceinline QuantizedNode* allocQuantizedNode(size_t thread) {
+      return (QuantizedNode*) alloc->malloc(thread,sizeof(QuantizedNode),1 << alignment);
     }
 
     __forceinline char* allocPrimitiveBlocks(size_t thread, size_t num) {
@@ -277,7 +384,9 @@ namespace embree
     /*! calculates the amount of bytes allocated */
     size_t bytesAllocated() 
     {
-      if (nodes || primitives)
+      if (mapped)
+        return bytesMapped;
+      else if (nodes || primitives)
         return bytesNodes+bytesPrimitives+numVertices*sizeof(Vec3fa);
       else
         return alloc->bytes()+numVertices*sizeof(Vec3fa);
@@ -287,6 +396,7 @@ namespace embree
     const PrimitiveType& primTy;       //!< primitive type stored in the BVH
     void* geometry;                    //!< pointer to additional data for primitive intersector
     NodeRef root;                      //!< Root node
+    bool quantized;                    //!< true if the nodes are of type QuantizedNode
     size_t numPrimitives;
     size_t numVertices;
 
@@ -297,6 +407,11 @@ namespace embree
     void* primitives;
     size_t bytesPrimitives;
     std::vector<BVH4*> objects;
+
+    /*! memory mapped data of a restored BVH */
+  public:
+    void* mapped;
+    size_t bytesMapped;
   };
 
   // FIXME: move the below code to somewhere else
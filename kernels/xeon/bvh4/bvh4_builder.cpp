@@ -64,6 +64,7 @@ namespace embree
     for (int i=0; i<5; i++) 
       BVH4Rotate::rotate(bvh,bvh->root);
 #endif
+    BVH4::sortForOcclusion(bvh->root);
     bvh->clearBarrier(bvh->root);
     bvh->bounds = initStage.pinfo.geomBounds;
     initStage.pinfo.clear();
@@ -187,6 +188,7 @@ namespace embree
     for (int i=0; i<5; i++) 
       BVH4Rotate::rotate(parent->bvh,dst); 
 #endif
+    BVH4::sortForOcclusion(dst);
     dst.setBarrier();
     delete this;
   }
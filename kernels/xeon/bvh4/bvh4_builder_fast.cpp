@@ -18,6 +18,7 @@
 #include "bvh4_builder_fast.h"
 #include "bvh4_statistics.h"
 #include "bvh4_builder_binner.h"
+#include "common/buildsource.h"
 
 #include "geometry/triangle1.h"
 #include "geometry/triangle4.h"
@@ -29,6 +30,10 @@
 #define THRESHOLD_FOR_SUBTREE_RECURSION 128
 #define BUILD_RECORD_SPLIT_THRESHOLD 512
 
+#define PRESPLIT_DEPTH 2              // each pre-split primitive gets subdivided into 2^PRESPLIT_DEPTH references
+#define PRESPLIT_MIN_AREA_RATIO 8.0f  // minimal ratio of bounding box area to triangle area to pre-split a primitive
+#define PRESPLIT_BUCKETS 32
+
 #define DBG(x) 
 
 //#if defined(__USE_STAT_COUNTERS__)
@@ -44,7 +49,7 @@ namespace embree
     std::auto_ptr<BVH4BuilderFast::GlobalState> BVH4BuilderFast::g_state(NULL);
     
     BVH4BuilderFast::BVH4BuilderFast (BVH4* bvh, BuildSource* source, Scene* scene, TriangleMesh* mesh, const size_t minLeafSize, const size_t maxLeafSize)
-    : source(source), scene(scene), mesh(mesh), primTy(bvh->primTy), bvh(bvh), numGroups(0), numPrimitives(0), prims(NULL), bytesPrims(0), createSmallLeaf(NULL)
+    : source(source), scene(scene), mesh(mesh), primTy(bvh->primTy), bvh(bvh), numGroups(0), numPrimitives(0), prims(NULL), bytesPrims(0), numPrimRefs(0), duplications(0.0f), numPreSplitPrims(0), preSplitMinBucket(0), createSmallLeaf(NULL)
     {
       needAllThreads = true;
       if (mesh) needAllThreads = mesh->numTriangles > 50000;
@@ -183,19 +188,23 @@ namespace embree
         size_t additionalBlocks = 1;
         if (needAllThreads) additionalBlocks = threadCount;
         
+        /* reserve additional primitive references for pre-splits and builders that duplicate primitives */
+        numPreSplitPrims = numPrimitives*g_presplits/100;
+        numPrimRefs = numPrimitives + numPreSplitPrims + size_t(duplications*numPrimitives);
+
         /* allocate as much memory as likely needed and reserve conservative amounts of memory */
-        size_t numPrimBlocks = bvh->primTy.blocks(numPrimitives);
-        size_t numAllocatedNodes = min(size_t(0.6*numPrimBlocks),numPrimitives);
-        size_t numAllocatedPrimitives = min(size_t(1.2*numPrimBlocks),numPrimitives);
+        size_t numPrimBlocks = bvh->primTy.blocks(numPrimRefs);
+        size_t numAllocatedNodes = min(size_t(0.6*numPrimBlocks),numPrimRefs);
+        size_t numAllocatedPrimitives = min(size_t(1.2*numPrimBlocks),numPrimRefs);
 #if defined(__X86_64__)
-        size_t numReservedNodes = 2*numPrimitives;
-        size_t numReservedPrimitives = 2*numPrimitives;
+        size_t numReservedNodes = 2*numPrimRefs;
+        size_t numReservedPrimitives = 2*numPrimRefs;
 #else
         size_t numReservedNodes = 1.5*numAllocatedNodes;
         size_t numReservedPrimitives = 1.5*numAllocatedPrimitives;
 #endif
 
-        bytesPrims = numPrimitives * sizeof(PrimRef);
+        bytesPrims = numPrimRefs * sizeof(PrimRef);
         size_t bytesAllocatedNodes      = numAllocatedNodes * sizeof(BVH4::Node);
         size_t bytesAllocatedPrimitives = numAllocatedPrimitives * bvh->primTy.bytes;
         bytesAllocatedPrimitives        = max(bytesAllocatedPrimitives,bytesPrims); // required as we store prims into primitive array for parallel splits
@@ -324,6 +333,121 @@ namespace embree
     }
 #endif
     
+    // =======================================================================================================
+    // =======================================================================================================
+    // =======================================================================================================
+
+    int BVH4BuilderFast::preSplitBucket(const PrimRef& prim) const
+    {
+      const TriangleMesh* __restrict__ const mesh = scene->getTriangleMesh(prim.geomID());
+      const TriangleMesh::Triangle& tri = mesh->triangle(prim.primID());
+      const Vec3fa v0 = mesh->vertex(tri.v[0]);
+      const Vec3fa v1 = mesh->vertex(tri.v[1]);
+      const Vec3fa v2 = mesh->vertex(tri.v[2]);
+
+      /* only split primitives whose bounds are much larger than the triangle */
+      const float triArea = 0.5f*length(cross(v1-v0,v2-v0));
+      const float boxArea = halfArea(prim.bounds());
+      if (!(triArea > 0.0f) || boxArea < PRESPLIT_MIN_AREA_RATIO*triArea)
+        return -1;
+
+      /* priority classes are powers of two of the area ratio */
+      int bucket = 0;
+      for (float ratio = boxArea/(PRESPLIT_MIN_AREA_RATIO*triArea); ratio >= 2.0f && bucket < PRESPLIT_BUCKETS-1; ratio *= 0.5f)
+        bucket++;
+      return bucket;
+    }
+
+    void BVH4BuilderFast::computePreSplitHistogram(const size_t threadID, const size_t numThreads)
+    {
+      const size_t startID = (threadID+0)*numPrimitives/numThreads;
+      const size_t endID   = (threadID+1)*numPrimitives/numThreads;
+
+      size_t* histogram = &preSplitHistogram[threadID*PRESPLIT_BUCKETS];
+      for (size_t i=startID; i<endID; i++) {
+        const int bucket = preSplitBucket(prims[i]);
+        if (bucket >= 0) histogram[bucket]++;
+      }
+    }
+
+    void BVH4BuilderFast::computePreSplits(const size_t threadID, const size_t numThreads)
+    {
+      const size_t startID = (threadID+0)*numPrimitives/numThreads;
+      const size_t endID   = (threadID+1)*numPrimitives/numThreads;
+      const size_t numPieces = 1 << PRESPLIT_DEPTH;
+
+      /* the additional references of each thread are placed behind the ones of all previous threads */
+      size_t dst = numPrimitives;
+      for (size_t t=0; t<threadID; t++)
+        for (size_t b=preSplitMinBucket; b<PRESPLIT_BUCKETS; b++)
+          dst += (numPieces-1)*preSplitHistogram[t*PRESPLIT_BUCKETS+b];
+
+      Centroid_Scene_AABB bounds; bounds.reset();
+      for (size_t i=startID; i<endID; i++)
+      {
+        if (preSplitBucket(prims[i]) < preSplitMinBucket)
+          continue;
+
+        const TriangleMesh* __restrict__ const mesh = scene->getTriangleMesh(prims[i].geomID());
+        const TriangleMesh::Triangle& tri = mesh->triangle(prims[i].primID());
+        const Vec3fa v0 = mesh->vertex(tri.v[0]);
+        const Vec3fa v1 = mesh->vertex(tri.v[1]);
+        const Vec3fa v2 = mesh->vertex(tri.v[2]);
+
+        /* recursively split all pieces in the middle of their largest extent */
+        PrimRef pieces[numPieces];
+        pieces[0] = prims[i];
+        for (size_t n=1; n<numPieces; n*=2) {
+          for (size_t k=0; k<n; k++) {
+            const BBox3fa box = pieces[k].bounds();
+            const int dim = maxDim(box.size());
+            const PrimRef piece = pieces[k];
+            splitTriangle(piece,dim,0.5f*(box.lower[dim]+box.upper[dim]),v0,v1,v2,pieces[k],pieces[n+k]);
+          }
+        }
+
+        prims[i] = pieces[0];
+        bounds.extend(pieces[0].bounds());
+        for (size_t k=1; k<numPieces; k++) {
+          prims[dst++] = pieces[k];
+          bounds.extend(pieces[k].bounds());
+        }
+      }
+      global_bounds.extend_atomic(bounds);
+    }
+
+    size_t BVH4BuilderFast::preSplit(size_t threadIndex, size_t threadCount)
+    {
+      if (numPreSplitPrims == 0)
+        return numPrimitives;
+
+      /* count primitives per priority class */
+      preSplitHistogram.clear();
+      preSplitHistogram.resize(threadCount*PRESPLIT_BUCKETS,0);
+      if (threadCount == 1) computePreSplitHistogram(0,1);
+      else g_state->scheduler.dispatchTask( task_computePreSplitHistogram, this, threadIndex, threadCount );
+
+      /* split the primitives of the highest priority classes that fit into the budget */
+      const size_t numPieces = 1 << PRESPLIT_DEPTH;
+      size_t numSplits = 0;
+      preSplitMinBucket = PRESPLIT_BUCKETS;
+      for (int b=PRESPLIT_BUCKETS-1; b>=0; b--)
+      {
+        size_t num = 0;
+        for (size_t t=0; t<threadCount; t++)
+          num += preSplitHistogram[t*PRESPLIT_BUCKETS+b];
+        if ((numSplits+num)*(numPieces-1) > numPreSplitPrims) break;
+        numSplits += num;
+        preSplitMinBucket = b;
+      }
+      if (numSplits == 0)
+        return numPrimitives;
+
+      if (threadCount == 1) computePreSplits(0,1);
+      else g_state->scheduler.dispatchTask( task_computePreSplits, this, threadIndex, threadCount );
+      return numPrimitives + numSplits*(numPieces-1);
+    }
+    
     // =======================================================================================================
     // =======================================================================================================
     // =======================================================================================================
@@ -521,7 +645,7 @@ namespace embree
       return true;
     }
     
-    __forceinline bool BVH4BuilderFast::split(BuildRecord& current, BuildRecord& left, BuildRecord& right, const size_t mode, const size_t threadID, const size_t numThreads)
+    bool BVH4BuilderFast::split(BuildRecord& current, BuildRecord& left, BuildRecord& right, const size_t mode, const size_t threadID, const size_t numThreads)
     {
       if (mode == BUILD_TOP_LEVEL && current.items() >= BUILD_RECORD_SPLIT_THRESHOLD)
         return splitParallel(current,left,right,threadID,numThreads);		  
@@ -686,6 +810,12 @@ namespace embree
       }
     }
 
+    void BVH4BuilderFast::sortSubTrees(const size_t threadID, const size_t numThreads)
+    {
+      for (size_t i=threadID; i<subTrees.size(); i+=numThreads)
+        BVH4::sortForOcclusion(*subTrees[i]);
+    }
+
     void BVH4BuilderFast::build_sequential(size_t threadIndex, size_t threadCount) 
     {
       /* start measurement */
@@ -701,17 +831,22 @@ namespace embree
       /* create prim refs */
       global_bounds.reset();
       computePrimRefs(0,1);
+      const size_t numRefs = preSplit(threadIndex,1);
       bvh->bounds = global_bounds.geometry;
 
       /* create initial build record */
       BuildRecord br;
-      br.init(global_bounds,0,numPrimitives);
+      br.init(global_bounds,0,numRefs);
+      br.ext_end = numPrimRefs;
       br.depth = 1;
       br.parentNode = (size_t)&bvh->root;
 
       /* build BVH in single thread */
       recurseSAH(br,nodeAlloc,leafAlloc,RECURSE_SEQUENTIAL,threadIndex,threadCount);
 
+      /* order the children for shadow rays */
+      BVH4::sortForOcclusion(bvh->root);
+
       /* stop measurement */
       if (g_verbose >= 2) dt = getSeconds()-t0;
     }
@@ -734,6 +869,7 @@ namespace embree
       /* calculate list of primrefs */
       global_bounds.reset();
       g_state->scheduler.dispatchTask( task_computePrimRefs, this, threadIndex, threadCount );
+      const size_t numRefs = preSplit(threadIndex,threadCount);
       bvh->bounds = global_bounds.geometry;
       
       /* initialize node and leaf allocator */
@@ -744,7 +880,8 @@ namespace embree
 
       /* create initial build record */
       BuildRecord br;
-      br.init(global_bounds,0,numPrimitives);
+      br.init(global_bounds,0,numRefs);
+      br.ext_end = numPrimRefs;
       br.depth = 1;
       br.parentNode = (size_t)&bvh->root;
       
@@ -772,8 +909,20 @@ namespace embree
         recurseSAH(br,nodeAlloc,leafAlloc,BUILD_TOP_LEVEL,threadIndex,threadCount);
       }
       
+      /* remember the roots of the subtrees */
+      subTrees.clear();
+      for (size_t i=0; i<g_state->workStack.size(); i++)
+        subTrees.push_back((NodeRef*)g_state->workStack.t[i].parentNode);
+
       /* now process all created subtasks on multiple threads */
       g_state->scheduler.dispatchTask(task_buildSubTrees, this, threadIndex, threadCount );
+
+      /* order the children for shadow rays, the subtrees in parallel, then the top of the tree */
+      g_state->scheduler.dispatchTask(task_sortSubTrees, this, threadIndex, threadCount );
+      for (size_t i=0; i<subTrees.size(); i++)
+        if (subTrees[i]->isNode()) subTrees[i]->setBarrier();
+      BVH4::sortForOcclusion(bvh->root);
+      bvh->clearBarrier(bvh->root);
       
       /* release all threads again */
       g_state->scheduler.releaseThreads(threadCount);
@@ -74,9 +74,18 @@ namespace embree
       /* single threaded build */
       void build_sequential(size_t threadIndex, size_t threadCount);
       
+      /*! subdivides primitives with large bounds, returns the number of primitive references */
+      size_t preSplit(size_t threadIndex, size_t threadCount);
+
+      /*! returns the pre-split priority class of a primitive, or -1 if it should not get split */
+      int preSplitBucket(const PrimRef& prim) const;
+
     public:
       TASK_FUNCTION(BVH4BuilderFast,computePrimRefs);
+      TASK_FUNCTION(BVH4BuilderFast,computePreSplitHistogram);
+      TASK_FUNCTION(BVH4BuilderFast,computePreSplits);
       TASK_FUNCTION(BVH4BuilderFast,buildSubTrees);
+      TASK_FUNCTION(BVH4BuilderFast,sortSubTrees);
       TASK_RUN_FUNCTION(BVH4BuilderFast,build_parallel);
 
     public:
@@ -85,7 +94,7 @@ namespace embree
       enum { RECURSE_SEQUENTIAL = 1, RECURSE_PARALLEL = 2, BUILD_TOP_LEVEL = 3 };
       
       /*! splitting function that selects between sequential and parallel mode */
-      bool split(BuildRecord& current, BuildRecord& left, BuildRecord& right, const size_t mode, const size_t threadID, const size_t numThreads);
+      virtual bool split(BuildRecord& current, BuildRecord& left, BuildRecord& right, const size_t mode, const size_t threadID, const size_t numThreads);
       
       /*! perform sequential binning and splitting */
       bool splitSequential(BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild);
@@ -123,6 +132,14 @@ namespace embree
     protected:
       PrimRef* prims;
       size_t bytesPrims;
+      std::vector<NodeRef*> subTrees; //!< roots of the subtrees built in parallel
+      size_t numPrimRefs;      //!< number of allocated primitive references
+      float duplications;      //!< additional primitive references reserved per primitive
+
+    protected:
+      size_t numPreSplitPrims;                //!< maximal number of primitive references added by pre-splits
+      std::vector<size_t> preSplitHistogram;  //!< number of primitives per thread and priority class
+      int preSplitMinBucket;                  //!< lowest priority class that gets split
       
     protected:
       size_t numGroups;
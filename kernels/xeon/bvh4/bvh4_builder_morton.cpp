@@ -17,6 +17,7 @@
 #include "bvh4.h"
 #include "bvh4_builder_morton.h"
 #include "bvh4_statistics.h"
+#include "bvh4_restructure.h"
 
 #include "geometry/triangle1.h"
 #include "geometry/triangle4.h"
@@ -43,7 +44,7 @@ namespace embree
     
     BVH4BuilderMorton::BVH4BuilderMorton (BVH4* bvh, BuildSource* source, Scene* scene, TriangleMesh* mesh, const size_t minLeafSize, const size_t maxLeafSize)
     : bvh(bvh), source(source), scene(scene), mesh(mesh), topLevelItemThreshold(0), encodeShift(0), encodeMask(0),
-      morton(NULL), bytesMorton(0), numGroups(0), numPrimitives(0), numAllocatedPrimitives(0), numAllocatedNodes(0)
+      use64BitCodes(g_morton_bits >= 64), morton(NULL), morton64(NULL), bytesMorton(0), numGroups(0), numPrimitives(0), numAllocatedPrimitives(0), numAllocatedNodes(0)
     {
       needAllThreads = true;
       if (mesh) needAllThreads = mesh->numTriangles > 50000;
@@ -225,7 +226,7 @@ namespace embree
         size_t numReservedNodes = 1.5*numAllocatedNodes;
         size_t numReservedPrimitives = 1.5*numAllocatedPrimitives;
 #endif
-        bytesMorton = ((numPrimitives+7)&(-8)) * sizeof(MortonID32Bit);
+        bytesMorton = ((numPrimitives+7)&(-8)) * (use64BitCodes ? sizeof(MortonID64Bit) : sizeof(MortonID32Bit));
         size_t bytesAllocatedNodes      = numAllocatedNodes * sizeof(BVH4::Node);
         size_t bytesAllocatedPrimitives = numAllocatedPrimitives * bvh->primTy.bytes;
         size_t bytesReservedNodes       = numReservedNodes * sizeof(BVH4::Node);
@@ -239,6 +240,7 @@ namespace embree
 
         /* allocated memory for primrefs, nodes, and primitives */
         morton = (MortonID32Bit* ) os_malloc(bytesMorton); memset(morton,0,bytesMorton);
+        morton64 = (MortonID64Bit*) morton;
         nodeAllocator.init(bytesAllocatedNodes,bytesReservedNodes);
         primAllocator.init(bytesAllocatedPrimitives,bytesReservedPrimitives);
         
@@ -345,7 +347,7 @@ namespace embree
       /* compute mapping from world space into 3D grid */
       const ssef base     = (ssef)global_bounds.centroid2.lower;
       const ssef diagonal = (ssef)global_bounds.centroid2.upper - (ssef)global_bounds.centroid2.lower;
-      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(MortonID32Bit::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
       
       size_t currentID = startID;
       size_t offset = startOffset;
@@ -399,17 +401,58 @@ namespace embree
       }
     }
     
+    void BVH4BuilderMorton::computeMortonCodes(const size_t startID, const size_t endID, 
+                                               const size_t startGroup, const size_t startOffset, 
+                                               MortonID64Bit* __restrict__ const dest)
+    {
+      /* compute mapping from world space into 3D grid */
+      const ssef base     = (ssef)global_bounds.centroid2.lower;
+      const ssef diagonal = (ssef)global_bounds.centroid2.upper - (ssef)global_bounds.centroid2.lower;
+      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(MortonID64Bit::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      
+      size_t currentID = startID;
+      size_t offset = startOffset;
+      
+      for (size_t group = startGroup; group<numGroups; group++) 
+      {       
+        Geometry* geom = scene->get(group);
+        if (!geom || geom->type != TRIANGLE_MESH) continue;
+        TriangleMesh* mesh = (TriangleMesh*) geom;
+        if (mesh->numTimeSteps != 1) continue;
+        const size_t numTriangles = min(mesh->numTriangles-offset,endID-currentID);
+        
+        for (size_t i=0; i<numTriangles; i++, currentID++)	  
+        {
+          const BBox3fa b = mesh->bounds(offset+i);
+          const ssef lower = (ssef)b.lower;
+          const ssef upper = (ssef)b.upper;
+          const ssef centroid = lower+upper;
+          const ssei binID = ssei((centroid-base)*scale);
+          dest[currentID].code  = MortonID64Bit::encode(extract<0>(binID),extract<1>(binID),extract<2>(binID));
+          dest[currentID].index = (group << encodeShift) | (offset+i);
+        }
+        offset = 0;
+        if (currentID == endID) break;
+      }
+    }
+    
     void BVH4BuilderMorton::computeMortonCodes(const size_t threadID, const size_t numThreads)
     {      
       const size_t startID = (threadID+0)*numPrimitives/numThreads;
       const size_t endID   = (threadID+1)*numPrimitives/numThreads;
       
       /* store the morton codes temporarily in 'node' memory */
-      MortonID32Bit* __restrict__ const dest = (MortonID32Bit*)nodeAllocator.data; 
-      computeMortonCodes(startID,endID,g_state->startGroup[threadID],g_state->startGroupOffset[threadID],dest);
+      if (use64BitCodes) {
+        MortonID64Bit* __restrict__ const dest = (MortonID64Bit*)nodeAllocator.data; 
+        computeMortonCodes(startID,endID,g_state->startGroup[threadID],g_state->startGroupOffset[threadID],dest);
+      } else {
+        MortonID32Bit* __restrict__ const dest = (MortonID32Bit*)nodeAllocator.data; 
+        computeMortonCodes(startID,endID,g_state->startGroup[threadID],g_state->startGroupOffset[threadID],dest);
+      }
     }
     
-    void BVH4BuilderMorton::recreateMortonCodes(SmallBuildRecord& current) const
+    template<typename MortonID>
+    void BVH4BuilderMorton::recreateMortonCodes(MortonID* __restrict__ const morton, SmallBuildRecord& current) const
     {
       assert(current.size() > 4);
       Centroid_Scene_AABB global_bounds;
@@ -426,7 +469,7 @@ namespace embree
       /* compute mapping from world space into 3D grid */
       const ssef base     = (ssef)global_bounds.centroid2.lower;
       const ssef diagonal = (ssef)global_bounds.centroid2.upper - (ssef)global_bounds.centroid2.lower;
-      const ssef scale    = select(diagonal != 0,rcp(diagonal) * ssef(LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      const ssef scale    = select(diagonal != 0,rcp(diagonal) * ssef(MortonID::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
       
       for (size_t i=current.begin; i<current.end; i++)
       {
@@ -441,10 +484,9 @@ namespace embree
         const unsigned int bx = extract<0>(binID);
         const unsigned int by = extract<1>(binID);
         const unsigned int bz = extract<2>(binID);
-        const unsigned int code = bitInterleave(bx,by,bz);
-        morton[i].code  = code;
+        morton[i].code = MortonID::encode(bx,by,bz);
       }
-      quicksort_insertionsort_ascending<MortonID32Bit,512>(morton,current.begin,current.end-1); 
+      quicksort_insertionsort_ascending<MortonID,512>(morton,current.begin,current.end-1); 
       
 #if defined(DEBUG)
       for (size_t i=current.begin; i<current.end-1; i++)
@@ -454,66 +496,11 @@ namespace embree
     
     void BVH4BuilderMorton::radixsort(const size_t threadID, const size_t numThreads)
     {
-      //size_t taskID = TaskLogger::beginTask(threadID,"BVH4BuilderMorton::radixsort",0);
-
-      const size_t startID = (threadID+0)*numPrimitives/numThreads;
-      const size_t endID   = (threadID+1)*numPrimitives/numThreads;
-      
-      MortonID32Bit* __restrict__ mortonID[2];
-      mortonID[0] = (MortonID32Bit*) morton; 
-      //mortonID[1] = (MortonID32Bit*) node;
-      mortonID[1] = (MortonID32Bit*) nodeAllocator.data;
-      MortonBuilderState::ThreadRadixCountTy* radixCount = g_state->radixCount;
-      
-      /* we need 3 iterations to process all 32 bits */
-      for (size_t b=0; b<3; b++)
-      {
-        const MortonID32Bit* __restrict src = (MortonID32Bit*) &mortonID[((b+1)%2)][0];
-        MortonID32Bit*       __restrict dst = (MortonID32Bit*) &mortonID[((b+0)%2)][0];
-        
-        /* shift and mask to extract some number of bits */
-        const unsigned int mask = RADIX_BUCKETS_MASK;
-        const unsigned int shift = b * RADIX_BITS;
-        
-        /* count how many items go into the buckets */
-        for (size_t i=0; i<RADIX_BUCKETS; i++)
-          radixCount[threadID][i] = 0;
-        
-        for (size_t i=startID; i<endID; i++) {
-          const size_t index = src[i].get(shift, mask);
-          radixCount[threadID][index]++;
-        }
-        scheduler.syncThreads(threadID,numThreads);
-        
-        /* calculate total number of items for each bucket */
-        __aligned(64) size_t total[RADIX_BUCKETS];
-        for (size_t i=0; i<RADIX_BUCKETS; i++)
-          total[i] = 0;
-        
-        for (size_t i=0; i<numThreads; i++)
-          for (size_t j=0; j<RADIX_BUCKETS; j++)
-            total[j] += radixCount[i][j];
-        
-        /* calculate start offset of each bucket */
-        __aligned(64) size_t offset[RADIX_BUCKETS];
-        offset[0] = 0;
-        for (size_t i=1; i<RADIX_BUCKETS; i++)    
-          offset[i] = offset[i-1] + total[i-1];
-        
-        /* calculate start offset of each bucket for this thread */
-        for (size_t j=0; j<RADIX_BUCKETS; j++)
-          for (size_t i=0; i<threadID; i++)
-            offset[j] += radixCount[i][j];
-        
-        /* copy items into their buckets */
-        for (size_t i=startID; i<endID; i++) {
-          const size_t index = src[i].get(shift, mask);
-          dst[offset[index]++] = src[i];
-        }
-        if (b < 2) scheduler.syncThreads(threadID,numThreads);
-      }
-
-      //TaskLogger::endTask(threadID,taskID);
+      /* the morton codes are stored in 'node' memory and get sorted into the morton array */
+      if (use64BitCodes)
+        radixSortMortonCodes((MortonID64Bit*)nodeAllocator.data,morton64,numPrimitives,g_state->radixCount,threadID,numThreads);
+      else
+        radixSortMortonCodes((MortonID32Bit*)nodeAllocator.data,morton,numPrimitives,g_state->radixCount,threadID,numThreads);
     }
     
     void BVH4BuilderMorton::recurseSubMortonTrees(const size_t threadID, const size_t numThreads)
@@ -527,6 +514,9 @@ namespace embree
         
         //size_t id = TaskLogger::beginTask(threadID,"BVH4BuilderMorton::subtree",0);
         recurse(g_state->buildRecords[taskID],nodeAlloc,leafAlloc,RECURSE,threadID);
+        for (size_t i=0; i<g_restructure_passes; i++)
+          BVH4Restructure::restructure(bvh,*g_state->buildRecords[taskID].parent,g_state->buildRecords[taskID].depth);
+        BVH4::sortForOcclusion(*g_state->buildRecords[taskID].parent);
         g_state->buildRecords[taskID].parent->setBarrier();
         g_state->workStack.push(g_state->buildRecords[taskID]);
         //TaskLogger::endTask(threadID,id);
@@ -551,7 +541,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++) 
       {	
-        const size_t index = This->morton[start+i].index;
+        const size_t index = This->mortonIndex(start+i);
         const size_t primID = index & This->encodeMask; 
         const size_t geomID = index >> This->encodeShift; 
         const TriangleMesh* __restrict__ const mesh = This->scene->getTriangleMesh(geomID);
@@ -593,7 +583,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++)
       {
-        const size_t index = This->morton[start+i].index;
+        const size_t index = This->mortonIndex(start+i);
         const size_t primID = index & This->encodeMask; 
         const size_t geomID = index >> This->encodeShift; 
         const TriangleMesh* __restrict__ const mesh = This->scene->getTriangleMesh(geomID);
@@ -629,7 +619,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++) 
       {	
-        const size_t index = This->morton[start+i].index;
+        const size_t index = This->mortonIndex(start+i);
         const size_t primID = index & This->encodeMask; 
         const size_t geomID = index >> This->encodeShift; 
         const TriangleMesh* __restrict__ const mesh = This->scene->getTriangleMesh(geomID);
@@ -670,7 +660,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++)
       {
-        const size_t index = This->morton[start+i].index;
+        const size_t index = This->mortonIndex(start+i);
         const size_t primID = index & This->encodeMask; 
         const size_t geomID = index >> This->encodeShift; 
         const TriangleMesh* __restrict__ const mesh = This->scene->getTriangleMesh(geomID);
@@ -739,24 +729,22 @@ namespace embree
       return bounds0;
     }  
     
-    __forceinline void BVH4BuilderMorton::split(SmallBuildRecord& current,
+    template<typename MortonID>
+    __forceinline void BVH4BuilderMorton::split(MortonID* __restrict__ const morton,
+                                                SmallBuildRecord& current,
                                                 SmallBuildRecord& left,
                                                 SmallBuildRecord& right) const
     {
-      const unsigned int code_start = morton[current.begin].code;
-      const unsigned int code_end   = morton[current.end-1].code;
-      unsigned int bitpos = clz(code_start^code_end);
+      int bitpos = MortonID::highestDifferentBit(morton[current.begin].code,morton[current.end-1].code);
       
       /* if all items mapped to same morton code, then create new morton codes for the items */
-      if (unlikely(bitpos == 32)) 
+      if (unlikely(bitpos < 0)) 
       {
-        recreateMortonCodes(current);
-        const unsigned int code_start = morton[current.begin].code;
-        const unsigned int code_end   = morton[current.end-1].code;
-        bitpos = clz(code_start^code_end);
+        recreateMortonCodes(morton,current);
+        bitpos = MortonID::highestDifferentBit(morton[current.begin].code,morton[current.end-1].code);
         
         /* if the morton code is still the same, goto fall back split */
-        if (unlikely(bitpos == 32)) 
+        if (unlikely(bitpos < 0)) 
         {
           size_t center = (current.begin + current.end)/2; 
           left.init(current.begin,center);
@@ -766,15 +754,14 @@ namespace embree
       }
       
       /* split the items at the topmost different morton code bit */
-      const unsigned int bitpos_diff = 31-bitpos;
-      const unsigned int bitmask = 1 << bitpos_diff;
+      const typename MortonID::CodeTy bitmask = typename MortonID::CodeTy(1) << bitpos;
       
       /* find location where bit differs using binary search */
       size_t begin = current.begin;
       size_t end   = current.end;
       while (begin + 1 != end) {
         const size_t mid = (begin+end)/2;
-        const unsigned bit = morton[mid].code & bitmask;
+        const typename MortonID::CodeTy bit = morton[mid].code & bitmask;
         if (bit == 0) begin = mid; else end = mid;
       }
       size_t center = end;
@@ -787,6 +774,14 @@ namespace embree
       right.init(center,current.end);
     }
     
+    __forceinline void BVH4BuilderMorton::split(SmallBuildRecord& current,
+                                                SmallBuildRecord& left,
+                                                SmallBuildRecord& right) const
+    {
+      if (use64BitCodes) split(morton64,current,left,right);
+      else               split(morton,current,left,right);
+    }
+    
     BBox3fa BVH4BuilderMorton::recurse(SmallBuildRecord& current, Allocator& nodeAlloc, Allocator& leafAlloc, const size_t mode, const size_t threadID) 
     {
       /* stop toplevel recursion at some number of items */
@@ -959,29 +954,39 @@ namespace embree
                     Vec3fa(upper_x,upper_y,upper_z));
     }
 
-    void BVH4BuilderMorton::build_sequential_morton(size_t threadIndex, size_t threadCount) 
+    void BVH4BuilderMorton::sortMortonCodesSequential() 
     {
-      /* start measurement */
-      double t0 = 0.0f;
-      if (g_verbose >= 2) t0 = getSeconds();
-
       /* compute scene bounds */
       global_bounds = computeBounds();
       bvh->bounds = global_bounds.geometry;
 
-      /* compute morton codes */
-      if (mesh)
-        computeMortonCodes(0,numPrimitives,mesh->id,0,morton);
-      else
-        computeMortonCodes(0,numPrimitives,0,0,morton);
+      /* compute morton codes into 'node' memory and sort them into the morton array */
+      const size_t startGroup = mesh ? mesh->id : 0;
+      __aligned(64) MortonRadixCountTy radixCount[1];
+      if (use64BitCodes) {
+        MortonID64Bit* __restrict__ const dest = (MortonID64Bit*) nodeAllocator.data;
+        computeMortonCodes(0,numPrimitives,startGroup,0,dest);
+        radixSortMortonCodes(dest,morton64,numPrimitives,radixCount,0,1);
+      } else {
+        MortonID32Bit* __restrict__ const dest = (MortonID32Bit*) nodeAllocator.data;
+        computeMortonCodes(0,numPrimitives,startGroup,0,dest);
+        radixSortMortonCodes(dest,morton,numPrimitives,radixCount,0,1);
+      }
 
-      /* sort morton codes */
-      std::sort(&morton[0],&morton[numPrimitives]); // FIMXE: use radix sort
-      
 #if defined(DEBUG)
       for (size_t i=1; i<numPrimitives; i++)
-        assert(morton[i-1].code <= morton[i].code);
+        assert(use64BitCodes ? morton64[i-1].code <= morton64[i].code : morton[i-1].code <= morton[i].code);
 #endif	    
+    }
+
+    void BVH4BuilderMorton::build_sequential_morton(size_t threadIndex, size_t threadCount) 
+    {
+      /* start measurement */
+      double t0 = 0.0f;
+      if (g_verbose >= 2) t0 = getSeconds();
+
+      /* compute sorted morton codes */
+      sortMortonCodesSequential();
       
       SmallBuildRecord br;
       br.init(0,numPrimitives);
@@ -994,29 +999,20 @@ namespace embree
       __aligned(64) Allocator nodeAlloc(nodeAllocator);
       __aligned(64) Allocator leafAlloc(primAllocator);
       recurse(br,nodeAlloc,leafAlloc,RECURSE,threadIndex);	    
+
+      /* optimize the SAH of small treelets */
+      for (size_t i=0; i<g_restructure_passes; i++)
+        BVH4Restructure::restructure(bvh,bvh->root);
+
+      /* order the children for shadow rays */
+      BVH4::sortForOcclusion(bvh->root);
             
       /* stop measurement */
       if (g_verbose >= 2) dt = getSeconds()-t0;
     }
     
-    void BVH4BuilderMorton::build_parallel_morton(size_t threadIndex, size_t threadCount, size_t, size_t, TaskScheduler::Event* event) 
+    void BVH4BuilderMorton::sortMortonCodesParallel(size_t threadIndex, size_t threadCount) 
     {
-      /* wait for all threads to enter */
-      g_state->barrier.wait(threadIndex,threadCount);
-
-      /* start measurement */
-      double t0 = 0.0f;
-      if (g_verbose >= 2) t0 = getSeconds();
-      
-      /* initialize thread state */
-      initThreadState(threadIndex,threadCount);
-      
-	  /* let all thread except for control thread wait for work */
-      if (threadIndex != 0) {
-        scheduler.dispatchTaskMainLoop(threadIndex,threadCount);
-        return;
-      }
-      
       /* compute scene bounds */
       global_bounds.reset();
       scheduler.dispatchTask( task_computeBounds, this, threadIndex, threadCount );
@@ -1026,10 +1022,16 @@ namespace embree
       scheduler.dispatchTask( task_computeMortonCodes, this, threadIndex, threadCount );   
       
       /* padding */
-      MortonID32Bit* __restrict__ const dest = (MortonID32Bit*) nodeAllocator.data;
       for (size_t i=numPrimitives; i<( (numPrimitives+7)&(-8) ); i++) {
-        dest[i].code  = 0xffffffff; 
-        dest[i].index = 0;
+        if (use64BitCodes) {
+          MortonID64Bit* __restrict__ const dest = (MortonID64Bit*) nodeAllocator.data;
+          dest[i].code  = (uint64)-1; 
+          dest[i].index = 0;
+        } else {
+          MortonID32Bit* __restrict__ const dest = (MortonID32Bit*) nodeAllocator.data;
+          dest[i].code  = 0xffffffff; 
+          dest[i].index = 0;
+        }
       }
       
       /* sort morton codes */
@@ -1037,8 +1039,30 @@ namespace embree
 
 #if defined(DEBUG)
       for (size_t i=1; i<numPrimitives; i++)
-        assert(morton[i-1].code <= morton[i].code);
+        assert(use64BitCodes ? morton64[i-1].code <= morton64[i].code : morton[i-1].code <= morton[i].code);
 #endif	    
+    }
+    
+    void BVH4BuilderMorton::build_parallel_morton(size_t threadIndex, size_t threadCount, size_t, size_t, TaskScheduler::Event* event) 
+    {
+      /* wait for all threads to enter */
+      g_state->barrier.wait(threadIndex,threadCount);
+
+      /* start measurement */
+      double t0 = 0.0f;
+      if (g_verbose >= 2) t0 = getSeconds();
+      
+      /* initialize thread state */
+      initThreadState(threadIndex,threadCount);
+      
+	  /* let all thread except for control thread wait for work */
+      if (threadIndex != 0) {
+        scheduler.dispatchTaskMainLoop(threadIndex,threadCount);
+        return;
+      }
+      
+      /* compute sorted morton codes */
+      sortMortonCodesParallel(threadIndex,threadCount);
       
       /* build and extract top-level tree */
       g_state->numBuildRecords = 0;
@@ -1065,6 +1089,15 @@ namespace embree
       
       /* refit toplevel part of tree */
       refit_toplevel(bvh->root);
+
+      /* optimize the SAH of small treelets of the toplevel part of the tree and order its children 
+       * for shadow rays, the sub-trees got already optimized and ordered */
+      for (size_t i=0; i<g_state->numBuildRecords; i++)
+        g_state->buildRecords[i].parent->setBarrier();
+      for (size_t i=0; i<g_restructure_passes; i++)
+        BVH4Restructure::restructure(bvh,bvh->root);
+      BVH4::sortForOcclusion(bvh->root);
+      bvh->clearBarrier(bvh->root);
       
       /* end task */
       scheduler.releaseThreads(threadCount);
@@ -18,6 +18,7 @@
 
 #include "bvh4.h"
 #include "../bvh4i/bvh4i_builder_util.h"
+#include "../builders/morton.h"
 
 namespace embree
 {
@@ -26,6 +27,7 @@ namespace embree
     class BVH4BuilderMorton : public Builder
     {
       ALIGNED_CLASS;
+    protected:
       
       /*! Type shortcuts */
       typedef BVH4::Node    Node;
@@ -38,12 +40,6 @@ namespace embree
       static const size_t NUM_TOP_LEVEL_BINS = 1024 + 4*BVH4::maxBuildDepth;
 
       static const size_t MORTON_LEAF_THRESHOLD = 4;
-      static const size_t LATTICE_BITS_PER_DIM = 10;
-      static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
-      
-      static const size_t RADIX_BITS = 11;
-      static const size_t RADIX_BUCKETS = (1 << RADIX_BITS);
-      static const size_t RADIX_BUCKETS_MASK = (RADIX_BUCKETS-1);
 
     public:
   
@@ -71,48 +67,19 @@ namespace embree
         __forceinline bool operator>(const SmallBuildRecord& br) const { return size() > br.size(); } 
       };
 
-      struct __aligned(8) MortonID32Bit
-      {
-        union {
-          struct {
-            unsigned int code;
-            unsigned int index;
-          };
-          int64 all;
-        };
-        
-        __forceinline unsigned int get(const unsigned int shift, const unsigned and_mask) const {
-          return (code >> shift) & and_mask;
-        }
-        
-        __forceinline void operator=(const MortonID32Bit& v) {   
-          all = v.all; 
-        };  
-        
-        __forceinline friend std::ostream &operator<<(std::ostream &o, const MortonID32Bit& mc) {
-          o << "index " << mc.index << " code = " << mc.code;
-          return o;
-        }
-        
-        __forceinline bool operator<(const MortonID32Bit &m) const { return code < m.code; } 
-        __forceinline bool operator>(const MortonID32Bit &m) const { return code > m.code; } 
-      };
-
       struct MortonBuilderState
       {
         ALIGNED_CLASS;
 
       public:
 
-        typedef unsigned int ThreadRadixCountTy[RADIX_BUCKETS];
-
         MortonBuilderState () 
         {
           numBuildRecords = 0;
           numThreads = getNumberOfLogicalThreads();
           startGroup = new unsigned int[numThreads];
           startGroupOffset = new unsigned int[numThreads];
-          radixCount = (ThreadRadixCountTy*) alignedMalloc(numThreads*sizeof(ThreadRadixCountTy));
+          radixCount = (MortonRadixCountTy*) alignedMalloc(numThreads*sizeof(MortonRadixCountTy));
         }
 
         ~MortonBuilderState () 
@@ -125,7 +92,7 @@ namespace embree
         size_t numThreads;
         unsigned int* startGroup;
         unsigned int* startGroupOffset;
-        ThreadRadixCountTy* radixCount;
+        MortonRadixCountTy* radixCount;
         
         size_t numBuildRecords;
         __aligned(64) SmallBuildRecord buildRecords[NUM_TOP_LEVEL_BINS];
@@ -151,12 +118,20 @@ namespace embree
       /*! single threaded build */
       void build_sequential_morton(size_t threadIndex, size_t threadCount);
 
+      /*! computes the scene bounds and the sorted morton codes of all primitives */
+      void sortMortonCodesSequential();
+      void sortMortonCodesParallel(size_t threadIndex, size_t threadCount);
+
       Centroid_Scene_AABB computeBounds();
 
       void computeMortonCodes(const size_t startID, const size_t endID, 
                               const size_t startGroup, const size_t startOffset, 
                               MortonID32Bit* __restrict__ const dest);
 
+      void computeMortonCodes(const size_t startID, const size_t endID, 
+                              const size_t startGroup, const size_t startOffset, 
+                              MortonID64Bit* __restrict__ const dest);
+
       /*! main build task */
       TASK_RUN_FUNCTION(BVH4BuilderMorton,build_parallel_morton);
       TaskScheduler::Task task;
@@ -191,6 +166,10 @@ namespace embree
       
       /*! split a build record into two */
       void split(SmallBuildRecord& current, SmallBuildRecord& left, SmallBuildRecord& right) const;
+
+      /*! split a build record at the highest bit the morton codes differ in */
+      template<typename MortonID>
+        void split(MortonID* __restrict__ const morton, SmallBuildRecord& current, SmallBuildRecord& left, SmallBuildRecord& right) const;
       
       /*! main recursive build function */
       BBox3fa recurse(SmallBuildRecord& current, 
@@ -211,7 +190,13 @@ namespace embree
       BBox3fa refit(NodeRef& index) const;
       
       /*! recreates morton codes when reaching a region where all codes are identical */
-      void recreateMortonCodes(SmallBuildRecord& current) const;
+      template<typename MortonID>
+        void recreateMortonCodes(MortonID* __restrict__ const morton, SmallBuildRecord& current) const;
+
+      /*! returns the encoded geometry and primitive ID of the i'th sorted primitive */
+      __forceinline size_t mortonIndex(const size_t i) const {
+        return use64BitCodes ? morton64[i].index : morton[i].index;
+      }
       
     public:
       BVH4* bvh;               //!< Output BVH
@@ -226,7 +211,9 @@ namespace embree
       static std::auto_ptr<MortonBuilderState> g_state;
             
     protected:
-      MortonID32Bit* __restrict__ morton;
+      bool use64BitCodes;                     //!< use morton codes with 21 instead of 10 bits per dimension
+      MortonID32Bit* __restrict__ morton;     //!< 32 bit morton codes
+      MortonID64Bit* __restrict__ morton64;   //!< 64 bit morton codes, aliases the same memory
       size_t bytesMorton;
       
     public:
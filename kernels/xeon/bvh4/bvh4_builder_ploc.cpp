@@ -0,0 +1,212 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4.h"
+#include "bvh4_builder_ploc.h"
+#include "bvh4_statistics.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    static double dt = 0.0f;
+
+    BVH4BuilderPLOC::BVH4BuilderPLOC (BVH4* bvh, BuildSource* source, Scene* scene, TriangleMesh* mesh, const size_t minLeafSize, const size_t maxLeafSize)
+      : BVH4BuilderMorton(bvh,source,scene,mesh,minLeafSize,maxLeafSize), numClusterBuildRecords(0) {}
+
+    void BVH4BuilderPLOC::build(size_t threadIndex, size_t threadCount)
+    {
+      if (g_verbose >= 2)
+        std::cout << "building BVH4 with " << TOSTRING(isa) << "::BVH4BuilderPLOC ... " << std::flush;
+
+      /* do some global inits first */
+      init(threadIndex,threadCount);
+      clusterBuilder.init(numPrimitives);
+
+      if (needAllThreads)
+      {
+        if (!g_state.get()) g_state.reset(new MortonBuilderState);
+        scheduler.init(threadCount);
+        TaskScheduler::executeTask(threadIndex,threadCount,_build_parallel_ploc,this,threadCount,"build_parallel_ploc");
+      } else {
+        build_sequential_ploc(threadIndex,threadCount);
+      }
+
+      if (g_verbose >= 2) {
+        double perf = numPrimitives/dt*1E-6;
+        std::cout << "[DONE] " << 1000.0f*dt << "ms (" << perf << " Mtris/s)" << std::endl;
+        std::cout << BVH4Statistics(bvh).str();
+      }
+    }
+
+    void BVH4BuilderPLOC::createLeafClusters(const size_t threadID, const size_t numThreads) {
+      clusterBuilder.setLeaves(this,threadID,numThreads);
+    }
+
+    void BVH4BuilderPLOC::mergeClusters(const size_t threadID, const size_t numThreads) {
+      clusterBuilder.build(threadID,numThreads);
+    }
+
+    void BVH4BuilderPLOC::collapseSubClusterTrees(const size_t threadID, const size_t numThreads)
+    {
+      __aligned(64) Allocator nodeAlloc(nodeAllocator);
+      __aligned(64) Allocator leafAlloc(primAllocator);
+      while (true)
+      {
+        const unsigned int taskID = scheduler.taskCounter.inc();
+        if (taskID >= numClusterBuildRecords) break;
+        collapse(clusterBuildRecords[taskID],nodeAlloc,leafAlloc,RECURSE,threadID);
+        BVH4::sortForOcclusion(*clusterBuildRecords[taskID].parent);
+      }
+    }
+
+    void BVH4BuilderPLOC::collapse(ClusterBuildRecord& current, Allocator& nodeAlloc, Allocator& leafAlloc, const size_t mode, const size_t threadID)
+    {
+      const PLOCClusterBuilder::Cluster* __restrict__ const clusters = clusterBuilder.clusters;
+
+      /* stop toplevel recursion at some number of items */
+      if (mode == CREATE_TOP_LEVEL && (current.size() <= topLevelItemThreshold || numClusterBuildRecords >= MAX_TOP_LEVEL_BINS))
+      {
+        assert(numClusterBuildRecords < NUM_TOP_LEVEL_BINS);
+        clusterBuildRecords[numClusterBuildRecords++] = current;
+        return;
+      }
+
+      /* create leaf node, the morton builder splits leaves that are too large because of the depth limit */
+      if (current.size() <= MORTON_LEAF_THRESHOLD || current.depth >= BVH4::maxBuildDepth) {
+        if (use64BitCodes) clusterBuilder.gatherPrimitives(current.cluster,morton64,current.begin);
+        else               clusterBuilder.gatherPrimitives(current.cluster,morton  ,current.begin);
+        createLeaf(current,nodeAlloc,leafAlloc,threadID);
+        return;
+      }
+
+      /* fill all 4 children by always opening the cluster with the largest surface area */
+      __aligned(64) ClusterBuildRecord children[BVH4::N];
+      const size_t numChildren = clusterBuilder.open(current,children,BVH4::N,MORTON_LEAF_THRESHOLD);
+
+      /* allocate node */
+      Node* node = (Node*) nodeAlloc.malloc(sizeof(Node)); node->clear();
+      *current.parent = bvh->encodeNode(node);
+
+      /* the bounds of the clusters are exact, thus no refit is required */
+      for (size_t i=0; i<numChildren; i++)
+      {
+        node->set(i,clusters[children[i].cluster].bounds);
+        children[i].parent = &node->child(i);
+        collapse(children[i],nodeAlloc,leafAlloc,mode,threadID);
+      }
+    }
+
+    void BVH4BuilderPLOC::collapse(Allocator& nodeAlloc, Allocator& leafAlloc, const size_t mode, const size_t threadID)
+    {
+      if (numPrimitives == 0) {
+        bvh->root = BVH4::emptyNode;
+        return;
+      }
+
+      ClusterBuildRecord br;
+      br.init(0,numPrimitives,clusterBuilder.root());
+      br.parent = &bvh->root;
+      br.depth = 1;
+      collapse(br,nodeAlloc,leafAlloc,mode,threadID);
+    }
+
+    void BVH4BuilderPLOC::build_sequential_ploc(size_t threadIndex, size_t threadCount)
+    {
+      /* start measurement */
+      double t0 = 0.0f;
+      if (g_verbose >= 2) t0 = getSeconds();
+
+      /* compute sorted morton codes */
+      sortMortonCodesSequential();
+
+      /* cluster the primitives */
+      createLeafClusters(0,1);
+      clusterBuilder.build(0,1);
+
+      /* collapse the cluster tree */
+      nodeAllocator.reset();
+      primAllocator.reset();
+      __aligned(64) Allocator nodeAlloc(nodeAllocator);
+      __aligned(64) Allocator leafAlloc(primAllocator);
+      collapse(nodeAlloc,leafAlloc,RECURSE,threadIndex);
+
+      /* order the children for shadow rays */
+      BVH4::sortForOcclusion(bvh->root);
+
+      /* stop measurement */
+      if (g_verbose >= 2) dt = getSeconds()-t0;
+    }
+
+    void BVH4BuilderPLOC::build_parallel_ploc(size_t threadIndex, size_t threadCount, size_t, size_t, TaskScheduler::Event* event)
+    {
+      /* wait for all threads to enter */
+      g_state->barrier.wait(threadIndex,threadCount);
+
+      /* start measurement */
+      double t0 = 0.0f;
+      if (g_verbose >= 2) t0 = getSeconds();
+
+      /* initialize thread state */
+      initThreadState(threadIndex,threadCount);
+
+      /* let all thread except for control thread wait for work */
+      if (threadIndex != 0) {
+        scheduler.dispatchTaskMainLoop(threadIndex,threadCount);
+        return;
+      }
+
+      /* compute sorted morton codes */
+      sortMortonCodesParallel(threadIndex,threadCount);
+
+      /* cluster the primitives, the last iterations with few clusters left run single threaded */
+      scheduler.dispatchTask( task_createLeafClusters, this, threadIndex, threadCount );
+      scheduler.dispatchTask( task_mergeClusters, this, threadIndex, threadCount );
+      clusterBuilder.build(0,1);
+
+      /* collapse the toplevel part of the cluster tree */
+      numClusterBuildRecords = 0;
+      topLevelItemThreshold = (numPrimitives + threadCount-1)/(2*threadCount);
+      nodeAllocator.reset();
+      primAllocator.reset();
+      __aligned(64) Allocator nodeAlloc(nodeAllocator);
+      __aligned(64) Allocator leafAlloc(primAllocator);
+      collapse(nodeAlloc,leafAlloc,CREATE_TOP_LEVEL,threadIndex);
+
+      /* sort all subtasks by size */
+      insertionsort_decending<ClusterBuildRecord>(clusterBuildRecords,numClusterBuildRecords);
+
+      /* collapse sub-trees in parallel */
+      scheduler.dispatchTask( task_collapseSubClusterTrees, this, threadIndex, threadCount );
+
+      /* order the children of the toplevel part of the tree for shadow rays, the sub-trees got already ordered */
+      for (size_t i=0; i<numClusterBuildRecords; i++)
+        clusterBuildRecords[i].parent->setBarrier();
+      BVH4::sortForOcclusion(bvh->root);
+      bvh->clearBarrier(bvh->root);
+
+      /* end task */
+      scheduler.releaseThreads(threadCount);
+
+      /* stop measurement */
+      if (g_verbose >= 2) dt = getSeconds()-t0;
+    }
+
+    Builder* BVH4BuilderPLOCFast (void* bvh, BuildSource* source, Scene* scene, const size_t minLeafSize, const size_t maxLeafSize) {
+      return new BVH4BuilderPLOC((BVH4*)bvh,source,scene,NULL,minLeafSize,maxLeafSize);
+    }
+  }
+}
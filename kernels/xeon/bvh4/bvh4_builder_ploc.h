@@ -0,0 +1,79 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4_builder_morton.h"
+#include "../builders/ploc.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! Agglomerative builder that clusters the morton sorted
+     *  primitives bottom-up and collapses the binary cluster tree into
+     *  a BVH4 by opening the child with the largest surface area,
+     *  like the top-down builders do. The collapse reorders the
+     *  primitives such that each cluster covers a continuous range
+     *  of the morton array, thus leaves get created by the morton
+     *  builder. */
+    class BVH4BuilderPLOC : public BVH4BuilderMorton
+    {
+      ALIGNED_CLASS;
+
+    public:
+
+      /*! build record of the collapse, the primitives of the cluster get stored in [begin,end) */
+      typedef PLOCClusterBuilder::CollapseBuildRecord<SmallBuildRecord> ClusterBuildRecord;
+
+    public:
+
+      /*! Constructor. */
+      BVH4BuilderPLOC (BVH4* bvh, BuildSource* source, Scene* scene, TriangleMesh* mesh, const size_t minLeafSize = 1, const size_t maxLeafSize = inf);
+
+      /* build function */
+      void build(size_t threadIndex, size_t threadCount);
+
+      /*! single threaded build */
+      void build_sequential_ploc(size_t threadIndex, size_t threadCount);
+
+      /*! main build task */
+      TASK_RUN_FUNCTION(BVH4BuilderPLOC,build_parallel_ploc);
+
+      /*! task that creates a cluster for each primitive */
+      TASK_FUNCTION(BVH4BuilderPLOC,createLeafClusters);
+
+      /*! task that merges the clusters */
+      TASK_FUNCTION(BVH4BuilderPLOC,mergeClusters);
+
+      /*! task that collapses a list of cluster sub-trees */
+      TASK_FUNCTION(BVH4BuilderPLOC,collapseSubClusterTrees);
+
+    public:
+
+      /*! collapses the cluster tree into BVH4 nodes */
+      void collapse(ClusterBuildRecord& current, Allocator& nodeAlloc, Allocator& leafAlloc, const size_t mode, const size_t threadID);
+
+      /*! collapses the full cluster tree */
+      void collapse(Allocator& nodeAlloc, Allocator& leafAlloc, const size_t mode, const size_t threadID);
+
+    protected:
+      PLOCClusterBuilder clusterBuilder;
+      size_t numClusterBuildRecords;
+      __aligned(64) ClusterBuildRecord clusterBuildRecords[NUM_TOP_LEVEL_BINS];
+    };
+  }
+}
@@ -0,0 +1,132 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_builder_quantized.h"
+
+namespace embree
+{
+  BVH4BuilderQuantized::BVH4BuilderQuantized (BVH4* bvh, BuildSource* source, Builder* builder)
+    : bvh(bvh), source(source), builder(builder), numNodes(0)
+  {
+    needAllThreads = builder->needAllThreads;
+  }
+
+  BVH4BuilderQuantized::~BVH4BuilderQuantized () {
+    delete builder; builder = NULL;
+  }
+
+  void BVH4BuilderQuantized::build(size_t threadIndex, size_t threadCount) 
+  {
+    /* the nodes of the wrapped builder only live until they got converted */
+    const size_t numPrimitives = source->size();
+#if defined(__X86_64__)
+    const size_t numReservedNodes = 2*numPrimitives;
+#else
+    const size_t numReservedNodes = numPrimitives;
+#endif
+    bvh->allocTempNodes = new LinearAllocatorPerThread;
+    bvh->allocTempNodes->init(numReservedNodes*sizeof(Node));
+    builder->build(threadIndex,threadCount);
+
+    double t0 = 0.0;
+    if (g_verbose >= 2) {
+      std::cout << "quantizing BVH4<" << bvh->primTy.name << "> ... " << std::flush;
+      t0 = getSeconds();
+    }
+
+    /* convert the top levels sequentially until there are enough
+     * subtrees to keep all threads busy, then convert the subtrees in
+     * parallel */
+    size_t maxDepth = 0;
+    if (needAllThreads) 
+      while ((size_t(1) << (2*maxDepth)) < 4*threadCount) maxDepth++;
+
+    numNodes = 0;
+    roots.clear();
+    convert_top(bvh->root,0,maxDepth);
+
+    const size_t numRoots = roots.size();
+    if (!needAllThreads || numRoots <= 1) {
+      for (size_t i=0; i<numRoots; i++) 
+        task_convert_parallel(threadIndex,threadCount,i,numRoots,NULL);
+    }
+    else
+      TaskScheduler::executeTask(threadIndex,threadCount,_task_convert_parallel,this,numRoots,"BVH4BuilderQuantized::convert");
+
+    roots.clear();
+    bvh->quantized = true;
+    bvh->allocTempNodes = NULL;
+
+    if (g_verbose >= 2) {
+      const double t1 = getSeconds();
+      std::cout << "[DONE]" << std::endl;
+      std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, " << numNodes << " nodes, " 
+                << 1E-6*double(size_t(numNodes)*sizeof(QuantizedNode)) << " MB instead of " 
+                << 1E-6*double(size_t(numNodes)*sizeof(Node)) << " MB" << std::endl;
+    }
+  }
+
+  void BVH4BuilderQuantized::convert_top(NodeRef& ref, size_t depth, size_t maxDepth)
+  {
+    if (ref.isLeaf()) 
+      return;
+
+    if (depth == maxDepth) {
+      roots.push_back(&ref);
+      return;
+    }
+
+    const Node* node = ref.node();
+    QuantizedNode* qnode = bvh->allocQuantizedNode(0);
+    qnode->init(*node);
+    numNodes++;
+    for (size_t i=0; i<4; i++) {
+      qnode->child(i) = node->child(i);
+      convert_top(qnode->child(i),depth+1,maxDepth);
+    }
+    ref = NodeRef((size_t)qnode);
+  }
+
+  BVH4BuilderQuantized::NodeRef BVH4BuilderQuantized::convert(size_t threadIndex, NodeRef ref, size_t& nodes)
+  {
+    if (ref.isLeaf()) 
+      return ref;
+
+    /* nodes of each subtree are stored in depth first order */
+    const Node* node = ref.node();
+    QuantizedNode* qnode = bvh->allocQuantizedNode(threadIndex);
+    qnode->init(*node);
+    nodes++;
+    for (size_t i=0; i<4; i++)
+      qnode->child(i) = convert(threadIndex,node->child(i),nodes);
+    return NodeRef((size_t)qnode);
+  }
+
+  void BVH4BuilderQuantized::task_convert_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) 
+  {
+    size_t nodes = 0;
+    NodeRef& ref = *roots[taskIndex];
+    ref = convert(threadIndex,ref,nodes);
+    numNodes += nodes;
+  }
+
+  Builder* BVH4BuilderObjectSplit4 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+
+  Builder* BVH4BuilderObjectSplit4Quantized (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    Builder* builder = BVH4BuilderObjectSplit4(accel,source,geometry,minLeafSize,maxLeafSize);
+    return new BVH4BuilderQuantized((BVH4*)accel,source,builder);
+  }
+}
@@ -0,0 +1,68 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4.h"
+#include "common/builder.h"
+#include "sys/taskscheduler.h"
+
+namespace embree
+{
+  /*! Builder stage that runs a BVH4 builder and converts the nodes of
+   *  the resulting BVH into quantized nodes. The nodes of the wrapped
+   *  builder are allocated from a temporary allocator that gets
+   *  released after the conversion, the leaves are kept. */
+  class BVH4BuilderQuantized : public Builder
+  {
+    ALIGNED_CLASS;
+  public:
+
+    /*! Type shortcuts */
+    typedef BVH4::Node          Node;
+    typedef BVH4::QuantizedNode QuantizedNode;
+    typedef BVH4::NodeRef       NodeRef;
+
+  public:
+
+    /*! Constructor, takes ownership of the wrapped builder. */
+    BVH4BuilderQuantized (BVH4* bvh, BuildSource* source, Builder* builder);
+
+    /*! Destructor */
+    ~BVH4BuilderQuantized ();
+
+    /*! builder entry point */
+    void build(size_t threadIndex, size_t threadCount);
+
+  private:
+
+    /*! converts the top levels of the BVH and collects the subtrees to convert in parallel */
+    void convert_top(NodeRef& ref, size_t depth, size_t maxDepth);
+
+    /*! converts a subtree, returns the reference to the converted subtree */
+    NodeRef convert(size_t threadIndex, NodeRef ref, size_t& nodes);
+
+    /*! task that converts one of the collected subtrees */
+    TASK_RUN_FUNCTION(BVH4BuilderQuantized,task_convert_parallel);
+
+  private:
+    BVH4* bvh;                   //!< output
+    BuildSource* source;         //!< build source
+    Builder* builder;            //!< builder producing the nodes that get converted
+    std::vector<NodeRef*> roots; //!< references to the subtrees that get converted in parallel
+    AtomicCounter numNodes;      //!< number of converted nodes
+  };
+}
@@ -0,0 +1,469 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_builder_spatial.h"
+#include "common/buildsource.h"
+
+#define QBVH_BUILDER_LEAF_ITEM_THRESHOLD 4
+#define BUILD_RECORD_SPLIT_THRESHOLD 512
+
+/*! additional primitive references reserved per primitive for spatial splits */
+#define SPATIAL_SPLIT_DUPLICATIONS 0.3f
+
+/*! spatial splits are only tried if the children of the object split
+ *  overlap by more than this fraction of the scene surface area */
+#define SPATIAL_SPLIT_OVERLAP_THRESHOLD 1E-5f
+
+namespace embree
+{
+  namespace isa
+  {
+    std::auto_ptr<BVH4BuilderSpatialFast::SpatialState> BVH4BuilderSpatialFast::g_spatial_state(NULL);
+
+    BVH4BuilderSpatialFast::BVH4BuilderSpatialFast (BVH4* bvh, BuildSource* source, Scene* scene, const size_t minLeafSize, const size_t maxLeafSize)
+      : BVH4BuilderFast(bvh,source,scene,NULL,minLeafSize,maxLeafSize), splitInfo(NULL), src(NULL), leftBegin(0), rightBegin(0)
+    {
+      duplications = SPATIAL_SPLIT_DUPLICATIONS;
+    }
+
+    void BVH4BuilderSpatialFast::build(size_t threadIndex, size_t threadCount)
+    {
+      if (needAllThreads && !g_spatial_state.get())
+        g_spatial_state.reset(new SpatialState);
+
+      BVH4BuilderFast::build(threadIndex,threadCount);
+    }
+
+    // =======================================================================================================
+    // =======================================================================================================
+    // =======================================================================================================
+
+    void BVH4BuilderSpatialFast::SpatialBinner::reset()
+    {
+      for (size_t i=0; i<BINS; i++)
+      {
+        bounds[i][0] = empty;
+        bounds[i][1] = empty;
+        bounds[i][2] = empty;
+        numEnter[i] = 0;
+        numExit[i] = 0;
+      }
+    }
+
+    void BVH4BuilderSpatialFast::SpatialBinner::bin(const BVH4BuilderSpatialFast* This, const PrimRef* prims, const size_t begin, const size_t end, const SpatialMapping& mapping)
+    {
+      reset();
+      for (size_t i=begin; i<end; i++)
+      {
+        const PrimRef& prim = prims[i];
+        const ssei bin0 = mapping.bin(prim.lower);
+        const ssei bin1 = mapping.bin(prim.upper);
+
+        for (int dim=0; dim<3; dim++)
+        {
+          const int b0 = bin0[dim], b1 = bin1[dim];
+          numEnter[b0][dim]++;
+          numExit [b1][dim]++;
+
+          if (likely(b0 == b1)) {
+            bounds[b0][dim].extend(prim.bounds());
+            continue;
+          }
+
+          /* chop the reference at all planes between its first and last bin */
+          PrimRef rest = prim;
+          for (int b=b0; b<b1; b++)
+          {
+            PrimRef left, right;
+            const float pos = clamp(mapping.pos(b+1,dim),rest.lower[dim],rest.upper[dim]);
+            This->splitPrimRef(rest,dim,pos,left,right);
+            bounds[b][dim].extend(left.bounds());
+            rest = right;
+          }
+          bounds[b1][dim].extend(rest.bounds());
+        }
+      }
+    }
+
+    void BVH4BuilderSpatialFast::SpatialBinner::reduce(const SpatialBinner binners[], size_t num, SpatialBinner& binner_o)
+    {
+      binner_o = binners[0];
+      for (size_t tid=1; tid<num; tid++)
+      {
+        const SpatialBinner& binner = binners[tid];
+        for (size_t bin=0; bin<BINS; bin++)
+        {
+          binner_o.bounds[bin][0].extend(binner.bounds[bin][0]);
+          binner_o.bounds[bin][1].extend(binner.bounds[bin][1]);
+          binner_o.bounds[bin][2].extend(binner.bounds[bin][2]);
+          binner_o.numEnter[bin] += binner.numEnter[bin];
+          binner_o.numExit [bin] += binner.numExit [bin];
+        }
+      }
+    }
+
+    void BVH4BuilderSpatialFast::SpatialBinner::best(SpatialSplit& split, const SpatialMapping& mapping) const
+    {
+      for (int dim=0; dim<3; dim++)
+      {
+        /* ignore zero sized dimensions */
+        if (unlikely(mapping.scale[dim] == 0.0f))
+          continue;
+
+        /* sweep from right to left and compute parallel prefix of merged bounds */
+        float rAreas[BINS];
+        size_t rCounts[BINS];
+        size_t count = 0; BBox3fa bounds = empty;
+        for (size_t i=BINS-1; i>0; i--)
+        {
+          count += numExit[i][dim];
+          rCounts[i] = count;
+          bounds.extend(this->bounds[i][dim]);
+          rAreas[i] = area(bounds);
+        }
+
+        /* sweep from left to right and compute SAH, duplicated references count on both sides */
+        count = 0; bounds = empty;
+        for (size_t i=1; i<BINS; i++)
+        {
+          count += numEnter[i-1][dim];
+          bounds.extend(this->bounds[i-1][dim]);
+          if (count == 0 || rCounts[i] == 0) continue;
+          const float sah = area(bounds)*float((count+3)/4) + rAreas[i]*float((rCounts[i]+3)/4);
+          if (sah < split.cost) {
+            split.dim = dim;
+            split.pos = i;
+            split.cost = sah;
+          }
+        }
+      }
+    }
+
+    // =======================================================================================================
+    // =======================================================================================================
+    // =======================================================================================================
+
+    bool BVH4BuilderSpatialFast::trySpatialSplit(const BuildRecord& current, const Binner<16>& binner, const Split& split) const
+    {
+      /* no free space left to store duplicated references */
+      if (current.ext_end <= current.end)
+        return false;
+
+      /* spatial splits may separate references with equal centroids */
+      if (split.pos == -1)
+        return true;
+
+      /* only chop references if the children of the object split overlap */
+      BBox3fa left = empty, right = empty;
+      for (int i=0; i<split.pos; i++) left.extend(binner.bounds[i][split.dim]);
+      for (int i=split.pos; i<BINS; i++) right.extend(binner.bounds[i][split.dim]);
+      const BBox3fa overlap = intersect(left,right);
+      if (overlap.empty()) return false;
+      return area(overlap) > SPATIAL_SPLIT_OVERLAP_THRESHOLD*area(bvh->bounds);
+    }
+
+    void BVH4BuilderSpatialFast::splitPrimRef(const PrimRef& prim, const int dim, const float pos, PrimRef& left_o, PrimRef& right_o) const
+    {
+      const TriangleMesh* mesh = scene->getTriangleMesh(prim.geomID());
+      const TriangleMesh::Triangle& tri = mesh->triangle(prim.primID());
+      splitTriangle(prim,dim,pos,mesh->vertex(tri.v[0]),mesh->vertex(tri.v[1]),mesh->vertex(tri.v[2]),left_o,right_o);
+
+      /* the clipped triangle parts lie on the respective side of the plane */
+      left_o .upper[dim] = min(left_o .upper[dim],pos);
+      right_o.lower[dim] = max(right_o.lower[dim],pos);
+    }
+
+    void BVH4BuilderSpatialFast::distributeFreeSpace(const BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild)
+    {
+      /* the free space is distributed proportional to the number of references */
+      const size_t numLeft = leftChild.items();
+      const size_t numRight = rightChild.items();
+      const size_t numFree = current.ext_end - rightChild.end;
+      const size_t extraLeft = size_t(double(numFree)*double(numLeft)/double(numLeft+numRight));
+      leftChild.ext_end = leftChild.end + extraLeft;
+      rightChild.ext_end = current.ext_end;
+      if (extraLeft == 0) return;
+
+      /* move the first references of the right child behind its last reference */
+      const size_t begin = rightChild.begin;
+      const size_t num = min(extraLeft,numRight);
+      const size_t dst = begin + max(extraLeft,numRight);
+      for (size_t i=0; i<num; i++)
+        prims[dst+i] = prims[begin+i];
+
+      rightChild.begin += extraLeft;
+      rightChild.end   += extraLeft;
+    }
+
+    bool BVH4BuilderSpatialFast::partitionSequential(const BuildRecord& current, const SplitInfo& info, BuildRecord& leftChild, BuildRecord& rightChild)
+    {
+      const size_t begin = current.begin;
+      size_t end = current.end;
+
+      /* split references that straddle the plane and append their right parts */
+      if (info.spatial)
+      {
+        size_t numLeft = 0, numRight = 0, numBoth = 0;
+        for (size_t i=begin; i<end; i++)
+        {
+          switch (info.classify(prims[i])) {
+          case SplitInfo::LEFT : numLeft++;  break;
+          case SplitInfo::RIGHT: numRight++; break;
+          default              : numBoth++;  break;
+          }
+        }
+        if (numLeft+numBoth == 0 || numRight+numBoth == 0) return false;
+        if (end+numBoth > current.ext_end) return false;
+
+        for (size_t i=begin, j=end; i<current.end; i++)
+        {
+          if (info.classify(prims[i]) != SplitInfo::BOTH) continue;
+          const PrimRef prim = prims[i];
+          splitPrimRef(prim,info.dim,info.pos,prims[i],prims[j++]);
+        }
+        end += numBoth;
+      }
+
+      /* inplace partitioning of all references */
+      Centroid_Scene_AABB left;  left.reset();
+      Centroid_Scene_AABB right; right.reset();
+      size_t l = begin, r = end;
+      while (l < r)
+      {
+        if (info.classify(prims[l]) == SplitInfo::LEFT) {
+          left.extend(prims[l].bounds());
+          l++;
+        } else {
+          right.extend(prims[l].bounds());
+          std::swap(prims[l],prims[--r]);
+        }
+      }
+      if (l == begin || l == end) return false;
+
+      leftChild.init(left,begin,l);
+      rightChild.init(right,l,end);
+      distributeFreeSpace(current,leftChild,rightChild);
+      return true;
+    }
+
+    bool BVH4BuilderSpatialFast::splitSequentialSpatial(BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild)
+    {
+      /* mark as leaf if leaf threshold reached */
+      if (current.items() <= QBVH_BUILDER_LEAF_ITEM_THRESHOLD) {
+        current.createLeaf();
+        return false;
+      }
+
+      /* binning of centroids */
+      Mapping<16> mapping(current.bounds);
+      Binner<16> binner;
+      binner.bin(prims,current.begin,current.end,mapping);
+      Split split;
+      binner.best(split,mapping);
+
+      /* binning of chopped references */
+      SpatialSplit spatialSplit;
+      const SpatialMapping spatialMapping(current.bounds.geometry);
+      if (trySpatialSplit(current,binner,split)) {
+        SpatialBinner spatialBinner;
+        spatialBinner.bin(this,prims,current.begin,current.end,spatialMapping);
+        spatialBinner.best(spatialSplit,spatialMapping);
+      }
+
+      /* fall back to the object split if the spatial split does not fit into the free space */
+      bool valid = false;
+      if (spatialSplit.cost < split.cost)
+        valid = partitionSequential(current,SplitInfo(spatialSplit,spatialMapping),leftChild,rightChild);
+      if (!valid && split.pos != -1)
+        valid = partitionSequential(current,SplitInfo(split,mapping),leftChild,rightChild);
+
+      /* if we cannot find a valid split, enforce an arbitrary split */
+      if (!valid) {
+        split_fallback(prims,current,leftChild,rightChild);
+        distributeFreeSpace(current,leftChild,rightChild);
+      }
+
+      if (leftChild.items()  <= QBVH_BUILDER_LEAF_ITEM_THRESHOLD) leftChild.createLeaf();
+      if (rightChild.items() <= QBVH_BUILDER_LEAF_ITEM_THRESHOLD) rightChild.createLeaf();
+      return true;
+    }
+
+    // =======================================================================================================
+    // =======================================================================================================
+    // =======================================================================================================
+
+    void BVH4BuilderSpatialFast::parallelSpatialBinning(const size_t threadID, const size_t numThreads)
+    {
+      const size_t startID = rec.begin + (threadID+0)*rec.items()/numThreads;
+      const size_t endID   = rec.begin + (threadID+1)*rec.items()/numThreads;
+      g_spatial_state->binners[threadID].bin(this,prims,startID,endID,spatialMapping);
+    }
+
+    void BVH4BuilderSpatialFast::parallelCount(const size_t threadID, const size_t numThreads)
+    {
+      const size_t startID = rec.begin + (threadID+0)*rec.items()/numThreads;
+      const size_t endID   = rec.begin + (threadID+1)*rec.items()/numThreads;
+
+      size_t numLeft = 0, numRight = 0;
+      for (size_t i=startID; i<endID; i++)
+      {
+        const int side = splitInfo->classify(src[i]);
+        if (side & SplitInfo::LEFT ) numLeft++;
+        if (side & SplitInfo::RIGHT) numRight++;
+      }
+      g_spatial_state->numLeft [threadID] = numLeft;
+      g_spatial_state->numRight[threadID] = numRight;
+    }
+
+    void BVH4BuilderSpatialFast::parallelScatter(const size_t threadID, const size_t numThreads)
+    {
+      const size_t startID = rec.begin + (threadID+0)*rec.items()/numThreads;
+      const size_t endID   = rec.begin + (threadID+1)*rec.items()/numThreads;
+
+      /* the references of each thread are placed behind the ones of all previous threads */
+      size_t l = leftBegin, r = rightBegin;
+      for (size_t i=0; i<threadID; i++) {
+        l += g_spatial_state->numLeft [i];
+        r += g_spatial_state->numRight[i];
+      }
+
+      Centroid_Scene_AABB leftBounds;  leftBounds.reset();
+      Centroid_Scene_AABB rightBounds; rightBounds.reset();
+      for (size_t i=startID; i<endID; i++)
+      {
+        const int side = splitInfo->classify(src[i]);
+        if (likely(side == SplitInfo::LEFT)) {
+          leftBounds.extend(src[i].bounds());
+          prims[l++] = src[i];
+        }
+        else if (likely(side == SplitInfo::RIGHT)) {
+          rightBounds.extend(src[i].bounds());
+          prims[r++] = src[i];
+        }
+        else {
+          splitPrimRef(src[i],splitInfo->dim,splitInfo->pos,prims[l],prims[r]);
+          leftBounds .extend(prims[l++].bounds());
+          rightBounds.extend(prims[r++].bounds());
+        }
+      }
+      g_spatial_state->leftBounds [threadID] = leftBounds;
+      g_spatial_state->rightBounds[threadID] = rightBounds;
+    }
+
+    bool BVH4BuilderSpatialFast::partitionParallel(const BuildRecord& current, const SplitInfo& info, const PrimRef* tmp,
+                                                   BuildRecord& leftChild, BuildRecord& rightChild, const size_t threadID, const size_t numThreads)
+    {
+      rec = current;
+      splitInfo = &info;
+      src = tmp;
+
+      /* count references per thread */
+      g_state->scheduler.dispatchTask(task_parallelCount,this,threadID,numThreads);
+      size_t numLeft = 0, numRight = 0;
+      for (size_t i=0; i<numThreads; i++) {
+        numLeft  += g_spatial_state->numLeft [i];
+        numRight += g_spatial_state->numRight[i];
+      }
+      if (numLeft == 0 || numRight == 0) return false;
+      if (current.begin+numLeft+numRight > current.ext_end) return false;
+
+      /* the free space is distributed proportional to the number of references */
+      const size_t numFree = current.ext_end - (current.begin+numLeft+numRight);
+      const size_t extraLeft = size_t(double(numFree)*double(numLeft)/double(numLeft+numRight));
+      leftBegin = current.begin;
+      rightBegin = current.begin+numLeft+extraLeft;
+
+      /* copy references to their final location */
+      g_state->scheduler.dispatchTask(task_parallelScatter,this,threadID,numThreads);
+      Centroid_Scene_AABB left;  left.reset();
+      Centroid_Scene_AABB right; right.reset();
+      for (size_t i=0; i<numThreads; i++) {
+        left .extend(g_spatial_state->leftBounds [i]);
+        right.extend(g_spatial_state->rightBounds[i]);
+      }
+
+      leftChild.init(left,leftBegin,leftBegin+numLeft);
+      leftChild.ext_end = rightBegin;
+      rightChild.init(right,rightBegin,rightBegin+numRight);
+      rightChild.ext_end = current.ext_end;
+      return true;
+    }
+
+    bool BVH4BuilderSpatialFast::splitParallelSpatial(BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild, const size_t threadID, const size_t numThreads)
+    {
+      const unsigned int items = current.items();
+      assert(items >= BUILD_RECORD_SPLIT_THRESHOLD);
+
+      /* mark as leaf if leaf threshold reached */
+      if (items <= QBVH_BUILDER_LEAF_ITEM_THRESHOLD) {
+        current.createLeaf();
+        return false;
+      }
+
+      /* use primitive array temporarily for parallel splits */
+      PrimRef* tmp = (PrimRef*) primAllocator.base();
+
+      /* parallel binning of centroids */
+      g_state->parallelBinner.bin(current,prims,tmp,threadID,numThreads);
+      Split split;
+      g_state->parallelBinner.best(split);
+
+      /* parallel binning of chopped references */
+      SpatialSplit spatialSplit;
+      const SpatialMapping spatialMapping(current.bounds.geometry);
+      if (trySpatialSplit(current,g_state->parallelBinner.bin16,split))
+      {
+        rec = current;
+        this->spatialMapping = spatialMapping;
+        g_state->scheduler.dispatchTask(task_parallelSpatialBinning,this,threadID,numThreads);
+
+        /* reduce binning information from all threads */
+        SpatialBinner spatialBinner;
+        SpatialBinner::reduce(g_spatial_state->binners,numThreads,spatialBinner);
+        spatialBinner.best(spatialSplit,spatialMapping);
+      }
+
+      /* fall back to the object split if the spatial split does not fit into the free space */
+      bool valid = false;
+      if (spatialSplit.cost < split.cost)
+        valid = partitionParallel(current,SplitInfo(spatialSplit,spatialMapping),tmp,leftChild,rightChild,threadID,numThreads);
+      if (!valid && split.pos != -1)
+        valid = partitionParallel(current,SplitInfo(split,g_state->parallelBinner.mapping),tmp,leftChild,rightChild,threadID,numThreads);
+
+      /* if we cannot find a valid split, enforce an arbitrary split */
+      if (!valid) {
+        split_fallback(prims,current,leftChild,rightChild);
+        distributeFreeSpace(current,leftChild,rightChild);
+      }
+
+      if (leftChild.items()  <= QBVH_BUILDER_LEAF_ITEM_THRESHOLD) leftChild.createLeaf();
+      if (rightChild.items() <= QBVH_BUILDER_LEAF_ITEM_THRESHOLD) rightChild.createLeaf();
+      return true;
+    }
+
+    bool BVH4BuilderSpatialFast::split(BuildRecord& current, BuildRecord& left, BuildRecord& right, const size_t mode, const size_t threadID, const size_t numThreads)
+    {
+      if (mode == BUILD_TOP_LEVEL && current.items() >= BUILD_RECORD_SPLIT_THRESHOLD)
+        return splitParallelSpatial(current,left,right,threadID,numThreads);
+      else
+        return splitSequentialSpatial(current,left,right);
+    }
+
+    Builder* BVH4BuilderSpatialSplit4Fast (void* bvh, BuildSource* source, Scene* scene, const size_t minLeafSize, const size_t maxLeafSize) {
+      return new BVH4BuilderSpatialFast((BVH4*)bvh,source,scene,minLeafSize,maxLeafSize);
+    }
+  }
+}
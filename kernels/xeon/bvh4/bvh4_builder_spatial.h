@@ -0,0 +1,191 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4_builder_fast.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! Spatial split SAH builder running on the task structure of the
+     *  fast builder. Object and spatial bins are computed in parallel
+     *  near the top of the tree. Each build record owns some free space
+     *  behind its range that bounds the number of primitive references
+     *  its subtree may duplicate. Partitions are computed through
+     *  per-thread prefix sums, thus the output does not depend on the
+     *  timing of the threads. */
+    class BVH4BuilderSpatialFast : public BVH4BuilderFast
+    {
+      ALIGNED_CLASS;
+      static const size_t BINS = 16;
+
+    public:
+
+      /*! maps bounds to equally sized spatial bins */
+      struct SpatialMapping
+      {
+        __forceinline SpatialMapping () {}
+
+        __forceinline SpatialMapping (const BBox3fa& bounds)
+        {
+          const ssef diag = (ssef) bounds.size();
+          scale = select(diag > 0.0f,rcp(diag) * ssef(BINS * 0.99f),ssef(0.0f));
+          ofs = (ssef) bounds.lower;
+        }
+
+        /*! computes the bin numbers for each dimension for a point */
+        __forceinline ssei bin(const Vec3fa& p) const {
+          return floori(clamp((ssef(p) - ofs)*scale,ssef(0.0f),ssef(BINS-1)));
+        }
+
+        /*! returns the position of the plane left of some bin */
+        __forceinline float pos(const int bin, const int dim) const {
+          return ofs[dim] + float(bin)/scale[dim];
+        }
+
+      public:
+        ssef ofs;        //!< offset to compute bin
+        ssef scale;      //!< scaling factor to compute bin
+      };
+
+      /*! best spatial split found */
+      struct SpatialSplit
+      {
+        __forceinline SpatialSplit ()
+          : dim(-1), pos(-1), cost(pos_inf) {}
+
+      public:
+        int dim;       //!< split dimension
+        int pos;       //!< bin left of which the split plane is placed
+        float cost;    //!< SAH cost of the split
+      };
+
+      /*! bins the chopped bounds of primitive references along all dimensions */
+      struct SpatialBinner
+      {
+        /*! reset the binner */
+        void reset();
+
+        /*! bins an array of primitive references */
+        void bin(const BVH4BuilderSpatialFast* This, const PrimRef* prims, const size_t begin, const size_t end, const SpatialMapping& mapping);
+
+        /*! merge multiple binning infos into one */
+        static void reduce(const SpatialBinner binners[], size_t num, SpatialBinner& binner_o);
+
+        /*! calculate the best possible split */
+        void best(SpatialSplit& split, const SpatialMapping& mapping) const;
+
+      public:
+        BBox3fa bounds[BINS][3];   //!< bounds of the chopped references per bin
+        ssei numEnter[BINS];       //!< number of references starting in the bin
+        ssei numExit[BINS];        //!< number of references ending in the bin
+      };
+
+      /*! split plane used to partition a build record */
+      struct SplitInfo
+      {
+        enum { LEFT = 1, RIGHT = 2, BOTH = 3 };
+
+        /*! object split at some centroid bin */
+        __forceinline SplitInfo (const Split& split, const Mapping<16>& mapping)
+          : spatial(false), dim(split.dim), bin(split.pos), pos(0.0f), mapping(mapping) {}
+
+        /*! spatial split at some plane */
+        __forceinline SplitInfo (const SpatialSplit& split, const SpatialMapping& mapping)
+          : spatial(true), dim(split.dim), bin(split.pos), pos(mapping.pos(split.pos,split.dim)) {}
+
+        /*! returns to which side the primitive reference belongs */
+        __forceinline int classify(const PrimRef& prim) const
+        {
+          if (!spatial) return mapping.bin(prim.bounds())[dim] < bin ? LEFT : RIGHT;
+          if (prim.upper[dim] <= pos) return LEFT;
+          if (prim.lower[dim] >= pos) return RIGHT;
+          return BOTH;
+        }
+
+      public:
+        bool spatial;          //!< true for spatial splits
+        int dim;               //!< split dimension
+        int bin;               //!< centroid bin for object splits
+        float pos;             //!< plane position for spatial splits
+        Mapping<16> mapping;   //!< centroid mapping for object splits
+      };
+
+      /*! per-thread data of the parallel splits */
+      struct SpatialState
+      {
+        ALIGNED_CLASS;
+      public:
+        __aligned(64) SpatialBinner binners[MAX_MIC_THREADS];
+        __aligned(64) Centroid_Scene_AABB leftBounds[MAX_MIC_THREADS];
+        __aligned(64) Centroid_Scene_AABB rightBounds[MAX_MIC_THREADS];
+        size_t numLeft[MAX_MIC_THREADS];
+        size_t numRight[MAX_MIC_THREADS];
+      };
+
+      static std::auto_ptr<SpatialState> g_spatial_state;
+
+    public:
+
+      /*! Constructor. */
+      BVH4BuilderSpatialFast (BVH4* bvh, BuildSource* source, Scene* scene, const size_t minLeafSize = 1, const size_t maxLeafSize = inf);
+
+      /* build function */
+      void build(size_t threadIndex, size_t threadCount);
+
+      /*! splitting function that selects between sequential and parallel mode */
+      bool split(BuildRecord& current, BuildRecord& left, BuildRecord& right, const size_t mode, const size_t threadID, const size_t numThreads);
+
+      /*! perform sequential binning and splitting */
+      bool splitSequentialSpatial(BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild);
+
+      /*! perform parallel binning and splitting */
+      bool splitParallelSpatial(BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild, const size_t threadID, const size_t numThreads);
+
+    private:
+
+      /*! tests if the children of the object split overlap enough to try spatial splits */
+      bool trySpatialSplit(const BuildRecord& current, const Binner<16>& binner, const Split& split) const;
+
+      /*! splits a primitive reference at some plane */
+      void splitPrimRef(const PrimRef& prim, const int dim, const float pos, PrimRef& left_o, PrimRef& right_o) const;
+
+      /*! inplace partitioning of a build record, duplicated references get appended to the range */
+      bool partitionSequential(const BuildRecord& current, const SplitInfo& info, BuildRecord& leftChild, BuildRecord& rightChild);
+
+      /*! partitioning of a build record stored in the temporary array into the primitive reference array */
+      bool partitionParallel(const BuildRecord& current, const SplitInfo& info, const PrimRef* tmp, BuildRecord& leftChild, BuildRecord& rightChild, const size_t threadID, const size_t numThreads);
+
+      /*! distributes the free space of a build record to its children */
+      void distributeFreeSpace(const BuildRecord& current, BuildRecord& leftChild, BuildRecord& rightChild);
+
+    private:
+      TASK_FUNCTION(BVH4BuilderSpatialFast,parallelSpatialBinning);
+      TASK_FUNCTION(BVH4BuilderSpatialFast,parallelCount);
+      TASK_FUNCTION(BVH4BuilderSpatialFast,parallelScatter);
+
+    private:
+      BuildRecord rec;                //!< build record currently split in parallel
+      SpatialMapping spatialMapping;  //!< spatial mapping of the parallel split
+      const SplitInfo* splitInfo;     //!< split plane of the parallel partitioning
+      const PrimRef* src;             //!< source array of the parallel partitioning
+      size_t leftBegin;               //!< start of the left child of the parallel partitioning
+      size_t rightBegin;              //!< start of the right child of the parallel partitioning
+    };
+  }
+}
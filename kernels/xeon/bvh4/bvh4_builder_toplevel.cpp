@@ -66,15 +66,20 @@ namespace embree
 
       /* delete some objects */
       size_t N = scene->size();
+      counters.resize(objects.size());
+      prebuilt.resize(objects.size());
       for (size_t i=N; i<objects.size(); i++) {
         delete builders[i]; builders[i] = NULL;
         delete objects[i]; objects[i] = NULL;
+        counters[i] = prebuilt[i] = 0;
       }
       
       /* resize object array if scene got larger */
       if (objects.size() < N) {
         objects.resize(N);
         builders.resize(N);
+        counters.resize(N);
+        prebuilt.resize(N);
       }
       
       refs.resize(N);
@@ -185,6 +190,7 @@ namespace embree
       if (mesh->state == Geometry::ERASING) {
         delete builders[objectID]; builders[objectID] = NULL;
         delete objects[objectID]; objects[objectID] = NULL;
+        counters[objectID] = prebuilt[objectID] = 0;
         return;
       }
       
@@ -197,6 +203,39 @@ namespace embree
         allThreadBuilds.push_back(objectID);
     }
     
+    void BVH4BuilderTopLevel::prebuild(size_t threadIndex, size_t threadCount, size_t objectID)
+    {
+      /* only new meshes of static scenes get prebuilt, the application
+       * may still add geometries, but cannot enable, disable or delete
+       * them and waits for this task before it modifies the mesh */
+      Geometry* geom = scene->get_locked(objectID);
+      if (geom == NULL || geom->type != TRIANGLE_MESH) return;
+      TriangleMesh* mesh = (TriangleMesh*) geom;
+      if (mesh->numTimeSteps != 1 || mesh->state != Geometry::ENABLING) return;
+
+      /* create BVH and builder for the mesh */
+      Builder* builder = NULL;
+      {
+        Lock<MutexSys> lock(mutex);
+        if (objects.size() <= objectID) {
+          objects.resize(objectID+1);
+          builders.resize(objectID+1);
+          counters.resize(objectID+1);
+          prebuilt.resize(objectID+1);
+        }
+        if (objects[objectID] == NULL)
+          createTriangleMeshAccel(mesh,objects[objectID],builders[objectID]);
+        builder = builders[objectID];
+      }
+
+      /* meshes that need all threads get built together with the
+       * toplevel BVH, the state of the mesh only changes at commit */
+      if (builder->needAllThreads) return;
+      builder->build(threadIndex,threadCount);
+      Lock<MutexSys> lock(mutex);
+      prebuilt[objectID] = mesh->modCounter;
+    }
+    
     BBox3fa BVH4BuilderTopLevel::build (size_t threadIndex, size_t threadCount, size_t objectID)
     {
       /* ignore if no triangle mesh or not enabled */
@@ -209,9 +248,13 @@ namespace embree
       assert(builder);
       assert(object);
       
-      /* build object if it got modified */
-      if (mesh->isModified()) {
-        builder->build(threadIndex,threadCount);
+      /* build object if it got modified since its last build, the
+       * state alone is not sufficient as the mesh may be shared with
+       * a second set of acceleration structures of the scene */
+      if (counters[objectID] != mesh->modCounter) {
+        if (prebuilt[objectID] != mesh->modCounter)
+          builder->build(threadIndex,threadCount);
+        counters[objectID] = mesh->modCounter;
         mesh->state = Geometry::ENABLED;
       }
       
@@ -84,6 +84,9 @@ namespace embree
       
       BBox3fa build (size_t threadIndex, size_t threadCount, size_t objectID);
       void create_object(size_t objectID);
+
+      /*! builds the BVH of a single mesh ahead of the toplevel build */
+      void prebuild(size_t threadIndex, size_t threadCount, size_t objectID);
       
       void open_sequential();
       TASK_RUN_FUNCTION(BVH4BuilderTopLevel,task_open_parallel);
@@ -102,6 +105,8 @@ namespace embree
       BVH4* bvh;      //!< Output BVH4
       std::vector<BVH4*>& objects;
       std::vector<Builder*> builders;
+      std::vector<size_t> counters;           //!< modification counter of each mesh at its last build
+      std::vector<size_t> prebuilt;           //!< modification counter of each mesh at its last background build
       std::vector<size_t> allThreadBuilds;    
       
     public:
@@ -119,6 +124,7 @@ namespace embree
       volatile float global_max_volume;
       AlignedAtomicCounter32 nextRef;
       Barrier barrier;
+      MutexSys mutex;    //!< protects object and builder arrays during prebuilds
     };
   }
 }
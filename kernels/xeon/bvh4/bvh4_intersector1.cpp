@@ -31,8 +31,8 @@ namespace embree
 { 
   namespace isa
   {
-    template<typename PrimitiveIntersector>
-    void BVH4Intersector1<PrimitiveIntersector>::intersect(const BVH4* bvh, Ray& ray)
+    template<typename PrimitiveIntersector, typename NodeT>
+    void BVH4Intersector1<PrimitiveIntersector,NodeT>::intersect(const BVH4* bvh, Ray& ray)
     {
       /*! perform per ray precalculations required by the primitive intersector */
       const Precalculations pre(ray);
@@ -45,9 +45,9 @@ namespace embree
       stack[0].dist = neg_inf;
       
       /*! offsets to select the side that becomes the lower or upper bound */
-      const size_t nearX = ray.dir.x >= 0.0f ? 0*sizeof(ssef) : 1*sizeof(ssef);
-      const size_t nearY = ray.dir.y >= 0.0f ? 2*sizeof(ssef) : 3*sizeof(ssef);
-      const size_t nearZ = ray.dir.z >= 0.0f ? 4*sizeof(ssef) : 5*sizeof(ssef);
+      const size_t nearX = ray.dir.x >= 0.0f ? 0*NodeT::boundsStride : 1*NodeT::boundsStride;
+      const size_t nearY = ray.dir.y >= 0.0f ? 2*NodeT::boundsStride : 3*NodeT::boundsStride;
+      const size_t nearZ = ray.dir.z >= 0.0f ? 4*NodeT::boundsStride : 5*NodeT::boundsStride;
       
 #if 0 // FIXME: why is this slower
       /*! load the ray */
@@ -95,22 +95,22 @@ namespace embree
           STAT3(normal.trav_nodes,1,1,1);
           
           /*! single ray intersection with 4 boxes */
-          const Node* node = cur.node();
-          const size_t farX  = nearX ^ 16, farY  = nearY ^ 16, farZ  = nearZ ^ 16;
+          const NodeT* node = NodeT::get(cur);
+          const size_t farX  = nearX ^ NodeT::boundsStride, farY  = nearY ^ NodeT::boundsStride, farZ  = nearZ ^ NodeT::boundsStride;
 #if defined (__AVX2__)
-          const ssef tNearX = msub(load4f((const char*)node+nearX), rdir.x, org_rdir.x);
-          const ssef tNearY = msub(load4f((const char*)node+nearY), rdir.y, org_rdir.y);
-          const ssef tNearZ = msub(load4f((const char*)node+nearZ), rdir.z, org_rdir.z);
-          const ssef tFarX  = msub(load4f((const char*)node+farX ), rdir.x, org_rdir.x);
-          const ssef tFarY  = msub(load4f((const char*)node+farY ), rdir.y, org_rdir.y);
-          const ssef tFarZ  = msub(load4f((const char*)node+farZ ), rdir.z, org_rdir.z);
+          const ssef tNearX = msub(node->boundsX(nearX), rdir.x, org_rdir.x);
+          const ssef tNearY = msub(node->boundsY(nearY), rdir.y, org_rdir.y);
+          const ssef tNearZ = msub(node->boundsZ(nearZ), rdir.z, org_rdir.z);
+          const ssef tFarX  = msub(node->boundsX(farX ), rdir.x, org_rdir.x);
+          const ssef tFarY  = msub(node->boundsY(farY ), rdir.y, org_rdir.y);
+          const ssef tFarZ  = msub(node->boundsZ(farZ ), rdir.z, org_rdir.z);
 #else
-          const ssef tNearX = (norg.x + load4f((const char*)node+nearX)) * rdir.x;
-          const ssef tNearY = (norg.y + load4f((const char*)node+nearY)) * rdir.y;
-          const ssef tNearZ = (norg.z + load4f((const char*)node+nearZ)) * rdir.z;
-          const ssef tFarX  = (norg.x + load4f((const char*)node+farX )) * rdir.x;
-          const ssef tFarY  = (norg.y + load4f((const char*)node+farY )) * rdir.y;
-          const ssef tFarZ  = (norg.z + load4f((const char*)node+farZ )) * rdir.z;
+          const ssef tNearX = (norg.x + node->boundsX(nearX)) * rdir.x;
+          const ssef tNearY = (norg.y + node->boundsY(nearY)) * rdir.y;
+          const ssef tNearZ = (norg.z + node->boundsZ(nearZ)) * rdir.z;
+          const ssef tFarX  = (norg.x + node->boundsX(farX )) * rdir.x;
+          const ssef tFarY  = (norg.y + node->boundsY(farY )) * rdir.y;
+          const ssef tFarZ  = (norg.z + node->boundsZ(farZ )) * rdir.z;
 #endif
 
 #if defined(__SSE4_1__)
@@ -185,8 +185,8 @@ namespace embree
       AVX_ZERO_UPPER();
     }
     
-    template<typename PrimitiveIntersector>
-    void BVH4Intersector1<PrimitiveIntersector>::occluded(const BVH4* bvh, Ray& ray)
+    template<typename PrimitiveIntersector, typename NodeT>
+    void BVH4Intersector1<PrimitiveIntersector,NodeT>::occluded(const BVH4* bvh, Ray& ray)
     {
       /*! perform per ray precalculations required by the primitive intersector */
       const Precalculations pre(ray);
@@ -196,11 +196,12 @@ namespace embree
       NodeRef* stackPtr = stack+1;        //!< current stack pointer
       NodeRef* stackEnd = stack+stackSize;
       stack[0] = bvh->root;
+      STAT(size_t numNodes = 0);
       
       /*! offsets to select the side that becomes the lower or upper bound */
-      const size_t nearX = ray.dir.x >= 0 ? 0*sizeof(ssef) : 1*sizeof(ssef);
-      const size_t nearY = ray.dir.y >= 0 ? 2*sizeof(ssef) : 3*sizeof(ssef);
-      const size_t nearZ = ray.dir.z >= 0 ? 4*sizeof(ssef) : 5*sizeof(ssef);
+      const size_t nearX = ray.dir.x >= 0 ? 0*NodeT::boundsStride : 1*NodeT::boundsStride;
+      const size_t nearY = ray.dir.y >= 0 ? 2*NodeT::boundsStride : 3*NodeT::boundsStride;
+      const size_t nearZ = ray.dir.z >= 0 ? 4*NodeT::boundsStride : 5*NodeT::boundsStride;
       
 #if 0 // FIXME: why is this slower
       /*! load the ray */
@@ -242,24 +243,25 @@ namespace embree
           /*! stop if we found a leaf */
           if (unlikely(cur.isLeaf())) break;
           STAT3(shadow.trav_nodes,1,1,1);
+          STAT(numNodes++);
           
           /*! single ray intersection with 4 boxes */
-          const Node* node = cur.node();
-          const size_t farX  = nearX ^ 16, farY  = nearY ^ 16, farZ  = nearZ ^ 16;
+          const NodeT* node = NodeT::get(cur);
+          const size_t farX  = nearX ^ NodeT::boundsStride, farY  = nearY ^ NodeT::boundsStride, farZ  = nearZ ^ NodeT::boundsStride;
 #if defined (__AVX2__)
-          const ssef tNearX = msub(load4f((const char*)node+nearX), rdir.x, org_rdir.x);
-          const ssef tNearY = msub(load4f((const char*)node+nearY), rdir.y, org_rdir.y);
-          const ssef tNearZ = msub(load4f((const char*)node+nearZ), rdir.z, org_rdir.z);
-          const ssef tFarX  = msub(load4f((const char*)node+farX ), rdir.x, org_rdir.x);
-          const ssef tFarY  = msub(load4f((const char*)node+farY ), rdir.y, org_rdir.y);
-          const ssef tFarZ  = msub(load4f((const char*)node+farZ ), rdir.z, org_rdir.z);
+          const ssef tNearX = msub(node->boundsX(nearX), rdir.x, org_rdir.x);
+          const ssef tNearY = msub(node->boundsY(nearY), rdir.y, org_rdir.y);
+          const ssef tNearZ = msub(node->boundsZ(nearZ), rdir.z, org_rdir.z);
+          const ssef tFarX  = msub(node->boundsX(farX ), rdir.x, org_rdir.x);
+          const ssef tFarY  = msub(node->boundsY(farY ), rdir.y, org_rdir.y);
+          const ssef tFarZ  = msub(node->boundsZ(farZ ), rdir.z, org_rdir.z);
 #else
-          const ssef tNearX = (norg.x + load4f((const char*)node+nearX)) * rdir.x;
-          const ssef tNearY = (norg.y + load4f((const char*)node+nearY)) * rdir.y;
-          const ssef tNearZ = (norg.z + load4f((const char*)node+nearZ)) * rdir.z;
-          const ssef tFarX  = (norg.x + load4f((const char*)node+farX )) * rdir.x;
-          const ssef tFarY  = (norg.y + load4f((const char*)node+farY )) * rdir.y;
-          const ssef tFarZ  = (norg.z + load4f((const char*)node+farZ )) * rdir.z;
+          const ssef tNearX = (norg.x + node->boundsX(nearX)) * rdir.x;
+          const ssef tNearY = (norg.y + node->boundsY(nearY)) * rdir.y;
+          const ssef tNearZ = (norg.z + node->boundsZ(nearZ)) * rdir.z;
+          const ssef tFarX  = (norg.x + node->boundsX(farX )) * rdir.x;
+          const ssef tFarY  = (norg.y + node->boundsY(farY )) * rdir.y;
+          const ssef tFarZ  = (norg.z + node->boundsZ(farZ )) * rdir.z;
 #endif
           
 #if defined(__SSE4_1__)
@@ -278,51 +280,32 @@ namespace embree
           if (unlikely(mask == 0))
             goto pop;
           
-          /*! one child is hit, continue with that child */
+          /*! continue with the first hit child in the order the builder
+           *  sorted the children for shadow rays, push the other hit
+           *  children such that they get popped in that order */
           size_t r = __bscf(mask);
-          if (likely(mask == 0)) {
-            cur = node->child(r); cur.prefetch(); 
-            assert(cur != BVH4::emptyNode);
-            continue;
-          }
-          
-          /*! two children are hit, push far child, and continue with closer child */
-          NodeRef c0 = node->child(r); c0.prefetch(); const unsigned int d0 = ((unsigned int*)&tNear)[r];
-          r = __bscf(mask);
-          NodeRef c1 = node->child(r); c1.prefetch(); const unsigned int d1 = ((unsigned int*)&tNear)[r];
-          assert(c0 != BVH4::emptyNode);
-          assert(c1 != BVH4::emptyNode);
-          if (likely(mask == 0)) {
-            assert(stackPtr < stackEnd);
-            if (d0 < d1) { *stackPtr = c1; stackPtr++; cur = c0; continue; }
-            else         { *stackPtr = c0; stackPtr++; cur = c1; continue; }
-          }
-          assert(stackPtr < stackEnd);
-          *stackPtr = c0; stackPtr++;
-          assert(stackPtr < stackEnd);
-          *stackPtr = c1; stackPtr++;
-          
-          /*! three children are hit */
-          r = __bscf(mask);
           cur = node->child(r); cur.prefetch();
           assert(cur != BVH4::emptyNode);
-          if (likely(mask == 0)) continue;
-          assert(stackPtr < stackEnd);
-          *stackPtr = cur; stackPtr++;
-          
-          /*! four children are hit */
-          cur = node->child(3); cur.prefetch();
-          assert(cur != BVH4::emptyNode);
+          while (unlikely(mask != 0)) {
+            assert(stackPtr < stackEnd);
+            r = __bsr(mask); mask = __btc(mask,r);
+            NodeRef c = node->child(r); c.prefetch();
+            assert(c != BVH4::emptyNode);
+            *stackPtr = c; stackPtr++;
+          }
         }
         
         /*! this is a leaf node */
         STAT3(shadow.trav_leaves,1,1,1);
         size_t num; Primitive* prim = (Primitive*) cur.leaf(num);
         if (PrimitiveIntersector::occluded(pre,ray,prim,num,bvh->geometry)) {
+          STAT3(shadow.trav_occluded,1,1,1);
           ray.geomID = 0;
           break;
         }
       }
+      STAT3(shadow.trav_occlusion,1,1,1);
+      STAT3(shadow.trav_occlusion_nodes,numNodes,numNodes,numNodes);
       AVX_ZERO_UPPER();
     }
 
@@ -335,6 +318,7 @@ namespace embree
     DEFINE_INTERSECTOR1(BVH4Triangle1vIntersector1Pluecker,BVH4Intersector1<Triangle1vIntersector1Pluecker>);
     DEFINE_INTERSECTOR1(BVH4Triangle4vIntersector1Pluecker,BVH4Intersector1<Triangle4vIntersector1Pluecker>);
     DEFINE_INTERSECTOR1(BVH4Triangle4iIntersector1Pluecker,BVH4Intersector1<Triangle4iIntersector1Pluecker>);
+    DEFINE_INTERSECTOR1(BVH4Triangle4iIntersector1QuantizedPluecker,BVH4Intersector1Quantized<Triangle4iIntersector1Pluecker>);
     DEFINE_INTERSECTOR1(BVH4VirtualIntersector1,BVH4Intersector1<VirtualAccelIntersector1>);
   }
 }
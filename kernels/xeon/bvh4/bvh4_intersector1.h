@@ -24,15 +24,15 @@ namespace embree
 {
   namespace isa
   {
-    /*! BVH4 single ray traversal implementation. */
-    template<typename PrimitiveIntersector>
+    /*! BVH4 single ray traversal implementation. The node type is
+     *  either BVH4::Node or BVH4::QuantizedNode. */
+    template<typename PrimitiveIntersector, typename NodeT = BVH4::Node>
       class BVH4Intersector1 
     {
       /* shortcuts for frequently used types */
       typedef typename PrimitiveIntersector::Precalculations Precalculations;
       typedef typename PrimitiveIntersector::Primitive Primitive;
       typedef typename BVH4::NodeRef NodeRef;
-      typedef typename BVH4::Node Node;
       typedef StackItemT<size_t> StackItem;
       static const size_t stackSize = 1+3*BVH4::maxDepth;
       
@@ -40,5 +40,9 @@ namespace embree
       static void intersect(const BVH4* This, Ray& ray);
       static void occluded (const BVH4* This, Ray& ray);
     };
+
+    /*! BVH4 single ray traversal implementation for quantized nodes. */
+    template<typename PrimitiveIntersector>
+      class BVH4Intersector1Quantized : public BVH4Intersector1<PrimitiveIntersector,BVH4::QuantizedNode> {};
   }
 }
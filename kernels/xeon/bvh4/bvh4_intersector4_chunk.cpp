@@ -20,6 +20,7 @@
 #include "geometry/triangle4_intersector4_moeller.h"
 #if defined (__AVX__)
 #include "geometry/triangle8_intersector4_moeller.h"
+#include "geometry/bezier1i_intersectorN.h"
 #endif
 #include "geometry/triangle1v_intersector4_pluecker.h"
 #include "geometry/triangle4v_intersector4_pluecker.h"
@@ -30,8 +31,8 @@ namespace embree
 {
   namespace isa
   {
-    template<typename PrimitiveIntersector4>
-    void BVH4Intersector4Chunk<PrimitiveIntersector4>::intersect(sseb* valid_i, BVH4* bvh, Ray4& ray)
+    template<typename PrimitiveIntersector4, typename NodeT>
+    void BVH4Intersector4Chunk<PrimitiveIntersector4,NodeT>::intersect(sseb* valid_i, BVH4* bvh, Ray4& ray)
     {
       /* load ray */
       const sseb valid0 = *valid_i;
@@ -77,7 +78,11 @@ namespace embree
           
           const sseb valid_node = ray_tfar > curDist;
           STAT3(normal.trav_nodes,1,popcnt(valid_node),4);
-          const Node* __restrict__ const node = curNode.node();
+          const NodeT* __restrict__ const node = NodeT::get(curNode);
+
+          /* load the bounds of the 4 children */
+          ssef lower_x, upper_x, lower_y, upper_y, lower_z, upper_z;
+          node->bounds(lower_x,upper_x,lower_y,upper_y,lower_z,upper_z);
           
           /* pop of next node */
           assert(sptr_node > stack_node);
@@ -93,19 +98,19 @@ namespace embree
             if (unlikely(child == BVH4::emptyNode)) break;
             
 #if defined(__AVX2__)
-            const ssef lclipMinX = msub(node->lower_x[i],rdir.x,org_rdir.x);
-            const ssef lclipMinY = msub(node->lower_y[i],rdir.y,org_rdir.y);
-            const ssef lclipMinZ = msub(node->lower_z[i],rdir.z,org_rdir.z);
-            const ssef lclipMaxX = msub(node->upper_x[i],rdir.x,org_rdir.x);
-            const ssef lclipMaxY = msub(node->upper_y[i],rdir.y,org_rdir.y);
-            const ssef lclipMaxZ = msub(node->upper_z[i],rdir.z,org_rdir.z);
+            const ssef lclipMinX = msub(lower_x[i],rdir.x,org_rdir.x);
+            const ssef lclipMinY = msub(lower_y[i],rdir.y,org_rdir.y);
+            const ssef lclipMinZ = msub(lower_z[i],rdir.z,org_rdir.z);
+            const ssef lclipMaxX = msub(upper_x[i],rdir.x,org_rdir.x);
+            const ssef lclipMaxY = msub(upper_y[i],rdir.y,org_rdir.y);
+            const ssef lclipMaxZ = msub(upper_z[i],rdir.z,org_rdir.z);
 #else
-            const ssef lclipMinX = (node->lower_x[i] - org.x) * rdir.x;
-            const ssef lclipMinY = (node->lower_y[i] - org.y) * rdir.y;
-            const ssef lclipMinZ = (node->lower_z[i] - org.z) * rdir.z;
-            const ssef lclipMaxX = (node->upper_x[i] - org.x) * rdir.x;
-            const ssef lclipMaxY = (node->upper_y[i] - org.y) * rdir.y;
-            const ssef lclipMaxZ = (node->upper_z[i] - org.z) * rdir.z;
+            const ssef lclipMinX = (lower_x[i] - org.x) * rdir.x;
+            const ssef lclipMinY = (lower_y[i] - org.y) * rdir.y;
+            const ssef lclipMinZ = (lower_z[i] - org.z) * rdir.z;
+            const ssef lclipMaxX = (upper_x[i] - org.x) * rdir.x;
+            const ssef lclipMaxY = (upper_y[i] - org.y) * rdir.y;
+            const ssef lclipMaxZ = (upper_z[i] - org.z) * rdir.z;
 #endif
 
 #if defined(__SSE4_1__)
@@ -163,8 +168,8 @@ namespace embree
       AVX_ZERO_UPPER();
     }
     
-    template<typename PrimitiveIntersector4>
-    void BVH4Intersector4Chunk<PrimitiveIntersector4>::occluded(sseb* valid_i, BVH4* bvh, Ray4& ray)
+    template<typename PrimitiveIntersector4, typename NodeT>
+    void BVH4Intersector4Chunk<PrimitiveIntersector4,NodeT>::occluded(sseb* valid_i, BVH4* bvh, Ray4& ray)
     {
       /* load ray */
       const sseb valid = *valid_i;
@@ -211,7 +216,11 @@ namespace embree
           
           const sseb valid_node = ray_tfar > curDist;
           STAT3(shadow.trav_nodes,1,popcnt(valid_node),4);
-          const Node* __restrict__ const node = curNode.node();
+          const NodeT* __restrict__ const node = NodeT::get(curNode);
+
+          /* load the bounds of the 4 children */
+          ssef lower_x, upper_x, lower_y, upper_y, lower_z, upper_z;
+          node->bounds(lower_x,upper_x,lower_y,upper_y,lower_z,upper_z);
           
           /* pop of next node */
           assert(sptr_node > stack_node);
@@ -221,25 +230,25 @@ namespace embree
           curDist = *sptr_near;
           
 #pragma unroll(4)
-          for (unsigned i=0; i<4; i++)
+          for (int i=3; i>=0; i--)
           {
             const NodeRef child = node->children[i];
-            if (unlikely(child == BVH4::emptyNode)) break;
+            if (child == BVH4::emptyNode) continue;
             
 #if defined(__AVX2__)
-            const ssef lclipMinX = msub(node->lower_x[i],rdir.x,org_rdir.x);
-            const ssef lclipMinY = msub(node->lower_y[i],rdir.y,org_rdir.y);
-            const ssef lclipMinZ = msub(node->lower_z[i],rdir.z,org_rdir.z);
-            const ssef lclipMaxX = msub(node->upper_x[i],rdir.x,org_rdir.x);
-            const ssef lclipMaxY = msub(node->upper_y[i],rdir.y,org_rdir.y);
-            const ssef lclipMaxZ = msub(node->upper_z[i],rdir.z,org_rdir.z);
+            const ssef lclipMinX = msub(lower_x[i],rdir.x,org_rdir.x);
+            const ssef lclipMinY = msub(lower_y[i],rdir.y,org_rdir.y);
+            const ssef lclipMinZ = msub(lower_z[i],rdir.z,org_rdir.z);
+            const ssef lclipMaxX = msub(upper_x[i],rdir.x,org_rdir.x);
+            const ssef lclipMaxY = msub(upper_y[i],rdir.y,org_rdir.y);
+            const ssef lclipMaxZ = msub(upper_z[i],rdir.z,org_rdir.z);
 #else
-            const ssef lclipMinX = (node->lower_x[i] - org.x) * rdir.x;
-            const ssef lclipMinY = (node->lower_y[i] - org.y) * rdir.y;
-            const ssef lclipMinZ = (node->lower_z[i] - org.z) * rdir.z;
-            const ssef lclipMaxX = (node->upper_x[i] - org.x) * rdir.x;
-            const ssef lclipMaxY = (node->upper_y[i] - org.y) * rdir.y;
-            const ssef lclipMaxZ = (node->upper_z[i] - org.z) * rdir.z;
+            const ssef lclipMinX = (lower_x[i] - org.x) * rdir.x;
+            const ssef lclipMinY = (lower_y[i] - org.y) * rdir.y;
+            const ssef lclipMinZ = (lower_z[i] - org.z) * rdir.z;
+            const ssef lclipMaxX = (upper_x[i] - org.x) * rdir.x;
+            const ssef lclipMaxY = (upper_y[i] - org.y) * rdir.y;
+            const ssef lclipMaxZ = (upper_z[i] - org.z) * rdir.z;
 #endif
 
 #if defined(__SSE4_1__)
@@ -252,30 +261,17 @@ namespace embree
             const sseb lhit   = max(lnearP,ray_tnear) <= min(lfarP,ray_tfar);      
 #endif
             
-            /* if we hit the child we choose to continue with that child if it 
-               is closer than the current next child, or we push it onto the stack */
+            /* the children are visited in reverse order and each hit child
+               becomes the current node, thus hit children get traversed in
+               the order the builder sorted them for shadow rays */
             if (likely(any(lhit)))
             {
               assert(sptr_node < stackEnd);
               assert(child != BVH4::emptyNode);
-              const ssef childDist = select(lhit,lnearP,inf);
-              sptr_node++;
-              sptr_near++;
-              
-              /* push cur node onto stack and continue with hit child */
-              if (any(childDist < curDist))
-              {
-                *(sptr_node-1) = curNode;
-                *(sptr_near-1) = curDist; 
-                curDist = childDist;
-                curNode = child;
-              }
-              
-              /* push hit child onto stack */
-              else {
-                *(sptr_node-1) = child;
-                *(sptr_near-1) = childDist; 
-              }
+              *sptr_node = curNode; sptr_node++;
+              *sptr_near = curDist; sptr_near++;
+              curDist = select(lhit,lnearP,inf);
+              curNode = child;
             }	      
           }
         }
@@ -302,10 +298,12 @@ namespace embree
     DEFINE_INTERSECTOR4(BVH4Triangle4Intersector4ChunkMoeller, BVH4Intersector4Chunk<Triangle4Intersector4MoellerTrumbore>);
 #if defined (__AVX__)
     DEFINE_INTERSECTOR4(BVH4Triangle8Intersector4ChunkMoeller, BVH4Intersector4Chunk<Triangle8Intersector4MoellerTrumbore>);
+    DEFINE_INTERSECTOR4(BVH4Bezier1iIntersector4Chunk, BVH4Intersector4Chunk<Bezier1iIntersectorN<Ray4> >);
 #endif
     DEFINE_INTERSECTOR4(BVH4Triangle1vIntersector4ChunkPluecker, BVH4Intersector4Chunk<Triangle1vIntersector4Pluecker>);
     DEFINE_INTERSECTOR4(BVH4Triangle4vIntersector4ChunkPluecker, BVH4Intersector4Chunk<Triangle4vIntersector4Pluecker>);
     DEFINE_INTERSECTOR4(BVH4Triangle4iIntersector4ChunkPluecker, BVH4Intersector4Chunk<Triangle4iIntersector4Pluecker>);
+    DEFINE_INTERSECTOR4(BVH4Triangle4iIntersector4QuantizedPluecker, BVH4Intersector4Quantized<Triangle4iIntersector4Pluecker>);
     DEFINE_INTERSECTOR4(BVH4VirtualIntersector4Chunk, BVH4Intersector4Chunk<VirtualAccelIntersector4>);
   }
 }
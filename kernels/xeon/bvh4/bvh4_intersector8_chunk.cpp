@@ -23,13 +23,14 @@
 #include "geometry/triangle4v_intersector8_pluecker.h"
 #include "geometry/triangle4i_intersector8.h"
 #include "geometry/virtual_accel_intersector8.h"
+#include "geometry/bezier1i_intersectorN.h"
 
 namespace embree
 {
   namespace isa
   {
-    template<typename PrimitiveIntersector8>
-    void BVH4Intersector8Chunk<PrimitiveIntersector8>::intersect(avxb* valid_i, BVH4* bvh, Ray8& ray)
+    template<typename PrimitiveIntersector8, typename NodeT>
+    void BVH4Intersector8Chunk<PrimitiveIntersector8,NodeT>::intersect(avxb* valid_i, BVH4* bvh, Ray8& ray)
     {
       /* load ray */
       const avxb valid0 = *valid_i;
@@ -75,7 +76,11 @@ namespace embree
           
           const avxb valid_node = ray_tfar > curDist;
           STAT3(normal.trav_nodes,1,popcnt(valid_node),8);
-          const Node* __restrict__ const node = curNode.node();
+          const NodeT* __restrict__ const node = NodeT::get(curNode);
+
+          /* load the bounds of the 4 children */
+          ssef lower_x, upper_x, lower_y, upper_y, lower_z, upper_z;
+          node->bounds(lower_x,upper_x,lower_y,upper_y,lower_z,upper_z);
           
           /* pop of next node */
           assert(sptr_node > stack_node);
@@ -91,22 +96,22 @@ namespace embree
             if (unlikely(child == BVH4::emptyNode)) break;
             
 #if defined(__AVX2__)
-            const avxf lclipMinX = msub(node->lower_x[i],rdir.x,org_rdir.x);
-            const avxf lclipMinY = msub(node->lower_y[i],rdir.y,org_rdir.y);
-            const avxf lclipMinZ = msub(node->lower_z[i],rdir.z,org_rdir.z);
-            const avxf lclipMaxX = msub(node->upper_x[i],rdir.x,org_rdir.x);
-            const avxf lclipMaxY = msub(node->upper_y[i],rdir.y,org_rdir.y);
-            const avxf lclipMaxZ = msub(node->upper_z[i],rdir.z,org_rdir.z);
+            const avxf lclipMinX = msub(lower_x[i],rdir.x,org_rdir.x);
+            const avxf lclipMinY = msub(lower_y[i],rdir.y,org_rdir.y);
+            const avxf lclipMinZ = msub(lower_z[i],rdir.z,org_rdir.z);
+            const avxf lclipMaxX = msub(upper_x[i],rdir.x,org_rdir.x);
+            const avxf lclipMaxY = msub(upper_y[i],rdir.y,org_rdir.y);
+            const avxf lclipMaxZ = msub(upper_z[i],rdir.z,org_rdir.z);
             const avxf lnearP = maxi(maxi(mini(lclipMinX, lclipMaxX), mini(lclipMinY, lclipMaxY)), mini(lclipMinZ, lclipMaxZ));
             const avxf lfarP  = mini(mini(maxi(lclipMinX, lclipMaxX), maxi(lclipMinY, lclipMaxY)), maxi(lclipMinZ, lclipMaxZ));
             const avxb lhit   = maxi(lnearP,ray_tnear) <= mini(lfarP,ray_tfar);      
 #else
-            const avxf lclipMinX = (node->lower_x[i] - org.x) * rdir.x;
-            const avxf lclipMinY = (node->lower_y[i] - org.y) * rdir.y;
-            const avxf lclipMinZ = (node->lower_z[i] - org.z) * rdir.z;
-            const avxf lclipMaxX = (node->upper_x[i] - org.x) * rdir.x;
-            const avxf lclipMaxY = (node->upper_y[i] - org.y) * rdir.y;
-            const avxf lclipMaxZ = (node->upper_z[i] - org.z) * rdir.z;
+            const avxf lclipMinX = (lower_x[i] - org.x) * rdir.x;
+            const avxf lclipMinY = (lower_y[i] - org.y) * rdir.y;
+            const avxf lclipMinZ = (lower_z[i] - org.z) * rdir.z;
+            const avxf lclipMaxX = (upper_x[i] - org.x) * rdir.x;
+            const avxf lclipMaxY = (upper_y[i] - org.y) * rdir.y;
+            const avxf lclipMaxZ = (upper_z[i] - org.z) * rdir.z;
             const avxf lnearP = max(max(min(lclipMinX, lclipMaxX), min(lclipMinY, lclipMaxY)), min(lclipMinZ, lclipMaxZ));
             const avxf lfarP  = min(min(max(lclipMinX, lclipMaxX), max(lclipMinY, lclipMaxY)), max(lclipMinZ, lclipMaxZ));
             const avxb lhit   = max(lnearP,ray_tnear) <= min(lfarP,ray_tfar);      
@@ -156,8 +161,8 @@ namespace embree
       AVX_ZERO_UPPER();
     }
     
-    template<typename PrimitiveIntersector8>
-    void BVH4Intersector8Chunk<PrimitiveIntersector8>::occluded(avxb* valid_i, BVH4* bvh, Ray8& ray)
+    template<typename PrimitiveIntersector8, typename NodeT>
+    void BVH4Intersector8Chunk<PrimitiveIntersector8,NodeT>::occluded(avxb* valid_i, BVH4* bvh, Ray8& ray)
     {
       /* load ray */
       const avxb valid = *valid_i;
@@ -204,7 +209,11 @@ namespace embree
           
           const avxb valid_node = ray_tfar > curDist;
           STAT3(shadow.trav_nodes,1,popcnt(valid_node),8);
-          const Node* __restrict__ const node = curNode.node();
+          const NodeT* __restrict__ const node = NodeT::get(curNode);
+
+          /* load the bounds of the 4 children */
+          ssef lower_x, upper_x, lower_y, upper_y, lower_z, upper_z;
+          node->bounds(lower_x,upper_x,lower_y,upper_y,lower_z,upper_z);
           
           /* pop of next node */
           assert(sptr_node > stack_node);
@@ -214,57 +223,44 @@ namespace embree
           curDist = *sptr_near;
           
 #pragma unroll(4)
-          for (unsigned i=0; i<4; i++)
+          for (int i=3; i>=0; i--)
           {
             const NodeRef child = node->children[i];
-            if (unlikely(child == BVH4::emptyNode)) break;
+            if (child == BVH4::emptyNode) continue;
             
 #if defined(__AVX2__)
-            const avxf lclipMinX = msub(node->lower_x[i],rdir.x,org_rdir.x);
-            const avxf lclipMinY = msub(node->lower_y[i],rdir.y,org_rdir.y);
-            const avxf lclipMinZ = msub(node->lower_z[i],rdir.z,org_rdir.z);
-            const avxf lclipMaxX = msub(node->upper_x[i],rdir.x,org_rdir.x);
-            const avxf lclipMaxY = msub(node->upper_y[i],rdir.y,org_rdir.y);
-            const avxf lclipMaxZ = msub(node->upper_z[i],rdir.z,org_rdir.z);
+            const avxf lclipMinX = msub(lower_x[i],rdir.x,org_rdir.x);
+            const avxf lclipMinY = msub(lower_y[i],rdir.y,org_rdir.y);
+            const avxf lclipMinZ = msub(lower_z[i],rdir.z,org_rdir.z);
+            const avxf lclipMaxX = msub(upper_x[i],rdir.x,org_rdir.x);
+            const avxf lclipMaxY = msub(upper_y[i],rdir.y,org_rdir.y);
+            const avxf lclipMaxZ = msub(upper_z[i],rdir.z,org_rdir.z);
             const avxf lnearP = maxi(maxi(mini(lclipMinX, lclipMaxX), mini(lclipMinY, lclipMaxY)), mini(lclipMinZ, lclipMaxZ));
             const avxf lfarP  = mini(mini(maxi(lclipMinX, lclipMaxX), maxi(lclipMinY, lclipMaxY)), maxi(lclipMinZ, lclipMaxZ));
             const avxb lhit   = maxi(lnearP,ray_tnear) <= mini(lfarP,ray_tfar);      
 #else
-            const avxf lclipMinX = (node->lower_x[i] - org.x) * rdir.x;
-            const avxf lclipMinY = (node->lower_y[i] - org.y) * rdir.y;
-            const avxf lclipMinZ = (node->lower_z[i] - org.z) * rdir.z;
-            const avxf lclipMaxX = (node->upper_x[i] - org.x) * rdir.x;
-            const avxf lclipMaxY = (node->upper_y[i] - org.y) * rdir.y;
-            const avxf lclipMaxZ = (node->upper_z[i] - org.z) * rdir.z;
+            const avxf lclipMinX = (lower_x[i] - org.x) * rdir.x;
+            const avxf lclipMinY = (lower_y[i] - org.y) * rdir.y;
+            const avxf lclipMinZ = (lower_z[i] - org.z) * rdir.z;
+            const avxf lclipMaxX = (upper_x[i] - org.x) * rdir.x;
+            const avxf lclipMaxY = (upper_y[i] - org.y) * rdir.y;
+            const avxf lclipMaxZ = (upper_z[i] - org.z) * rdir.z;
             const avxf lnearP = max(max(min(lclipMinX, lclipMaxX), min(lclipMinY, lclipMaxY)), min(lclipMinZ, lclipMaxZ));
             const avxf lfarP  = min(min(max(lclipMinX, lclipMaxX), max(lclipMinY, lclipMaxY)), max(lclipMinZ, lclipMaxZ));
             const avxb lhit   = max(lnearP,ray_tnear) <= min(lfarP,ray_tfar);      
 #endif
             
-            /* if we hit the child we choose to continue with that child if it 
-               is closer than the current next child, or we push it onto the stack */
+            /* the children are visited in reverse order and each hit child
+               becomes the current node, thus hit children get traversed in
+               the order the builder sorted them for shadow rays */
             if (likely(any(lhit)))
             {
               assert(sptr_node < stackEnd);
               assert(child != BVH4::emptyNode);
-              const avxf childDist = select(lhit,lnearP,inf);
-              sptr_node++;
-              sptr_near++;
-              
-              /* push cur node onto stack and continue with hit child */
-              if (any(childDist < curDist))
-              {
-                *(sptr_node-1) = curNode;
-                *(sptr_near-1) = curDist; 
-                curDist = childDist;
-                curNode = child;
-              }
-              
-              /* push hit child onto stack */
-              else {
-                *(sptr_node-1) = child;
-                *(sptr_near-1) = childDist; 
-              }
+              *sptr_node = curNode; sptr_node++;
+              *sptr_near = curDist; sptr_near++;
+              curDist = select(lhit,lnearP,inf);
+              curNode = child;
             }	      
           }
         }
@@ -293,6 +289,8 @@ namespace embree
     DEFINE_INTERSECTOR8(BVH4Triangle1vIntersector8ChunkPluecker, BVH4Intersector8Chunk<Triangle1vIntersector8Pluecker>);
     DEFINE_INTERSECTOR8(BVH4Triangle4vIntersector8ChunkPluecker, BVH4Intersector8Chunk<Triangle4vIntersector8Pluecker>);
     DEFINE_INTERSECTOR8(BVH4Triangle4iIntersector8ChunkPluecker, BVH4Intersector8Chunk<Triangle4iIntersector8Pluecker>);
+    DEFINE_INTERSECTOR8(BVH4Triangle4iIntersector8QuantizedPluecker, BVH4Intersector8Quantized<Triangle4iIntersector8Pluecker>);
     DEFINE_INTERSECTOR8(BVH4VirtualIntersector8Chunk, BVH4Intersector8Chunk<VirtualAccelIntersector8>);
+    DEFINE_INTERSECTOR8(BVH4Bezier1iIntersector8Chunk, BVH4Intersector8Chunk<Bezier1iIntersectorN<Ray8> >);
   }
 }
@@ -23,19 +23,23 @@ namespace embree
 {
   namespace isa
   {
-    /*! BVH4 packet traversal implementation. */
-    template<typename PrimitiveIntersector>
+    /*! BVH4 packet traversal implementation. The node type is
+     *  either BVH4::Node or BVH4::QuantizedNode. */
+    template<typename PrimitiveIntersector, typename NodeT = BVH4::Node>
       class BVH4Intersector8Chunk
     {
       /* shortcuts for frequently used types */
       typedef typename PrimitiveIntersector::Primitive Primitive;
       typedef typename BVH4::NodeRef NodeRef;
-      typedef typename BVH4::Node Node;
       static const size_t stackSize = 4*BVH4::maxDepth+1;
       
     public:
       static void intersect(avxb* valid, BVH4* bvh, Ray8& ray);
       static void occluded (avxb* valid, BVH4* bvh, Ray8& ray);
     };
+
+    /*! BVH4 packet traversal implementation for quantized nodes. */
+    template<typename PrimitiveIntersector>
+      class BVH4Intersector8Quantized : public BVH4Intersector8Chunk<PrimitiveIntersector,BVH4::QuantizedNode> {};
   }
 }
@@ -0,0 +1,225 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_intersector8_trail.h"
+
+#include "geometry/triangle4_intersector8_moeller.h"
+#include "geometry/triangle8_intersector8_moeller.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! intersects the packet with the children of a node selected by mask, returns mask of hit children */
+    static __forceinline size_t intersectNode(const BVH4::Node* node, size_t mask, const avxb& valid,
+                                              const avx3f& org, const avx3f& rdir, const avx3f& org_rdir,
+                                              const avxf& ray_tnear, const avxf& ray_tfar, avxf* dist)
+    {
+      size_t hit = 0;
+      while (mask)
+      {
+        const size_t i = __bscf(mask);
+#if defined(__AVX2__)
+        const avxf lclipMinX = msub(node->lower_x[i],rdir.x,org_rdir.x);
+        const avxf lclipMinY = msub(node->lower_y[i],rdir.y,org_rdir.y);
+        const avxf lclipMinZ = msub(node->lower_z[i],rdir.z,org_rdir.z);
+        const avxf lclipMaxX = msub(node->upper_x[i],rdir.x,org_rdir.x);
+        const avxf lclipMaxY = msub(node->upper_y[i],rdir.y,org_rdir.y);
+        const avxf lclipMaxZ = msub(node->upper_z[i],rdir.z,org_rdir.z);
+        const avxf lnearP = maxi(maxi(mini(lclipMinX, lclipMaxX), mini(lclipMinY, lclipMaxY)), mini(lclipMinZ, lclipMaxZ));
+        const avxf lfarP  = mini(mini(maxi(lclipMinX, lclipMaxX), maxi(lclipMinY, lclipMaxY)), maxi(lclipMinZ, lclipMaxZ));
+        const avxb lhit   = valid & (maxi(lnearP,ray_tnear) <= mini(lfarP,ray_tfar));
+#else
+        const avxf lclipMinX = (node->lower_x[i] - org.x) * rdir.x;
+        const avxf lclipMinY = (node->lower_y[i] - org.y) * rdir.y;
+        const avxf lclipMinZ = (node->lower_z[i] - org.z) * rdir.z;
+        const avxf lclipMaxX = (node->upper_x[i] - org.x) * rdir.x;
+        const avxf lclipMaxY = (node->upper_y[i] - org.y) * rdir.y;
+        const avxf lclipMaxZ = (node->upper_z[i] - org.z) * rdir.z;
+        const avxf lnearP = max(max(min(lclipMinX, lclipMaxX), min(lclipMinY, lclipMaxY)), min(lclipMinZ, lclipMaxZ));
+        const avxf lfarP  = min(min(max(lclipMinX, lclipMaxX), max(lclipMinY, lclipMaxY)), max(lclipMinZ, lclipMaxZ));
+        const avxb lhit   = valid & (max(lnearP,ray_tnear) <= min(lfarP,ray_tfar));
+#endif
+        if (likely(any(lhit))) {
+          hit |= size_t(1) << i;
+          dist[i] = select(lhit,lnearP,avxf(pos_inf));
+        }
+      }
+      return hit;
+    }
+
+    /*! selects the hit child that is closest to the packet */
+    static __forceinline size_t closestChild(size_t hit, const avxf* dist)
+    {
+      size_t best = __bscf(hit);
+      float bestDist = reduce_min(dist[best]);
+      while (hit) {
+        const size_t i = __bscf(hit);
+        const float d = reduce_min(dist[i]);
+        if (d < bestDist) { best = i; bestDist = d; }
+      }
+      return best;
+    }
+
+    template<typename PrimitiveIntersector8>
+    void BVH4Intersector8Trail<PrimitiveIntersector8>::intersect(avxb* valid_i, BVH4* bvh, Ray8& ray)
+    {
+      /* load ray */
+      const avxb valid0 = *valid_i;
+      const avx3f rdir = rcp_safe(ray.dir);
+      const avx3f org(ray.org), org_rdir = org * rdir;
+      avxf ray_tnear = select(valid0,ray.tnear,pos_inf);
+      avxf ray_tfar  = select(valid0,ray.tfar ,neg_inf);
+
+      /* traversal state */
+      RestartTrail trail(bvh->root);
+      NodeRef cur = bvh->root;
+      avxb cur_valid = valid0;   //!< rays that hit the current node
+      size_t level = 0;
+      avxf dist[4];
+
+      while (1)
+      {
+        /* down traversal, always continue with the closest hit child */
+        while (likely(cur.isNode()))
+        {
+          STAT3(normal.trav_nodes,1,popcnt(cur_valid),8);
+          const Node* node = cur.node();
+          const size_t hit = intersectNode(node,0xF,cur_valid,org,rdir,org_rdir,ray_tnear,ray_tfar,dist);
+          if (unlikely(hit == 0)) goto pop;
+
+          const size_t c = closestChild(hit,dist);
+          trail.set(level,cur,hit & ~(size_t(1) << c),c);
+          cur_valid = dist[c] < avxf(pos_inf);
+          cur = node->child(c); cur.prefetch();
+          level++;
+        }
+
+        /* intersect leaf */
+        {
+          const avxb valid_leaf = cur_valid & (ray_tfar >= ray_tnear);
+          STAT3(normal.trav_leaves,1,popcnt(valid_leaf),8);
+          size_t items; const Primitive* prim = (Primitive*) cur.leaf(items);
+          PrimitiveIntersector8::intersect(valid_leaf,ray,prim,items,bvh->geometry);
+          ray_tfar = select(valid_leaf,ray.tfar,ray_tfar);
+        }
+
+      pop:
+        /* reenter the path at the deepest level with pending children,
+           the pending children get tested again to cull them with the
+           current hit distances */
+        while (1)
+        {
+          const ssize_t l = trail.deepest();
+          if (unlikely(l < 0)) {
+            AVX_ZERO_UPPER();
+            return;
+          }
+          STAT(if (!trail.cached(l)) { STAT3(normal.trav_restarts,1,1,1); });
+          const NodeRef ref = trail.node(l);
+          const Node* node = ref.node();
+          const size_t hit = intersectNode(node,trail.pending(l),valid0,org,rdir,org_rdir,ray_tnear,ray_tfar,dist);
+          if (unlikely(hit == 0)) {
+            trail.clear(l);
+            continue;
+          }
+          const size_t c = closestChild(hit,dist);
+          trail.set(l,ref,hit & ~(size_t(1) << c),c);
+          cur_valid = dist[c] < avxf(pos_inf);
+          cur = node->child(c); cur.prefetch();
+          level = l+1;
+          break;
+        }
+      }
+    }
+
+    template<typename PrimitiveIntersector8>
+    void BVH4Intersector8Trail<PrimitiveIntersector8>::occluded(avxb* valid_i, BVH4* bvh, Ray8& ray)
+    {
+      /* load ray */
+      const avxb valid = *valid_i;
+      avxb terminated = !valid;
+      const avx3f rdir = rcp_safe(ray.dir);
+      const avx3f org(ray.org), org_rdir = org * rdir;
+      avxf ray_tnear = select(valid,ray.tnear,pos_inf);
+      avxf ray_tfar  = select(valid,ray.tfar ,neg_inf);
+
+      /* traversal state */
+      RestartTrail trail(bvh->root);
+      NodeRef cur = bvh->root;
+      avxb cur_valid = valid;   //!< rays that hit the current node
+      size_t level = 0;
+      avxf dist[4];
+
+      while (1)
+      {
+        /* down traversal, continue with the first hit child in the
+           order the builder sorted the children for shadow rays */
+        while (likely(cur.isNode()))
+        {
+          STAT3(shadow.trav_nodes,1,popcnt(cur_valid),8);
+          const Node* node = cur.node();
+          const size_t hit = intersectNode(node,0xF,cur_valid,org,rdir,org_rdir,ray_tnear,ray_tfar,dist);
+          if (unlikely(hit == 0)) goto pop;
+
+          const size_t c = __bsf(hit);
+          trail.set(level,cur,hit & ~(size_t(1) << c),c);
+          cur_valid = dist[c] < avxf(pos_inf);
+          cur = node->child(c); cur.prefetch();
+          level++;
+        }
+
+        /* intersect leaf */
+        {
+          const avxb valid_leaf = cur_valid & !terminated;
+          STAT3(shadow.trav_leaves,1,popcnt(valid_leaf),8);
+          size_t items; const Primitive* prim = (Primitive*) cur.leaf(items);
+          terminated |= PrimitiveIntersector8::occluded(valid_leaf,ray,prim,items,bvh->geometry);
+          if (all(terminated)) break;
+          ray_tfar = select(terminated,avxf(neg_inf),ray_tfar);
+        }
+
+      pop:
+        /* reenter the path at the deepest level with pending children */
+        while (1)
+        {
+          const ssize_t l = trail.deepest();
+          if (unlikely(l < 0)) goto done;
+          STAT(if (!trail.cached(l)) { STAT3(shadow.trav_restarts,1,1,1); });
+          const NodeRef ref = trail.node(l);
+          const Node* node = ref.node();
+          const size_t hit = intersectNode(node,trail.pending(l),!terminated,org,rdir,org_rdir,ray_tnear,ray_tfar,dist);
+          if (unlikely(hit == 0)) {
+            trail.clear(l);
+            continue;
+          }
+          const size_t c = __bsf(hit);
+          trail.set(l,ref,hit & ~(size_t(1) << c),c);
+          cur_valid = dist[c] < avxf(pos_inf);
+          cur = node->child(c); cur.prefetch();
+          level = l+1;
+          break;
+        }
+      }
+    done:
+      store8i(valid & terminated,&ray.geomID,0);
+      AVX_ZERO_UPPER();
+    }
+
+    DEFINE_INTERSECTOR8(BVH4Triangle4Intersector8TrailMoeller, BVH4Intersector8Trail<Triangle4Intersector8MoellerTrumbore>);
+    DEFINE_INTERSECTOR8(BVH4Triangle8Intersector8TrailMoeller, BVH4Intersector8Trail<Triangle8Intersector8MoellerTrumbore>);
+  }
+}
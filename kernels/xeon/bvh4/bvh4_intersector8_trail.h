@@ -0,0 +1,120 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4.h"
+#include "common/ray8.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! BVH4 packet traversal without a traversal stack. Instead of
+     *  pushing hit children, a restart trail stores for each level of
+     *  the current path the hit children that still have to get
+     *  traversed and the child that got taken. To continue with a
+     *  pending child the traversal reenters the path at its level,
+     *  taking the node from a short cache of the most recent path
+     *  nodes or following the trail from the root. The traversal state
+     *  has a few hundred bytes instead of the 20kB of node and
+     *  distance stacks of the chunk kernel. */
+    template<typename PrimitiveIntersector>
+      class BVH4Intersector8Trail
+    {
+      /* shortcuts for frequently used types */
+      typedef typename PrimitiveIntersector::Primitive Primitive;
+      typedef typename BVH4::NodeRef NodeRef;
+      typedef typename BVH4::Node Node;
+
+      /*! Restart trail of the current traversal path. */
+      class RestartTrail
+      {
+        /*! number of cached nodes of the path */
+        static const size_t pathCacheSize = 8;
+
+        /*! number of words of the bit mask of levels with pending children */
+        static const size_t levelWords = (BVH4::maxDepth+63)/64;
+
+      public:
+        __forceinline RestartTrail (NodeRef root) : root(root) {
+          for (size_t i=0; i<levelWords; i++) levels[i] = 0;
+          for (size_t i=0; i<pathCacheSize; i++) pathLevel[i] = -1;
+        }
+
+        /*! records the node of a level, the hit children that are still pending, and the taken child */
+        __forceinline void set(size_t level, NodeRef node, size_t pending, size_t taken)
+        {
+          assert(level < BVH4::maxDepth);
+          trail[level] = (unsigned char)(pending | (taken << 4));
+          pathNode [level%pathCacheSize] = node;
+          pathLevel[level%pathCacheSize] = level;
+          if (pending) levels[level/64] |=  (size_t(1) << (level%64));
+          else         levels[level/64] &= ~(size_t(1) << (level%64));
+        }
+
+        /*! marks that a level has no pending children anymore */
+        __forceinline void clear(size_t level) {
+          trail[level] &= 0xF0;
+          levels[level/64] &= ~(size_t(1) << (level%64));
+        }
+
+        /*! returns the deepest level with pending children or -1 if traversal is done */
+        __forceinline ssize_t deepest() const
+        {
+          for (ssize_t i=levelWords-1; i>=0; i--)
+            if (levels[i]) return 64*i+__bsr(levels[i]);
+          return -1;
+        }
+
+        /*! returns the pending children of a level */
+        __forceinline size_t pending(size_t level) const {
+          return trail[level] & 0xF;
+        }
+
+        /*! checks if the node of a level is cached, the most recently
+         *  entered node of a level is always on the current path */
+        __forceinline bool cached(size_t level) const {
+          return pathLevel[level%pathCacheSize] == ssize_t(level);
+        }
+
+        /*! returns the node of a level of the current path */
+        __forceinline NodeRef node(size_t level) const
+        {
+          if (likely(cached(level)))
+            return pathNode[level%pathCacheSize];
+
+          /* restart from the root */
+          NodeRef cur = root;
+          for (size_t i=0; i<level; i++)
+            cur = cur.node()->child(trail[i] >> 4);
+          return cur;
+        }
+
+      private:
+        NodeRef root;                             //!< root of the traversal
+        size_t levels[levelWords];                //!< bit mask of the levels with pending children
+        unsigned char trail[BVH4::maxDepth];      //!< pending children (bits 0-3) and taken child (bits 4-5) per level
+        NodeRef pathNode[pathCacheSize];          //!< most recent nodes of the path
+        ssize_t pathLevel[pathCacheSize];         //!< levels of the cached nodes
+      };
+
+    public:
+      static void intersect(avxb* valid, BVH4* bvh, Ray8& ray);
+      static void occluded (avxb* valid, BVH4* bvh, Ray8& ray);
+    };
+  }
+}
@@ -16,6 +16,7 @@
 
 #include "bvh4_refit.h"
 #include "bvh4_builder.h"
+#include "bvh4_rotate.h"
 #include "bvh4_statistics.h"
 #include "builders/heuristics.h"
 #include "sys/tasklogger.h"
@@ -27,6 +28,9 @@ namespace embree
   namespace isa
   {
     static const size_t block_size = 1024;
+
+    /*! the BVH gets rebuilt when refitting increased its SAH cost by this factor */
+    static const float refit_rebuild_ratio = 2.0f;
     
     __forceinline bool compare(const BVH4::NodeRef* a, const BVH4::NodeRef* b)
     {
@@ -34,9 +38,13 @@ namespace embree
       int sb = *(size_t*)b->node();
       return sa < sb;
     }
+
+    __forceinline bool compare_depth(const std::pair<BVH4::NodeRef*,size_t>& a, const std::pair<BVH4::NodeRef*,size_t>& b) {
+      return compare(a.first,b.first);
+    }
     
     BVH4Refit::BVH4Refit (BVH4* bvh, Builder* builder, TriangleMesh* mesh)
-    : builder(builder), mesh(mesh), primTy(bvh->primTy), bvh(bvh) 
+    : builder(builder), mesh(mesh), primTy(bvh->primTy), bvh(bvh), rebuild(true), measured(false), buildSAH(0.0f), refitSAH(0.0f)
     {
       needAllThreads = builder->needAllThreads;
     }
@@ -47,17 +55,18 @@ namespace embree
     
     void BVH4Refit::build(size_t threadIndex, size_t threadCount) 
     {
-      /* build initial BVH */
-      if (builder) {
+      /* build initial BVH, large BVHs get built with all threads and
+       * are split into subtrees to get refit in parallel, BVHs to
+       * optimize are split to rotate the most degraded subtrees */
+      if (rebuild) {
         builder->build(threadIndex,threadCount);
-        if (false) { //bvh->numPrimitives > 50000) {
+        roots.clear();
+        if (needAllThreads || g_refit_budget) {
           annotate_tree_sizes(bvh->root);
           calculate_refit_roots();
-          needAllThreads = false;
-        } else {
-          needAllThreads = false;
         }
-        delete builder; builder = NULL;
+        rebuild = false;
+        measured = false;
       }
       
       /* refit BVH */
@@ -69,9 +78,17 @@ namespace embree
       
       /* schedule refit tasks */
       size_t numRoots = roots.size();
+      subtreeSAH.resize(numRoots);
       if (numRoots <= 1) {
         size_t taskID = TaskLogger::beginTask(threadIndex,"BVH4Refit::sequential",0);
         refit_sequential(threadIndex,threadCount,NULL);
+        if (numRoots) subtreeSAH[0] = refitSAH;
+        TaskLogger::endTask(threadIndex,taskID);
+      }
+      else if (!needAllThreads) {
+        size_t taskID = TaskLogger::beginTask(threadIndex,"BVH4Refit::sequential",0);
+        for (size_t i=0; i<numRoots; i++) task_refit_parallel(threadIndex,threadCount,i,numRoots,NULL);
+        task_refit_complete(threadIndex,threadCount,NULL);
         TaskLogger::endTask(threadIndex,taskID);
       }
       else
@@ -83,6 +100,57 @@ namespace embree
         std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, perf = " << 1E-6*double(mesh->numTriangles)/(t1-t0) << " Mprim/s" << std::endl;
         std::cout << BVH4Statistics(bvh).str();
       }
+
+      /* the first refit after a build measures the quality of the
+       * built BVH, later refits rebuild if the quality degraded, a BVH
+       * built over degenerate geometry (zero root area) gets rebuilt
+       * as soon as the geometry has some extent */
+      const float rootArea = bvh->bounds.empty() ? 0.0f : halfArea(bvh->bounds);
+      const float sah = rootArea > 0.0f ? refitSAH/rootArea : 0.0f;
+      if (!measured) {
+        measured = true;
+        buildSAH = sah;
+        subtreeBuildSAH = subtreeSAH;
+      }
+      else if (sah > refit_rebuild_ratio*buildSAH) 
+      {
+        if (g_verbose >= 2) 
+          std::cout << "rebuilding BVH4 <" << bvh->primTy.name << ">, SAH degraded from " << buildSAH << " to " << sah << std::endl;
+        rebuild = true;
+        build(threadIndex,threadCount);
+      }
+      else if (g_refit_budget) 
+        optimize();
+    }
+
+    void BVH4Refit::optimize()
+    {
+      /* order subtrees by the increase of their SAH cost since the last build */
+      std::vector<std::pair<float,size_t> > order;
+      for (size_t i=0; i<roots.size(); i++) {
+        if (subtreeBuildSAH[i] <= 0.0f || subtreeSAH[i] <= subtreeBuildSAH[i]) continue;
+        order.push_back(std::make_pair(subtreeSAH[i]/subtreeBuildSAH[i],i));
+      }
+      std::sort(order.begin(),order.end());
+
+      /* rotate the most degraded subtrees until the time budget of the
+       * scene build is used up, the budget is shared by all refitted
+       * BVHs of the scene, rotations do not change the bounds of the
+       * subtree roots, the rotated subtrees get ordered for shadow rays
+       * again */
+      AtomicCounter& budget = mesh->parent->refitBudget;
+      const double t0 = getSeconds();
+      size_t numRotated = 0;
+      for (ssize_t j=ssize_t(order.size())-1; j>=0 && atomic_t(budget) > 0; j--, numRotated++) {
+        const size_t i = order[j].second;
+        const double t1 = getSeconds();
+        BVH4Rotate::rotate(bvh,*roots[i],rootDepths[i]);
+        BVH4::sortForOcclusion(*roots[i]);
+        budget -= atomic_t(1E6*(getSeconds()-t1))+1;
+      }
+
+      if (g_verbose >= 2) 
+        std::cout << "rotated " << numRotated << " of " << order.size() << " degraded subtrees of BVH4 <" << bvh->primTy.name << "> in " << 1000.0f*(getSeconds()-t0) << "ms" << std::endl;
     }
     
     size_t BVH4Refit::annotate_tree_sizes(BVH4::NodeRef& ref)
@@ -109,56 +177,68 @@ namespace embree
     
     void BVH4Refit::calculate_refit_roots ()
     {
+      rootDepths.clear();
       if (!bvh->root.isNode()) return;
       
-      roots.push_back(&bvh->root);
-      std::make_heap (roots.begin(), roots.end(), compare);
+      /* the depth of each subtree root limits the rotations inside the subtree */
+      std::vector<std::pair<BVH4::NodeRef*,size_t> > heap;
+      heap.push_back(std::make_pair(&bvh->root,size_t(1)));
       
       while (true)
       {
-        std::pop_heap(roots.begin(), roots.end(), compare);
-        BVH4::NodeRef* node = roots.back();
-        roots.pop_back();
-        if (*(size_t*)node->node() < block_size) 
+        std::pop_heap(heap.begin(), heap.end(), compare_depth);
+        const std::pair<BVH4::NodeRef*,size_t> node = heap.back();
+        
+        /* the largest subtree is small enough, keep it as subtree root */
+        if (*(size_t*)node.first->node() < block_size) 
           break;
         
+        heap.pop_back();
         for (size_t i=0; i<BVH4::N; i++) {
-          BVH4::NodeRef* child = &node->node()->child(i);
+          BVH4::NodeRef* child = &node.first->node()->child(i);
           if (child->isNode()) {
-            roots.push_back(child);
-            std::push_heap(roots.begin(), roots.end(), compare);
+            heap.push_back(std::make_pair(child,node.second+1));
+            std::push_heap(heap.begin(), heap.end(), compare_depth);
           }
         }
+        if (heap.empty()) break;
+      }
+
+      for (size_t i=0; i<heap.size(); i++) {
+        roots.push_back(heap[i].first);
+        rootDepths.push_back(heap[i].second);
       }
     }
     
-    __forceinline BBox3fa BVH4Refit::leaf_bounds(NodeRef& ref)
+    __forceinline BBox3fa BVH4Refit::leaf_bounds(NodeRef& ref, float& sah)
     {
       size_t num; char* tri = ref.leaf(num);
       if (unlikely(num == 0)) return empty;
-      return bvh->primTy.update(tri,num,mesh);
+      const BBox3fa bounds = bvh->primTy.update(tri,num,mesh);
+      sah += float(num)*halfArea(bounds);
+      return bounds;
     }
     
-    __forceinline BBox3fa BVH4Refit::node_bounds(NodeRef& ref)
+    __forceinline BBox3fa BVH4Refit::node_bounds(NodeRef& ref, float& sah)
     {
       if (ref.isNode())
         return ref.node()->bounds();
       else
-        return leaf_bounds(ref);
+        return leaf_bounds(ref,sah);
     }
     
-    BBox3fa BVH4Refit::recurse_bottom(NodeRef& ref)
+    BBox3fa BVH4Refit::recurse_bottom(NodeRef& ref, float& sah)
     {
       /* this is a leaf node */
       if (unlikely(ref.isLeaf()))
-        return leaf_bounds(ref);
+        return leaf_bounds(ref,sah);
       
       /* recurse if this is an internal node */
       Node* node = ref.node();
-      const BBox3fa bounds0 = recurse_bottom(node->child(0));
-      const BBox3fa bounds1 = recurse_bottom(node->child(1));
-      const BBox3fa bounds2 = recurse_bottom(node->child(2));
-      const BBox3fa bounds3 = recurse_bottom(node->child(3));
+      const BBox3fa bounds0 = recurse_bottom(node->child(0),sah);
+      const BBox3fa bounds1 = recurse_bottom(node->child(1),sah);
+      const BBox3fa bounds2 = recurse_bottom(node->child(2),sah);
+      const BBox3fa bounds3 = recurse_bottom(node->child(3),sah);
       
       /* AOS to SOA transform */
       BBox<sse3f> bounds;
@@ -180,28 +260,30 @@ namespace embree
       const float upper_x = reduce_max(bounds.upper.x);
       const float upper_y = reduce_max(bounds.upper.y);
       const float upper_z = reduce_max(bounds.upper.z);
-      return BBox3fa(Vec3fa(lower_x,lower_y,lower_z),
-                    Vec3fa(upper_x,upper_y,upper_z));
+      const BBox3fa merged(Vec3fa(lower_x,lower_y,lower_z),
+                           Vec3fa(upper_x,upper_y,upper_z));
+      sah += halfArea(merged);
+      return merged;
     }
     
-    BBox3fa BVH4Refit::recurse_top(NodeRef& ref)
+    BBox3fa BVH4Refit::recurse_top(NodeRef& ref, float& sah)
     {
       /* stop here if we encounter a barrier */
       if (unlikely(ref.isBarrier())) {
         ref.clearBarrier();
-        return node_bounds(ref);
+        return node_bounds(ref,sah);
       }
       
       /* this is a leaf node */
       if (unlikely(ref.isLeaf()))
-        return leaf_bounds(ref);
+        return leaf_bounds(ref,sah);
       
       /* recurse if this is an internal node */
       Node* node = ref.node();
-      const BBox3fa bounds0 = recurse_top(node->child(0));
-      const BBox3fa bounds1 = recurse_top(node->child(1));
-      const BBox3fa bounds2 = recurse_top(node->child(2));
-      const BBox3fa bounds3 = recurse_top(node->child(3));
+      const BBox3fa bounds0 = recurse_top(node->child(0),sah);
+      const BBox3fa bounds1 = recurse_top(node->child(1),sah);
+      const BBox3fa bounds2 = recurse_top(node->child(2),sah);
+      const BBox3fa bounds3 = recurse_top(node->child(3),sah);
       
       /* AOS to SOA transform */
       BBox<sse3f> bounds;
@@ -223,23 +305,30 @@ namespace embree
       const float upper_x = reduce_max(bounds.upper.x);
       const float upper_y = reduce_max(bounds.upper.y);
       const float upper_z = reduce_max(bounds.upper.z);
-      return BBox3fa(Vec3fa(lower_x,lower_y,lower_z),
-                    Vec3fa(upper_x,upper_y,upper_z));
+      const BBox3fa merged(Vec3fa(lower_x,lower_y,lower_z),
+                           Vec3fa(upper_x,upper_y,upper_z));
+      sah += halfArea(merged);
+      return merged;
     }
     
     void BVH4Refit::task_refit_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) 
     {
       NodeRef& ref = *roots[taskIndex];
-      recurse_bottom(ref);
+      subtreeSAH[taskIndex] = 0.0f;
+      recurse_bottom(ref,subtreeSAH[taskIndex]);
       ref.setBarrier();
     }
     
-    void BVH4Refit::task_refit_complete(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-      bvh->bounds = recurse_top(bvh->root);
+    void BVH4Refit::task_refit_complete(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) 
+    {
+      refitSAH = 0.0f;
+      for (size_t i=0; i<subtreeSAH.size(); i++) refitSAH += subtreeSAH[i];
+      bvh->bounds = recurse_top(bvh->root,refitSAH);
     }
     
     void BVH4Refit::refit_sequential(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-      bvh->bounds = recurse_bottom(bvh->root);
+      refitSAH = 0.0f;
+      bvh->bounds = recurse_bottom(bvh->root,refitSAH);
     }
 
     Builder* BVH4BuilderObjectSplit4TriangleMeshFast (void* bvh, TriangleMesh* mesh, const size_t minLeafSize, const size_t maxLeafSize);
@@ -48,11 +48,14 @@ namespace embree
     private:
       size_t annotate_tree_sizes(NodeRef& ref);
       void calculate_refit_roots ();
+
+      /*! rotates the subtrees whose SAH cost increased most within the time budget */
+      void optimize();
       
-      BBox3fa leaf_bounds(NodeRef& ref);
-      BBox3fa node_bounds(NodeRef& ref);
-      BBox3fa recurse_bottom(NodeRef& ref);
-      BBox3fa recurse_top(NodeRef& ref);
+      BBox3fa leaf_bounds(NodeRef& ref, float& sah);
+      BBox3fa node_bounds(NodeRef& ref, float& sah);
+      BBox3fa recurse_bottom(NodeRef& ref, float& sah);
+      BBox3fa recurse_top(NodeRef& ref, float& sah);
       
     private:
       //BuildSource* source;           //!< input geometry
@@ -67,6 +70,13 @@ namespace embree
       Builder* builder;
       BVH4* bvh;                      //!< BVH to refit
       std::vector<NodeRef*> roots;    //!< List of equal sized subtrees for bvh refit
+      std::vector<size_t> rootDepths; //!< depth of each subtree root
+      std::vector<float> subtreeSAH;  //!< SAH cost of each subtree of the last refit
+      std::vector<float> subtreeBuildSAH; //!< SAH cost of each subtree after the last build
+      bool rebuild;                   //!< BVH has to get built from scratch
+      bool measured;                  //!< SAH cost of the BVH got measured after its last build
+      float buildSAH;                 //!< relative SAH cost of the BVH after its last build
+      float refitSAH;                 //!< SAH cost of the BVH after the last refit
     };
   }
 }
@@ -0,0 +1,159 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_restructure.h"
+#include "bvh4i/bvh4i.h"
+
+namespace embree
+{
+  /*! BVH4 nodes are referenced by pointer, BVH4i nodes by offset */
+  template<> __forceinline BVH4::Node* BVHRestructure<BVH4>::node(BVH4* bvh, NodeRef ref) {
+    return ref.node();
+  }
+
+  template<> __forceinline BVH4i::Node* BVHRestructure<BVH4i>::node(BVH4i* bvh, NodeRef ref) {
+    return ref.node(bvh->nodePtr());
+  }
+
+  /*! Finds the subset of treelet leaves that minimizes the area of
+   *  the inner node. Each subset of at most 4 leaves that leaves at
+   *  most 3 leaves for the parent is a candidate. The bounds of all
+   *  subsets are computed incrementally from the subset with the
+   *  lowest leaf removed. Returns 0 if no subset improves the area. */
+  template<typename BVH>
+  __noinline size_t BVHRestructure<BVH>::findBestSubset(const Treelet& treelet, const size_t currentSet, const size_t invalidSet, float& bestArea)
+  {
+    BBox3fa setBounds[size_t(1) << MAX_TREELET_LEAVES];
+    size_t setSize[size_t(1) << MAX_TREELET_LEAVES];
+    setBounds[0] = empty; setSize[0] = 0;
+
+    size_t bestSet = 0;
+    const size_t numSets = size_t(1) << treelet.numLeaves;
+    for (size_t set=1; set<numSets; set++)
+    {
+      const size_t i = __bsf(set);
+      setBounds[set] = merge(setBounds[set & (set-1)],treelet.bounds[i]);
+      setSize[set] = setSize[set & (set-1)]+1;
+      if (set == currentSet || (set & invalidSet)) continue;
+      if (setSize[set] < 2 || setSize[set] > 4 || treelet.numLeaves-setSize[set] > 3) continue;
+      
+      const float area = halfArea(setBounds[set]);
+      if (area < bestArea) {
+        bestArea = area;
+        bestSet = set;
+      }
+    }
+    return bestSet;
+  }
+
+  template<typename BVH>
+  size_t BVHRestructure<BVH>::restructure(BVH* bvh, NodeRef parentRef, size_t depth)
+  {
+    /*! nothing to restructure if we reached a leaf node. */
+    if (parentRef.isBarrier()) return 0;
+    if (parentRef.isLeaf()) return 0;
+    Node* parent = node(bvh,parentRef);
+
+    /*! restructure all children first */
+    ssei cdepth;
+    for (size_t c=0; c<4; c++)
+      cdepth[c] = (int)restructure(bvh,parent->child(c),depth+1);
+
+    /*! Find best treelet. We pick an inner child (child2) and collect
+      the other children of the parent and the children of child2 as
+      treelet leaves. The leaves get redistributed such that the area
+      of child2 gets minimal, which minimizes the SAH of the treelet
+      as the area of the parent stays the same. */
+    float bestGain = 0;
+    int bestChild2 = -1;
+    size_t bestSet = 0;
+    Treelet best;
+
+    for (size_t c2=0; c2<4; c2++)
+    {
+      /*! ignore leaf nodes as we cannot descent into them */
+      if (parent->child(c2).isBarrier()) continue;
+      if (parent->child(c2).isLeaf()) continue;
+      Node* child2 = node(bvh,parent->child(c2));
+
+      /*! gather treelet leaves, children of the parent get pushed down when put into child2 */
+      Treelet treelet;
+      treelet.numLeaves = 0;
+      treelet.parentLeaves = 0;
+      size_t currentSet = 0, invalidSet = 0;
+      for (size_t c=0; c<4; c++) 
+      {
+        if (c == c2 || parent->child(c) == BVH::emptyNode) continue;
+        const size_t i = treelet.numLeaves++;
+        if (depth+1+cdepth[c] > BVH::maxBuildDepth) invalidSet |= size_t(1) << i; // only select treelets that fulfill depth constraints
+        treelet.parentLeaves |= size_t(1) << i;
+        treelet.leaves[i] = parent->child(c); 
+        treelet.bounds[i] = parent->bounds(c); 
+        treelet.height[i] = cdepth[c];
+      }
+      for (size_t c=0; c<4; c++) 
+      {
+        if (child2->child(c) == BVH::emptyNode) continue;
+        const size_t i = treelet.numLeaves++;
+        currentSet |= size_t(1) << i;
+        treelet.leaves[i] = child2->child(c); 
+        treelet.bounds[i] = child2->bounds(c); 
+        treelet.height[i] = cdepth[c2]-1;
+      }
+
+      /*! accept a treelet when it reduces cost */
+      const float childArea = halfArea(parent->bounds(c2));
+      float area = childArea;
+      const size_t set = findBestSubset(treelet,currentSet,invalidSet,area);
+      if (set && area-childArea < bestGain) {
+        bestGain = area-childArea;
+        bestChild2 = c2;
+        bestSet = set;
+        best = treelet;
+      }
+    }
+
+    /*! if we did not find a treelet that improves the SAH then do nothing */
+    if (bestChild2 == -1) return 1+reduce_max(cdepth);
+
+    /*! redistribute the treelet leaves */
+    const NodeRef child2Ref = parent->child(bestChild2);
+    Node* child2 = node(bvh,child2Ref);
+    int child2Depth = cdepth[bestChild2];
+    parent->clear();
+    child2->clear();
+    
+    size_t numParent = 1, numChild2 = 0;
+    for (size_t i=0; i<best.numLeaves; i++)
+    {
+      if (bestSet & (size_t(1) << i)) {
+        child2->set(numChild2++,best.bounds[i],best.leaves[i]);
+        if (best.parentLeaves & (size_t(1) << i)) child2Depth = max(child2Depth,best.height[i]+1); 
+      }
+      else
+        parent->set(numParent++,best.bounds[i],best.leaves[i]);
+    }
+    parent->set(0,child2->bounds(),child2Ref);
+    
+    /*! This returned depth is conservative as the leaves that were
+     *  pulled up in the tree could have been on the critical path. */
+    return 1+max(child2Depth,reduce_max(cdepth));
+  }
+
+  /*! explicit instantiations */
+  template class BVHRestructure<BVH4>;
+  template class BVHRestructure<BVH4i>;
+}
@@ -0,0 +1,59 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4.h"
+
+namespace embree
+{
+  class BVH4i;
+
+  /* Treelet Restructuring of BVH4 and BVH4i. A treelet is formed by
+   * a node and one of its inner children and has up to 7 treelet
+   * leaves. The leaves get redistributed between both nodes such
+   * that the SAH of the treelet gets minimal. */
+  template<typename BVH>
+  class BVHRestructure
+  {
+  public:
+    typedef typename BVH::Node Node;
+    typedef typename BVH::NodeRef NodeRef;
+
+    /*! maximal number of leaves of a treelet */
+    static const size_t MAX_TREELET_LEAVES = 7;
+
+    /*! Leaves of a treelet formed by a node and one of its children. */
+    struct Treelet
+    {
+      size_t numLeaves;                       //!< number of treelet leaves
+      NodeRef leaves[MAX_TREELET_LEAVES];     //!< references to the treelet leaves
+      BBox3fa bounds[MAX_TREELET_LEAVES];     //!< bounds of the treelet leaves
+      int height[MAX_TREELET_LEAVES];         //!< height of the subtrees of the treelet leaves
+      size_t parentLeaves;                    //!< set of leaves that are children of the parent
+    };
+
+  public:
+    static size_t restructure(BVH* bvh, NodeRef parentRef, size_t depth = 1);
+
+  private:
+    static Node* node(BVH* bvh, NodeRef ref);
+    static size_t findBestSubset(const Treelet& treelet, const size_t currentSet, const size_t invalidSet, float& bestArea);
+  };
+
+  typedef BVHRestructure<BVH4>  BVH4Restructure;
+  typedef BVHRestructure<BVH4i> BVH4iRestructure;
+}
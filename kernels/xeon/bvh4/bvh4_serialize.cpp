@@ -0,0 +1,45 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4.h"
+#include "bvh4_serialize.h"
+
+namespace embree
+{
+  bool BVH4::store(FILE* file)
+  {
+    /* two level BVHs cannot get stored */
+    if (objects.size())
+      return false;
+
+    if (quantized) return BVHSerializer<BVH4,QuantizedNode>::store(this,file);
+    else           return BVHSerializer<BVH4>::store(this,file);
+  }
+
+  bool BVH4::restore(const char* filename, size_t offset, size_t bytes)
+  {
+    if (quantized) return BVHSerializer<BVH4,QuantizedNode>::restore(this,filename,offset,bytes);
+    else           return BVHSerializer<BVH4>::restore(this,filename,offset,bytes);
+  }
+
+  void BVH4::unmap()
+  {
+    if (mapped) os_unmap_file(mapped, bytesMapped);
+    mapped = NULL; bytesMapped = 0;
+    root = emptyNode; bounds = empty;
+    numPrimitives = numVertices = 0;
+  }
+}
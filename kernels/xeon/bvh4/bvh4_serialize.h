@@ -0,0 +1,253 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common/default.h"
+#include <deque>
+#include <vector>
+
+namespace embree
+{
+  /*! Header of a stored BVH. All offsets are relative to the start
+   *  of the header. The nodes are stored in breadth first order,
+   *  followed by the primitive blocks of all leaves. */
+  struct BVHFileHeader
+  {
+    char primTy[32];          //!< name of the primitive type
+    uint64 bytesNode;         //!< size of a node
+    uint64 bytesPrimitive;    //!< size of a primitive block
+    uint64 numPrimitives;     //!< number of primitives
+    uint64 numVertices;       //!< number of vertices
+    BBox3fa bounds;           //!< bounds of the BVH
+    uint64 root;              //!< relative reference to the root node
+    uint64 nodesOfs;          //!< offset of the first node
+    uint64 numNodes;          //!< number of nodes
+    uint64 primsOfs;          //!< offset of the first primitive block
+    uint64 bytesPrims;        //!< number of bytes of all primitive blocks
+  };
+
+  /*! Stores and restores BVHs of any branching factor, used by BVH4
+   *  and BVH8. The node type defaults to the regular node of the BVH,
+   *  quantized BVH4s are stored with BVH4::QuantizedNode. */
+  template<typename BVH, typename Node = typename BVH::Node>
+  class BVHSerializer
+  {
+    typedef typename BVH::NodeRef NodeRef;
+
+    /*! alignment of the first node and of the primitive blocks of a leaf */
+    static const size_t blockAlignment = 64;
+
+  public:
+
+    /*! stores the BVH at the current position of a file */
+    static bool store(const BVH* bvh, FILE* file)
+    {
+      /* count nodes and bytes of all leaves */
+      size_t numNodes = 0, bytesPrims = 0;
+      std::deque<NodeRef> queue;
+      queue.push_back(bvh->root);
+      while (!queue.empty())
+      {
+        NodeRef ref = queue.front(); queue.pop_front();
+        if (ref == BVH::emptyNode) continue;
+        if (ref.isLeaf()) { bytesPrims += leafBytes(bvh,ref); continue; }
+        numNodes++;
+        for (size_t i=0; i<BVH::N; i++) queue.push_back(node(ref)->child(i));
+      }
+
+      /* nodes and leaves get their offsets in the order they are visited */
+      BVHFileHeader header; memset(&header,0,sizeof(header));
+      strncpy(header.primTy,bvh->primTy.name.c_str(),sizeof(header.primTy)-1);
+      header.bytesNode = sizeof(Node);
+      header.bytesPrimitive = bvh->primTy.bytes;
+      header.numPrimitives = bvh->numPrimitives;
+      header.numVertices = bvh->numVertices;
+      header.bounds = bvh->bounds;
+      header.nodesOfs = align(sizeof(BVHFileHeader));
+      header.numNodes = numNodes;
+      header.primsOfs = align(header.nodesOfs + numNodes*sizeof(Node));
+      header.bytesPrims = bytesPrims;
+
+      size_t nextNode = header.nodesOfs;
+      size_t nextPrim = header.primsOfs;
+      header.root = relocate(bvh,bvh->root,nextNode,nextPrim);
+
+      if (fwrite(&header,sizeof(header),1,file) != 1) return false;
+      if (!writeZeros(file,header.nodesOfs-sizeof(header))) return false;
+
+      /* write nodes with relative child references */
+      queue.push_back(bvh->root);
+      while (!queue.empty())
+      {
+        NodeRef ref = queue.front(); queue.pop_front();
+        if (ref == BVH::emptyNode || ref.isLeaf()) continue;
+        Node n = *node(ref);
+        for (size_t i=0; i<BVH::N; i++) {
+          queue.push_back(n.child(i));
+          n.child(i) = relocate(bvh,n.child(i),nextNode,nextPrim);
+        }
+        if (fwrite(&n,sizeof(Node),1,file) != 1) return false;
+      }
+      if (!writeZeros(file,header.primsOfs-header.nodesOfs-numNodes*sizeof(Node))) return false;
+
+      /* write primitive blocks in the same order, the primitive type replaces pointers in a copy of each leaf */
+      std::vector<char> block;
+      queue.push_back(bvh->root);
+      while (!queue.empty())
+      {
+        NodeRef ref = queue.front(); queue.pop_front();
+        if (ref == BVH::emptyNode) continue;
+        if (ref.isNode()) {
+          for (size_t i=0; i<BVH::N; i++) queue.push_back(node(ref)->child(i));
+          continue;
+        }
+        size_t num; char* prims = ref.leaf(num);
+        const size_t bytes = num*bvh->primTy.bytes;
+        block.assign(leafBytes(bvh,ref),0);
+        if (bytes) memcpy(&block[0],prims,bytes);
+        if (!bvh->primTy.store(&block[0],num,bvh->geometry)) return false;
+        if (fwrite(&block[0],1,block.size(),file) != block.size()) return false;
+      }
+      return true;
+    }
+
+    /*! maps a BVH stored with store into memory and relocates its node references */
+    static bool restore(BVH* bvh, const char* filename, size_t offset, size_t bytes)
+    {
+      if (bytes < sizeof(BVHFileHeader))
+        return false;
+
+      char* base = (char*) os_map_file(filename,offset,bytes);
+      if (base == NULL) return false;
+
+      /* the stored BVH has to fit this BVH and the mapped range */
+      const BVHFileHeader* header = (const BVHFileHeader*) base;
+      if (!valid(bvh,*header,bytes) || !relocateNodes(bvh,base,*header)) {
+        os_unmap_file(base,bytes);
+        return false;
+      }
+
+      if (bvh->mapped) os_unmap_file(bvh->mapped,bvh->bytesMapped);
+      bvh->mapped = base; bvh->bytesMapped = bytes;
+      bvh->root = header->root == BVH::emptyNode ? NodeRef(BVH::emptyNode) : NodeRef((size_t)base + header->root);
+      bvh->bounds = header->bounds;
+      bvh->numPrimitives = header->numPrimitives;
+      bvh->numVertices = header->numVertices;
+      return true;
+    }
+
+  private:
+
+    /*! returns the node a reference points to */
+    static __forceinline Node* node(NodeRef ref) { 
+      assert(ref.isNode()); return (Node*)(size_t)ref; 
+    }
+
+    /*! aligns a file offset to the block alignment */
+    static __forceinline size_t align(size_t ofs) { 
+      return (ofs+blockAlignment-1) & ~(blockAlignment-1); 
+    }
+
+    /*! writes zero bytes for padding */
+    static bool writeZeros(FILE* file, size_t bytes)
+    {
+      char zeros[256]; memset(zeros,0,sizeof(zeros));
+      for (size_t i=0; i<bytes; i+=sizeof(zeros)) {
+        const size_t n = min(bytes-i,sizeof(zeros));
+        if (fwrite(zeros,1,n,file) != n) return false;
+      }
+      return true;
+    }
+
+    /*! number of bytes a leaf occupies in the file */
+    static __forceinline size_t leafBytes(const BVH* bvh, NodeRef ref)
+    {
+      size_t num; ref.leaf(num);
+      return align(num*bvh->primTy.bytes);
+    }
+
+    /*! returns the reference of a node or leaf relative to the start of the stored BVH */
+    static __forceinline NodeRef relocate(const BVH* bvh, NodeRef ref, size_t& nextNode, size_t& nextPrim)
+    {
+      if (ref == BVH::emptyNode) return ref;
+      if (ref.isNode()) {
+        NodeRef r = nextNode; nextNode += sizeof(Node); return r;
+      }
+      NodeRef r = nextPrim | (ref & BVH::align_mask); nextPrim += leafBytes(bvh,ref); return r;
+    }
+
+    /*! checks that the header matches the BVH and that all nodes and primitives lie inside the mapped range */
+    static bool valid(const BVH* bvh, const BVHFileHeader& header, size_t bytes)
+    {
+      if (strncmp(header.primTy,bvh->primTy.name.c_str(),sizeof(header.primTy)) != 0) return false;
+      if (header.bytesNode != sizeof(Node) || header.bytesPrimitive != bvh->primTy.bytes) return false;
+      if (header.nodesOfs != align(sizeof(BVHFileHeader)) || header.nodesOfs > bytes) return false;
+      if (header.numNodes > (bytes-header.nodesOfs)/sizeof(Node)) return false;
+      if (header.primsOfs != align(header.nodesOfs + header.numNodes*sizeof(Node)) || header.primsOfs > bytes) return false;
+      if (header.bytesPrims > bytes-header.primsOfs) return false;
+      return true;
+    }
+
+    /*! Relocates the stored references of the BVH. A reference is
+     *  only accepted at the offset store assigned to it, this keeps
+     *  all references inside the mapped range and makes sure that
+     *  each node is referenced once by a node stored before it. The
+     *  depth of the BVH is limited to what the traversal stacks
+     *  support. Leaves get restored by the primitive type,
+     *  only the pages storing nodes and primitives get touched. */
+    static bool relocateNodes(BVH* bvh, char* base, const BVHFileHeader& header)
+    {
+      size_t nextNode = header.nodesOfs;
+      size_t nextPrim = header.primsOfs;
+      const size_t endPrims = header.primsOfs + header.bytesPrims;
+      if (!relocateRef(bvh,base,header.root,nextNode,nextPrim,endPrims)) return false;
+
+      Node* nodes = (Node*) (base + header.nodesOfs);
+      size_t depth = 1, levelEnd = (nextNode-header.nodesOfs)/sizeof(Node);
+      for (size_t i=0; i<header.numNodes; i++) 
+      {
+        /* nodes of the next level end where the references of this level ended, each node has to be referenced */
+        if (i == levelEnd) {
+          levelEnd = (nextNode-header.nodesOfs)/sizeof(Node);
+          if (levelEnd == i || ++depth >= BVH::maxDepth) return false;
+        }
+        for (size_t c=0; c<BVH::N; c++) {
+          NodeRef& child = nodes[i].child(c);
+          if (!relocateRef(bvh,base,child,nextNode,nextPrim,endPrims)) return false;
+          if (child != BVH::emptyNode) child = NodeRef((size_t)base + child);
+        }
+      }
+      return nextNode == header.nodesOfs + header.numNodes*sizeof(Node) && nextPrim == endPrims;
+    }
+
+    /*! checks that a stored reference has the offset store assigned to it and restores the primitives of leaves */
+    static bool relocateRef(BVH* bvh, char* base, NodeRef ref, size_t& nextNode, size_t& nextPrim, size_t endPrims)
+    {
+      if (ref == BVH::emptyNode) return true;
+      if (ref.isNode()) {
+        if (size_t(ref) != nextNode) return false;
+        nextNode += sizeof(Node);
+        return true;
+      }
+      size_t num; const size_t ofs = (size_t) ref.leaf(num);
+      if (ofs != nextPrim || num > (endPrims-ofs)/bvh->primTy.bytes) return false;
+      nextPrim += leafBytes(bvh,ref);
+      if (nextPrim > endPrims) return false;
+      return bvh->primTy.restore(base+ofs,num,bvh->geometry);
+    }
+  };
+}
@@ -18,6 +18,9 @@
 
 #include "bvh4/bvh4.h"
 #include "bvh4i/bvh4i.h"
+#if defined(__TARGET_AVX__)
+#include "bvh8/bvh8.h"
+#endif
 
 namespace embree
 {
@@ -32,6 +35,13 @@ namespace embree
   extern Accel::Intersector4 BVH4iVirtualIntersector4Chunk;
   extern Accel::Intersector8 BVH4iVirtualIntersector8Chunk;
 
+#if defined(__TARGET_AVX__)
+  extern Accel::Intersector1 BVH8VirtualIntersector1;
+  extern Accel::Intersector4 BVH8VirtualIntersector4Chunk;
+  extern Accel::Intersector8 BVH8VirtualIntersector8Chunk;
+  Builder* BVH8BuilderObjectSplit1 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+#endif
+
   Builder* BVH4BuilderObjectSplit1 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
 
   VirtualAccel::VirtualAccel (const std::string& ty, std::vector<AccelSet*>& accels)
@@ -46,6 +56,17 @@ namespace embree
       intersectors.intersector16 = NULL;
       builder = BVH4BuilderObjectSplit1(accel,&source,&accels,1,1);
     }
+#if defined(__TARGET_AVX__)
+    else if (ty == "bvh8")
+    {
+      intersectors.ptr = accel = new BVH8(virtual_accel_object_type);
+      intersectors.intersector1 = BVH8VirtualIntersector1;
+      intersectors.intersector4 = BVH8VirtualIntersector4Chunk;
+      intersectors.intersector8 = BVH8VirtualIntersector8Chunk;
+      intersectors.intersector16 = NULL;
+      builder = BVH8BuilderObjectSplit1(accel,&source,&accels,1,1);
+    }
+#endif
     else
       throw std::runtime_error("unknown acceleration structure: \"" + ty + "\"");
   }
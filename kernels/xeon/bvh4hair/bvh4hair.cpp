@@ -20,6 +20,8 @@
 namespace embree
 {
   DECLARE_SYMBOL(Accel::Intersector1,BVH4HairIntersector1_);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH4HairIntersector4_);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH4HairIntersector8_);
 
   Builder* BVH4HairBuilder_ (BVH4Hair* bvh, Scene* scene);
 
@@ -70,6 +72,8 @@ namespace embree
   {
     int features = getCPUFeatures();
     SELECT_SYMBOL_AVX_AVX2(features,BVH4HairIntersector1_);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4HairIntersector4_);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH4HairIntersector8_);
   }
 
   BVH4Hair::BVH4Hair (Scene* scene) 
@@ -83,8 +87,8 @@ namespace embree
     Accel::Intersectors intersectors;
     intersectors.ptr = bvh;
     intersectors.intersector1 = BVH4HairIntersector1_;
-    intersectors.intersector4 = NULL;
-    intersectors.intersector8 = NULL;
+    intersectors.intersector4 = BVH4HairIntersector4_;
+    intersectors.intersector8 = BVH4HairIntersector8_;
     intersectors.intersector16 = NULL;
     return intersectors;
   }
@@ -63,6 +63,7 @@ namespace embree
       if (geom->type != BEZIER_CURVES) continue;
       if (!geom->isEnabled()) continue;
       BezierCurves* set = (BezierCurves*) geom;
+      if (set->numTimeSteps != 1) continue; // motion blur curves get built by a separate acceleration structure
 
       for (size_t j=0; j<set->numCurves; j++) {
         const int ofs = set->curve(j);
@@ -83,9 +84,13 @@ namespace embree
     bvh->numPrimitives = curves.size();
     bvh->numVertices = 0;
 
-    /* start recursive build */
-    size_t begin = 0, end = curves.size();
-    bvh->root = recurse(threadIndex,0,begin,end,computeAlignedBounds(&curves[0],begin,end,LinearSpace3fa(one)));
+    /* temporary curve array for parallel splits */
+    if (curves.size() >= parallelThreshold) 
+      tmp.resize(curves.size());
+
+    /* start parallel build */
+    TaskScheduler::executeTask(threadIndex,threadCount,_buildFunction,this,"BVH4HairBuilder::build");
+    tmp.clear();
     bvh->bounds = bounds;
     NAVI(naviNode = bvh->root);
     NAVI(rootNode = bvh->root);
@@ -99,6 +104,12 @@ namespace embree
     }
   }
 
+  void BVH4HairBuilder::buildFunction(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) 
+  {
+    size_t begin = 0, end = curves.size();
+    recurseTask(threadIndex,event,bvh->root,0,begin,end,computeAlignedBounds(&curves[0],begin,end,LinearSpace3fa(one)));
+  }
+
   void BVH4HairBuilder::subdivide(float ratio)
   {
     if (g_verbose >= 2) 
@@ -259,35 +270,21 @@ namespace embree
     return left;
   }
 
-  __forceinline BVH4HairBuilder::ObjectSplit BVH4HairBuilder::ObjectSplit::find(Bezier1* curves, size_t begin, size_t end, const LinearSpace3fa& space)
+  void BVH4HairBuilder::ObjectSplit::Binner::clear()
   {
-    /* calculate geometry and centroid bounds */
-    BBox3fa centBounds = empty;
-    BBox3fa geomBounds = empty;
-    for (size_t i=begin; i<end; i++) {
-      const Vec3fa p0 = xfmPoint(space,curves[i].p0);
-      const Vec3fa p3 = xfmPoint(space,curves[i].p3);
-      geomBounds.extend(curves[i].bounds(space)); // FIXME: transforms points again
-      centBounds.extend(p0+p3);
-    }
-
-    /* calculate binning function */
-    const ssef ofs = (ssef) centBounds.lower;
-    const ssef diag = (ssef) centBounds.size();
-    const ssef scale = select(diag != 0.0f,rcp(diag) * ssef(BINS * 0.99f),ssef(0.0f));
-
-    /* initialize bins */
-    BBox3fa bounds[BINS][4];
-    ssei    counts[BINS];
     for (size_t i=0; i<BINS; i++) {
       bounds[i][0] = bounds[i][1] = bounds[i][2] = bounds[i][3] = empty;
+      areas[i] = 0.0f;
       counts[i] = 0;
     }
- 
-    /* perform binning of curves */
+  }
+
+  void BVH4HairBuilder::ObjectSplit::Binner::bin(const Bezier1* curves, size_t begin, size_t end, const LinearSpace3fa& space, const ssef& ofs, const ssef& scale)
+  {
     for (size_t i=begin; i<end; i++)
     {
       const BBox3fa cbounds = curves[i].bounds(space); // FIXME: transforms again
+      const float A = halfArea(cbounds);
       const Vec3fa p0 = xfmPoint(space,curves[i].p0);
       const Vec3fa p3 = xfmPoint(space,curves[i].p3);
       //const ssei bin = clamp(floori((ssef(p0+p3) - ofs)*scale),ssei(0),ssei(BINS-1));
@@ -295,11 +292,26 @@ namespace embree
       assert(bin[0] >=0 && bin[0] < BINS);
       assert(bin[1] >=0 && bin[1] < BINS);
       assert(bin[2] >=0 && bin[2] < BINS);
-      const int b0 = bin[0]; counts[b0][0]++; bounds[b0][0].extend(cbounds);
-      const int b1 = bin[1]; counts[b1][1]++; bounds[b1][1].extend(cbounds);
-      const int b2 = bin[2]; counts[b2][2]++; bounds[b2][2].extend(cbounds);
+      const int b0 = bin[0]; counts[b0][0]++; areas[b0][0] += A; bounds[b0][0].extend(cbounds);
+      const int b1 = bin[1]; counts[b1][1]++; areas[b1][1] += A; bounds[b1][1].extend(cbounds);
+      const int b2 = bin[2]; counts[b2][2]++; areas[b2][2] += A; bounds[b2][2].extend(cbounds);
     }
-    
+  }
+
+  void BVH4HairBuilder::ObjectSplit::Binner::merge(const Binner& other)
+  {
+    for (size_t i=0; i<BINS; i++) 
+    {
+      bounds[i][0].extend(other.bounds[i][0]);
+      bounds[i][1].extend(other.bounds[i][1]);
+      bounds[i][2].extend(other.bounds[i][2]);
+      areas [i] += other.areas [i];
+      counts[i] += other.counts[i];
+    }
+  }
+
+  BVH4HairBuilder::ObjectSplit BVH4HairBuilder::ObjectSplit::Binner::best(const LinearSpace3fa& space, const ssef& ofs, const ssef& scale, size_t N) const
+  {
     /* sweep from right to left and compute parallel prefix of merged bounds */
     ssef rAreas[BINS];
     ssei rCounts[BINS];
@@ -357,12 +369,50 @@ namespace embree
         split.pos = bestPos[dim];
         split.cost = bestSAH[dim];
         split.num0 = bestLeft[dim];
-        split.num1 = end-begin-split.num0;
+        split.num1 = N-split.num0;
       }
     }
+    if (split.dim == -1) 
+      return split;
+
+    /* merge the bins of both sides */
+    float area0 = 0.0f, area1 = 0.0f;
+    BBox3fa bounds0 = empty, bounds1 = empty;
+    for (size_t i=0; i<split.pos; i++) {
+      bounds0.extend(bounds[i][split.dim]);
+      area0 += areas[i][split.dim];
+    }
+    for (size_t i=split.pos; i<BINS; i++) {
+      bounds1.extend(bounds[i][split.dim]);
+      area1 += areas[i][split.dim];
+    }
+    split.bounds0 = NAABBox3fa(space,bounds0); split.bounds0.bounds.upper.w = area0;
+    split.bounds1 = NAABBox3fa(space,bounds1); split.bounds1.bounds.upper.w = area1;
     return split;
   }
 
+  __forceinline BVH4HairBuilder::ObjectSplit BVH4HairBuilder::ObjectSplit::find(Bezier1* curves, size_t begin, size_t end, const LinearSpace3fa& space)
+  {
+    /* calculate centroid bounds */
+    BBox3fa centBounds = empty;
+    for (size_t i=begin; i<end; i++) {
+      const Vec3fa p0 = xfmPoint(space,curves[i].p0);
+      const Vec3fa p3 = xfmPoint(space,curves[i].p3);
+      centBounds.extend(p0+p3);
+    }
+
+    /* calculate binning function */
+    const ssef ofs = (ssef) centBounds.lower;
+    const ssef diag = (ssef) centBounds.size();
+    const ssef scale = select(diag != 0.0f,rcp(diag) * ssef(BINS * 0.99f),ssef(0.0f));
+
+    /* perform binning of curves */
+    Binner binner;
+    binner.clear();
+    binner.bin(curves,begin,end,space,ofs,scale);
+    return binner.best(space,ofs,scale,end-begin);
+  }
+
   const BVH4HairBuilder::ObjectSplit BVH4HairBuilder::ObjectSplit::alignedBounds(Bezier1* curves, size_t begin, size_t end)
   {
     if (dim == -1) {
@@ -431,7 +481,8 @@ namespace embree
       std::cout << "WARNING: Loosing " << N-BVH4Hair::maxLeafBlocks << " primitives during build!" << std::endl;
       N = (size_t)BVH4Hair::maxLeafBlocks;
     }
-    numGeneratedPrims+=N; if (numGeneratedPrims > 10000) { std::cout << "." << std::flush; numGeneratedPrims = 0; }
+    const size_t numGenerated = numGeneratedPrims.add(N);
+    if (g_verbose >= 2 && numGenerated/10000 != (numGenerated-N)/10000) std::cout << "." << std::flush;
     //assert(N <= (size_t)BVH4Hair::maxLeafBlocks);
     Bezier1* leaf = (Bezier1*) bvh->allocPrimitiveBlocks(threadIndex,N);
     for (size_t i=0; i<N; i++) leaf[i] = curves[begin+i];
@@ -503,18 +554,10 @@ namespace embree
     }
   }
 
-  BVH4Hair::NodeRef BVH4HairBuilder::recurse(size_t threadIndex, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds)
+  size_t BVH4HairBuilder::splitNode(size_t begin, size_t end, const NAABBox3fa& bounds, size_t* cbegin, size_t* cend, NAABBox3fa* cbounds, bool& isAligned)
   {
-    /* create enforced leaf */
-    const size_t N = end-begin;
-    if (N <= minLeafSize || depth > BVH4Hair::maxBuildDepth)
-      return leaf(threadIndex,depth,begin,end,bounds);
-
     /*! initialize child list */
-    bool isAligned = true;
-    size_t cbegin [BVH4Hair::N];
-    size_t cend   [BVH4Hair::N];
-    NAABBox3fa cbounds[BVH4Hair::N];
+    isAligned = true;
     cbegin[0] = begin;
     cend  [0] = end;
     cbounds[0] = bounds;
@@ -544,14 +587,16 @@ namespace embree
       
     } while (numChildren < BVH4Hair::N);
 
-    //for (size_t i=0; i<numChildren; i++)
-    //PRINT3(depth,i,cend[i]-cbegin[i]);
-    
+    return numChildren;
+  }
+
+  BVH4Hair::NodeRef BVH4HairBuilder::createNode(size_t threadIndex, size_t numChildren, const NAABBox3fa* cbounds, bool isAligned)
+  {
     /* create aligned node */
     if (isAligned) {
       AlignedNode* node = bvh->allocAlignedNode(threadIndex);
       for (size_t i=0; i<numChildren; i++)
-        node->set(i,cbounds[i].bounds,recurse(threadIndex,depth+1,cbegin[i],cend[i],cbounds[i]));
+        node->set(i,cbounds[i].bounds,BVH4Hair::emptyNode);
       return bvh->encodeNode(node);
     }
     
@@ -559,11 +604,282 @@ namespace embree
     else {
       UnalignedNode* node = bvh->allocUnalignedNode(threadIndex);
       for (size_t i=0; i<numChildren; i++)
-        node->set(i,cbounds[i],recurse(threadIndex,depth+1,cbegin[i],cend[i],cbounds[i]));
+        node->set(i,cbounds[i],BVH4Hair::emptyNode);
       return bvh->encodeNode(node);
     }
   }
 
+  BVH4Hair::NodeRef BVH4HairBuilder::recurse(size_t threadIndex, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds)
+  {
+    /* create enforced leaf */
+    const size_t N = end-begin;
+    if (N <= minLeafSize || depth > BVH4Hair::maxBuildDepth)
+      return leaf(threadIndex,depth,begin,end,bounds);
+
+    /*! split into the children of a node */
+    bool isAligned = true;
+    size_t cbegin [BVH4Hair::N];
+    size_t cend   [BVH4Hair::N];
+    NAABBox3fa cbounds[BVH4Hair::N];
+    const size_t numChildren = splitNode(begin,end,bounds,cbegin,cend,cbounds,isAligned);
+
+    /*! create node and recurse into the children */
+    NodeRef ref = createNode(threadIndex,numChildren,cbounds,isAligned);
+    Node* node = ref.node();
+    for (size_t i=0; i<numChildren; i++)
+      node->child(i) = recurse(threadIndex,depth+1,cbegin[i],cend[i],cbounds[i]);
+    return ref;
+  }
+
+  void BVH4HairBuilder::recurseTask(size_t threadIndex, TaskScheduler::Event* event, NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds)
+  {
+    /* use full single threaded build for small jobs */
+    if (end-begin < 4*1024) 
+      new BuildTask(threadIndex,event,this,dst,depth,begin,end,bounds);
+
+    /* use single threaded split for large jobs */
+    else if (end-begin < parallelThreshold || depth > BVH4Hair::maxBuildDepth)
+      new SplitTask(threadIndex,event,this,dst,depth,begin,end,bounds);
+
+    /* use parallel split for very large jobs */
+    else
+      new ParallelSplitTask(threadIndex,event,this,dst,depth,begin,end,bounds);
+  }
+
+  BVH4HairBuilder::BuildTask::BuildTask (size_t threadIndex, TaskScheduler::Event* event, BVH4HairBuilder* parent, 
+                                         NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds)
+    : parent(parent), dst(dst), depth(depth), begin(begin), end(end), bounds(bounds)
+  {
+    new (&task) TaskScheduler::Task(event,_run,this,"build::hair_full");
+    TaskScheduler::addTask(threadIndex,TaskScheduler::GLOBAL_BACK,&task);
+  }
+
+  void BVH4HairBuilder::BuildTask::run(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event)
+  {
+    dst = parent->recurse(threadIndex,depth,begin,end,bounds);
+    delete this;
+  }
+
+  BVH4HairBuilder::SplitTask::SplitTask (size_t threadIndex, TaskScheduler::Event* event, BVH4HairBuilder* parent, 
+                                         NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds)
+    : parent(parent), dst(dst), depth(depth), begin(begin), end(end), bounds(bounds)
+  {
+    new (&task) TaskScheduler::Task(event,_recurse,this,"build::hair_split");
+    TaskScheduler::addTask(threadIndex,TaskScheduler::GLOBAL_BACK,&task);
+  }
+
+  void BVH4HairBuilder::SplitTask::recurse(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event)
+  {
+    /* create enforced leaf */
+    const size_t N = end-begin;
+    if (N <= parent->minLeafSize || depth > BVH4Hair::maxBuildDepth) {
+      dst = parent->leaf(threadIndex,depth,begin,end,bounds);
+      delete this; 
+      return;
+    }
+
+    /*! split into the children of a node */
+    bool isAligned = true;
+    size_t cbegin [BVH4Hair::N];
+    size_t cend   [BVH4Hair::N];
+    NAABBox3fa cbounds[BVH4Hair::N];
+    const size_t numChildren = parent->splitNode(begin,end,bounds,cbegin,cend,cbounds,isAligned);
+
+    /*! create node and a task for each child, the children work on disjoint ranges of curves */
+    dst = parent->createNode(threadIndex,numChildren,cbounds,isAligned);
+    Node* node = dst.node();
+    for (size_t i=0; i<numChildren; i++)
+      parent->recurseTask(threadIndex,event,node->child(i),depth+1,cbegin[i],cend[i],cbounds[i]);
+    delete this;
+  }
+
+  BVH4HairBuilder::ParallelSplitTask::ParallelSplitTask (size_t threadIndex, TaskScheduler::Event* event, BVH4HairBuilder* parent, 
+                                                         NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds)
+    : parent(parent), dst(dst), depth(depth), numChildren(1), bestChild(0), isAligned(true)
+  {
+    /*! initialize child list and perform first split */
+    cbegin[0] = begin;
+    cend  [0] = end;
+    cbounds[0] = bounds;
+    splitParallel(threadIndex,event);
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::splitParallel(size_t threadIndex, TaskScheduler::Event* event)
+  {
+    space[0] = one;
+    space[1] = cbounds[bestChild].space;
+    new (&task) TaskScheduler::Task(event,
+                                    _task_bound_parallel,this,numTasks,
+                                    _task_bound_reduce,this,
+                                    "build::hair_parsplit_bound");
+    TaskScheduler::addTask(threadIndex,TaskScheduler::GLOBAL_FRONT,&task);
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_bound_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+  {
+    const Bezier1* curves = &parent->curves[0];
+    BBox3fa centBounds0 = empty, centBounds1 = empty;
+    for (size_t i=taskBegin(taskIndex); i<taskBegin(taskIndex+1); i++) {
+      centBounds0.extend(xfmPoint(space[0],curves[i].p0)+xfmPoint(space[0],curves[i].p3));
+      centBounds1.extend(xfmPoint(space[1],curves[i].p0)+xfmPoint(space[1],curves[i].p3));
+    }
+    centBounds[taskIndex][0] = centBounds0;
+    centBounds[taskIndex][1] = centBounds1;
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_bound_reduce(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event)
+  {
+    /* calculate binning functions of both spaces */
+    for (size_t s=0; s<2; s++) 
+    {
+      BBox3fa bounds = empty;
+      for (size_t i=0; i<numTasks; i++) bounds.extend(centBounds[i][s]);
+      const ssef diag = (ssef) bounds.size();
+      ofs  [s] = (ssef) bounds.lower;
+      scale[s] = select(diag != 0.0f,rcp(diag) * ssef(ObjectSplit::BINS * 0.99f),ssef(0.0f));
+    }
+
+    new (&task) TaskScheduler::Task(event,
+                                    _task_bin_parallel,this,numTasks,
+                                    _task_bin_reduce,this,
+                                    "build::hair_parsplit_bin");
+    TaskScheduler::addTask(threadIndex,TaskScheduler::GLOBAL_FRONT,&task);
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_bin_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+  {
+    for (size_t s=0; s<2; s++) {
+      binners[taskIndex][s].clear();
+      binners[taskIndex][s].bin(&parent->curves[0],taskBegin(taskIndex),taskBegin(taskIndex+1),space[s],ofs[s],scale[s]);
+    }
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_bin_reduce(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event)
+  {
+    const size_t begin = cbegin[bestChild], end = cend[bestChild];
+    const NAABBox3fa& bounds = cbounds[bestChild];
+
+    /* find best split in the aligned space and the space of the child */
+    ObjectSplit splits[2];
+    for (size_t s=0; s<2; s++) {
+      ObjectSplit::Binner binner; binner.clear();
+      for (size_t i=0; i<numTasks; i++) binner.merge(binners[i][s]);
+      splits[s] = binner.best(space[s],ofs[s],scale[s],end-begin);
+    }
+    const int travCostAligned = isAligned ? BVH4Hair::travCostAligned : BVH4Hair::travCostUnaligned;
+    const float alignedObjectSAH   = splits[0].dim == -1 ? float(inf) : travCostAligned             *halfArea(bounds.bounds) + splits[0].modifiedSAH();
+    const float unalignedObjectSAH = splits[1].dim == -1 ? float(inf) : BVH4Hair::travCostUnaligned*halfArea(bounds.bounds) + splits[1].modifiedSAH();
+
+    /* perform fallback split in a single thread */
+    if (alignedObjectSAH == float(inf) && unalignedObjectSAH == float(inf)) 
+    {
+      const FallBackSplit fallback = FallBackSplit::find(&parent->curves[0],begin,end);
+      assert((fallback.center-begin > 0) && (end-fallback.center) > 0);
+      split.num0 = fallback.center-begin; split.bounds0 = fallback.bounds0;
+      split.num1 = end-fallback.center;   split.bounds1 = fallback.bounds1;
+      task_split_done(threadIndex,threadCount,event);
+      return;
+    }
+    splitSpace = alignedObjectSAH <= unalignedObjectSAH ? 0 : 1;
+    split = splits[splitSpace];
+    if (splitSpace == 1) isAligned = false;
+
+    /* calculate where each task stores its curves, the per-task counts of the bins give the sizes */
+    size_t lofs = begin, rofs = begin+split.num0;
+    for (size_t i=0; i<numTasks; i++) 
+    {
+      size_t lnum = 0;
+      for (size_t b=0; b<split.pos; b++) lnum += binners[i][splitSpace].counts[b][split.dim];
+      loffset[i] = lofs; lofs += lnum;
+      roffset[i] = rofs; rofs += taskBegin(i+1)-taskBegin(i)-lnum;
+    }
+    assert(lofs == begin+split.num0 && rofs == end);
+
+    new (&task) TaskScheduler::Task(event,
+                                    _task_partition_parallel,this,numTasks,
+                                    _task_partition_done,this,
+                                    "build::hair_parsplit_partition");
+    TaskScheduler::addTask(threadIndex,TaskScheduler::GLOBAL_FRONT,&task);
+  }
+  
+  void BVH4HairBuilder::ParallelSplitTask::task_partition_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+  {
+    const Bezier1* curves = &parent->curves[0];
+    Bezier1* tmp = &parent->tmp[0];
+    size_t l = loffset[taskIndex], r = roffset[taskIndex];
+    for (size_t i=taskBegin(taskIndex); i<taskBegin(taskIndex+1); i++) {
+      const Vec3fa p0 = xfmPoint(split.space,curves[i].p0);
+      const Vec3fa p3 = xfmPoint(split.space,curves[i].p3);
+      const ssei bin = floori((ssef(p0+p3) - split.ofs)*split.scale);
+      if (bin[split.dim] < split.pos) tmp[l++] = curves[i];
+      else                            tmp[r++] = curves[i];
+    }
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_partition_done(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event)
+  {
+    new (&task) TaskScheduler::Task(event,
+                                    _task_copy_parallel,this,numTasks,
+                                    _task_split_done,this,
+                                    "build::hair_parsplit_copy");
+    TaskScheduler::addTask(threadIndex,TaskScheduler::GLOBAL_FRONT,&task);
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_copy_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+  {
+    for (size_t i=taskBegin(taskIndex); i<taskBegin(taskIndex+1); i++)
+      parent->curves[i] = parent->tmp[i];
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::task_split_done(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event)
+  {
+    /*! copy new children into work array */
+    const size_t center = cbegin[bestChild]+split.num0;
+    cbounds[numChildren] = split.bounds1; cbegin[numChildren] = center; cend[numChildren] = cend[bestChild];
+    cbounds[bestChild  ] = split.bounds0;                               cend[bestChild  ] = center; 
+    numChildren++;
+    next(threadIndex,event);
+  }
+
+  void BVH4HairBuilder::ParallelSplitTask::next(size_t threadIndex, TaskScheduler::Event* event)
+  {
+    /*! split until node is full */
+    while (numChildren < BVH4Hair::N)
+    {
+      /*! find best child to split */
+      float bestArea = neg_inf; 
+      bestChild = -1;
+      for (size_t i=0; i<numChildren; i++) 
+      {
+        size_t N = cend[i]-cbegin[i];
+        float A = halfArea(cbounds[i].bounds);
+        if (N <= parent->minLeafSize) continue; 
+        if (A > bestArea) { bestChild = i; bestArea = A; }
+      }
+      if (bestChild == -1) break;
+
+      /*! split large children in parallel */
+      if (cend[bestChild]-cbegin[bestChild] >= parallelThreshold) {
+        splitParallel(threadIndex,event);
+        return;
+      }
+      
+      /*! split small children in this thread */
+      NAABBox3fa lbounds, rbounds;
+      size_t center = parent->split(cbegin[bestChild],cend[bestChild],cbounds[bestChild],lbounds,rbounds,isAligned);
+      cbounds[numChildren] = rbounds; cbegin[numChildren] = center; cend[numChildren] = cend[bestChild];
+      cbounds[bestChild  ] = lbounds;                               cend[bestChild  ] = center; 
+      numChildren++;
+    }
+
+    /*! create node and a task for each child */
+    dst = parent->createNode(threadIndex,numChildren,cbounds,isAligned);
+    Node* node = dst.node();
+    for (size_t i=0; i<numChildren; i++)
+      parent->recurseTask(threadIndex,event,node->child(i),depth+1,cbegin[i],cend[i],cbounds[i]);
+    delete this;
+  }
+
   Builder* BVH4HairBuilder_ (BVH4Hair* accel, Scene* scene) {
     return new BVH4HairBuilder(accel,scene);
   }
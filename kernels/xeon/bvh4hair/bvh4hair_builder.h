@@ -17,9 +17,17 @@
 #pragma once
 
 #include "geometry/primitive.h"
+#include "sys/taskscheduler.h"
 
 namespace embree
 {
+  /* BVH4Hair builder. The builder is multi-threaded: very large
+   * ranges of curves at the top of the tree are binned and
+   * partitioned by all threads (ParallelSplitTask), large ranges are
+   * split into a node by a single thread (SplitTask) that creates
+   * tasks for its children, and small ranges are finished in a single
+   * thread (BuildTask). Tasks work on disjoint ranges of the curve
+   * array. */
   class BVH4HairBuilder : public Builder
   {
     ALIGNED_CLASS;
@@ -27,6 +35,7 @@ namespace embree
 
     /*! Type shortcuts */
     typedef BVH4Hair::NodeRef NodeRef;
+    typedef BVH4Hair::Node Node;
     typedef BVH4Hair::AlignedNode AlignedNode;
     typedef BVH4Hair::UnalignedNode UnalignedNode;
     typedef BVH4Hair::Bezier1 Bezier1;
@@ -89,6 +98,27 @@ namespace embree
       /*! number of bins */
       static const size_t BINS = 16;
 
+      /*! Bins of the object binning, the binning of disjoint ranges of curves can get merged. */
+      struct Binner
+      {
+        /*! clears all bins */
+        void clear();
+
+        /*! bins a range of curves */
+        void bin(const Bezier1* curves, size_t begin, size_t end, const LinearSpace3fa& space, const ssef& ofs, const ssef& scale);
+
+        /*! merges the bins of some other binner */
+        void merge(const Binner& other);
+
+        /*! finds the best split, the split also gets the bounds and area sums of both sides */
+        ObjectSplit best(const LinearSpace3fa& space, const ssef& ofs, const ssef& scale, size_t N) const;
+
+      public:
+        BBox3fa bounds[BINS][4];  //!< bounds of the curves of each bin and dimension
+        ssef    areas [BINS];     //!< sum of the half areas of the curves of each bin and dimension
+        ssei    counts[BINS];     //!< number of curves of each bin and dimension
+      };
+
     public:
 
       /*! default constructor */
@@ -170,15 +200,157 @@ namespace embree
 
     size_t split(size_t begin, size_t end, const NAABBox3fa& bounds, NAABBox3fa& lbounds, NAABBox3fa& rbounds, bool& isAligned);
 
+    /*! splits a range of curves into the children of a node, returns the number of children */
+    size_t splitNode(size_t begin, size_t end, const NAABBox3fa& bounds, size_t* cbegin, size_t* cend, NAABBox3fa* cbounds, bool& isAligned);
+
+    /*! allocates an aligned or unaligned node for the children */
+    NodeRef createNode(size_t threadIndex, size_t numChildren, const NAABBox3fa* cbounds, bool isAligned);
+
     /*! recursive build function for aligned and non-aligned bounds */
     NodeRef recurse(size_t threadIndex, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds);
 
+    /*! build job */
+    TASK_COMPLETE_FUNCTION_(BVH4HairBuilder,buildFunction);
+    void buildFunction(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+    /*! Selects between full build, single-threaded split, and parallel split strategy. */
+    void recurseTask(size_t threadIndex, TaskScheduler::Event* event, NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds);
+
+    /*! Single-threaded task that builds a complete subtree. */
+    class BuildTask 
+    {
+      ALIGNED_CLASS;
+    public:
+      BuildTask (size_t threadIndex, TaskScheduler::Event* event, BVH4HairBuilder* parent, 
+                 NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds);
+
+      /*! Task entry function. */
+      TASK_COMPLETE_FUNCTION_(BuildTask,run);
+      void run(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+    private:
+      TaskScheduler::Task task;
+      BVH4HairBuilder* parent;   //!< Pointer to parent task.
+      NodeRef& dst;              //!< Reference to output the node.
+      size_t depth;              //!< Recursion depth of the root of this subtree.
+      size_t begin, end;         //!< Range of curves of this subtree.
+      NAABBox3fa bounds;         //!< Bounds of the curves.
+    };
+
+    /*! Single-threaded task that builds a single node and creates subtasks for the children. */
+    class SplitTask 
+    {
+      ALIGNED_CLASS;
+    public:
+      SplitTask (size_t threadIndex, TaskScheduler::Event* event, BVH4HairBuilder* parent, 
+                 NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds);
+
+      /*! Task entry function. */
+      TASK_COMPLETE_FUNCTION_(SplitTask,recurse);
+      void recurse(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+    private:
+      TaskScheduler::Task task;
+      BVH4HairBuilder* parent;   //!< Pointer to parent task.
+      NodeRef& dst;              //!< Reference to output the node.
+      size_t depth;              //!< Recursion depth of this node.
+      size_t begin, end;         //!< Range of curves of this node.
+      NAABBox3fa bounds;         //!< Bounds of the curves.
+    };
+
+    /*! Multi-threaded task that splits a large range of curves into
+     *  the children of a node. Children that are still large get
+     *  binned in the aligned space and the space of the child, and
+     *  partitioned by all threads, smaller children get split by a
+     *  single thread. Strand splits are not considered for large
+     *  children. */
+    class ParallelSplitTask 
+    {
+      ALIGNED_CLASS;
+
+      /*! number of tasks the curves of a child get distributed to */
+      static const size_t numTasks = 32;
+
+    public:
+      ParallelSplitTask (size_t threadIndex, TaskScheduler::Event* event, BVH4HairBuilder* parent, 
+                         NodeRef& dst, size_t depth, size_t begin, size_t end, const NAABBox3fa& bounds);
+
+      /*! Starts the parallel split of the selected child. */
+      void splitParallel(size_t threadIndex, TaskScheduler::Event* event);
+
+      /*! Splits the next child, creates the node when no child is left to split. */
+      void next(size_t threadIndex, TaskScheduler::Event* event);
+
+      /*! Parallel calculation of the centroid bounds of the child to split. */
+      TASK_RUN_FUNCTION_(ParallelSplitTask,task_bound_parallel);
+      void task_bound_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event);
+
+      /*! Reduces the centroid bounds and starts the parallel binning. */
+      TASK_COMPLETE_FUNCTION_(ParallelSplitTask,task_bound_reduce);
+      void task_bound_reduce(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+      /*! Parallel binning of the child to split. */
+      TASK_RUN_FUNCTION_(ParallelSplitTask,task_bin_parallel);
+      void task_bin_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event);
+
+      /*! Reduces the bins, selects the best split, and starts the parallel partitioning. */
+      TASK_COMPLETE_FUNCTION_(ParallelSplitTask,task_bin_reduce);
+      void task_bin_reduce(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+      /*! Parallel partitioning of the curves into the temporary curve array. */
+      TASK_RUN_FUNCTION_(ParallelSplitTask,task_partition_parallel);
+      void task_partition_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event);
+
+      /*! Starts the parallel copy once the curves are partitioned. */
+      TASK_COMPLETE_FUNCTION_(ParallelSplitTask,task_partition_done);
+      void task_partition_done(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+      /*! Parallel copy of the partitioned curves back into the curve array. */
+      TASK_RUN_FUNCTION_(ParallelSplitTask,task_copy_parallel);
+      void task_copy_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event);
+
+      /*! Stores the two new children and continues with the next split. */
+      TASK_COMPLETE_FUNCTION_(ParallelSplitTask,task_split_done);
+      void task_split_done(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event);
+
+    private:
+
+      /*! range of curves of the kth task of the child to split */
+      __forceinline size_t taskBegin(size_t k) const { return cbegin[bestChild] + k*(cend[bestChild]-cbegin[bestChild])/numTasks; }
+
+    private:
+      TaskScheduler::Task task;
+      BVH4HairBuilder* parent;   //!< Pointer to parent task.
+      NodeRef& dst;              //!< Reference to output the node.
+      size_t depth;              //!< Recursion depth of this node.
+
+      size_t cbegin [BVH4Hair::N];   //!< Range of curves of each child.
+      size_t cend   [BVH4Hair::N];  
+      NAABBox3fa cbounds[BVH4Hair::N]; //!< Bounds of the curves of each child.
+      size_t numChildren;            //!< Current number of children.
+      ssize_t bestChild;             //!< Child that gets split.
+      bool isAligned;                //!< True if all children have aligned bounds.
+
+      LinearSpace3fa space[2];                 //!< aligned space and space of the child to split
+      BBox3fa centBounds[numTasks][2];         //!< centroid bounds calculated by each task in both spaces
+      ssef ofs[2], scale[2];                   //!< binning functions of both spaces
+      ObjectSplit::Binner binners[numTasks][2]; //!< bins of each task in both spaces
+      ObjectSplit split;                       //!< selected split
+      size_t splitSpace;                       //!< space of the selected split
+      size_t loffset[numTasks];                //!< where each task stores its left curves
+      size_t roffset[numTasks];                //!< where each task stores its right curves
+    };
+
   public:
     Scene* scene;          //!< source
     size_t minLeafSize;    //!< minimal size of a leaf
     size_t maxLeafSize;    //!< maximal size of a leaf
-    size_t numGeneratedPrims;
+    AtomicCounter numGeneratedPrims;
     BVH4Hair* bvh;         //!< output
     vector_t<Bezier1> curves; //!< array with all curves
+    vector_t<Bezier1> tmp;    //!< temporary curve array for parallel partitioning
+
+    /*! ranges of at least this many curves are split in parallel */
+    static const size_t parallelThreshold = 256*1024;
   };
 }
@@ -62,7 +62,12 @@ namespace embree
 #endif
     }
 
-    __forceinline void BVH4HairIntersector1::intersectBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene)
+    __forceinline bool BVH4HairIntersector1::isRound(const Scene* scene, const unsigned int geomID) {
+      return ((const BezierCurves*)scene->get(geomID))->type == RTC_CURVE_ROUND;
+    }
+
+    template<typename Filter>
+    __forceinline void BVH4HairIntersector1::intersectBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene, const Filter& filter)
     {
       /* load bezier curve control points */
       STAT3(normal.trav_prims,1,1,1);
@@ -126,9 +131,9 @@ namespace embree
       const avx4f w = -p0;
       const avxf d0 = w.x*v.x + w.y*v.y;
       const avxf d1 = v.x*v.x + v.y*v.y;
-      const avxf u = clamp(d0*rcp(d1),avxf(zero),avxf(one));
+      avxf u = clamp(d0*rcp(d1),avxf(zero),avxf(one));
       const avx4f p = p0 + u*v;
-      const avxf t = p.z;
+      avxf t = p.z;
       const avxf d2 = p.x*p.x + p.y*p.y; 
       const avxf r = p.w; //max(p.w,ray.org.w+ray.dir.w*t);
       const avxf r2 = r*r;
@@ -136,6 +141,12 @@ namespace embree
 
 #endif
 
+      /* round curves are intersected with a tube around each candidate segment */
+      if (none(valid)) return;
+      const bool round = isRound(scene,bezier.geomID);
+      if (unlikely(round)) 
+        Bezier1iHits::intersectTubes(BezierCurve3D(v0,v1,v2,v3,0.0f,1.0f,0),3,ray.org,ray.dir,ray.tnear,ray.tfar,valid,u,t);
+
     retry:
       if (unlikely(none(valid))) return;
       const float one_over_8 = 1.0f/8.0f;
@@ -145,7 +156,7 @@ namespace embree
 #if defined(__INTERSECTION_FILTER__)
       int geomID = bezier.geomID;
       const Geometry* geometry = scene->get(geomID);
-      if (!likely(geometry->hasIntersectionFilter1())) 
+      if (!likely(filter.hasIntersectionFilter(geometry))) 
       {
 #endif
         /* update hit information */
@@ -157,7 +168,7 @@ namespace embree
         ray.u = uu;
         ray.v = 0.0f;
         ray.tfar = t[i];
-        ray.Ng = T;
+        ray.Ng = likely(!round) ? T : Bezier1iHits::tubeNormal(ray.org,ray.dir,t[i],P,T);
         ray.geomID = bezier.geomID;
         ray.primID = bezier.primID;
 #if defined(__INTERSECTION_FILTER__)
@@ -169,8 +180,10 @@ namespace embree
         const float uu = (float(i)+u[i])*one_over_8;
         BezierCurve3D curve3D(v0,v1,v2,v3,0.0f,1.0f,0);
         Vec3fa P,T; curve3D.eval(uu,P,T);
-        if (T != Vec3fa(zero))
-            if (runIntersectionFilter1(geometry,ray,uu,0.0f,t[i],T,geomID,bezier.primID)) return;
+        if (T != Vec3fa(zero)) {
+          const Vec3fa Ng = likely(!round) ? T : Bezier1iHits::tubeNormal(ray.org,ray.dir,t[i],P,T);
+          if (filter.intersectionFilter(geometry,ray,uu,0.0f,t[i],Ng,geomID,bezier.primID)) return;
+        }
         valid[i] = 0;
         if (none(valid)) return;
         i = select_min(valid,t);
@@ -178,7 +191,8 @@ namespace embree
 #endif
     }
 
-    void BVH4HairIntersector1::intersect(const BVH4Hair* bvh, Ray& ray)
+    template<typename Filter>
+    void BVH4HairIntersector1::intersectRay(const BVH4Hair* bvh, Ray& ray, const Filter& filter)
     {
       /*! perform per ray precalculations required by the primitive intersector */
       //const Precalculations pre(ray);
@@ -373,12 +387,13 @@ namespace embree
         /*! this is a leaf node */
         STAT3(normal.trav_leaves,1,1,1);
         size_t num; Bezier1* prim = (Bezier1*) cur.leaf(num);
-        for (size_t i=0; i<num; i++) intersectBezier(pre,ray,prim[i],bvh->scene);
+        for (size_t i=0; i<num; i++) intersectBezier(pre,ray,prim[i],bvh->scene,filter);
       }
       AVX_ZERO_UPPER();
     }
 
-    __forceinline bool BVH4HairIntersector1::occludedBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene)
+    template<typename Filter>
+    __forceinline bool BVH4HairIntersector1::occludedBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene, const Filter& filter)
     {
       /* load bezier curve control points */
       STAT3(shadow.trav_prims,1,1,1);
@@ -403,14 +418,21 @@ namespace embree
       const avx4f w = -p0;
       const avxf d0 = w.x*v.x + w.y*v.y;
       const avxf d1 = v.x*v.x + v.y*v.y;
-      const avxf u = clamp(d0/d1,avxf(zero),avxf(one));
+      avxf u = clamp(d0/d1,avxf(zero),avxf(one));
       const avx4f p = p0 + u*v;
-      const avxf t = p.z;
+      avxf t = p.z;
       const avxf d2 = p.x*p.x + p.y*p.y; 
       const avxf r = p.w; //+ray.org.w+ray.dir.w*t;
       const avxf r2 = r*r;
       avxb valid = d2 <= r2 & avxf(ray.tnear) < t & t < avxf(ray.tfar);
       if (none(valid)) return false;
+
+      /* round curves are intersected with a tube around each candidate segment */
+      const bool round = isRound(scene,bezier.geomID);
+      if (unlikely(round)) {
+        Bezier1iHits::intersectTubes(BezierCurve3D(v0,v1,v2,v3,0.0f,1.0f,0),3,ray.org,ray.dir,ray.tnear,ray.tfar,valid,u,t);
+        if (none(valid)) return false;
+      }
       STAT3(shadow.trav_prim_hits,1,1,1);
 
       /* intersection filter test */
@@ -419,7 +441,7 @@ namespace embree
       size_t i = select_min(valid,t);
       int geomID = bezier.geomID;
       const Geometry* geometry = scene->get(geomID);
-      if (likely(!geometry->hasOcclusionFilter1())) return true;
+      if (likely(!filter.hasOcclusionFilter(geometry))) return true;
       const float one_over_8 = 1.0f/8.0f;
 
       while (true) 
@@ -428,8 +450,10 @@ namespace embree
         const float uu = (float(i)+u[i])*one_over_8;
         BezierCurve3D curve3D(v0,v1,v2,v3,0.0f,1.0f,0);
         Vec3fa P,T; curve3D.eval(uu,P,T);
-        if (T != Vec3fa(zero))
-          if (runOcclusionFilter1(geometry,ray,uu,0.0f,t[i],T,geomID,bezier.primID)) break;
+        if (T != Vec3fa(zero)) {
+          const Vec3fa Ng = likely(!round) ? T : Bezier1iHits::tubeNormal(ray.org,ray.dir,t[i],P,T);
+          if (filter.occlusionFilter(geometry,ray,uu,0.0f,t[i],Ng,geomID,bezier.primID)) break;
+        }
         valid[i] = 0;
         if (none(valid)) return false;
         i = select_min(valid,t);
@@ -438,7 +462,8 @@ namespace embree
       return true;
     }
     
-    void BVH4HairIntersector1::occluded(const BVH4Hair* bvh, Ray& ray) 
+    template<typename Filter>
+    void BVH4HairIntersector1::occludedRay(const BVH4Hair* bvh, Ray& ray, const Filter& filter) 
     {
       /*! perform per ray precalculations required by the primitive intersector */
       //const Precalculations pre(ray);
@@ -600,7 +625,7 @@ namespace embree
         STAT3(normal.trav_leaves,1,1,1);
         size_t num; Bezier1* prim = (Bezier1*) cur.leaf(num);
         for (size_t i=0; i<num; i++) {
-          if (occludedBezier(pre,ray,prim[i],bvh->scene)) {
+          if (occludedBezier(pre,ray,prim[i],bvh->scene,filter)) {
             ray.geomID = 0;
             goto exit;
           }
@@ -610,6 +635,36 @@ namespace embree
       AVX_ZERO_UPPER();
     }
 
+    void BVH4HairIntersector1::intersect(const BVH4Hair* bvh, Ray& ray) {
+      intersectRay(bvh,ray,Filter1());
+    }
+
+    void BVH4HairIntersector1::occluded(const BVH4Hair* bvh, Ray& ray) {
+      occludedRay(bvh,ray,Filter1());
+    }
+
+    template<typename Filter>
+    void BVH4HairIntersector1::intersectLeaf(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter& filter)
+    {
+      for (size_t i=0; i<num; i++) 
+        intersectBezier(ray_space,ray,prims[i],scene,filter);
+    }
+
+    template<typename Filter>
+    bool BVH4HairIntersector1::occludedLeaf(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter& filter)
+    {
+      for (size_t i=0; i<num; i++) 
+        if (occludedBezier(ray_space,ray,prims[i],scene,filter)) 
+          return true;
+      return false;
+    }
+
+    /*! the packet intersectors intersect the leaves with each ray of the packet */
+    template void BVH4HairIntersector1::intersectLeaf<BVH4HairIntersector1::Filter4>(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter4& filter);
+    template bool BVH4HairIntersector1::occludedLeaf <BVH4HairIntersector1::Filter4>(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter4& filter);
+    template void BVH4HairIntersector1::intersectLeaf<BVH4HairIntersector1::Filter8>(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter8& filter);
+    template bool BVH4HairIntersector1::occludedLeaf <BVH4HairIntersector1::Filter8>(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter8& filter);
+
     DEFINE_INTERSECTOR1(BVH4HairIntersector1_,BVH4HairIntersector1);
   }
 }
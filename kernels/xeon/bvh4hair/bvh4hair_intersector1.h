@@ -19,6 +19,7 @@
 #include "bvh4hair.h"
 #include "common/ray.h"
 #include "common/stack_item.h"
+#include "geometry/filter.h"
 
 namespace embree
 {
@@ -92,12 +93,89 @@ namespace embree
 #endif
       };
 
+    public:
+
+      /*! invokes the filter functions of the single ray API */
+      struct Filter1
+      {
+        __forceinline bool hasIntersectionFilter(const Geometry* geometry) const { return geometry->hasIntersectionFilter1(); }
+        __forceinline bool hasOcclusionFilter   (const Geometry* geometry) const { return geometry->hasOcclusionFilter1(); }
+
+        __forceinline bool intersectionFilter(const Geometry* geometry, Ray& ray, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) const {
+          return runIntersectionFilter1(geometry,ray,u,v,t,Ng,geomID,primID);
+        }
+
+        __forceinline bool occlusionFilter(const Geometry* geometry, Ray& ray, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) const {
+          return runOcclusionFilter1(geometry,ray,u,v,t,Ng,geomID,primID);
+        }
+      };
+
+      /*! invokes the filter functions of the packet API for the kth
+       *  ray of a packet whose leaves get intersected as single ray, a
+       *  hit accepted by the filter is also stored into the single ray */
+      struct Filter4
+      {
+        __forceinline Filter4 (Ray4& ray, size_t k) : ray4(ray), k(k) {}
+
+        __forceinline bool hasIntersectionFilter(const Geometry* geometry) const { return geometry->hasIntersectionFilter4(); }
+        __forceinline bool hasOcclusionFilter   (const Geometry* geometry) const { return geometry->hasOcclusionFilter4(); }
+
+        __forceinline bool intersectionFilter(const Geometry* geometry, Ray& ray, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) const 
+        {
+          if (!runIntersectionFilter4(geometry,ray4,k,u,v,t,Ng,geomID,primID)) return false;
+          ray.u = u; ray.v = v; ray.tfar = t; ray.Ng = Ng; ray.geomID = geomID; ray.primID = primID;
+          return true;
+        }
+
+        __forceinline bool occlusionFilter(const Geometry* geometry, Ray& ray, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) const {
+          return runOcclusionFilter4(geometry,ray4,k,u,v,t,Ng,geomID,primID);
+        }
+
+        Ray4& ray4;
+        size_t k;
+      };
+
+      /*! invokes the filter functions of the packet API for the kth
+       *  ray of a packet of 8 rays */
+      struct Filter8
+      {
+        __forceinline Filter8 (Ray8& ray, size_t k) : ray8(ray), k(k) {}
+
+        __forceinline bool hasIntersectionFilter(const Geometry* geometry) const { return geometry->hasIntersectionFilter8(); }
+        __forceinline bool hasOcclusionFilter   (const Geometry* geometry) const { return geometry->hasOcclusionFilter8(); }
+
+        __forceinline bool intersectionFilter(const Geometry* geometry, Ray& ray, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) const 
+        {
+          if (!runIntersectionFilter8(geometry,ray8,k,u,v,t,Ng,geomID,primID)) return false;
+          ray.u = u; ray.v = v; ray.tfar = t; ray.Ng = Ng; ray.geomID = geomID; ray.primID = primID;
+          return true;
+        }
+
+        __forceinline bool occlusionFilter(const Geometry* geometry, Ray& ray, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) const {
+          return runOcclusionFilter8(geometry,ray8,k,u,v,t,Ng,geomID,primID);
+        }
+
+        Ray8& ray8;
+        size_t k;
+      };
+
     private:
+      /*! tests if the curves of a geometry get intersected as round tubes instead of ribbons */
+      static bool isRound(const Scene* scene, const unsigned int geomID);
+
       static size_t intersectBox(const AffineSpaceSOA4& naabb, const simd3f& org, const simd3f& dir, simdf& tNear, simdf& tFar);
-      static void intersectBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene);
-      static bool occludedBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene);
+      template<typename Filter> static void intersectBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene, const Filter& filter);
+      template<typename Filter> static bool occludedBezier(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1& bezier, const Scene* scene, const Filter& filter);
       
     public:
+      /*! traverses a single ray, the filter functions are invoked through the filter */
+      template<typename Filter> static void intersectRay(const BVH4Hair* This, Ray& ray, const Filter& filter);
+      template<typename Filter> static void occludedRay (const BVH4Hair* This, Ray& ray, const Filter& filter);
+
+      /*! intersects a single ray with the curves of a leaf, ray_space is the ray space of the ray */
+      template<typename Filter> static void intersectLeaf(const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter& filter);
+      template<typename Filter> static bool occludedLeaf (const LinearSpace3fa& ray_space, Ray& ray, const Bezier1* prims, size_t num, const Scene* scene, const Filter& filter);
+
       static void intersect(const BVH4Hair* This, Ray& ray);
       static void occluded (const BVH4Hair* This, Ray& ray);
     };
@@ -0,0 +1,29 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4hair_intersector_chunk.h"
+#include "common/ray8.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! BVH4Hair traversal of packets of 8 rays. */
+    class BVH4HairIntersector8 : public BVH4HairIntersectorChunk<Ray8,avxb,avxf,BVH4HairIntersector1::Filter8> {};
+  }
+}
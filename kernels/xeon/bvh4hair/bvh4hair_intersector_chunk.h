@@ -0,0 +1,319 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4hair_intersector1.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! BVH4Hair packet traversal implementation. The active rays of
+     *  the packet traverse the aligned and unaligned nodes together,
+     *  at the leaves each active ray intersects the curves with the
+     *  single ray curve intersector. The packet filter functions are
+     *  invoked for each ray. */
+    template<typename RayN, typename simdbN, typename simdfN, typename FilterN>
+      class BVH4HairIntersectorChunk
+    {
+      /* shortcuts for frequently used types */
+      typedef Vec3<simdfN> simd3fN;
+      typedef BVH4Hair::NodeRef NodeRef;
+      typedef BVH4Hair::AlignedNode AlignedNode;
+      typedef BVH4Hair::UnalignedNode UnalignedNode;
+      typedef BVH4Hair::AffineSpaceSOA4 AffineSpaceSOA4;
+      typedef BVH4Hair::Bezier1 Bezier1;
+
+      static const size_t K = simdfN::size;
+      static const size_t stackSize = BVH4Hair::N*BVH4Hair::maxDepth+1;
+
+    private:
+
+      /*! intersects the packet with the ith child of a node */
+      static __forceinline simdbN intersectChild(const NodeRef& cur, size_t i, const simd3fN& org, const simd3fN& dir, const simd3fN& rdir,
+                                                 const simdfN& ray_tnear, const simdfN& ray_tfar, simdfN& tNear)
+      {
+        simd3fN tLower, tUpper;
+        if (likely(cur.isAlignedNode()))
+        {
+          const AlignedNode* node = cur.alignedNode();
+          tLower.x = (simdfN(node->lower_x[i]) - org.x) * rdir.x;
+          tLower.y = (simdfN(node->lower_y[i]) - org.y) * rdir.y;
+          tLower.z = (simdfN(node->lower_z[i]) - org.z) * rdir.z;
+          tUpper.x = (simdfN(node->upper_x[i]) - org.x) * rdir.x;
+          tUpper.y = (simdfN(node->upper_y[i]) - org.y) * rdir.y;
+          tUpper.z = (simdfN(node->upper_z[i]) - org.z) * rdir.z;
+        }
+        else
+        {
+          /* transform the rays into the space where the bounds of the child are the unit box */
+          const AffineSpaceSOA4& naabb = cur.unalignedNode()->naabb;
+          const simd3fN vx(simdfN(naabb.l.vx.x[i]),simdfN(naabb.l.vx.y[i]),simdfN(naabb.l.vx.z[i]));
+          const simd3fN vy(simdfN(naabb.l.vy.x[i]),simdfN(naabb.l.vy.y[i]),simdfN(naabb.l.vy.z[i]));
+          const simd3fN vz(simdfN(naabb.l.vz.x[i]),simdfN(naabb.l.vz.y[i]),simdfN(naabb.l.vz.z[i]));
+          const simd3fN p (simdfN(naabb.p   .x[i]),simdfN(naabb.p   .y[i]),simdfN(naabb.p   .z[i]));
+          const simd3fN ldir = dir.x*vx + dir.y*vy + dir.z*vz;
+          const simd3fN lorg = org.x*vx + org.y*vy + org.z*vz + p;
+          const simd3fN lrdir = rcp_safe(ldir);
+          tLower = - lorg * lrdir;   // (Vec3fa(zero) - org) * rdir;
+          tUpper = lrdir + tLower;   // (Vec3fa(one ) - org) * rdir;
+        }
+        tNear     = max(min(tLower.x,tUpper.x),min(tLower.y,tUpper.y),min(tLower.z,tUpper.z));
+        simdfN tFar = min(max(tLower.x,tUpper.x),max(tLower.y,tUpper.y),max(tLower.z,tUpper.z));
+        return max(tNear,ray_tnear) <= min(tFar,ray_tfar);
+      }
+
+    public:
+
+      static void intersect(simdbN* valid_i, const BVH4Hair* bvh, RayN& ray)
+      {
+        /* load ray */
+        const simdbN valid0 = *valid_i;
+        const simd3fN org = ray.org, dir = ray.dir;
+        const simd3fN rdir = rcp_safe(ray.dir);
+        simdfN ray_tnear = select(valid0,ray.tnear,simdfN(pos_inf));
+        simdfN ray_tfar  = select(valid0,ray.tfar ,simdfN(neg_inf));
+        const simdfN inf = simdfN(pos_inf);
+
+        /* create the single rays and their ray spaces for the leaves */
+        Ray rays[K];
+        LinearSpace3fa pre[K];
+        const size_t valid_bits = movemask(valid0);
+        for (size_t bits=valid_bits, k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits)) {
+          const Vec3fa org1(ray.org.x[k],ray.org.y[k],ray.org.z[k]);
+          const Vec3fa dir1(ray.dir.x[k],ray.dir.y[k],ray.dir.z[k]);
+          new (&rays[k]) Ray(org1,dir1,ray.tnear[k],ray.tfar[k],ray.time[k],ray.mask[k]);
+          pre[k] = frame(dir1).transposed(); // FIXME: works only with normalized ray direction
+        }
+
+        /* allocate stack and push root node */
+        simdfN  stack_near[stackSize];
+        NodeRef stack_node[stackSize];
+        stack_node[0] = BVH4Hair::invalidNode;
+        stack_near[0] = inf;
+        stack_node[1] = bvh->root;
+        stack_near[1] = ray_tnear;
+        NodeRef* stackEnd = stack_node+stackSize;
+        NodeRef* __restrict__ sptr_node = stack_node + 2;
+        simdfN*  __restrict__ sptr_near = stack_near + 2;
+
+        while (1)
+        {
+          /* pop next node from stack */
+          assert(sptr_node > stack_node);
+          sptr_node--;
+          sptr_near--;
+          NodeRef curNode = *sptr_node;
+          if (unlikely(curNode == BVH4Hair::invalidNode)) {
+            assert(sptr_node == stack_node);
+            break;
+          }
+
+          /* cull node if behind closest hit point */
+          simdfN curDist = *sptr_near;
+          if (unlikely(none(ray_tfar > curDist)))
+            continue;
+
+          while (1)
+          {
+            /* test if this is a leaf node */
+            if (unlikely(curNode.isLeaf()))
+              break;
+
+            const simdbN valid_node = ray_tfar > curDist;
+            STAT3(normal.trav_nodes,1,popcnt(valid_node),K);
+            const NodeRef node = curNode;
+
+            /* pop of next node */
+            assert(sptr_node > stack_node);
+            sptr_node--;
+            sptr_near--;
+            curNode = *sptr_node;
+            curDist = *sptr_near;
+
+            for (size_t i=0; i<BVH4Hair::N; i++)
+            {
+              const NodeRef child = node.node()->child(i);
+              if (unlikely(child == BVH4Hair::emptyNode)) break;
+              simdfN lnearP; const simdbN lhit = intersectChild(node,i,org,dir,rdir,ray_tnear,ray_tfar,lnearP);
+
+              /* if we hit the child we choose to continue with that child if it
+                 is closer than the current next child, or we push it onto the stack */
+              if (likely(any(lhit)))
+              {
+                assert(sptr_node < stackEnd);
+                const simdfN childDist = select(lhit,lnearP,inf);
+                sptr_node++;
+                sptr_near++;
+
+                /* push cur node onto stack and continue with hit child */
+                if (any(childDist < curDist))
+                {
+                  *(sptr_node-1) = curNode;
+                  *(sptr_near-1) = curDist;
+                  curDist = childDist;
+                  curNode = child;
+                }
+
+                /* push hit child onto stack */
+                else {
+                  *(sptr_node-1) = child;
+                  *(sptr_near-1) = childDist;
+                }
+              }
+            }
+          }
+
+          /* return if stack is empty */
+          if (unlikely(curNode == BVH4Hair::invalidNode)) {
+            assert(sptr_node == stack_node);
+            break;
+          }
+
+          /* intersect leaf with each active ray */
+          const simdbN valid_leaf = ray_tfar > curDist;
+          STAT3(normal.trav_leaves,1,popcnt(valid_leaf),K);
+          size_t num; const Bezier1* prim = (const Bezier1*) curNode.leaf(num);
+          for (size_t bits=movemask(valid_leaf), k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits)) {
+            BVH4HairIntersector1::intersectLeaf(pre[k],rays[k],prim,num,bvh->scene,FilterN(ray,k));
+            ray_tfar[k] = rays[k].tfar;
+          }
+        }
+
+        /* store the hits */
+        for (size_t bits=valid_bits, k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits))
+        {
+          if (rays[k].geomID == -1) continue;
+          ray.u[k] = rays[k].u;
+          ray.v[k] = rays[k].v;
+          ray.tfar[k] = rays[k].tfar;
+          ray.Ng.x[k] = rays[k].Ng.x;
+          ray.Ng.y[k] = rays[k].Ng.y;
+          ray.Ng.z[k] = rays[k].Ng.z;
+          ray.geomID[k] = rays[k].geomID;
+          ray.primID[k] = rays[k].primID;
+        }
+        AVX_ZERO_UPPER();
+      }
+
+      static void occluded(simdbN* valid_i, const BVH4Hair* bvh, RayN& ray)
+      {
+        /* load ray */
+        const simdbN valid0 = *valid_i;
+        const simd3fN org = ray.org, dir = ray.dir;
+        const simd3fN rdir = rcp_safe(ray.dir);
+        simdfN ray_tnear = select(valid0,ray.tnear,simdfN(pos_inf));
+        simdfN ray_tfar  = select(valid0,ray.tfar ,simdfN(neg_inf));
+        const simdfN inf = simdfN(pos_inf);
+        size_t active = movemask(valid0);
+
+        /* create the single rays and their ray spaces for the leaves */
+        Ray rays[K];
+        LinearSpace3fa pre[K];
+        for (size_t bits=active, k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits)) {
+          const Vec3fa org1(ray.org.x[k],ray.org.y[k],ray.org.z[k]);
+          const Vec3fa dir1(ray.dir.x[k],ray.dir.y[k],ray.dir.z[k]);
+          new (&rays[k]) Ray(org1,dir1,ray.tnear[k],ray.tfar[k],ray.time[k],ray.mask[k]);
+          pre[k] = frame(dir1).transposed(); // FIXME: works only for normalized ray.dir
+        }
+
+        /* allocate stack and push root node */
+        simdfN  stack_near[stackSize];
+        NodeRef stack_node[stackSize];
+        stack_node[0] = BVH4Hair::invalidNode;
+        stack_near[0] = inf;
+        stack_node[1] = bvh->root;
+        stack_near[1] = ray_tnear;
+        NodeRef* stackEnd = stack_node+stackSize;
+        NodeRef* __restrict__ sptr_node = stack_node + 2;
+        simdfN*  __restrict__ sptr_near = stack_near + 2;
+
+        while (1)
+        {
+          /* pop next node from stack */
+          assert(sptr_node > stack_node);
+          sptr_node--;
+          sptr_near--;
+          NodeRef curNode = *sptr_node;
+          if (unlikely(curNode == BVH4Hair::invalidNode)) {
+            assert(sptr_node == stack_node);
+            break;
+          }
+
+          /* cull node if behind closest hit point */
+          simdfN curDist = *sptr_near;
+          if (unlikely(none(ray_tfar > curDist)))
+            continue;
+
+          while (1)
+          {
+            /* test if this is a leaf node */
+            if (unlikely(curNode.isLeaf()))
+              break;
+
+            const simdbN valid_node = ray_tfar > curDist;
+            STAT3(shadow.trav_nodes,1,popcnt(valid_node),K);
+            const NodeRef node = curNode;
+
+            /* pop of next node */
+            assert(sptr_node > stack_node);
+            sptr_node--;
+            sptr_near--;
+            curNode = *sptr_node;
+            curDist = *sptr_near;
+
+            for (size_t i=0; i<BVH4Hair::N; i++)
+            {
+              const NodeRef child = node.node()->child(i);
+              if (unlikely(child == BVH4Hair::emptyNode)) break;
+              simdfN lnearP; const simdbN lhit = intersectChild(node,i,org,dir,rdir,ray_tnear,ray_tfar,lnearP);
+
+              /* each hit child becomes the current node */
+              if (likely(any(lhit)))
+              {
+                assert(sptr_node < stackEnd);
+                *sptr_node = curNode; sptr_node++;
+                *sptr_near = curDist; sptr_near++;
+                curDist = select(lhit,lnearP,inf);
+                curNode = child;
+              }
+            }
+          }
+
+          /* return if stack is empty */
+          if (unlikely(curNode == BVH4Hair::invalidNode)) {
+            assert(sptr_node == stack_node);
+            break;
+          }
+
+          /* intersect leaf with each active ray, occluded rays get terminated */
+          const simdbN valid_leaf = ray_tfar > curDist;
+          STAT3(shadow.trav_leaves,1,popcnt(valid_leaf),K);
+          size_t num; const Bezier1* prim = (const Bezier1*) curNode.leaf(num);
+          for (size_t bits=movemask(valid_leaf), k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits)) {
+            if (!BVH4HairIntersector1::occludedLeaf(pre[k],rays[k],prim,num,bvh->scene,FilterN(ray,k))) continue;
+            ray.geomID[k] = 0;
+            ray_tfar[k] = neg_inf;
+            active = __btc(active,k);
+          }
+          if (active == 0) break;
+        }
+        AVX_ZERO_UPPER();
+      }
+    };
+  }
+}
@@ -72,6 +72,7 @@ namespace embree
   DECLARE_BUILDER(BVH4iTriangle1BuilderObjectSplit4Fast);
   DECLARE_BUILDER(BVH4iTriangle1BuilderMorton);
   DECLARE_BUILDER(BVH4iTriangle1BuilderMortonEnhanced);
+  DECLARE_BUILDER(BVH4iTriangle1BuilderPLOC);
   
   Builder* BVH4iBuilderObjectSplit1 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
   Builder* BVH4iBuilderObjectSplit4 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
@@ -90,6 +91,7 @@ namespace embree
     SELECT_SYMBOL_AVX_AVX2(features,BVH4iTriangle1BuilderObjectSplit4Fast);
     SELECT_SYMBOL_AVX     (features,BVH4iTriangle1BuilderMorton);
     SELECT_SYMBOL_AVX     (features,BVH4iTriangle1BuilderMortonEnhanced);
+    SELECT_SYMBOL_AVX     (features,BVH4iTriangle1BuilderPLOC);
 
     SELECT_SYMBOL_DEFAULT_AVX_AVX2(features,BVH4iTriangle1Intersector1Moeller);
     SELECT_SYMBOL_DEFAULT_AVX_AVX2(features,BVH4iTriangle4Intersector1Moeller);
@@ -214,6 +216,7 @@ namespace embree
     else if (g_builder == "objectsplit_fast") builder = BVH4iTriangle1BuilderObjectSplit4Fast(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "morton"          ) builder = BVH4iTriangle1BuilderMorton(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else if (g_builder == "morton.enhanced" ) builder = BVH4iTriangle1BuilderMortonEnhanced(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else if (g_builder == "ploc"            ) builder = BVH4iTriangle1BuilderPLOC(accel,&scene->flat_triangle_source_1,scene,1,inf);
     else throw std::runtime_error("unknown builder "+g_builder+" for BVH4i<Triangle1>");
     
     Accel::Intersectors intersectors = BVH4iTriangle1Intersectors(accel);
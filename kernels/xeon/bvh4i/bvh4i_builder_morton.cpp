@@ -17,6 +17,7 @@
 #include "bvh4i.h"
 #include "bvh4i_builder_morton.h"
 #include "bvh4i_statistics.h"
+#include "bvh4/bvh4_restructure.h"
 #include "bvh4i_builder_util.h"
 
 #define BVH_NODE_PREALLOC_FACTOR 1.1f
@@ -37,7 +38,7 @@ namespace embree
     
     BVH4iBuilderMorton::BVH4iBuilderMorton (BVH4i* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize)
     : bvh(bvh), source(source), scene((Scene*)geometry), topLevelItemThreshold(0), encodeShift(0), encodeMask(0), numBuildRecords(0), 
-      morton(NULL), node(NULL), accel(NULL), numGroups(0), numPrimitives(0), numNodes(0), numAllocatedNodes(0)
+      use64BitCodes(g_morton_bits >= 64), morton(NULL), morton64(NULL), node(NULL), accel(NULL), numGroups(0), numPrimitives(0), numNodes(0), numAllocatedNodes(0)
     {
     }
     
@@ -132,7 +133,8 @@ namespace embree
       if (numPrimitivesOld != numPrimitives)
       {
         /* free previously allocated memory */
-        const size_t old_size_morton = numPrimitivesOld * sizeof(MortonID32Bit) + additional_size;
+        const size_t bytesMortonID = use64BitCodes ? sizeof(MortonID64Bit) : sizeof(MortonID32Bit);
+        const size_t old_size_morton = numPrimitivesOld * bytesMortonID + additional_size;
         const size_t old_size_node  = numAllocatedNodes * sizeof(BVHNode) + additional_size;
         const size_t old_size_accel = numPrimitivesOld * sizeof(Triangle1) + additional_size;
         if (morton) os_free(morton,old_size_morton);
@@ -141,11 +143,12 @@ namespace embree
         
         /* allocated memory for primrefs,nodes, and accel */
         numAllocatedNodes = numPrimitives * BVH_NODE_PREALLOC_FACTOR;
-        const size_t size_morton = numPrimitives * sizeof(MortonID32Bit) + additional_size;
+        const size_t size_morton = numPrimitives * bytesMortonID + additional_size;
         const size_t size_node   = numAllocatedNodes * sizeof(BVHNode) + additional_size;
         const size_t size_accel  = numPrimitives * sizeof(Triangle1) + additional_size;
         
         morton = (MortonID32Bit* ) os_malloc(size_morton); memset(morton,0,size_morton);
+        morton64 = (MortonID64Bit*) morton;
         node   = (BVHNode*)        os_malloc(size_node  ); memset(node  ,0,size_node);
         accel  = (Triangle1*)  os_malloc(size_accel ); memset(accel ,0,size_accel);	
       }
@@ -207,18 +210,60 @@ namespace embree
       global_bounds.extend_atomic(bounds);    
     }
     
-    void BVH4iBuilderMorton::computeMortonCodes(const size_t threadID, const size_t numThreads)
+    void BVH4iBuilderMorton::computeMortonCodes(const size_t threadID, const size_t numThreads, MortonID64Bit* __restrict__ const dest)
     {
       const size_t startID = (threadID+0)*numPrimitives/numThreads;
       const size_t endID   = (threadID+1)*numPrimitives/numThreads;
       
+      /* compute mapping from world space into 3D grid */
+      const ssef base     = (ssef)global_bounds.centroid2.lower;
+      const ssef diagonal = (ssef)global_bounds.centroid2.upper - (ssef)global_bounds.centroid2.lower;
+      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(MortonID64Bit::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      
+      size_t currentID = startID;
+      size_t offset = thread_startGroupOffset[threadID];
+      
+      for (size_t group = thread_startGroup[threadID]; group<numGroups; group++) 
+      {       
+        Geometry* geom = scene->get(group);
+        if (geom == NULL || geom->type != TRIANGLE_MESH) continue;
+        TriangleMesh* mesh = (TriangleMesh*) geom;
+	if (unlikely(!mesh->isEnabled())) continue;
+
+        const size_t numTriangles = min(mesh->numTriangles-offset,endID-currentID);
+        
+        for (size_t i=0; i<numTriangles; i++, currentID++)	  
+        {
+          const BBox3fa b = mesh->bounds(offset+i);
+          const ssef lower = (ssef)b.lower;
+          const ssef upper = (ssef)b.upper;
+          const ssef centroid2 = lower+upper;
+          const ssei binID = ssei((centroid2-base)*scale);
+          dest[currentID].code  = MortonID64Bit::encode(extract<0>(binID),extract<1>(binID),extract<2>(binID));
+          dest[currentID].index = (group << encodeShift) | (offset+i);
+        }
+        offset = 0;
+        if (currentID == endID) break;
+      }
+    }
+    
+    void BVH4iBuilderMorton::computeMortonCodes(const size_t threadID, const size_t numThreads)
+    {
       /* store the morton codes temporarily in 'node' memory */
+      if (use64BitCodes) {
+        computeMortonCodes(threadID,numThreads,(MortonID64Bit*)node);
+        return;
+      }
+      
+      const size_t startID = (threadID+0)*numPrimitives/numThreads;
+      const size_t endID   = (threadID+1)*numPrimitives/numThreads;
+      
       MortonID32Bit* __restrict__ const dest = (MortonID32Bit*)node; 
       
       /* compute mapping from world space into 3D grid */
       const ssef base     = (ssef)global_bounds.centroid2.lower;
       const ssef diagonal = (ssef)global_bounds.centroid2.upper - (ssef)global_bounds.centroid2.lower;
-      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      const ssef scale    = select(diagonal != 0, rcp(diagonal) * ssef(MortonID32Bit::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
       
       size_t currentID = startID;
       size_t offset = thread_startGroupOffset[threadID];
@@ -273,7 +318,8 @@ namespace embree
       }
     }
     
-    void BVH4iBuilderMorton::recreateMortonCodes(SmallBuildRecord& current) const
+    template<typename MortonID>
+    void BVH4iBuilderMorton::recreateMortonCodes(MortonID* __restrict__ const morton, SmallBuildRecord& current) const
     {
       Centroid_Scene_AABB global_bounds;
       global_bounds.reset();
@@ -289,7 +335,7 @@ namespace embree
       /* compute mapping from world space into 3D grid */
       const ssef base     = (ssef)global_bounds.centroid2.lower;
       const ssef diagonal = (ssef)global_bounds.centroid2.upper - (ssef)global_bounds.centroid2.lower;
-      const ssef scale    = select(diagonal != 0,rcp(diagonal) * ssef(LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
+      const ssef scale    = select(diagonal != 0,rcp(diagonal) * ssef(MortonID::LATTICE_SIZE_PER_DIM * 0.99f),ssef(0.0f));
       
       for (size_t i=current.begin; i<current.end; i++)
       {
@@ -304,11 +350,10 @@ namespace embree
         const unsigned int bx = extract<0>(binID);
         const unsigned int by = extract<1>(binID);
         const unsigned int bz = extract<2>(binID);
-        const unsigned int code = bitInterleave(bx,by,bz); //FIXME use SSE/AVX
-        morton[i].code  = code;
+        morton[i].code = MortonID::encode(bx,by,bz); //FIXME use SSE/AVX
       }
       
-      quicksort_insertionsort_ascending<MortonID32Bit,512>(morton,current.begin,current.end-1); 
+      quicksort_insertionsort_ascending<MortonID,512>(morton,current.begin,current.end-1); 
       
 #if defined(DEBUG)
       for (size_t i=current.begin; i<current.end-1; i++)
@@ -319,99 +364,11 @@ namespace embree
     
     void BVH4iBuilderMorton::radixsort(const size_t threadID, const size_t numThreads)
     {
-      const size_t startID = (threadID+0)*numPrimitives/numThreads;
-      const size_t endID   = (threadID+1)*numPrimitives/numThreads;
-      
-      MortonID32Bit* __restrict__ mortonID[2];
-      mortonID[0] = (MortonID32Bit*) morton; 
-      mortonID[1] = (MortonID32Bit*) node;
-      
-      /* we need 3 iterations to process all 32 bits */
-      for (size_t b=0; b<3; b++)
-      {
-        const MortonID32Bit* __restrict src = (MortonID32Bit*) &mortonID[((b+1)%2)][0];
-        MortonID32Bit*       __restrict dst = (MortonID32Bit*) &mortonID[((b+0)%2)][0];
-        
-        /* shift and mask to extract some number of bits */
-        const unsigned int mask = RADIX_BUCKETS_MASK;
-        const unsigned int shift = b * RADIX_BITS;
-        
-        /* count how many items go into the buckets */
-        for (size_t i=0; i<RADIX_BUCKETS; i++)
-          radixCount[threadID][i] = 0;
-        
-        for (size_t i=startID; i<endID; i++) {
-          const size_t index = src[i].get(shift, mask);
-          radixCount[threadID][index]++;
-        }
-        LockStepTaskScheduler::syncThreads(threadID,numThreads);
-        
-        /* calculate total number of items for each bucket */
-        /* 32bit uint allows for better vectorization      */
-        
-        
-#if 0
-        __aligned(64) unsigned int total[RADIX_BUCKETS];
-        for (size_t i=0; i<RADIX_BUCKETS; i++)
-          total[i] = 0;
-        
-        for (size_t i=0; i<numThreads; i++)
-          for (size_t j=0; j<RADIX_BUCKETS; j++)
-            total[j] += radixCount[i][j];
-#else
-        __aligned(64) unsigned int inner_offset[RADIX_BUCKETS];
-        
-#define CHUNK 64
-        
-#pragma unroll(CHUNK)
-        for (size_t i=0; i<RADIX_BUCKETS; i++)
-          inner_offset[i] = 0;
-        
-        for (size_t j=0; j<RADIX_BUCKETS; j+=CHUNK)
-          for (size_t i=0; i<threadID; i++)
-#pragma unroll(CHUNK)
-            for (size_t k=0;k<CHUNK;k++)
-              inner_offset[j+k] += radixCount[i][j+k];
-        
-        __aligned(64) unsigned int total[RADIX_BUCKETS];
-        
-#pragma unroll(CHUNK)      
-        for (size_t i=0; i<RADIX_BUCKETS; i++)
-          total[i] = inner_offset[i];
-        
-        for (size_t j=0; j<RADIX_BUCKETS; j+=CHUNK)
-          for (size_t i=threadID; i<numThreads; i++)
-#pragma unroll(CHUNK)
-            for (size_t k=0;k<CHUNK;k++)
-              total[j+k] += radixCount[i][j+k];
-        
-#endif
-        
-        /* calculate start offset of each bucket */
-        __aligned(64) unsigned int offset[RADIX_BUCKETS];
-        offset[0] = 0;
-        for (size_t i=1; i<RADIX_BUCKETS; i++)    
-          offset[i] = offset[i-1] + total[i-1];
-        
-        /* calculate start offset of each bucket for this thread */
-#if 0
-        for (size_t j=0; j<RADIX_BUCKETS; j++)
-          for (size_t i=0; i<threadID; i++)
-            offset[j] += radixCount[i][j];
-#else
-        
-#pragma unroll(32) 
-        for (size_t j=0; j<RADIX_BUCKETS; j++)
-          offset[j] += inner_offset[j];
-#endif
-        
-        /* copy items into their buckets */
-        for (size_t i=startID; i<endID; i++) {
-          const unsigned int index = src[i].get(shift, mask);
-          dst[offset[index]++] = src[i];
-        }
-        if (b < 2) LockStepTaskScheduler::syncThreads(threadID,numThreads);
-      }
+      /* the morton codes are stored in 'node' memory and get sorted into the morton array */
+      if (use64BitCodes)
+        radixSortMortonCodes((MortonID64Bit*)node,morton64,numPrimitives,radixCount,threadID,numThreads);
+      else
+        radixSortMortonCodes((MortonID32Bit*)node,morton,numPrimitives,radixCount,threadID,numThreads);
     }
     
     void BVH4iBuilderMorton::recurseSubMortonTrees(const size_t threadID, const size_t numThreads)
@@ -466,6 +423,23 @@ namespace embree
         convertToSOALayoutBlock4(bptr);
     }
     
+    void BVH4iBuilderMorton::restructureSubMortonTrees(const size_t threadID, const size_t numThreads)
+    {
+      BVH4i::Node* qbvh = (BVH4i::Node*) bvh->qbvh;
+      while (true)
+      {
+        const unsigned int taskID = LockStepTaskScheduler::taskCounter.inc();
+        if (taskID >= numBuildRecords) break;
+        
+        /* the reference to the sub-tree is stored in the node converted from the block of its parent entry */
+        const SmallBuildRecord& current = buildRecords[taskID];
+        BVH4i::NodeRef& ref = qbvh[current.parentID/BVH4i::N].child(current.parentID%BVH4i::N);
+        for (size_t i=0; i<g_restructure_passes; i++)
+          BVH4iRestructure::restructure(bvh,ref,current.depth);
+        ref.setBarrier();
+      }
+    }
+    
     // =======================================================================================================
     // =======================================================================================================
     // =======================================================================================================
@@ -479,7 +453,7 @@ namespace embree
       
       for (size_t i=0; i<items; i++) 
       {	
-        const size_t index = morton[start+i].index;
+        const size_t index = mortonIndex(start+i);
         const size_t primID = index & encodeMask; 
         const size_t geomID = index >> encodeShift; 
         const TriangleMesh* __restrict__ const mesh = scene->getTriangleMesh(geomID);
@@ -559,48 +533,39 @@ namespace embree
       return bounds;
     }  
     
-    __forceinline bool BVH4iBuilderMorton::split(SmallBuildRecord& current,
+    template<typename MortonID>
+    __forceinline void BVH4iBuilderMorton::split(MortonID* __restrict__ const morton,
+                                                 SmallBuildRecord& current,
                                                  SmallBuildRecord& left,
                                                  SmallBuildRecord& right) const
     {
-      /* mark as leaf if leaf threshold reached */
-      if (unlikely(current.size() <= BVH4iBuilderMorton::MORTON_LEAF_THRESHOLD)) {
-        //current.createLeaf();
-        return false;
-      }
-      
-      const unsigned int code_start = morton[current.begin].code;
-      const unsigned int code_end   = morton[current.end-1].code;
-      unsigned int bitpos = clz(code_start^code_end);
+      int bitpos = MortonID::highestDifferentBit(morton[current.begin].code,morton[current.end-1].code);
       
       /* if all items mapped to same morton code, then create new morton codes for the items */
-      if (unlikely(bitpos == 32)) 
+      if (unlikely(bitpos < 0)) 
       {
-        recreateMortonCodes(current);
-        const unsigned int code_start = morton[current.begin].code;
-        const unsigned int code_end   = morton[current.end-1].code;
-        bitpos = clz(code_start^code_end);
+        recreateMortonCodes(morton,current);
+        bitpos = MortonID::highestDifferentBit(morton[current.begin].code,morton[current.end-1].code);
         
         /* if the morton code is still the same, goto fall back split */
-        if (unlikely(bitpos == 32)) 
+        if (unlikely(bitpos < 0)) 
         {
           size_t center = (current.begin + current.end)/2; 
           left.init(current.begin,center);
           right.init(center,current.end);
-          return true;
+          return;
         }
       }
       
       /* split the items at the topmost different morton code bit */
-      const unsigned int bitpos_diff = 31-bitpos;
-      const unsigned int bitmask = 1 << bitpos_diff;
+      const typename MortonID::CodeTy bitmask = typename MortonID::CodeTy(1) << bitpos;
       
       /* find location where bit differs using binary search */
       size_t begin = current.begin;
       size_t end   = current.end;
       while (begin + 1 != end) {
         const size_t mid = (begin+end)/2;
-        const unsigned bit = morton[mid].code & bitmask;
+        const typename MortonID::CodeTy bit = morton[mid].code & bitmask;
         if (bit == 0) begin = mid; else end = mid;
       }
       size_t center = end;
@@ -611,6 +576,20 @@ namespace embree
       
       left.init(current.begin,center);
       right.init(center,current.end);
+    }
+    
+    __forceinline bool BVH4iBuilderMorton::split(SmallBuildRecord& current,
+                                                 SmallBuildRecord& left,
+                                                 SmallBuildRecord& right) const
+    {
+      /* mark as leaf if leaf threshold reached */
+      if (unlikely(current.size() <= BVH4iBuilderMorton::MORTON_LEAF_THRESHOLD)) {
+        //current.createLeaf();
+        return false;
+      }
+      
+      if (use64BitCodes) split(morton64,current,left,right);
+      else               split(morton,current,left,right);
       return true;
     }
     
@@ -770,7 +749,7 @@ namespace embree
       entry.upper.a = e1;
     }
     
-    void BVH4iBuilderMorton::build_main (const size_t threadIndex, const size_t threadCount)
+    void BVH4iBuilderMorton::sortMortonCodes (const size_t threadIndex, const size_t threadCount)
     { 
       /* compute scene bounds */
       global_bounds.reset();
@@ -780,10 +759,16 @@ namespace embree
       LockStepTaskScheduler::dispatchTask( task_computeMortonCodes, this, threadIndex, threadCount );   
       
       /* padding */
-      MortonID32Bit* __restrict__ const dest = (MortonID32Bit*)node;
       for (size_t i=numPrimitives; i<( (numPrimitives+7)&(-8) ); i++) {
-        dest[i].code  = 0xffffffff; 
-        dest[i].index = 0;
+        if (use64BitCodes) {
+          MortonID64Bit* __restrict__ const dest = (MortonID64Bit*)node;
+          dest[i].code  = (uint64)-1; 
+          dest[i].index = 0;
+        } else {
+          MortonID32Bit* __restrict__ const dest = (MortonID32Bit*)node;
+          dest[i].code  = 0xffffffff; 
+          dest[i].index = 0;
+        }
       }
       
       /* sort morton codes */
@@ -791,8 +776,14 @@ namespace embree
       
 #if defined(DEBUG)
       for (size_t i=1; i<numPrimitives; i++)
-        assert(morton[i-1].code <= morton[i].code);
+        assert(use64BitCodes ? morton64[i-1].code <= morton64[i].code : morton[i-1].code <= morton[i].code);
 #endif	    
+    }
+    
+    void BVH4iBuilderMorton::build_main (const size_t threadIndex, const size_t threadCount)
+    { 
+      /* compute sorted morton codes */
+      sortMortonCodes(threadIndex,threadCount);
       
       /* build and extract top-level tree */
       numBuildRecords = 0;
@@ -848,6 +839,16 @@ namespace embree
       bvh->qbvh  = node;
       LockStepTaskScheduler::dispatchTask( task_convertToSOALayout, this, threadIndex, threadCount );
       
+      /* optimize the SAH of small treelets, first of all sub-trees in parallel then of the toplevel part of the tree */
+      if (g_restructure_passes)
+      {
+        BVH4i::NodeRef& root = ((BVH4i::Node*)bvh->qbvh)[0].child(0);
+        LockStepTaskScheduler::dispatchTask( task_restructureSubMortonTrees, this, threadIndex, threadCount );
+        for (size_t i=0; i<g_restructure_passes; i++)
+          BVH4iRestructure::restructure(bvh,root);
+        bvh->clearBarrier(root);
+      }
+      
       /* set root and bounding box */
       const QBVHNode* const qbvh  = (QBVHNode*)bvh->qbvh;
       bvh->root = qbvh[0].min_d[0]; 
@@ -18,6 +18,7 @@
 
 #include "bvh4i.h"
 #include "bvh4i_builder_util.h"
+#include "../builders/morton.h"
 
 namespace embree
 {
@@ -26,14 +27,13 @@ namespace embree
     class BVH4iBuilderMorton : public Builder
     {
       ALIGNED_CLASS;
+    protected:
       
       enum { RECURSE = 1, CREATE_TOP_LEVEL = 2 };
       
       static const size_t MAX_TOP_LEVEL_BINS = 1024;
       static const size_t NODE_BLOCK_SIZE = 64;
       static const size_t MORTON_LEAF_THRESHOLD = 4;
-      static const size_t LATTICE_BITS_PER_DIM = 10;
-      static const size_t LATTICE_SIZE_PER_DIM = size_t(1) << LATTICE_BITS_PER_DIM;
       typedef AtomicIDBlock<NODE_BLOCK_SIZE> NodeAllocator;
       
     public:
@@ -62,28 +62,6 @@ namespace embree
         __forceinline bool operator>(const SmallBuildRecord& br) const { return size() > br.size(); } 
       };
       
-      struct __aligned(8) MortonID32Bit
-      {
-        unsigned int code;
-        unsigned int index;
-        
-        __forceinline unsigned int get(const unsigned int shift, const unsigned and_mask) const {
-          return (code >> shift) & and_mask;
-        }
-        
-        __forceinline void operator=(const MortonID32Bit& v) {   
-          *(long*)this = *(long*)&v; 
-        };  
-        
-        __forceinline friend std::ostream &operator<<(std::ostream &o, const MortonID32Bit& mc) {
-          o << "index " << mc.index << " code = " << mc.code;
-          return o;
-        }
-        
-        __forceinline bool operator<(const MortonID32Bit &m) const { return code < m.code; } 
-        __forceinline bool operator>(const MortonID32Bit &m) const { return code > m.code; } 
-      };
-      
       /*! Constructor. */
       BVH4iBuilderMorton (BVH4i* bvh, BuildSource* source, void* geometry, const size_t minLeafSize = 1, const size_t maxLeafSize = inf);
       
@@ -114,10 +92,16 @@ namespace embree
       
       /*! task that converts the BVH layout to SOA */
       TASK_FUNCTION(BVH4iBuilderMorton,convertToSOALayout);
+
+      /*! task that optimizes the SAH of small treelets of the sub-trees */
+      TASK_FUNCTION(BVH4iBuilderMorton,restructureSubMortonTrees);
       
     public:
       
       void build_main(const size_t threadID, const size_t numThreads);
+
+      /*! computes the scene bounds and the sorted morton codes of all primitives */
+      void sortMortonCodes(const size_t threadID, const size_t numThreads);
       
       /*! creates a leaf node */
       BBox3fa createSmallLeaf(SmallBuildRecord& current, NodeAllocator& alloc) const;
@@ -129,6 +113,10 @@ namespace embree
       
       /*! split a build record into two */
       bool split(SmallBuildRecord& current, SmallBuildRecord& left, SmallBuildRecord& right) const;
+
+      /*! split a build record at the highest bit the morton codes differ in */
+      template<typename MortonID>
+        void split(MortonID* __restrict__ const morton, SmallBuildRecord& current, SmallBuildRecord& left, SmallBuildRecord& right) const;
       
       /*! main recursive build function */
       BBox3fa recurse(SmallBuildRecord& current, 
@@ -143,7 +131,16 @@ namespace embree
       void refit(const size_t index) const;
       
       /*! recreates morton codes when reaching a region where all codes are identical */
-      void recreateMortonCodes(SmallBuildRecord& current) const;
+      template<typename MortonID>
+        void recreateMortonCodes(MortonID* __restrict__ const morton, SmallBuildRecord& current) const;
+
+      /*! calculates the 64 bit morton codes of the primitives of some thread */
+      void computeMortonCodes(const size_t threadID, const size_t numThreads, MortonID64Bit* __restrict__ const dest);
+
+      /*! returns the encoded geometry and primitive ID of the i'th sorted primitive */
+      __forceinline size_t mortonIndex(const size_t i) const {
+        return use64BitCodes ? morton64[i].index : morton[i].index;
+      }
       
     public:
       BVH4i* bvh;               //!< Output BVH
@@ -162,13 +159,12 @@ namespace embree
       
       /*! state for radix sort */
     public:
-      static const size_t RADIX_BITS = 11;
-      static const size_t RADIX_BUCKETS = (1 << RADIX_BITS);
-      static const size_t RADIX_BUCKETS_MASK = (RADIX_BUCKETS-1);
-      __aligned(64) unsigned int radixCount[MAX_MIC_THREADS][RADIX_BUCKETS];
+      __aligned(64) MortonRadixCountTy radixCount[MAX_MIC_THREADS];
       
     protected:
-      MortonID32Bit* __restrict__ morton;
+      bool use64BitCodes;                     //!< use morton codes with 21 instead of 10 bits per dimension
+      MortonID32Bit* __restrict__ morton;     //!< 32 bit morton codes
+      MortonID64Bit* __restrict__ morton64;   //!< 64 bit morton codes, aliases the same memory
       BVHNode* __restrict__ node;
       Triangle1* __restrict__ accel;
       
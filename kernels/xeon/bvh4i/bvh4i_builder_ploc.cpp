@@ -0,0 +1,190 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4i.h"
+#include "bvh4i_builder_ploc.h"
+#include "bvh4i_statistics.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    static double dt = 0.0f;
+
+    BVH4iBuilderPLOC::BVH4iBuilderPLOC (BVH4i* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize)
+      : BVH4iBuilderMorton(bvh,source,geometry,minLeafSize,maxLeafSize), numClusterBuildRecords(0) {}
+
+    void BVH4iBuilderPLOC::build(size_t threadIndex, size_t threadCount)
+    {
+      if (g_verbose >= 2)
+        std::cout << "building BVH4i with PLOC builder ... " << std::flush;
+
+      /* do some global inits first */
+      init();
+      clusterBuilder.init(numPrimitives);
+
+      LockStepTaskScheduler::init(TaskScheduler::getNumThreads());
+      TaskScheduler::executeTask(threadIndex,threadCount,_build_parallel_ploc,this,TaskScheduler::getNumThreads(),"build_parallel_ploc");
+
+      if (g_verbose >= 2) {
+        double perf = source->size()/dt*1E-6;
+        std::cout << "[DONE] " << 1000.0f*dt << "ms (" << perf << " Mtris/s)" << std::endl;
+        std::cout << BVH4iStatistics(bvh).str();
+      }
+    }
+
+    void BVH4iBuilderPLOC::createLeafClusters(const size_t threadID, const size_t numThreads) {
+      clusterBuilder.setLeaves(this,threadID,numThreads);
+    }
+
+    void BVH4iBuilderPLOC::mergeClusters(const size_t threadID, const size_t numThreads) {
+      clusterBuilder.build(threadID,numThreads);
+    }
+
+    void BVH4iBuilderPLOC::collapseSubClusterTrees(const size_t threadID, const size_t numThreads)
+    {
+      NodeAllocator alloc(atomicID,numAllocatedNodes);
+      while (true)
+      {
+        const unsigned int taskID = LockStepTaskScheduler::taskCounter.inc();
+        if (taskID >= numClusterBuildRecords) break;
+        collapse(clusterBuildRecords[taskID],alloc,RECURSE,threadID);
+      }
+    }
+
+    void BVH4iBuilderPLOC::collapse(ClusterBuildRecord& current, NodeAllocator& alloc, const size_t mode, const size_t threadID)
+    {
+      const PLOCClusterBuilder::Cluster* __restrict__ const clusters = clusterBuilder.clusters;
+
+      /* stop toplevel recursion at some number of items */
+      if (mode == CREATE_TOP_LEVEL && (current.size() <= topLevelItemThreshold || numClusterBuildRecords >= MAX_TOP_LEVEL_BINS))
+      {
+        assert(numClusterBuildRecords < NUM_TOP_LEVEL_BINS);
+        clusterBuildRecords[numClusterBuildRecords++] = current;
+        return;
+      }
+
+      /* create leaf node, the morton builder splits leaves that are too large because of the depth limit */
+      if (current.size() <= MORTON_LEAF_THRESHOLD || current.depth >= BVH4i::maxBuildDepth) {
+        if (use64BitCodes) clusterBuilder.gatherPrimitives(current.cluster,morton64,current.begin);
+        else               clusterBuilder.gatherPrimitives(current.cluster,morton  ,current.begin);
+        createLeaf(current,alloc);
+        return;
+      }
+
+      /* fill all 4 children by always opening the cluster with the largest surface area */
+      __aligned(64) ClusterBuildRecord children[BVH4i::N];
+      const size_t numChildren = clusterBuilder.open(current,children,BVH4i::N,MORTON_LEAF_THRESHOLD);
+
+      /* allocate next four nodes */
+      const size_t currentIndex = alloc.get(BVH4i::N);
+
+      /* the bounds of the clusters are exact, thus no refit is required */
+      const BBox3fa& bounds = clusters[current.cluster].bounds;
+      node[current.parentID].lower = bounds.lower;
+      node[current.parentID].upper = bounds.upper;
+      node[current.parentID].createNode(currentIndex,numChildren);
+
+      /* init unused nodes */
+      const avxf init_node = load8f((float*)initQBVHNode);
+      for (size_t i=numChildren; i<BVH4i::N; i++)
+        store8f_nt((float*)&node[currentIndex+i],init_node);
+
+      /* recurse into each child */
+      for (size_t i=0; i<numChildren; i++)
+      {
+        children[i].parentID = currentIndex+i;
+        collapse(children[i],alloc,mode,threadID);
+      }
+    }
+
+    void BVH4iBuilderPLOC::build_parallel_ploc(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event)
+    {
+      /* init lock step task scheduler */
+      if (threadIndex == 0)
+        LockStepTaskScheduler::init(TaskScheduler::getNumThreads());
+
+      /* start measurement */
+      double t0 = 0.0f;
+      if (g_verbose >= 2) t0 = getSeconds();
+
+      /* initialize thread state */
+      initThreadState(threadIndex,threadCount);
+
+      /* let all thread except for control thread wait for work */
+      if (threadIndex != 0) {
+        LockStepTaskScheduler::dispatchTaskMainLoop(threadIndex,threadCount);
+        return;
+      }
+
+      /* compute sorted morton codes */
+      sortMortonCodes(threadIndex,taskCount);
+
+      /* cluster the primitives, the last iterations with few clusters left run single threaded */
+      LockStepTaskScheduler::dispatchTask( task_createLeafClusters, this, threadIndex, threadCount );
+      LockStepTaskScheduler::dispatchTask( task_mergeClusters, this, threadIndex, threadCount );
+      clusterBuilder.build(0,1);
+
+      /* collapse the toplevel part of the cluster tree */
+      numClusterBuildRecords = 0;
+      atomicID.reset(BVH4i::N);
+      node[0].lower = global_bounds.geometry.lower;
+      node[0].upper = global_bounds.geometry.upper;
+      topLevelItemThreshold = (numPrimitives + threadCount-1)/(2*threadCount);
+
+      NodeAllocator alloc(atomicID,numAllocatedNodes);
+      if (numPrimitives == 0)
+      {
+        SmallBuildRecord br;
+        br.init(0,0);
+        createLeaf(br,alloc);
+      }
+      else
+      {
+        ClusterBuildRecord br;
+        br.init(0,numPrimitives,clusterBuilder.root());
+        collapse(br,alloc,CREATE_TOP_LEVEL,threadIndex);
+      }
+
+      /* sort all subtasks by size */
+      insertionsort_decending<ClusterBuildRecord>(clusterBuildRecords,numClusterBuildRecords);
+
+      /* collapse sub-trees in parallel */
+      LockStepTaskScheduler::dispatchTask( task_collapseSubClusterTrees, this, threadIndex, threadCount );
+      numNodes = atomicID >> 2;
+
+      /* convert to optimized layout */
+      bvh->accel = accel;
+      bvh->qbvh  = node;
+      LockStepTaskScheduler::dispatchTask( task_convertToSOALayout, this, threadIndex, threadCount );
+
+      /* set root and bounding box */
+      const QBVHNode* const qbvh  = (QBVHNode*)bvh->qbvh;
+      bvh->root = qbvh[0].min_d[0];
+      bvh->bounds = global_bounds.geometry;
+
+      /* end task */
+      LockStepTaskScheduler::releaseThreads(threadCount);
+
+      /* stop measurement */
+      if (g_verbose >= 2) dt = getSeconds()-t0;
+    }
+
+    Builder* BVH4iTriangle1BuilderPLOC (void* bvh, BuildSource* source, Scene* scene, const size_t minLeafSize, const size_t maxLeafSize) {
+      return new BVH4iBuilderPLOC((BVH4i*)bvh,source,scene,minLeafSize,maxLeafSize);
+    }
+  }
+}
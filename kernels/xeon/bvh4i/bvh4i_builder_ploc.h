@@ -0,0 +1,72 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh4i_builder_morton.h"
+#include "../builders/ploc.h"
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! Agglomerative builder that clusters the morton sorted
+     *  primitives bottom-up and collapses the binary cluster tree into
+     *  the node blocks of the morton builder, which get converted into
+     *  the BVH4i layout. */
+    class BVH4iBuilderPLOC : public BVH4iBuilderMorton
+    {
+      ALIGNED_CLASS;
+
+      static const size_t NUM_TOP_LEVEL_BINS = MAX_TOP_LEVEL_BINS + 4*BVH4i::maxBuildDepth;
+
+    public:
+
+      /*! build record of the collapse, the primitives of the cluster get stored in [begin,end) */
+      typedef PLOCClusterBuilder::CollapseBuildRecord<SmallBuildRecord> ClusterBuildRecord;
+
+    public:
+
+      /*! Constructor. */
+      BVH4iBuilderPLOC (BVH4i* bvh, BuildSource* source, void* geometry, const size_t minLeafSize = 1, const size_t maxLeafSize = inf);
+
+      /* build function */
+      void build(size_t threadIndex, size_t threadCount);
+
+      /*! main build task */
+      TASK_RUN_FUNCTION(BVH4iBuilderPLOC,build_parallel_ploc);
+
+      /*! task that creates a cluster for each primitive */
+      TASK_FUNCTION(BVH4iBuilderPLOC,createLeafClusters);
+
+      /*! task that merges the clusters */
+      TASK_FUNCTION(BVH4iBuilderPLOC,mergeClusters);
+
+      /*! task that collapses a list of cluster sub-trees */
+      TASK_FUNCTION(BVH4iBuilderPLOC,collapseSubClusterTrees);
+
+    public:
+
+      /*! collapses the cluster tree into node blocks */
+      void collapse(ClusterBuildRecord& current, NodeAllocator& alloc, const size_t mode, const size_t threadID);
+
+    protected:
+      PLOCClusterBuilder clusterBuilder;
+      size_t numClusterBuildRecords;
+      __aligned(64) ClusterBuildRecord clusterBuildRecords[NUM_TOP_LEVEL_BINS];
+    };
+  }
+}
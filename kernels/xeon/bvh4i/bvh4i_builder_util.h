@@ -110,6 +110,7 @@ namespace embree
     unsigned int flags;
     float sArea;
     size_t parentNode; 
+    unsigned int ext_end;       //!< end of range including free space for duplicated primitives
 
     BuildRecord()
       {
@@ -120,6 +121,7 @@ namespace embree
     {
       begin  = _begin;
       end    = _end;
+      ext_end = _end;
       parentID = (unsigned int)-1;
       sArea = area(bounds.geometry);
       flags = BUILD_RECORD_NODE;
@@ -72,7 +72,8 @@ namespace embree
 
   void BVH4MB::clear() 
   {
-    root = (Base*)Base::empty;
+    roots.clear();
+    roots.push_back((Base*)Base::empty);
     bounds = empty;
     alloc.clear();
   }
@@ -201,26 +202,26 @@ namespace embree
     return 1+reduce_max(cdepth); 
   }
 
-  std::pair<BBox3fa,BBox3fa> BVH4MB::refit(void* geom, Base* node)
+  std::pair<BBox3fa,BBox3fa> BVH4MB::refit(void* geom, Base* node, float t0, float t1)
   {
-    /*! merge bounds of triangles for both time steps */
+    /*! merge bounds of triangles for both times */
     if (node->isLeaf()) 
     {
       size_t num; char* tri = node->leaf(num);
-      return primTy.update2(tri,num,geom);
+      return primTy.update2(tri,num,geom,t0,t1);
     }
-    /*! set and propagate merged bounds for both time steps */
+    /*! set and propagate merged bounds for both times */
     else
     {
       Node* n = node->node();
       if (!n->hasBounds()) {
         for (size_t i=0; i<4; i++) {
-          std::pair<BBox3fa,BBox3fa> bounds = refit(geom,n->child[i]);
-          n->set(i,bounds.first,bounds.second);
+          std::pair<BBox3fa,BBox3fa> bounds = refit(geom,n->child[i],t0,t1);
+          n->set(i,bounds.first,bounds.second,t0,t1);
         }
       }
-      BBox3fa bounds0 = merge(n->bounds0(0),n->bounds0(1),n->bounds0(2),n->bounds0(3));
-      BBox3fa bounds1 = merge(n->bounds1(0),n->bounds1(1),n->bounds1(2),n->bounds1(3));
+      BBox3fa bounds0 = merge(n->bounds(0,t0),n->bounds(1,t0),n->bounds(2,t0),n->bounds(3,t0));
+      BBox3fa bounds1 = merge(n->bounds(0,t1),n->bounds(1,t1),n->bounds(2,t1),n->bounds(3,t1));
       return std::pair<BBox3fa,BBox3fa>(bounds0,bounds1);
     }
   }
@@ -262,7 +263,12 @@ namespace embree
   {
     /* calculate statistics */
     numNodes = numLeaves = numPrimBlocks = numPrims = depth = 0;
-    bvhSAH = statistics(root,0.0f,depth);
+    bvhSAH = 0.0f;
+    for (size_t i=0; i<roots.size(); i++) {
+      size_t rdepth = 0;
+      bvhSAH += statistics(roots[i],0.0f,rdepth);
+      depth = max(depth,rdepth);
+    }
 
     /* output statistics */
     std::ostringstream stream;
@@ -276,6 +282,7 @@ namespace embree
     stream.setf(std::ios::fixed, std::ios::floatfield);
     stream.precision(1);
     stream << "depth = " << depth << std::endl;
+    stream << "time segments = " << roots.size() << std::endl;
     stream << "size = " << bytesTotal/1E6 << " MB" << std::endl;
     stream << "nodes = "  << numNodes << " "
          << "(" << bytesNodes/1E6  << " MB) "
@@ -112,6 +112,10 @@ namespace embree
     /*! Maximal number of triangle blocks in a leaf. */
     static const size_t maxLeafBlocks = Base::maxLeafBlocks;    
 
+    /*! Maximal number of time segments, each time segment gets its own
+     *  tree. The scene rejects motion blur meshes that would require more. */
+    static const size_t maxTimeSegments = RTC_MAX_TIME_STEPS-1;
+
     /*! Cost of one traversal step. */
     static const int travCost = 1;      
    
@@ -154,6 +158,27 @@ namespace embree
         }
       }
 
+      /*! Sets the bounds of the child at the start and end of the
+       *  time range [time0,time1] of the tree. The bounds get stored
+       *  extrapolated to time 0 and time 1 such that the traversal
+       *  interpolates directly with the time of the ray. */
+      __forceinline void set(size_t i, const BBox3fa& bounds0, const BBox3fa& bounds1, float time0, float time1) 
+      {
+        if (unlikely(bounds0.empty())) {
+          set(i,bounds0,bounds1);
+          return;
+        }
+        const float rdt = 1.0f/(time1-time0);
+        const Vec3fa dlower = (bounds1.lower-bounds0.lower)*rdt;
+        const Vec3fa dupper = (bounds1.upper-bounds0.upper)*rdt;
+        const Vec3fa lower = bounds0.lower-time0*dlower;
+        const Vec3fa upper = bounds0.upper-time0*dupper;
+        lower_x[i] = lower.x; lower_y[i] = lower.y; lower_z[i] = lower.z;
+        upper_x[i] = upper.x; upper_y[i] = upper.y; upper_z[i] = upper.z;
+        lower_dx[i] = dlower.x; lower_dy[i] = dlower.y; lower_dz[i] = dlower.z;
+        upper_dx[i] = dupper.x; upper_dy[i] = dupper.y; upper_dz[i] = dupper.z;
+      }
+
       /*! tests if the node has valid bounds */
       __forceinline bool hasBounds() const {
         return lower_dx.i[0] != cast_f2i(float(nan));
@@ -171,6 +196,12 @@ namespace embree
                       Vec3fa(upper_x[i]+upper_dx[i],upper_y[i]+upper_dy[i],upper_z[i]+upper_dz[i]));
       }
 
+      /*! Return bounding box for some time */
+      __forceinline BBox3fa bounds(size_t i, float time) const {
+        return BBox3fa(Vec3fa(lower_x[i]+time*lower_dx[i],lower_y[i]+time*lower_dy[i],lower_z[i]+time*lower_dz[i]),
+                       Vec3fa(upper_x[i]+time*upper_dx[i],upper_y[i]+time*upper_dy[i],upper_z[i]+time*upper_dz[i]));
+      }
+
       /*! Returns bounds of node. */
       __forceinline BBox3fa bounds() const {
         return BBox3fa(Vec3fa(reduce_min(min(lower_x,lower_x+lower_dx)),
@@ -213,7 +244,7 @@ namespace embree
 
     /*! BVH4MB default constructor. */
     BVH4MB (const PrimitiveType& primTy, void* geometry = NULL)
-      : primTy(primTy), geometry(geometry), root((Base*)Base::empty) {}
+      : primTy(primTy), geometry(geometry), roots(1,(Base*)Base::empty) {}
 
     ~BVH4MB () {
       clear();
@@ -233,15 +264,31 @@ namespace embree
     /*! Rotates tree to improve SAH cost. */
     size_t rotate(Base* node, size_t depth);
 
-    /*! Propagate bounds for time t0 and time t1 up the tree. */
-    std::pair<BBox3fa,BBox3fa> refit(void* geom, Base* node);
+    /*! Propagate bounds for time t0 and time t1 up the tree of the time range [t0,t1]. */
+    std::pair<BBox3fa,BBox3fa> refit(void* geom, Base* node, float t0, float t1);
+
+    /*! Returns the number of time segments. */
+    __forceinline size_t numTimeSegments() const { 
+      return roots.size(); 
+    }
+
+    /*! Returns the time segment that contains the specified time. */
+    __forceinline size_t timeSegment(float time) const {
+      const int segment = (int)floorf(time*float(roots.size()));
+      return (size_t) clamp(segment,0,int(roots.size())-1);
+    }
+
+    /*! Returns the root of the tree of the time segment that contains the specified time. */
+    __forceinline Base* root(float time) const {
+      return roots[timeSegment(time)];
+    }
 
     /*! Data of the BVH */
   public:
     AllocatorPerThread alloc;          //!< allocator for nodes and triangles
     const PrimitiveType& primTy;       //!< primitive type stored in the BVH
     void* geometry;                    //!< pointer to geometry for intersection
-    Base* root;                      //!< Root node (can also be a leaf).
+    std::vector<Base*> roots;          //!< Root node of each time segment (can also be a leaf).
 
   private:
     float statistics(Base* node, float area, size_t& depth);
@@ -38,18 +38,26 @@ namespace embree
     double t0 = 0.0, t1 = 0.0f;
     if (g_verbose >= 2 || g_benchmark)
       t0 = getSeconds();
+
+    /* build a separate tree for each time segment */
+    const size_t numSegments = timeSegments();
+    bvh->roots.resize(numSegments,(BVH4MB::Base*)BVH4MB::Base::empty);
+    for (segment=0; segment<numSegments; segment++)
+    {
+      new (&segmentSource) TimeSegmentBuildSource(source,float(segment)/float(numSegments),float(segment+1)/float(numSegments));
     
-    /* first generate primrefs */
-    new (&initStage) PrimRefGenNormal(threadIndex,threadCount,source,&alloc);
+      /* first generate primrefs */
+      new (&initStage) PrimRefGenNormal(threadIndex,threadCount,&segmentSource,&alloc);
     
-    /* now build BVH */
-    TaskScheduler::executeTask(threadIndex,threadCount,_buildFunction,this,"BVH4MBBuilder::build");
+      /* now build BVH */
+      TaskScheduler::executeTask(threadIndex,threadCount,_buildFunction,this,"BVH4MBBuilder::build");
 
-    /* finish build */
-    finish(threadIndex,threadCount,NULL);
+      /* finish build */
+      finish(threadIndex,threadCount,NULL);
 
-    /* free all temporary blocks */
-    Alloc::global.clear();
+      /* free all temporary blocks */
+      Alloc::global.clear();
+    }
 
     if (g_verbose >= 2 || g_benchmark) 
       t1 = getSeconds();
@@ -61,9 +69,26 @@ namespace embree
     }
   }
 
+  template<typename Heuristic>
+  size_t BVH4MBBuilder<Heuristic>::timeSegments() const
+  {
+    /* least common multiple of the time segments of all geometries */
+    size_t numSegments = 1;
+    for (size_t g=0; g<source->groups(); g++) 
+    {
+      if (source->prims(g) == 0) continue;
+      const size_t n = max(source->timeSteps(g),size_t(2))-1;
+      size_t a = numSegments, b = n;
+      while (b) { const size_t r = a%b; a = b; b = r; }
+      numSegments = numSegments/a*n;
+    }
+    assert(numSegments <= BVH4MB::maxTimeSegments);
+    return numSegments;
+  }
+
   template<typename Heuristic>
   BVH4MBBuilder<Heuristic>::BVH4MBBuilder(BVH4MB* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize)
-    : source(source), geometry(geometry), trity(bvh->primTy),
+    : source(source), geometry(geometry), segment(0), trity(bvh->primTy),
       minLeafSize(minLeafSize), maxLeafSize(maxLeafSize),
       taskQueue(Heuristic::depthFirst ? TaskScheduler::GLOBAL_FRONT : TaskScheduler::GLOBAL_BACK),
       bvh(bvh)
@@ -79,13 +104,13 @@ namespace embree
 
   template<typename Heuristic>
   void BVH4MBBuilder<Heuristic>::buildFunction(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-    recurse(threadIndex,threadCount,event,bvh->root,1,initStage.prims,initStage.pinfo,initStage.split);
+    recurse(threadIndex,threadCount,event,bvh->roots[segment],1,initStage.prims,initStage.pinfo,initStage.split);
   }
 
   template<typename Heuristic>
   void BVH4MBBuilder<Heuristic>::finish(size_t threadIndex, size_t threadCount, TaskScheduler::Event* event) {
-    bvh->refit(geometry,bvh->root);
-    bvh->bounds = initStage.pinfo.geomBounds;
+    bvh->refit(geometry,bvh->roots[segment],segmentSource.time0,segmentSource.time1);
+    bvh->bounds.extend(initStage.pinfo.geomBounds);
   }
 
   template<typename Heuristic>
@@ -143,13 +168,13 @@ namespace embree
     /* first level */
     atomic_set<PrimRefBlock> prims0, prims1;
     PrimInfo                 cinfo0, cinfo1;
-    FallBackSplitter<Heuristic>::split(threadIndex,&alloc,source,prims,pinfo,prims0,cinfo0,prims1,cinfo1);
+    FallBackSplitter<Heuristic>::split(threadIndex,&alloc,&segmentSource,prims,pinfo,prims0,cinfo0,prims1,cinfo1);
 
     /* second level */
     atomic_set<PrimRefBlock> cprims[4];
     PrimInfo                 cinfo[4];
-    FallBackSplitter<Heuristic>::split(threadIndex,&alloc,source,prims0,cinfo0,cprims[0],cinfo[0],cprims[1],cinfo[1]);
-    FallBackSplitter<Heuristic>::split(threadIndex,&alloc,source,prims1,cinfo1,cprims[2],cinfo[2],cprims[3],cinfo[3]);
+    FallBackSplitter<Heuristic>::split(threadIndex,&alloc,&segmentSource,prims0,cinfo0,cprims[0],cinfo[0],cprims[1],cinfo[1]);
+    FallBackSplitter<Heuristic>::split(threadIndex,&alloc,&segmentSource,prims1,cinfo1,cprims[2],cinfo[2],cprims[3],cinfo[3]);
 
     /*! create an inner node */
     BVH4MB::Node* node = (BVH4MB::Node*) bvh->alloc.malloc(threadIndex,sizeof(BVH4MB::Node),1 << BVH4MB::alignment); node->clear();
@@ -177,7 +202,7 @@ namespace embree
     this->threadIndex = threadIndex;
     dst = recurse(depth,prims,pinfo,split);
     for (int i=0; i<5; i++) parent->bvh->rotate(dst,depth);
-    parent->bvh->refit(parent->geometry,dst);
+    parent->bvh->refit(parent->geometry,dst,parent->segmentSource.time0,parent->segmentSource.time1);
     delete this;
   }
 
@@ -217,7 +242,7 @@ namespace embree
       if (bestChild == -1) break;
 
       /*! perform best found split and find new splits */
-      SplitterNormal splitter(threadIndex,&parent->alloc,parent->source,cprims[bestChild],cinfo[bestChild],csplit[bestChild]);
+      SplitterNormal splitter(threadIndex,&parent->alloc,&parent->segmentSource,cprims[bestChild],cinfo[bestChild],csplit[bestChild]);
       cprims[bestChild  ] = splitter.lprims; cinfo[bestChild  ] = splitter.linfo; csplit[bestChild  ] = splitter.lsplit;
       cprims[numChildren] = splitter.rprims; cinfo[numChildren] = splitter.rinfo; csplit[numChildren] = splitter.rsplit;
       numChildren++;
@@ -280,7 +305,7 @@ namespace embree
       if (bestChild == -1) break;
 
       /*! perform best found split and find new splits */
-      SplitterNormal splitter(threadIndex,&parent->alloc,parent->source,cprims[bestChild],cinfo[bestChild],csplit[bestChild]);
+      SplitterNormal splitter(threadIndex,&parent->alloc,&parent->segmentSource,cprims[bestChild],cinfo[bestChild],csplit[bestChild]);
       cprims[bestChild  ] = splitter.lprims; cinfo[bestChild  ] = splitter.linfo; csplit[bestChild  ] = splitter.lsplit;
       cprims[numChildren] = splitter.rprims; cinfo[numChildren] = splitter.rinfo; csplit[numChildren] = splitter.rsplit;
       numChildren++;
@@ -323,7 +348,7 @@ namespace embree
 
     /*! perform first split */
     new (&splitter) MultiThreadedSplitterNormal(threadIndex,threadCount,event,
-                                                &parent->alloc,parent->source,
+                                                &parent->alloc,&parent->segmentSource,
                                                 cprims[bestChild],cinfo[bestChild],csplit[bestChild],
                                                 _loop,this);
   }
@@ -353,7 +378,7 @@ namespace embree
       if (bestChild != -1) 
       {
         new (&splitter) MultiThreadedSplitterNormal(threadIndex,threadCount,event,
-                                                    &parent->alloc,parent->source,
+                                                    &parent->alloc,&parent->segmentSource,
                                                     cprims[bestChild],cinfo[bestChild],csplit[bestChild],
                                                     _loop,this);
         return;
@@ -26,6 +26,38 @@
 
 namespace embree
 {
+  /*! Build source that bounds the primitives over one time segment of
+   *  the motion blur BVH. */
+  struct TimeSegmentBuildSource : public BuildSource
+  {
+    TimeSegmentBuildSource () 
+      : source(NULL), time0(0.0f), time1(1.0f) {}
+
+    TimeSegmentBuildSource (BuildSource* source, float time0, float time1)
+      : source(source), time0(time0), time1(time1) {}
+
+    bool isEmpty () const { 
+      return source->isEmpty(); 
+    }
+
+    size_t groups () const { 
+      return source->groups(); 
+    }
+
+    size_t prims (size_t group, size_t* pNumVertices) const { 
+      return source->prims(group,pNumVertices); 
+    }
+
+    const BBox3fa bounds(size_t group, size_t prim) const { 
+      return source->bounds(group,prim,time0,time1); 
+    }
+
+  public:
+    BuildSource* source;  //!< build source of all time steps
+    float time0;          //!< start of the time segment
+    float time1;          //!< end of the time segment
+  };
+
   /* BVH4MB builder. The builder is multi-threaded and implements 3
    * different build strategies: 1) Small tasks are finished in a
    * single thread (BuildTask) 2) Medium sized tasks are split into
@@ -55,6 +87,9 @@ namespace embree
     /*! builder entry point */
     void build(size_t threadIndex, size_t threadCount);
 
+    /*! Computes the number of time segments such that all geometries move linearly inside each time segment. */
+    size_t timeSegments() const;
+
     /*! Constructor. */
     BVH4MBBuilder(BVH4MB* bvh, BuildSource* source, void* geometry, const size_t minLeafSize = 1, const size_t maxLeafSize = inf);
 
@@ -155,6 +190,8 @@ namespace embree
   private:
     BuildSource* source;      //!< build source interface
     void* geometry;           //!< input geometry
+    size_t segment;           //!< time segment currently built
+    TimeSegmentBuildSource segmentSource; //!< build source of the time segment currently built
 
   private:
     //RTCGeometry* geom;                //!< input geometry
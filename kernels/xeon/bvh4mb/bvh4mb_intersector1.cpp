@@ -30,7 +30,7 @@ namespace embree
       STAT3(normal.travs,1,1,1);
       
       /*! stack state */
-      Base* popCur  = bvh->root;              //!< pre-popped top node from the stack
+      Base* popCur  = bvh->root(ray.time);    //!< pre-popped top node from the stack
       float popDist = neg_inf;                //!< pre-popped distance of top node from the stack
       StackItem stack[1+3*BVH4MB::maxDepth];  //!< stack of nodes that still need to get traversed
       StackItem* stackPtr = stack+1;          //!< current stack pointer
@@ -158,7 +158,7 @@ namespace embree
       /*! stack state */
       Base* stack[1+3*BVH4MB::maxDepth];  //!< stack of nodes that still need to get traversed
       Base** stackPtr = stack+1;          //!< current stack pointer
-      stack[0] = bvh->root;               //!< push first node onto stack
+      stack[0] = bvh->root(ray.time);     //!< push first node onto stack
       
       /*! offsets to select the side that becomes the lower or upper bound */
       const size_t nearX = (ray.dir.x >= 0) ? 0*2*sizeof(ssef) : 1*2*sizeof(ssef);
@@ -86,12 +86,34 @@ namespace embree
     template<typename TriangleIntersector>
     void BVH4MBIntersector4Chunk<TriangleIntersector>::intersect(sseb* valid_i, BVH4MB* bvh, Ray4& ray)
     {
-      sseb valid = *valid_i;
+      /* fast path for a single time segment */
+      if (likely(bvh->numTimeSegments() == 1)) {
+        intersectSegment(*valid_i,bvh->roots[0],bvh,ray);
+        return;
+      }
+
+      /* traverse the tree of each time segment with the rays whose time falls into that segment */
+      ssei segments;
+      for (size_t i=0; i<4; i++) segments[i] = (int)bvh->timeSegment(ray.time[i]);
+      sseb todo = *valid_i;
+      while (any(todo)) 
+      {
+        const int segment = segments[__bsf(movemask(todo))];
+        const sseb valid = todo & (segments == ssei(segment));
+        intersectSegment(valid,bvh->roots[segment],bvh,ray);
+        todo &= !valid;
+      }
+    }
+
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector4Chunk<TriangleIntersector>::intersectSegment(const sseb& valid_i, Base* root, BVH4MB* bvh, Ray4& ray)
+    {
+      sseb valid = valid_i;
       STAT3(normal.travs,1,popcnt(valid),4);
       
       StackItemBVH4MBPacket4 stack[2+3*BVH4MB::maxDepth];
       StackItemBVH4MBPacket4* stackPtr = stack+1; //!< current stack pointer
-      stack[0].ptr = bvh->root; 
+      stack[0].ptr = root; 
       stack[0].dist = neg_inf;
       
       /* let inactive rays miss all boxes */
@@ -207,13 +229,35 @@ namespace embree
     template<typename TriangleIntersector>
     void BVH4MBIntersector4Chunk<TriangleIntersector>::occluded(sseb* valid_i, BVH4MB* bvh, Ray4& ray)
     {
-      sseb valid = *valid_i;
+      /* fast path for a single time segment */
+      if (likely(bvh->numTimeSegments() == 1)) {
+        occludedSegment(*valid_i,bvh->roots[0],bvh,ray);
+        return;
+      }
+
+      /* traverse the tree of each time segment with the rays whose time falls into that segment */
+      ssei segments;
+      for (size_t i=0; i<4; i++) segments[i] = (int)bvh->timeSegment(ray.time[i]);
+      sseb todo = *valid_i;
+      while (any(todo)) 
+      {
+        const int segment = segments[__bsf(movemask(todo))];
+        const sseb valid = todo & (segments == ssei(segment));
+        occludedSegment(valid,bvh->roots[segment],bvh,ray);
+        todo &= !valid;
+      }
+    }
+
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector4Chunk<TriangleIntersector>::occludedSegment(const sseb& valid_i, Base* root, BVH4MB* bvh, Ray4& ray)
+    {
+      sseb valid = valid_i;
       STAT3(shadow.travs,1,popcnt(valid),4);
       sseb terminated = !valid;
       
       BVH4MB::Base* stack[2+3*BVH4MB::maxDepth];
       BVH4MB::Base** stackPtr = stack+1; //!< current stack pointer
-      stack[0] = bvh->root; 
+      stack[0] = root; 
       
       /* let terminated rays miss all boxes */
       sse3f rdir = rcp_safe(ray.dir);
@@ -36,6 +36,11 @@ namespace embree
     public:
       static void intersect(sseb* valid, BVH4MB* bvh, Ray4& ray);
       static void occluded (sseb* valid, BVH4MB* bvh, Ray4& ray);
+
+    private:
+      /*! traverses the tree of a single time segment */
+      static void intersectSegment(const sseb& valid, Base* root, BVH4MB* bvh, Ray4& ray);
+      static void occludedSegment (const sseb& valid, Base* root, BVH4MB* bvh, Ray4& ray);
     };
   }
 }
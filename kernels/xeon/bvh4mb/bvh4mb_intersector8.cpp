@@ -86,12 +86,34 @@ namespace embree
     template<typename TriangleIntersector>
     void BVH4MBIntersector8Chunk<TriangleIntersector>::intersect(avxb* valid_i, BVH4MB* bvh, Ray8& ray)
     {
-      avxb valid = *valid_i;
+      /* fast path for a single time segment */
+      if (likely(bvh->numTimeSegments() == 1)) {
+        intersectSegment(*valid_i,bvh->roots[0],bvh,ray);
+        return;
+      }
+
+      /* traverse the tree of each time segment with the rays whose time falls into that segment */
+      avxi segments;
+      for (size_t i=0; i<8; i++) segments[i] = (int)bvh->timeSegment(ray.time[i]);
+      avxb todo = *valid_i;
+      while (any(todo)) 
+      {
+        const int segment = segments[__bsf(movemask(todo))];
+        const avxb valid = todo & (segments == avxi(segment));
+        intersectSegment(valid,bvh->roots[segment],bvh,ray);
+        todo &= !valid;
+      }
+    }
+
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector8Chunk<TriangleIntersector>::intersectSegment(const avxb& valid_i, Base* root, BVH4MB* bvh, Ray8& ray)
+    {
+      avxb valid = valid_i;
       STAT3(normal.travs,1,popcnt(valid),4);
       
       StackItemBVH4MBPacket8 stack[2+3*BVH4MB::maxDepth];
       StackItemBVH4MBPacket8* stackPtr = stack+1; //!< current stack pointer
-      stack[0].ptr = bvh->root; 
+      stack[0].ptr = root; 
       stack[0].dist = neg_inf;
       
       /* let inactive rays miss all boxes */
@@ -207,13 +229,35 @@ namespace embree
     template<typename TriangleIntersector>
     void BVH4MBIntersector8Chunk<TriangleIntersector>::occluded(avxb* valid_i, BVH4MB* bvh, Ray8& ray)
     {
-      avxb valid = *valid_i;
+      /* fast path for a single time segment */
+      if (likely(bvh->numTimeSegments() == 1)) {
+        occludedSegment(*valid_i,bvh->roots[0],bvh,ray);
+        return;
+      }
+
+      /* traverse the tree of each time segment with the rays whose time falls into that segment */
+      avxi segments;
+      for (size_t i=0; i<8; i++) segments[i] = (int)bvh->timeSegment(ray.time[i]);
+      avxb todo = *valid_i;
+      while (any(todo)) 
+      {
+        const int segment = segments[__bsf(movemask(todo))];
+        const avxb valid = todo & (segments == avxi(segment));
+        occludedSegment(valid,bvh->roots[segment],bvh,ray);
+        todo &= !valid;
+      }
+    }
+
+    template<typename TriangleIntersector>
+    void BVH4MBIntersector8Chunk<TriangleIntersector>::occludedSegment(const avxb& valid_i, Base* root, BVH4MB* bvh, Ray8& ray)
+    {
+      avxb valid = valid_i;
       STAT3(shadow.travs,1,popcnt(valid),4);
       avxb terminated = !valid;
       
       BVH4MB::Base* stack[2+3*BVH4MB::maxDepth];
       BVH4MB::Base** stackPtr = stack+1; //!< current stack pointer
-      stack[0] = bvh->root; 
+      stack[0] = root; 
       
       /* let terminated rays miss all boxes */
       avx3f rdir = rcp_safe(ray.dir);
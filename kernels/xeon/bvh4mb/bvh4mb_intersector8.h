@@ -36,6 +36,11 @@ namespace embree
     public:
       static void intersect(avxb* valid, BVH4MB* bvh, Ray8& ray);
       static void occluded (avxb* valid, BVH4MB* bvh, Ray8& ray);
+
+    private:
+      /*! traverses the tree of a single time segment */
+      static void intersectSegment(const avxb& valid, Base* root, BVH4MB* bvh, Ray8& ray);
+      static void occludedSegment (const avxb& valid, Base* root, BVH4MB* bvh, Ray8& ray);
     };
   }
 }
@@ -0,0 +1,192 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh8.h"
+
+#include "geometry/bezier1i.h"
+#include "geometry/triangle4.h"
+#include "geometry/triangle8.h"
+
+#include "common/accelinstance.h"
+
+namespace embree
+{
+  DECLARE_SYMBOL(Accel::Intersector1,BVH8Bezier1iIntersector1);
+  DECLARE_SYMBOL(Accel::Intersector1,BVH8Triangle4Intersector1Moeller);
+  DECLARE_SYMBOL(Accel::Intersector1,BVH8Triangle8Intersector1Moeller);
+  DECLARE_SYMBOL(Accel::Intersector1,BVH8VirtualIntersector1);
+
+  DECLARE_SYMBOL(Accel::Intersector4,BVH8Bezier1iIntersector4Chunk);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH8Triangle4Intersector4ChunkMoeller);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH8Triangle8Intersector4ChunkMoeller);
+  DECLARE_SYMBOL(Accel::Intersector4,BVH8VirtualIntersector4Chunk);
+
+  DECLARE_SYMBOL(Accel::Intersector8,BVH8Bezier1iIntersector8Chunk);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH8Triangle4Intersector8ChunkMoeller);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH8Triangle8Intersector8ChunkMoeller);
+  DECLARE_SYMBOL(Accel::Intersector8,BVH8VirtualIntersector8Chunk);
+
+  Builder* BVH8BuilderObjectSplit1 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH8BuilderObjectSplit4 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH8BuilderObjectSplit8 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH8BuilderSpatialSplit4 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH8BuilderSpatialSplit8 (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH8BuilderSpatialSplit4Fast (void* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+
+  void BVH8Register ()
+  {
+    int features = getCPUFeatures();
+
+    /* select intersectors1 */
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Bezier1iIntersector1);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle4Intersector1Moeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8Intersector1Moeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8VirtualIntersector1);
+
+    /* select intersectors4 */
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Bezier1iIntersector4Chunk);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle4Intersector4ChunkMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8Intersector4ChunkMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8VirtualIntersector4Chunk);
+
+    /* select intersectors8 */
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Bezier1iIntersector8Chunk);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle4Intersector8ChunkMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8Triangle8Intersector8ChunkMoeller);
+    SELECT_SYMBOL_AVX_AVX2(features,BVH8VirtualIntersector8Chunk);
+  }
+
+  BVH8::BVH8 (const PrimitiveType& primTy, void* geometry)
+  : primTy(primTy), geometry(geometry), root(emptyNode),
+    numPrimitives(0), numVertices(0), mapped(NULL), bytesMapped(0)
+  {
+    alloc = new LinearAllocatorPerThread;
+  }
+
+  BVH8::~BVH8 () {
+    if (mapped) os_unmap_file(mapped, bytesMapped);
+  }
+
+  void BVH8::unmap()
+  {
+    if (mapped) os_unmap_file(mapped, bytesMapped);
+    mapped = NULL; bytesMapped = 0;
+    root = emptyNode; bounds = empty;
+    numPrimitives = numVertices = 0;
+  }
+
+  Accel::Intersectors BVH8Bezier1iIntersectors(BVH8* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH8Bezier1iIntersector1;
+    intersectors.intersector4 = BVH8Bezier1iIntersector4Chunk;
+    intersectors.intersector8 = BVH8Bezier1iIntersector8Chunk;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
+  Accel::Intersectors BVH8Triangle4Intersectors(BVH8* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH8Triangle4Intersector1Moeller;
+    intersectors.intersector4 = BVH8Triangle4Intersector4ChunkMoeller;
+    intersectors.intersector8 = BVH8Triangle4Intersector8ChunkMoeller;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
+  Accel::Intersectors BVH8Triangle8Intersectors(BVH8* bvh)
+  {
+    Accel::Intersectors intersectors;
+    intersectors.ptr = bvh;
+    intersectors.intersector1 = BVH8Triangle8Intersector1Moeller;
+    intersectors.intersector4 = BVH8Triangle8Intersector4ChunkMoeller;
+    intersectors.intersector8 = BVH8Triangle8Intersector8ChunkMoeller;
+    intersectors.intersector16 = NULL;
+    return intersectors;
+  }
+
+  Accel* BVH8::BVH8Bezier1i(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneBezier1i::type,scene);
+    Accel::Intersectors intersectors = BVH8Bezier1iIntersectors(accel);
+    Builder* builder = BVH8BuilderObjectSplit1(accel,&scene->bezier_source_1,scene,1,inf);
+    scene->needVertices = true;
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+  Accel* BVH8::BVH8Triangle4(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle4::type,scene);
+    Accel::Intersectors intersectors = BVH8Triangle4Intersectors(accel);
+
+    Builder* builder = NULL;
+    if      (g_builder == "default"     ) builder = BVH8BuilderObjectSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else if (g_builder == "spatialsplit") builder = BVH8BuilderSpatialSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else if (g_builder == "objectsplit" ) builder = BVH8BuilderObjectSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else throw std::runtime_error("unknown builder "+g_builder+" for BVH8<Triangle4>");
+
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+  Accel* BVH8::BVH8Triangle8(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle8::type,scene);
+    Accel::Intersectors intersectors = BVH8Triangle8Intersectors(accel);
+
+    Builder* builder = NULL;
+    if      (g_builder == "default"     ) builder = BVH8BuilderObjectSplit8(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else if (g_builder == "spatialsplit") builder = BVH8BuilderSpatialSplit8(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else if (g_builder == "objectsplit" ) builder = BVH8BuilderObjectSplit8(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    else throw std::runtime_error("unknown builder "+g_builder+" for BVH8<Triangle8>");
+
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+  Accel* BVH8::BVH8Triangle4SpatialSplit(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle4::type,scene);
+    Builder* builder = BVH8BuilderSpatialSplit4Fast(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Accel::Intersectors intersectors = BVH8Triangle4Intersectors(accel);
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+  Accel* BVH8::BVH8Triangle8SpatialSplit(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle8::type,scene);
+    Builder* builder = BVH8BuilderSpatialSplit8(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Accel::Intersectors intersectors = BVH8Triangle8Intersectors(accel);
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+  Accel* BVH8::BVH8Triangle4ObjectSplit(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle4::type,scene);
+    Builder* builder = BVH8BuilderObjectSplit4(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Accel::Intersectors intersectors = BVH8Triangle4Intersectors(accel);
+    return new AccelInstance(accel,builder,intersectors);
+  }
+
+  Accel* BVH8::BVH8Triangle8ObjectSplit(Scene* scene)
+  {
+    BVH8* accel = new BVH8(SceneTriangle8::type,scene);
+    Builder* builder = BVH8BuilderObjectSplit8(accel,&scene->flat_triangle_source_1,scene,1,inf);
+    Accel::Intersectors intersectors = BVH8Triangle8Intersectors(accel);
+    return new AccelInstance(accel,builder,intersectors);
+  }
+}
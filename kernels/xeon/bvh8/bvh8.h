@@ -0,0 +1,222 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "embree2/rtcore.h"
+#include "common/alloc.h"
+#include "common/accel.h"
+#include "common/scene.h"
+#include "geometry/primitive.h"
+#include "bvh4/bvh4.h"
+
+namespace embree
+{
+  /*! Multi BVH with 8 children. Each node stores the bounding box of
+   *  it's 8 children as well as 8 child pointers. Leaves are encoded
+   *  like in the BVH4, thus the BVH8 gets built by collapsing the
+   *  nodes of a BVH4. The nodes require AVX for traversal. */
+  class BVH8 : public Bounded
+  {
+    ALIGNED_CLASS;
+  public:
+
+    /*! forward declaration of node type */
+    struct Node;
+
+    /*! branching width of the tree */
+    static const size_t N = 8;
+
+    /*! Number of address bits the Node and primitives are aligned
+        to. Maximally 2^alignment-2 many primitive blocks per leaf are
+        supported. */
+    static const size_t alignment = BVH4::alignment;
+
+    /*! Masks the bits that store the number of items per leaf. */
+    static const size_t align_mask = (1 << alignment)-1;
+    static const size_t items_mask = (1 << (alignment-1))-1;
+
+    /*! Empty node */
+    static const size_t emptyNode = 1;
+
+    /*! Invalid node, used as marker in traversal */
+    static const size_t invalidNode = (((size_t)-1) & (~items_mask)) | 1;
+
+    /*! Maximal depth of the BVH, collapsing never increases the depth of the BVH4. */
+    static const size_t maxDepth = BVH4::maxDepth;
+
+    /*! Maximal number of primitive blocks in a leaf. */
+    static const size_t maxLeafBlocks = items_mask-1;
+
+    /*! Pointer that points to a node or a list of primitives */
+    struct NodeRef
+    {
+      /*! Default constructor */
+      __forceinline NodeRef () {}
+
+      /*! Construction from integer */
+      __forceinline NodeRef (size_t ptr) : ptr(ptr) { }
+
+      /*! Cast to size_t */
+      __forceinline operator size_t() const { return ptr; }
+
+       /*! Prefetches the node this reference points to */
+      __forceinline void prefetch() const {
+#if defined(__AVX2__)
+	prefetchL1(((char*)ptr)+0*64);
+	prefetchL1(((char*)ptr)+1*64);
+	prefetchL1(((char*)ptr)+2*64);
+	prefetchL1(((char*)ptr)+3*64);
+#endif
+      }
+
+      /*! checks if this is a leaf */
+      __forceinline int isLeaf() const { return (ptr & (size_t)align_mask) != 0; }
+
+      /*! checks if this is a node */
+      __forceinline int isNode() const { return (ptr & (size_t)align_mask) == 0; }
+
+      /*! returns node pointer */
+      __forceinline       Node* node()       { assert(isNode()); return (      Node*)ptr; }
+      __forceinline const Node* node() const { assert(isNode()); return (const Node*)ptr; }
+
+      /*! returns leaf pointer */
+      __forceinline char* leaf(size_t& num) const {
+        assert(isLeaf());
+        num = (ptr & (size_t)items_mask)-1;
+        return (char*)(ptr & ~(size_t)align_mask);
+      }
+
+    private:
+      size_t ptr;
+    };
+
+#if defined(__AVX__)
+
+    /*! BVH8 Node */
+    struct Node
+    {
+      /*! Clears the node. */
+      __forceinline void clear() {
+        lower_x = lower_y = lower_z = pos_inf;
+        upper_x = upper_y = upper_z = neg_inf;
+        for (size_t i=0; i<8; i++) children[i] = emptyNode;
+      }
+
+      /*! Sets bounding box of child. */
+      __forceinline void set(size_t i, const BBox3fa& bounds)
+      {
+        assert(i < 8);
+        lower_x[i] = bounds.lower.x; lower_y[i] = bounds.lower.y; lower_z[i] = bounds.lower.z;
+        upper_x[i] = bounds.upper.x; upper_y[i] = bounds.upper.y; upper_z[i] = bounds.upper.z;
+      }
+
+      /*! Sets bounding box and ID of child. */
+      __forceinline void set(size_t i, const BBox3fa& bounds, const NodeRef& childID) {
+        set(i,bounds);
+        children[i] = childID;
+      }
+
+      /*! Returns bounds of node. */
+      __forceinline BBox3fa bounds() const {
+        const Vec3fa lower(reduce_min(lower_x),reduce_min(lower_y),reduce_min(lower_z));
+        const Vec3fa upper(reduce_max(upper_x),reduce_max(upper_y),reduce_max(upper_z));
+        return BBox3fa(lower,upper);
+      }
+
+      /*! Returns bounds of specified child. */
+      __forceinline BBox3fa bounds(size_t i) const
+      {
+        assert(i < 8);
+        const Vec3fa lower(lower_x[i],lower_y[i],lower_z[i]);
+        const Vec3fa upper(upper_x[i],upper_y[i],upper_z[i]);
+        return BBox3fa(lower,upper);
+      }
+
+      /*! Returns reference to specified child */
+      __forceinline       NodeRef& child(size_t i)       { assert(i<8); return children[i]; }
+      __forceinline const NodeRef& child(size_t i) const { assert(i<8); return children[i]; }
+
+    public:
+      avxf lower_x;           //!< X dimension of lower bounds of all 8 children.
+      avxf upper_x;           //!< X dimension of upper bounds of all 8 children.
+      avxf lower_y;           //!< Y dimension of lower bounds of all 8 children.
+      avxf upper_y;           //!< Y dimension of upper bounds of all 8 children.
+      avxf lower_z;           //!< Z dimension of lower bounds of all 8 children.
+      avxf upper_z;           //!< Z dimension of upper bounds of all 8 children.
+      NodeRef children[8];    //!< Pointer to the 8 children (can be a node or leaf)
+    };
+
+#endif
+
+  public:
+
+    /*! BVH8 default constructor. */
+    BVH8 (const PrimitiveType& primTy, void* geometry = NULL);
+
+    /*! BVH8 destruction */
+    ~BVH8 ();
+
+    /*! BVH8 instantiations */
+    static Accel* BVH8Bezier1i(Scene* scene);
+    static Accel* BVH8Triangle4(Scene* scene);
+    static Accel* BVH8Triangle8(Scene* scene);
+
+    static Accel* BVH8Triangle4SpatialSplit(Scene* scene);
+    static Accel* BVH8Triangle8SpatialSplit(Scene* scene);
+    static Accel* BVH8Triangle4ObjectSplit(Scene* scene);
+    static Accel* BVH8Triangle8ObjectSplit(Scene* scene);
+
+    /*! Stores the BVH at the current position of a file. Node
+     *  references are stored relative to the start of the BVH. */
+    bool store (FILE* file);
+
+    /*! Maps a BVH stored with store into memory and relocates its
+     *  node references. */
+    bool restore (const char* filename, size_t offset, size_t bytes);
+
+    /*! Releases a previously restored BVH. */
+    void unmap ();
+
+#if defined(__AVX__)
+
+    __forceinline Node* allocNode(size_t thread) {
+      Node* node = (Node*) alloc->malloc(thread,sizeof(Node),1 << 6); node->clear(); return node;
+    }
+
+    /*! Encodes a node */
+    __forceinline NodeRef encodeNode(Node* node) {
+      return NodeRef((size_t) node);
+    }
+
+#endif
+
+  public:
+    const PrimitiveType& primTy;       //!< primitive type stored in the BVH
+    void* geometry;                    //!< pointer to additional data for primitive intersector
+    NodeRef root;                      //!< Root node
+    size_t numPrimitives;
+    size_t numVertices;
+
+    /*! Allocator of the nodes and leaves, shared with the BVH4 that gets collapsed. */
+    Ref<LinearAllocatorPerThread> alloc;
+
+    /*! memory mapped data of a restored BVH */
+  public:
+    void* mapped;
+    size_t bytesMapped;
+  };
+}
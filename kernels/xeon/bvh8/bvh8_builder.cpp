@@ -0,0 +1,244 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh8_builder.h"
+
+namespace embree
+{
+  BVH8Builder::BVH8Builder (BVH8* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize, BVH4BuilderFunc createBuilder)
+    : bvh(bvh), bvh4(NULL), source(source), builder(NULL), numNodes(0), numChildren(0)
+  {
+    /* the BVH8 nodes get allocated next to the leaves of the BVH4 */
+    bvh4 = new BVH4(bvh->primTy,bvh->geometry);
+    bvh->alloc = bvh4->alloc;
+    builder = createBuilder(bvh4,source,geometry,minLeafSize,maxLeafSize);
+    needAllThreads = builder->needAllThreads;
+  }
+
+  BVH8Builder::~BVH8Builder () {
+    delete builder; builder = NULL; // delete builder first!
+    delete bvh4; bvh4 = NULL;
+  }
+
+  void BVH8Builder::build(size_t threadIndex, size_t threadCount)
+  {
+    /* the nodes of the BVH4 only live until they got collapsed */
+    const size_t numPrimitives = source->size();
+#if defined(__X86_64__)
+    const size_t numReservedNodes = 2*numPrimitives;
+#else
+    const size_t numReservedNodes = numPrimitives;
+#endif
+    bvh->unmap();
+    bvh4->allocTempNodes = new LinearAllocatorPerThread;
+    bvh4->allocTempNodes->init(numReservedNodes*sizeof(BVH4::Node));
+    builder->build(threadIndex,threadCount);
+
+    double t0 = 0.0;
+    if (g_verbose >= 2) {
+      std::cout << "collapsing BVH4<" << bvh->primTy.name << "> into BVH8 ... " << std::flush;
+      t0 = getSeconds();
+    }
+
+    /* builders that manage their own node and leaf memory leave the shared allocator to the BVH8 nodes */
+    if (bvh4->nodes) 
+      bvh->alloc->init(max(bvh4->bytesNodes,size_t(sizeof(BVH8::Node))));
+
+    /* collapse the top levels sequentially until there are enough
+     * subtrees to keep all threads busy, then collapse the subtrees in
+     * parallel */
+    size_t maxDepth = 0;
+    if (needAllThreads) 
+      while ((size_t(1) << (3*maxDepth)) < 4*threadCount) maxDepth++;
+
+    numNodes = numChildren = 0;
+    roots.clear();
+    collapse_top(bvh->root,bvh4->root,0,maxDepth);
+
+    const size_t numRoots = roots.size();
+    if (!needAllThreads || numRoots <= 1) {
+      for (size_t i=0; i<numRoots; i++) 
+        task_collapse_parallel(threadIndex,threadCount,i,numRoots,NULL);
+    }
+    else
+      TaskScheduler::executeTask(threadIndex,threadCount,_task_collapse_parallel,this,numRoots,"BVH8Builder::collapse");
+
+    /* the tasks only count the nodes of their own subtree */
+    for (size_t i=0; i<numRoots; i++) {
+      numNodes += roots[i].numNodes;
+      numChildren += roots[i].numChildren;
+    }
+    roots.clear();
+    bvh->bounds = bvh4->bounds;
+    bvh->numPrimitives = bvh4->numPrimitives;
+    bvh->numVertices = bvh4->numVertices;
+    bvh4->root = BVH4::emptyNode;
+    bvh4->allocTempNodes = NULL;
+
+    if (g_verbose >= 2) {
+      const double t1 = getSeconds();
+      std::cout << "[DONE]" << std::endl;
+      std::cout << "  dt = " << 1000.0f*(t1-t0) << "ms, " << numNodes << " nodes, "
+                << double(numChildren)/double(max(size_t(numNodes),size_t(1))) << " children per node, "
+                << 1E-6*double(size_t(numNodes)*sizeof(BVH8::Node)) << " MB" << std::endl;
+    }
+  }
+
+  size_t BVH8Builder::gather(BVH4::NodeRef ref, BVH4::NodeRef children[BVH8::N], BBox3fa bounds[BVH8::N])
+  {
+    /* start with the children of the BVH4 node */
+    size_t num = 0;
+    const BVH4::Node* node = ref.node();
+    for (size_t i=0; i<4; i++) {
+      if (node->child(i) == BVH4::emptyNode) continue;
+      children[num] = node->child(i);
+      bounds[num] = node->bounds(i);
+      num++;
+    }
+
+    /* open the inner child with the largest surface area as long as its children fit */
+    while (true)
+    {
+      ssize_t bestChild = -1;
+      float bestArea = neg_inf;
+      for (size_t i=0; i<num; i++)
+      {
+        if (children[i].isLeaf()) continue;
+        const BVH4::Node* child = children[i].node();
+        size_t n = 0;
+        for (size_t j=0; j<4; j++)
+          n += child->child(j) != BVH4::emptyNode;
+        if (num-1+n > BVH8::N) continue;
+
+        const float A = halfArea(bounds[i]);
+        if (A > bestArea) { bestArea = A; bestChild = i; }
+      }
+      if (bestChild == -1) break;
+
+      /* replace best child by its children */
+      const BVH4::Node* best = children[bestChild].node();
+      children[bestChild] = children[num-1];
+      bounds  [bestChild] = bounds  [num-1];
+      num--;
+      for (size_t j=0; j<4; j++) {
+        if (best->child(j) == BVH4::emptyNode) continue;
+        children[num] = best->child(j);
+        bounds[num] = best->bounds(j);
+        num++;
+      }
+    }
+
+    /* order children for shadow rays, leaves first then larger children first */
+    for (size_t i=1; i<num; i++) {
+      for (size_t j=i; j>0; j--) {
+        const bool before = children[j].isLeaf() != children[j-1].isLeaf() ? children[j].isLeaf() : halfArea(bounds[j]) > halfArea(bounds[j-1]);
+        if (!before) break;
+        std::swap(children[j],children[j-1]);
+        std::swap(bounds[j],bounds[j-1]);
+      }
+    }
+
+    return num;
+  }
+
+  void BVH8Builder::collapse_top(BVH8::NodeRef& dst, BVH4::NodeRef ref, size_t depth, size_t maxDepth)
+  {
+    /* leaves are encoded identically */
+    if (ref.isLeaf()) {
+      dst = BVH8::NodeRef((size_t)ref);
+      return;
+    }
+
+    if (depth == maxDepth) {
+      roots.push_back(SubTree(&dst,ref));
+      return;
+    }
+
+    BVH4::NodeRef children[BVH8::N];
+    BBox3fa bounds[BVH8::N];
+    const size_t num = gather(ref,children,bounds);
+
+    BVH8::Node* node8 = bvh->allocNode(0);
+    numNodes++;
+    numChildren += num;
+    for (size_t i=0; i<num; i++) {
+      node8->set(i,bounds[i],BVH8::emptyNode);
+      collapse_top(node8->child(i),children[i],depth+1,maxDepth);
+    }
+    dst = bvh->encodeNode(node8);
+  }
+
+  BVH8::NodeRef BVH8Builder::collapse(size_t threadIndex, BVH4::NodeRef ref, size_t& nodes, size_t& childCount)
+  {
+    /* leaves are encoded identically */
+    if (ref.isLeaf())
+      return BVH8::NodeRef((size_t)ref);
+
+    BVH4::NodeRef children[BVH8::N];
+    BBox3fa bounds[BVH8::N];
+    const size_t num = gather(ref,children,bounds);
+
+    /* nodes of each subtree are stored in depth first order */
+    BVH8::Node* node8 = bvh->allocNode(threadIndex);
+    nodes++;
+    childCount += num;
+    for (size_t i=0; i<num; i++)
+      node8->set(i,bounds[i],collapse(threadIndex,children[i],nodes,childCount));
+    return bvh->encodeNode(node8);
+  }
+
+  void BVH8Builder::task_collapse_parallel(size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) 
+  {
+    SubTree& root = roots[taskIndex];
+    *root.dst = collapse(threadIndex,root.src,root.numNodes,root.numChildren);
+  }
+
+  Builder* BVH4BuilderObjectSplit1 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH4BuilderObjectSplit4 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH4BuilderObjectSplit8 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH4BuilderSpatialSplit4 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  Builder* BVH4BuilderSpatialSplit8 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+  extern BuilderFunc BVH4BuilderSpatialSplit4Fast;
+
+  /*! the fast spatial split builder gets selected at runtime and takes the scene as geometry */
+  static Builder* BVH4BuilderSpatialSplit4FastScene (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return BVH4BuilderSpatialSplit4Fast(accel,source,(Scene*)geometry,minLeafSize,maxLeafSize);
+  }
+
+  Builder* BVH8BuilderObjectSplit1 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return new BVH8Builder((BVH8*)accel,source,geometry,minLeafSize,maxLeafSize,BVH4BuilderObjectSplit1);
+  }
+
+  Builder* BVH8BuilderObjectSplit4 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return new BVH8Builder((BVH8*)accel,source,geometry,minLeafSize,maxLeafSize,BVH4BuilderObjectSplit4);
+  }
+
+  Builder* BVH8BuilderObjectSplit8 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return new BVH8Builder((BVH8*)accel,source,geometry,minLeafSize,maxLeafSize,BVH4BuilderObjectSplit8);
+  }
+
+  Builder* BVH8BuilderSpatialSplit4 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return new BVH8Builder((BVH8*)accel,source,geometry,minLeafSize,maxLeafSize,BVH4BuilderSpatialSplit4);
+  }
+
+  Builder* BVH8BuilderSpatialSplit8 (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return new BVH8Builder((BVH8*)accel,source,geometry,minLeafSize,maxLeafSize,BVH4BuilderSpatialSplit8);
+  }
+
+  Builder* BVH8BuilderSpatialSplit4Fast (void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize) {
+    return new BVH8Builder((BVH8*)accel,source,geometry,minLeafSize,maxLeafSize,BVH4BuilderSpatialSplit4FastScene);
+  }
+}
@@ -0,0 +1,87 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bvh8.h"
+#include "common/builder.h"
+#include "sys/taskscheduler.h"
+
+namespace embree
+{
+  /*! Builder that runs one of the BVH4 SAH builders and collapses the
+   *  resulting BVH4 into a BVH8. Each BVH4 node already represents
+   *  two levels of binary splits, the collapse opens the inner child
+   *  with the largest surface area until 8 children are reached. The
+   *  nodes of the BVH4 are allocated from a temporary allocator that
+   *  gets released after the collapse, the leaves are kept. */
+  class BVH8Builder : public Builder
+  {
+    ALIGNED_CLASS;
+  public:
+
+    /*! Type of the factories of the BVH4 builders that can get collapsed. */
+    typedef Builder* (*BVH4BuilderFunc)(void* accel, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize);
+
+  public:
+
+    /*! Constructor. */
+    BVH8Builder (BVH8* bvh, BuildSource* source, void* geometry, const size_t minLeafSize, const size_t maxLeafSize, BVH4BuilderFunc createBuilder);
+
+    /*! Destructor */
+    ~BVH8Builder ();
+
+    /*! builder entry point */
+    void build(size_t threadIndex, size_t threadCount);
+
+  private:
+
+    /*! gathers up to 8 children of a BVH4 node by opening its inner children, returns the number of children */
+    size_t gather(BVH4::NodeRef ref, BVH4::NodeRef children[BVH8::N], BBox3fa bounds[BVH8::N]);
+
+    /*! collapses the top levels of the BVH4 and collects the subtrees to collapse in parallel */
+    void collapse_top(BVH8::NodeRef& dst, BVH4::NodeRef ref, size_t depth, size_t maxDepth);
+
+    /*! collapses a BVH4 subtree, returns the reference to the BVH8 subtree */
+    BVH8::NodeRef collapse(size_t threadIndex, BVH4::NodeRef ref, size_t& nodes, size_t& childCount);
+
+    /*! task that collapses one of the collected subtrees */
+    TASK_RUN_FUNCTION(BVH8Builder,task_collapse_parallel);
+
+  private:
+
+    /*! subtree that gets collapsed by one parallel task, the task counts the nodes it creates */
+    struct SubTree
+    {
+      SubTree (BVH8::NodeRef* dst, BVH4::NodeRef src) 
+        : dst(dst), src(src), numNodes(0), numChildren(0) {}
+
+      BVH8::NodeRef* dst;   //!< reference to the BVH8 subtree
+      BVH4::NodeRef src;    //!< BVH4 subtree to collapse
+      size_t numNodes;      //!< number of BVH8 nodes of the subtree
+      size_t numChildren;   //!< number of children of all BVH8 nodes of the subtree
+    };
+
+  private:
+    BVH8* bvh;              //!< output
+    BVH4* bvh4;             //!< BVH4 that gets collapsed
+    BuildSource* source;    //!< build source
+    Builder* builder;       //!< builder producing the BVH4
+    std::vector<SubTree> roots; //!< subtrees that get collapsed in parallel
+    size_t numNodes;            //!< number of BVH8 nodes
+    size_t numChildren;         //!< number of children of all BVH8 nodes
+  };
+}
@@ -0,0 +1,29 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh8.h"
+#include "bvh4/bvh4_serialize.h"
+
+namespace embree
+{
+  bool BVH8::store(FILE* file) {
+    return BVHSerializer<BVH8>::store(this,file);
+  }
+
+  bool BVH8::restore(const char* filename, size_t offset, size_t bytes) {
+    return BVHSerializer<BVH8>::restore(this,filename,offset,bytes);
+  }
+}
@@ -44,7 +44,7 @@ namespace embree
 #endif
     const BezierCurves* curves = scene->getBezierCurves(geomID);
     const Vec3fa& p0 = curves->vertex(curves->curve(primID));
-    new (dst) Bezier1i(&p0,geomID,primID,curves->mask);
+    new (dst) Bezier1i(&p0,geomID,primID,curves->mask,curves->subdivisionDepth(primID),curves->type == RTC_CURVE_ROUND,curves->numTimeSteps);
     prims++;
   }
   
@@ -61,7 +61,7 @@ namespace embree
     const BezierCurves* curves = scene->getBezierCurves(geomID);
     const int vtx = curves->curve(primID);
     const Vec3fa& p0 = curves->vertex(vtx);
-    new (dst) Bezier1i(&p0,geomID,primID,curves->mask);
+    new (dst) Bezier1i(&p0,geomID,primID,curves->mask,curves->subdivisionDepth(primID),curves->type == RTC_CURVE_ROUND,curves->numTimeSteps);
     prims++;
   }
     
@@ -77,11 +77,14 @@ namespace embree
       const unsigned primID = dst.primID;
       const BezierCurves* curves = scene->getBezierCurves(geomID);
       const int vtx = curves->curve(primID);
-      bounds.extend(curves->vertex(vtx+0));
-      bounds.extend(curves->vertex(vtx+1));
-      bounds.extend(curves->vertex(vtx+2));
-      bounds.extend(curves->vertex(vtx+3));
+      for (size_t t=0; t<curves->numTimeSteps; t++) {
+        bounds.extend(curves->vertex(vtx+0,t));
+        bounds.extend(curves->vertex(vtx+1,t));
+        bounds.extend(curves->vertex(vtx+2,t));
+        bounds.extend(curves->vertex(vtx+3,t));
+      }
       dst.mask = curves->mask;
+      dst.depth = curves->subdivisionDepth(primID);
     }
     return bounds; 
   }
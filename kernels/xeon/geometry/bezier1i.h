@@ -24,6 +24,8 @@ namespace embree
 #if defined(__AVX__)
   extern avxf coeff0[4];
   extern avxf coeff1[4];
+  extern avxf bezier_coeff0[4][4]; //!< start points of the 2^depth segments of a curve for each depth
+  extern avxf bezier_coeff1[4][4]; //!< end points of the 2^depth segments of a curve for each depth
 #endif
 
   struct Bezier1i
@@ -34,8 +36,8 @@ namespace embree
     __forceinline Bezier1i () {}
 
     /*! Construction from vertices and IDs. */
-    __forceinline Bezier1i (const Vec3fa* p, const unsigned int geomID, const unsigned int primID, const unsigned int mask)
-      : p(p), geomID(geomID), primID(primID), mask(mask) {}
+    __forceinline Bezier1i (const Vec3fa* p, const unsigned int geomID, const unsigned int primID, const unsigned int mask, const unsigned int depth, const bool round, const unsigned int numTimeSteps = 1)
+      : p(p), geomID(geomID), primID(primID), mask(mask), depth(depth), round(round), numTimeSteps(numTimeSteps) {}
 
     /*! calculate the bounds of the triangle */
     __forceinline BBox3fa bounds() const {
@@ -48,6 +50,9 @@ namespace embree
     unsigned int geomID;  //!< geometry ID
     unsigned int primID;  //!< primitive ID
     unsigned int mask;    //!< geometry mask
+    unsigned char depth;  //!< number of subdivision levels for intersection (0 to 3)
+    bool round;           //!< intersect as round tube instead of ribbon
+    unsigned char numTimeSteps; //!< number of time steps, motion blur curves get interpolated at the ray time
   };
 
   struct Bezier1iType : public PrimitiveType {
@@ -18,6 +18,7 @@
 
 #include "bezier1i.h"
 #include "common/ray.h"
+#include "common/scene.h"
 #include "geometry/filter.h"
 
 namespace embree
@@ -42,6 +43,161 @@ namespace embree
 #endif
   }
 
+  /*! Hit candidates of a ray with a bezier curve. The curve is
+   *  subdivided into the 2^depth line segments selected at build time,
+   *  which get tested in parallel. Nearly straight curves (depth 0)
+   *  are tested as a single segment without evaluating the curve. A
+   *  ribbon is hit where the ray passes a segment closer than the
+   *  curve radius, round curves are additionally intersected with a
+   *  tube around each candidate segment. Motion blur curves are
+   *  intersected at the ray time, their control points get linearly
+   *  interpolated between the time steps of the time segment that
+   *  contains the ray time. */
+  struct Bezier1iHits
+  {
+    __forceinline Bezier1iHits (const LinearSpace3fa& ray_space, const Vec3fa& org, const Vec3fa& dir, const float tnear, const float tfar, const float time, 
+                                const Bezier1i& curve, const void* geom)
+      : curve3D(curveAtTime(curve,time,geom)), depth(curve.depth), round(curve.round)
+    {
+      /* transform control points into ray space */
+      const Vec3fa &v0 = curve3D.v0;
+      const Vec3fa &v1 = curve3D.v1;
+      const Vec3fa &v2 = curve3D.v2;
+      const Vec3fa &v3 = curve3D.v3;
+      Vec3fa w0 = xfmVector(ray_space,v0-org); w0.w = v0.w;
+      Vec3fa w1 = xfmVector(ray_space,v1-org); w1.w = v1.w;
+      Vec3fa w2 = xfmVector(ray_space,v2-org); w2.w = v2.w;
+      Vec3fa w3 = xfmVector(ray_space,v3-org); w3.w = v3.w;
+
+      if (depth == 0)
+      {
+        /* approximative intersection with the cone from first to last control point */
+        const Vec3fa v = w3-w0;
+        const Vec3fa w = -w0;
+        const float d0 = w.x*v.x + w.y*v.y;
+        const float d1 = v.x*v.x + v.y*v.y;
+        const float u0 = d1 > 0.0f ? clamp(d0/d1,0.0f,1.0f) : 0.0f;
+        const Vec3fa p = w0 + u0*v;
+        const float d2 = p.x*p.x + p.y*p.y;
+        const bool hit = d2 <= p.w*p.w && tnear < p.z && p.z < tfar;
+        valid = avxb(int(hit));
+        u = avxf(u0);
+        t = avxf(p.z);
+      }
+      else
+      {
+        /* subdivide depth levels at once */ 
+        BezierCurve3D curve2D(w0,w1,w2,w3,0.0f,1.0f,depth);
+        const avxf* c0 = bezier_coeff0[depth];
+        const avxf* c1 = bezier_coeff1[depth];
+        const avx4f p0 = curve2D.eval(c0[0],c0[1],c0[2],c0[3]);
+        const avx4f p1 = curve2D.eval(c1[0],c1[1],c1[2],c1[3]);
+
+        /* approximative intersection with cone */
+        const avx4f v = p1-p0;
+        const avx4f w = -p0;
+        const avxf d0 = w.x*v.x + w.y*v.y;
+        const avxf d1 = v.x*v.x + v.y*v.y;
+        u = clamp(d0*rcp(d1),avxf(zero),avxf(one));
+        const avx4f p = p0 + u*v;
+        t = p.z;
+        const avxf d2 = p.x*p.x + p.y*p.y; 
+        const avxf r = p.w;
+        const avxf r2 = r*r;
+        valid = d2 <= r2 & avxf(tnear) < t & t < avxf(tfar) & avxf(step) < avxf(float(1 << depth));
+      }
+      if (likely(!round)) return;
+
+      /* replace the candidates by the exact hits of the tubes */
+      intersectTubes(curve3D,depth,org,dir,tnear,tfar,valid,u,t);
+    }
+
+    /*! returns the curve at the specified time */
+    static __forceinline BezierCurve3D curveAtTime(const Bezier1i& curve, const float time, const void* geom)
+    {
+      if (likely(curve.numTimeSteps == 1))
+        return BezierCurve3D(curve.p[0],curve.p[1],curve.p[2],curve.p[3],0.0f,1.0f,0);
+
+      const BezierCurves* curves = ((Scene*)geom)->getBezierCurves(curve.geomID);
+      const int vtx = curves->curve(curve.primID);
+      const size_t segment = curves->timeSegment(time);
+      return BezierCurve3D(curves->interpolatedVertex(vtx+0,segment,time),
+                           curves->interpolatedVertex(vtx+1,segment,time),
+                           curves->interpolatedVertex(vtx+2,segment,time),
+                           curves->interpolatedVertex(vtx+3,segment,time),
+                           0.0f,1.0f,0);
+    }
+
+    /*! replaces the candidate segments of a curve subdivided into
+     *  2^depth segments by the hits of tubes around these segments */
+    static __forceinline void intersectTubes(const BezierCurve3D& curve3D, const unsigned int depth, const Vec3fa& org, const Vec3fa& dir, 
+                                             const float tnear, const float tfar, avxb& valid, avxf& u, avxf& t)
+    {
+      const float dt = 1.0f/float(1 << depth);
+      size_t bits = movemask(valid);
+      for (size_t i=__bsf(bits); bits!=0; bits=__btc(bits,i), i=__bsf(bits)) 
+      {
+        Vec3fa a,b,T; float ti,ui;
+        curve3D.eval(float(i+0)*dt,a,T);
+        curve3D.eval(float(i+1)*dt,b,T);
+        if (intersectTube(org,dir,a,b,0.5f*(a.w+b.w),ti,ui) && tnear < ti && ti < tfar) {
+          t[i] = ti; u[i] = ui;
+        } 
+        else valid[i] = 0;
+      }
+    }
+
+    /*! calculates the geometry normal of a tube hit at distance t, P
+     *  and T are the curve point and tangent of the hit */
+    static __forceinline Vec3fa tubeNormal(const Vec3fa& org, const Vec3fa& dir, const float t, const Vec3fa& P, const Vec3fa& T)
+    {
+      const Vec3fa Q = org + t*dir - P;
+      return Q - (dot(Q,T)/dot(T,T))*T;
+    }
+
+    /*! intersects the ray with a tube of radius r around the line segment from a to b */
+    static __forceinline bool intersectTube(const Vec3fa& org, const Vec3fa& dir, const Vec3fa& a, const Vec3fa& b, const float r, float& t_o, float& u_o)
+    {
+      const float l = length(b-a);
+      if (unlikely(l == 0.0f)) return false;
+      const Vec3fa d = (b-a)/l;
+      const Vec3fa ao = org-a;
+      const float dir_d = dot(dir,d);
+      const float ao_d = dot(ao,d);
+      const Vec3fa g0 = dir - dir_d*d;
+      const Vec3fa g1 = ao - ao_d*d;
+      const float A = dot(g0,g0);
+      const float B = 2.0f*dot(g0,g1);
+      const float C = dot(g1,g1) - r*r;
+      const float D = B*B - 4.0f*A*C;
+      if (D < 0.0f || A == 0.0f) return false;
+      const float t = (-B - sqrt(D))/(2.0f*A);
+      const float u = (ao_d + t*dir_d)/l;
+      if (u < 0.0f || u > 1.0f) return false;
+      t_o = t; u_o = u;
+      return true;
+    }
+
+    /*! calculates the curve parameter and geometry normal of the ith
+     *  candidate, returns false for denormalized curves */
+    __forceinline bool hit(const size_t i, const Vec3fa& org, const Vec3fa& dir, float& uu, Vec3fa& Ng) const
+    {
+      uu = (float(i)+u[i])/float(1 << depth);
+      Vec3fa P,T; curve3D.eval(uu,P,T);
+      if (T == Vec3fa(zero)) return false;
+      Ng = likely(!round) ? T : tubeNormal(org,dir,t[i],P,T);
+      return true;
+    }
+
+  public:
+    BezierCurve3D curve3D; //!< curve in world space
+    avxb valid;            //!< segments that are hit
+    avxf u;                //!< hit location on the segments
+    avxf t;                //!< hit distances
+    unsigned int depth;    //!< number of subdivision levels
+    bool round;            //!< intersect round tube instead of ribbon
+  };
+
 #if 1
 
   /*! Intersector for a single ray with a bezier curve. */
@@ -128,43 +284,11 @@ namespace embree
 
     static __forceinline void intersect(const Precalculations& pre, Ray& ray, const Bezier1i& curve_in, const void* geom)
     {
-      /* load bezier curve control points */
       STAT3(normal.trav_prims,1,1,1);
-      const Vec3fa &v0 = curve_in.p[0];
-      const Vec3fa &v1 = curve_in.p[1];
-      const Vec3fa &v2 = curve_in.p[2];
-      const Vec3fa &v3 = curve_in.p[3];
-
-      //if (!intersectCylinder(ray,v0,v1,v2,v3)) return;
-      //if (!intersectBoxes(ray,v0,v1,v2,v3)) return;
-
-      /* transform control points into ray space */
-      Vec3fa w0 = xfmVector(pre.ray_space,v0-ray.org); w0.w = v0.w;
-      Vec3fa w1 = xfmVector(pre.ray_space,v1-ray.org); w1.w = v1.w;
-      Vec3fa w2 = xfmVector(pre.ray_space,v2-ray.org); w2.w = v2.w;
-      Vec3fa w3 = xfmVector(pre.ray_space,v3-ray.org); w3.w = v3.w;
-      BezierCurve3D curve2D(w0,w1,w2,w3,0.0f,1.0f,4);
-
-      /* subdivide 3 levels at once */ 
-      const avx4f p0 = curve2D.eval(coeff0[0],coeff0[1],coeff0[2],coeff0[3]);
-      const avx4f p1 = curve2D.eval(coeff1[0],coeff1[1],coeff1[2],coeff1[3]); // FIXME: can be calculated from p0 by shifting
-
-      /* approximative intersection with cone */
-      const avx4f v = p1-p0;
-      const avx4f w = -p0;
-      const avxf d0 = w.x*v.x + w.y*v.y;
-      const avxf d1 = v.x*v.x + v.y*v.y;
-      const avxf u = clamp(d0*rcp(d1),avxf(zero),avxf(one));
-      const avx4f p = p0 + u*v;
-      const avxf t = p.z;
-      const avxf d2 = p.x*p.x + p.y*p.y; 
-      const avxf r = p.w; //max(p.w,ray.org.w+ray.dir.w*t);
-      const avxf r2 = r*r;
-      avxb valid = d2 <= r2 & avxf(ray.tnear) < t & t < avxf(ray.tfar);
+      Bezier1iHits hits(pre.ray_space,ray.org,ray.dir,ray.tnear,ray.tfar,ray.time,curve_in,geom);
     retry:
-      if (unlikely(none(valid))) return;
-      const float one_over_8 = 1.0f/8.0f;
-      size_t i = select_min(valid,t);
+      if (unlikely(none(hits.valid))) return;
+      size_t i = select_min(hits.valid,hits.t);
 
       /* intersection filter test */
 #if defined(__INTERSECTION_FILTER__)
@@ -174,14 +298,12 @@ namespace embree
       {
 #endif
         /* update hit information */
-        const float uu = (float(i)+u[i])*one_over_8;
-        BezierCurve3D curve3D(v0,v1,v2,v3,0.0f,1.0f,0);
-        Vec3fa P,T; curve3D.eval(uu,P,T);
-        if (T == Vec3fa(zero)) { valid[i] = 0; goto retry; } // ignore denormalized curves
+        float uu; Vec3fa Ng;
+        if (!hits.hit(i,ray.org,ray.dir,uu,Ng)) { hits.valid[i] = 0; goto retry; } // ignore denormalized curves
         ray.u = uu;
         ray.v = 0.0f;
-        ray.tfar = t[i];
-        ray.Ng = T;
+        ray.tfar = hits.t[i];
+        ray.Ng = Ng;
         ray.geomID = curve_in.geomID;
         ray.primID = curve_in.primID;
 #if defined(__INTERSECTION_FILTER__)
@@ -190,14 +312,12 @@ namespace embree
 
       while (true) 
       {
-        const float uu = (float(i)+u[i])*one_over_8;
-        BezierCurve3D curve3D(v0,v1,v2,v3,0.0f,1.0f,0);
-        Vec3fa P,T; curve3D.eval(uu,P,T);
-        if (T != Vec3fa(zero))
-            if (runIntersectionFilter1(geometry,ray,uu,0.0f,t[i],T,geomID,curve_in.primID)) return;
-        valid[i] = 0;
-        if (none(valid)) return;
-        i = select_min(valid,t);
+        float uu; Vec3fa Ng;
+        if (hits.hit(i,ray.org,ray.dir,uu,Ng))
+          if (runIntersectionFilter1(geometry,ray,uu,0.0f,hits.t[i],Ng,geomID,curve_in.primID)) return;
+        hits.valid[i] = 0;
+        if (none(hits.valid)) return;
+        i = select_min(hits.valid,hits.t);
       }
 #endif
     }
@@ -220,58 +340,27 @@ namespace embree
 
     static __forceinline bool occluded(const Precalculations& pre, Ray& ray, const Bezier1i& curve_in, const void* geom) 
     {
-      /* load bezier curve control points */
       STAT3(shadow.trav_prims,1,1,1);
-      const Vec3fa v0 = curve_in.p[0];
-      const Vec3fa v1 = curve_in.p[1];
-      const Vec3fa v2 = curve_in.p[2];
-      const Vec3fa v3 = curve_in.p[3];
-
-      /* transform control points into ray space */
-      Vec3fa w0 = xfmVector(pre.ray_space,v0-ray.org); w0.w = v0.w;
-      Vec3fa w1 = xfmVector(pre.ray_space,v1-ray.org); w1.w = v1.w;
-      Vec3fa w2 = xfmVector(pre.ray_space,v2-ray.org); w2.w = v2.w;
-      Vec3fa w3 = xfmVector(pre.ray_space,v3-ray.org); w3.w = v3.w;
-      BezierCurve3D curve2D(w0,w1,w2,w3,0.0f,1.0f,4);
-
-      /* subdivide 3 levels at once */ 
-      const avx4f p0 = curve2D.eval(coeff0[0],coeff0[1],coeff0[2],coeff0[3]);
-      const avx4f p1 = curve2D.eval(coeff1[0],coeff1[1],coeff1[2],coeff1[3]);
-
-      /* approximative intersection with cone */
-      const avx4f v = p1-p0;
-      const avx4f w = -p0;
-      const avxf d0 = w.x*v.x + w.y*v.y;
-      const avxf d1 = v.x*v.x + v.y*v.y;
-      const avxf u = clamp(d0/d1,avxf(zero),avxf(one));
-      const avx4f p = p0 + u*v;
-      const avxf t = p.z;
-      const avxf d2 = p.x*p.x + p.y*p.y; 
-      const avxf r = p.w; //+ray.org.w+ray.dir.w*t;
-      const avxf r2 = r*r;
-      avxb valid = d2 <= r2 & avxf(ray.tnear) < t & t < avxf(ray.tfar);
-      if (none(valid)) return false;
+      Bezier1iHits hits(pre.ray_space,ray.org,ray.dir,ray.tnear,ray.tfar,ray.time,curve_in,geom);
+      if (none(hits.valid)) return false;
 
       /* intersection filter test */
 #if defined(__INTERSECTION_FILTER__)
 
-      size_t i = select_min(valid,t);
+      size_t i = select_min(hits.valid,hits.t);
       int geomID = curve_in.geomID;
       Geometry* geometry = ((Scene*)geom)->get(geomID);
       if (likely(!geometry->hasOcclusionFilter1())) return true;
-      const float one_over_8 = 1.0f/8.0f;
 
       while (true) 
       {
         /* calculate hit information */
-        const float uu = (float(i)+u[i])*one_over_8;
-        BezierCurve3D curve3D(v0,v1,v2,v3,0.0f,1.0f,0);
-        Vec3fa P,T; curve3D.eval(uu,P,T);
-        if (T != Vec3fa(zero))
-          if (runOcclusionFilter1(geometry,ray,uu,0.0f,t[i],T,geomID,curve_in.primID)) break;
-        valid[i] = 0;
-        if (none(valid)) return false;
-        i = select_min(valid,t);
+        float uu; Vec3fa Ng;
+        if (hits.hit(i,ray.org,ray.dir,uu,Ng))
+          if (runOcclusionFilter1(geometry,ray,uu,0.0f,hits.t[i],Ng,geomID,curve_in.primID)) break;
+        hits.valid[i] = 0;
+        if (none(hits.valid)) return false;
+        i = select_min(hits.valid,hits.t);
       }
 #endif
       return true;
@@ -0,0 +1,177 @@
+// ======================================================================== //
+// Copyright 2009-2013 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "bezier1i_intersector1.h"
+#include "common/ray4.h"
+#if defined(__AVX__)
+#include "common/ray8.h"
+#endif
+#include "geometry/filter.h"
+
+namespace embree
+{
+  /*! Mask type and filter functions of a ray packet type. */
+  template<typename RayN> struct Bezier1iPacket {};
+
+  template<> struct Bezier1iPacket<Ray4>
+  {
+    typedef sseb simdb;
+
+    static __forceinline bool hasIntersectionFilter(const Geometry* geometry) { return geometry->hasIntersectionFilter4(); }
+    static __forceinline bool hasOcclusionFilter   (const Geometry* geometry) { return geometry->hasOcclusionFilter4(); }
+
+    static __forceinline bool runIntersectionFilter(const Geometry* geometry, Ray4& ray, const size_t k, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) {
+      return runIntersectionFilter4(geometry,ray,k,u,v,t,Ng,geomID,primID);
+    }
+
+    static __forceinline bool runOcclusionFilter(const Geometry* geometry, Ray4& ray, const size_t k, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) {
+      return runOcclusionFilter4(geometry,ray,k,u,v,t,Ng,geomID,primID);
+    }
+  };
+
+#if defined(__AVX__)
+  template<> struct Bezier1iPacket<Ray8>
+  {
+    typedef avxb simdb;
+
+    static __forceinline bool hasIntersectionFilter(const Geometry* geometry) { return geometry->hasIntersectionFilter8(); }
+    static __forceinline bool hasOcclusionFilter   (const Geometry* geometry) { return geometry->hasOcclusionFilter8(); }
+
+    static __forceinline bool runIntersectionFilter(const Geometry* geometry, Ray8& ray, const size_t k, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) {
+      return runIntersectionFilter8(geometry,ray,k,u,v,t,Ng,geomID,primID);
+    }
+
+    static __forceinline bool runOcclusionFilter(const Geometry* geometry, Ray8& ray, const size_t k, const float& u, const float& v, const float& t, const Vec3fa& Ng, const int geomID, const int primID) {
+      return runOcclusionFilter8(geometry,ray,k,u,v,t,Ng,geomID,primID);
+    }
+  };
+#endif
+
+  /*! Intersector for a packet of rays with a bezier curve. The line
+   *  segments of the subdivided curve are tested in parallel against
+   *  each active ray of the packet. */
+  template<typename RayN>
+  struct Bezier1iIntersectorN
+  {
+    typedef Bezier1i Primitive;
+    typedef Bezier1iPacket<RayN> Packet;
+    typedef typename Packet::simdb simdb;
+
+    static __forceinline void intersect(const LinearSpace3fa& ray_space, RayN& ray, const size_t k, const Bezier1i& curve_in, const void* geom)
+    {
+      STAT3(normal.trav_prims,1,1,1);
+      const Vec3fa org(ray.org.x[k],ray.org.y[k],ray.org.z[k]);
+      const Vec3fa dir(ray.dir.x[k],ray.dir.y[k],ray.dir.z[k]);
+      Bezier1iHits hits(ray_space,org,dir,ray.tnear[k],ray.tfar[k],ray.time[k],curve_in,geom);
+    retry:
+      if (unlikely(none(hits.valid))) return;
+      size_t i = select_min(hits.valid,hits.t);
+
+      /* intersection filter test */
+#if defined(__INTERSECTION_FILTER__)
+      int geomID = curve_in.geomID;
+      Geometry* geometry = ((Scene*)geom)->get(geomID);
+      if (!likely(Packet::hasIntersectionFilter(geometry))) 
+      {
+#endif
+        /* update hit information */
+        float uu; Vec3fa Ng;
+        if (!hits.hit(i,org,dir,uu,Ng)) { hits.valid[i] = 0; goto retry; } // ignore denormalized curves
+        ray.u[k] = uu;
+        ray.v[k] = 0.0f;
+        ray.tfar[k] = hits.t[i];
+        ray.Ng.x[k] = Ng.x;
+        ray.Ng.y[k] = Ng.y;
+        ray.Ng.z[k] = Ng.z;
+        ray.geomID[k] = curve_in.geomID;
+        ray.primID[k] = curve_in.primID;
+#if defined(__INTERSECTION_FILTER__)
+          return;
+      }
+
+      while (true) 
+      {
+        float uu; Vec3fa Ng;
+        if (hits.hit(i,org,dir,uu,Ng))
+          if (Packet::runIntersectionFilter(geometry,ray,k,uu,0.0f,hits.t[i],Ng,geomID,curve_in.primID)) return;
+        hits.valid[i] = 0;
+        if (none(hits.valid)) return;
+        i = select_min(hits.valid,hits.t);
+      }
+#endif
+    }
+
+    static __forceinline void intersect(const simdb& valid, RayN& ray, const Bezier1i* curves, size_t num, void* geom)
+    {
+      size_t bits = movemask(valid);
+      for (size_t k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits)) 
+      {
+        const LinearSpace3fa ray_space = rcp(frame(Vec3fa(ray.dir.x[k],ray.dir.y[k],ray.dir.z[k])));
+        for (size_t i=0; i<num; i++)
+          intersect(ray_space,ray,k,curves[i],geom);
+      }
+    }
+
+    static __forceinline bool occluded(const LinearSpace3fa& ray_space, RayN& ray, const size_t k, const Bezier1i& curve_in, const void* geom) 
+    {
+      STAT3(shadow.trav_prims,1,1,1);
+      const Vec3fa org(ray.org.x[k],ray.org.y[k],ray.org.z[k]);
+      const Vec3fa dir(ray.dir.x[k],ray.dir.y[k],ray.dir.z[k]);
+      Bezier1iHits hits(ray_space,org,dir,ray.tnear[k],ray.tfar[k],ray.time[k],curve_in,geom);
+      if (none(hits.valid)) return false;
+
+      /* intersection filter test */
+#if defined(__INTERSECTION_FILTER__)
+
+      size_t i = select_min(hits.valid,hits.t);
+      int geomID = curve_in.geomID;
+      Geometry* geometry = ((Scene*)geom)->get(geomID);
+      if (likely(!Packet::hasOcclusionFilter(geometry))) return true;
+
+      while (true) 
+      {
+        /* calculate hit information */
+        float uu; Vec3fa Ng;
+        if (hits.hit(i,org,dir,uu,Ng))
+          if (Packet::runOcclusionFilter(geometry,ray,k,uu,0.0f,hits.t[i],Ng,geomID,curve_in.primID)) break;
+        hits.valid[i] = 0;
+        if (none(hits.valid)) return false;
+        i = select_min(hits.valid,hits.t);
+      }
+#endif
+      return true;
+    }
+
+    static __forceinline simdb occluded(const simdb& valid, RayN& ray, const Bezier1i* curves, size_t num, void* geom) 
+    {
+      simdb terminated = false;
+      size_t bits = movemask(valid);
+      for (size_t k=__bsf(bits); bits!=0; bits=__btc(bits,k), k=__bsf(bits)) 
+      {
+        const LinearSpace3fa ray_space = rcp(frame(Vec3fa(ray.dir.x[k],ray.dir.y[k],ray.dir.z[k])));
+        for (size_t i=0; i<num; i++) {
+          if (occluded(ray_space,ray,k,curves[i],geom)) {
+            terminated[k] = -1;
+            break;
+          }
+        }
+      }
+      return terminated;
+    }
+  };
+}
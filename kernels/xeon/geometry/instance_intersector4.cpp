@@ -21,6 +21,41 @@ namespace embree
   namespace isa
   {
     typedef AffineSpaceT<LinearSpace3<sse3f> > AffineSpace3faSSE;
+
+    /*! transforms the rays into the local space of the instance, for
+     *  motion blurred instances the transformation gets interpolated
+     *  at the time of each ray */
+    static __forceinline void transformRays(const sseb& valid_i, const UserGeometryScene::Instance* instance, Ray4& ray, const sse3f& ray_org, const sse3f& ray_dir)
+    {
+      if (likely(instance->numTimeSteps == 1)) {
+        const AffineSpace3faSSE world2local(instance->world2local);
+        ray.org = xfmPoint (world2local,ray_org);
+        ray.dir = xfmVector(world2local,ray_dir);
+        return;
+      }
+
+      /* the rays of each time segment share the transformations they interpolate */
+      ssei segments;
+      for (size_t i=0; i<4; i++) segments[i] = (int)instance->timeSegment(ray.time[i]);
+      sseb todo = valid_i;
+      while (any(todo))
+      {
+        const int segment = segments[__bsf(movemask(todo))];
+        const sseb valid = todo & (segments == ssei(segment));
+        const AffineSpace3faSSE xfm0(instance->local2world[segment+0]);
+        const AffineSpace3faSSE xfm1(instance->local2world[segment+1]);
+        ssef f = ray.time*float(instance->numTimeSteps-1)-float(segment);
+        /* rays where the blend becomes singular use the nearest time step */
+        const ssef det = (xfm0 + f*(xfm1-xfm0)).l.det();
+        f = select(abs(det) < ssef(instance->singularDet(segment)),select(f < 0.5f,ssef(0.0f),ssef(1.0f)),f);
+        const AffineSpace3faSSE world2local = rcp(xfm0 + f*(xfm1-xfm0));
+        const sse3f org = xfmPoint (world2local,ray_org);
+        const sse3f dir = xfmVector(world2local,ray_dir);
+        ray.org = sse3f(select(valid,org.x,ray.org.x),select(valid,org.y,ray.org.y),select(valid,org.z,ray.org.z));
+        ray.dir = sse3f(select(valid,dir.x,ray.dir.x),select(valid,dir.y,ray.dir.y),select(valid,dir.z,ray.dir.z));
+        todo = todo & !valid;
+      }
+    }
     
     void FastInstanceIntersector4::intersect(sseb* valid, const UserGeometryScene::Instance* instance, Ray4& ray, size_t item)
     {
@@ -28,31 +63,38 @@ namespace embree
       const sse3f ray_dir = ray.dir;
       const ssei ray_geomID = ray.geomID;
       const ssei ray_instID = ray.instID;
-      const AffineSpace3faSSE world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
+      ssei ray_subInstID[RTC_MAX_INSTANCE_LEVELS-1];
+      for (size_t i=0; i<RTC_MAX_INSTANCE_LEVELS-1; i++) {
+        ray_subInstID[i] = ray.subInstID[i];
+        ray.subInstID[i] = -1;
+      }
+      transformRays(*valid,instance,ray,ray_org,ray_dir);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      ray.instID = -1;
       instance->object->intersect4(valid,(RTCRay4&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      /* the instantiated scene reports the instances below this one */
       sseb nohit = ray.geomID == ssei(-1);
       ray.geomID = select(nohit,ray_geomID,ray.geomID);
-      ray.instID = select(nohit,ray_instID,ray.instID);
+      for (size_t i=RTC_MAX_INSTANCE_LEVELS-2; i>0; i--)
+        ray.subInstID[i] = select(nohit,ray_subInstID[i],ray.subInstID[i-1]);
+      ray.subInstID[0] = select(nohit,ray_subInstID[0],ray.instID);
+      ray.instID = select(nohit,ray_instID,ssei(instance->id));
     }
     
     void FastInstanceIntersector4::occluded (sseb* valid, const UserGeometryScene::Instance* instance, Ray4& ray, size_t item)
     {
       const sse3f ray_org = ray.org;
       const sse3f ray_dir = ray.dir;
-      const ssei ray_geomID = ray.geomID;
-      const AffineSpace3faSSE world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
-      ray.instID = instance->id;
+      const ssei ray_instID = ray.instID;
+      transformRays(*valid,instance,ray,ray_org,ray_dir);
       instance->object->occluded4(valid,(RTCRay4&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      /* only rays that got occluded by the instance keep its ID */
+      const sseb occluded = *valid & (ray.geomID == ssei(zero));
+      ray.instID = select(occluded,ssei(instance->id),ray_instID);
     }
 
     DEFINE_SET_INTERSECTOR4(InstanceIntersector4,FastInstanceIntersector4);
@@ -21,6 +21,41 @@ namespace embree
   namespace isa
   {
     typedef AffineSpaceT<LinearSpace3<avx3f> > AffineSpace3faAVX;
+
+    /*! transforms the rays into the local space of the instance, for
+     *  motion blurred instances the transformation gets interpolated
+     *  at the time of each ray */
+    static __forceinline void transformRays(const avxb& valid_i, const UserGeometryScene::Instance* instance, Ray8& ray, const avx3f& ray_org, const avx3f& ray_dir)
+    {
+      if (likely(instance->numTimeSteps == 1)) {
+        const AffineSpace3faAVX world2local(instance->world2local);
+        ray.org = xfmPoint (world2local,ray_org);
+        ray.dir = xfmVector(world2local,ray_dir);
+        return;
+      }
+
+      /* the rays of each time segment share the transformations they interpolate */
+      avxi segments;
+      for (size_t i=0; i<8; i++) segments[i] = (int)instance->timeSegment(ray.time[i]);
+      avxb todo = valid_i;
+      while (any(todo))
+      {
+        const int segment = segments[__bsf(movemask(todo))];
+        const avxb valid = todo & (segments == avxi(segment));
+        const AffineSpace3faAVX xfm0(instance->local2world[segment+0]);
+        const AffineSpace3faAVX xfm1(instance->local2world[segment+1]);
+        avxf f = ray.time*float(instance->numTimeSteps-1)-float(segment);
+        /* rays where the blend becomes singular use the nearest time step */
+        const avxf det = (xfm0 + f*(xfm1-xfm0)).l.det();
+        f = select(abs(det) < avxf(instance->singularDet(segment)),select(f < 0.5f,avxf(0.0f),avxf(1.0f)),f);
+        const AffineSpace3faAVX world2local = rcp(xfm0 + f*(xfm1-xfm0));
+        const avx3f org = xfmPoint (world2local,ray_org);
+        const avx3f dir = xfmVector(world2local,ray_dir);
+        ray.org = avx3f(select(valid,org.x,ray.org.x),select(valid,org.y,ray.org.y),select(valid,org.z,ray.org.z));
+        ray.dir = avx3f(select(valid,dir.x,ray.dir.x),select(valid,dir.y,ray.dir.y),select(valid,dir.z,ray.dir.z));
+        todo = todo & !valid;
+      }
+    }
     
     void FastInstanceIntersector8::intersect(avxb* valid, const UserGeometryScene::Instance* instance, Ray8& ray, size_t item)
     {
@@ -28,31 +63,38 @@ namespace embree
       const avx3f ray_dir = ray.dir;
       const avxi ray_geomID = ray.geomID;
       const avxi ray_instID = ray.instID;
-      const AffineSpace3faAVX world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
+      avxi ray_subInstID[RTC_MAX_INSTANCE_LEVELS-1];
+      for (size_t i=0; i<RTC_MAX_INSTANCE_LEVELS-1; i++) {
+        ray_subInstID[i] = ray.subInstID[i];
+        ray.subInstID[i] = -1;
+      }
+      transformRays(*valid,instance,ray,ray_org,ray_dir);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      ray.instID = -1;
       instance->object->intersect8(valid,(RTCRay8&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      /* the instantiated scene reports the instances below this one */
       avxb nohit = ray.geomID == avxi(-1);
       ray.geomID = select(nohit,ray_geomID,ray.geomID);
-      ray.instID = select(nohit,ray_instID,ray.instID);
+      for (size_t i=RTC_MAX_INSTANCE_LEVELS-2; i>0; i--)
+        ray.subInstID[i] = select(nohit,ray_subInstID[i],ray.subInstID[i-1]);
+      ray.subInstID[0] = select(nohit,ray_subInstID[0],ray.instID);
+      ray.instID = select(nohit,ray_instID,avxi(instance->id));
     }
     
     void FastInstanceIntersector8::occluded (avxb* valid, const UserGeometryScene::Instance* instance, Ray8& ray, size_t item)
     {
       const avx3f ray_org = ray.org;
       const avx3f ray_dir = ray.dir;
-      const avxi ray_geomID = ray.geomID;
-      const AffineSpace3faAVX world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
-      ray.instID = instance->id;
+      const avxi ray_instID = ray.instID;
+      transformRays(*valid,instance,ray,ray_org,ray_dir);
       instance->object->occluded8(valid,(RTCRay8&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      /* only rays that got occluded by the instance keep its ID */
+      const avxb occluded = *valid & (ray.geomID == avxi(zero));
+      ray.instID = select(occluded,avxi(instance->id),ray_instID);
     }
 
     DEFINE_SET_INTERSECTOR8(InstanceIntersector8,FastInstanceIntersector8);
@@ -39,8 +39,14 @@ namespace embree
     /*! Updates all primitives stored in a leaf */
     virtual BBox3fa update(char* prim, size_t num, void* geom) const { return BBox3fa(empty); }
 
-    /*! Updates all primitives stored in a leaf */
-    virtual std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom) const { return std::pair<BBox3fa,BBox3fa>(empty,empty); }
+    /*! Updates all motion blur primitives stored in a leaf for the time range [time0,time1] and returns their bounds at time0 and time1 */
+    virtual std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom, float time0, float time1) const { return std::pair<BBox3fa,BBox3fa>(empty,empty); }
+
+    /*! Prepares a copy of the primitives of a leaf for storing them to a file, returns false if the primitives cannot get stored */
+    virtual bool store(char* prim, size_t num, void* geom) const { return !needVertices; }
+
+    /*! Prepares primitives loaded from a file for rendering, returns false if they do not match the geometry */
+    virtual bool restore(char* prim, size_t num, void* geom) const { return !needVertices; }
 
   public:
     std::string name;       //!< name of this primitive type
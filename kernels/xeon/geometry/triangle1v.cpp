@@ -146,21 +146,41 @@ namespace embree
     return 1;
   }
 
+  /*! Packs the linear motion of the time segment of the mesh that
+   *  contains the time range [time0,time1]. The vertices are
+   *  extrapolated to time 0 and time 1, thus the intersectors
+   *  interpolate directly with the time of the ray. */
+  static __forceinline void packMB(char* dst, const TriangleMesh* mesh, unsigned primID, float time0, float time1)
+  {
+    const TriangleMesh::Triangle& tri = mesh->triangle(primID);
+    const size_t segment = mesh->timeSegment(0.5f*(time0+time1));
+    const Vec3fa a0 = mesh->interpolatedVertex(tri.v[0],segment,0.0f);
+    const Vec3fa a1 = mesh->interpolatedVertex(tri.v[0],segment,1.0f);
+    const Vec3fa b0 = mesh->interpolatedVertex(tri.v[1],segment,0.0f);
+    const Vec3fa b1 = mesh->interpolatedVertex(tri.v[1],segment,1.0f);
+    const Vec3fa c0 = mesh->interpolatedVertex(tri.v[2],segment,0.0f);
+    const Vec3fa c1 = mesh->interpolatedVertex(tri.v[2],segment,1.0f);
+    new (dst) Triangle1vMB(a0,a1,b0,b1,c0,c1,mesh->id,primID,mesh->mask);
+  }
+
+  /*! Bounds of the triangles of a leaf at time0 and time1. */
+  static __forceinline std::pair<BBox3fa,BBox3fa> boundsMB(const Triangle1vMB* tris, size_t num, float time0, float time1)
+  {
+    BBox3fa bounds0 = empty, bounds1 = empty;
+    for (size_t j=0; j<num; j++) 
+    {
+      const Triangle1vMB& tri = tris[j];
+      bounds0.extend(merge(BBox3fa(tri.v0+time0*tri.d0),BBox3fa(tri.v1+time0*tri.d1),BBox3fa(tri.v2+time0*tri.d2)));
+      bounds1.extend(merge(BBox3fa(tri.v0+time1*tri.d0),BBox3fa(tri.v1+time1*tri.d1),BBox3fa(tri.v2+time1*tri.d2)));
+    }
+    return std::pair<BBox3fa,BBox3fa>(bounds0,bounds1);
+  }
+
   void SceneTriangle1vMB::pack(char* dst, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const 
   {
     Scene* scene = (Scene*) geom;
     const PrimRef& prim = *prims;
-    const unsigned geomID = prim.geomID();
-    const unsigned primID = prim.primID();
-    const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
-    const TriangleMesh::Triangle& tri = mesh->triangle(primID);
-    const Vec3fa& a0 = mesh->vertex(tri.v[0],0);
-    const Vec3fa& a1 = mesh->vertex(tri.v[0],1);
-    const Vec3fa& b0 = mesh->vertex(tri.v[1],0);
-    const Vec3fa& b1 = mesh->vertex(tri.v[1],1);
-    const Vec3fa& c0 = mesh->vertex(tri.v[2],0);
-    const Vec3fa& c1 = mesh->vertex(tri.v[2],1);
-    new (dst) Triangle1vMB(a0,a1,b0,b1,c0,c1,mesh->id,primID,mesh->mask);
+    packMB(dst,scene->getTriangleMesh(prim.geomID()),prim.primID(),0.0f,1.0f);
     prims++;
   }
     
@@ -168,77 +188,47 @@ namespace embree
   {
     Scene* scene = (Scene*) geom;
     const PrimRef& prim = *prims;
-    const unsigned geomID = prim.geomID();
-    const unsigned primID = prim.primID();
-    const TriangleMesh* mesh = scene->getTriangleMesh(geomID);
-    const TriangleMesh::Triangle& tri = mesh->triangle(primID);
-    const Vec3fa& a0 = mesh->vertex(tri.v[0],0);
-    const Vec3fa& a1 = mesh->vertex(tri.v[0],1);
-    const Vec3fa& b0 = mesh->vertex(tri.v[1],0);
-    const Vec3fa& b1 = mesh->vertex(tri.v[1],1);
-    const Vec3fa& c0 = mesh->vertex(tri.v[2],0);
-    const Vec3fa& c1 = mesh->vertex(tri.v[2],1);
-    new (dst) Triangle1vMB(a0,a1,b0,b1,c0,c1,mesh->id,primID,mesh->mask);
+    packMB(dst,scene->getTriangleMesh(prim.geomID()),prim.primID(),0.0f,1.0f);
     prims++;
   }
   
-  std::pair<BBox3fa,BBox3fa> SceneTriangle1vMB::update2(char* prim, size_t num, void* geom) const 
+  std::pair<BBox3fa,BBox3fa> SceneTriangle1vMB::update2(char* prim, size_t num, void* geom, float time0, float time1) const 
   {
-    BBox3fa bounds0 = empty, bounds1 = empty;
-    
-    for (size_t j=0; j<num; j++) 
-    {
-      const Triangle1vMB& tri = ((Triangle1vMB*) prim)[j];
-      bounds0.extend(merge(BBox3fa(tri.v0),BBox3fa(tri.v1),BBox3fa(tri.v2)));
-      bounds1.extend(merge(BBox3fa(tri.v0+tri.d0),BBox3fa(tri.v1+tri.d1),BBox3fa(tri.v2+tri.d2)));
+    Scene* scene = (Scene*) geom;
+    Triangle1vMB* tris = (Triangle1vMB*) prim;
+
+    /* meshes with more than two time steps move differently in each time segment */
+    for (size_t j=0; j<num; j++) {
+      const TriangleMesh* mesh = scene->getTriangleMesh(tris[j].geomID());
+      if (mesh->numTimeSteps > 2) packMB((char*)&tris[j],mesh,tris[j].primID(),time0,time1);
     }
-    return std::pair<BBox3fa,BBox3fa>(bounds0,bounds1);
+    return boundsMB(tris,num,time0,time1);
   }
 
   void TriangleMeshTriangle1vMB::pack(char* dst, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const 
   {
     const PrimRef& prim = *prims;
-    const unsigned geomID = prim.geomID();
-    const unsigned primID = prim.primID();
-    const TriangleMesh* mesh = (TriangleMesh*) geom;
-    const TriangleMesh::Triangle& tri = mesh->triangle(primID);
-    const Vec3fa& a0 = mesh->vertex(tri.v[0],0);
-    const Vec3fa& a1 = mesh->vertex(tri.v[0],1);
-    const Vec3fa& b0 = mesh->vertex(tri.v[1],0);
-    const Vec3fa& b1 = mesh->vertex(tri.v[1],1);
-    const Vec3fa& c0 = mesh->vertex(tri.v[2],0);
-    const Vec3fa& c1 = mesh->vertex(tri.v[2],1);
-    new (dst) Triangle1vMB(a0,a1,b0,b1,c0,c1,mesh->id,primID,mesh->mask);
+    packMB(dst,(TriangleMesh*) geom,prim.primID(),0.0f,1.0f);
     prims++;
   }
   
   void TriangleMeshTriangle1vMB::pack(char* dst, const PrimRef* prims, size_t num, void* geom) const 
   {
     const PrimRef& prim = *prims;
-    const unsigned geomID = prim.geomID();
-    const unsigned primID = prim.primID();
-    const TriangleMesh* mesh = (TriangleMesh*) geom;
-    const TriangleMesh::Triangle& tri = mesh->triangle(primID);
-    const Vec3fa& a0 = mesh->vertex(tri.v[0],0);
-    const Vec3fa& a1 = mesh->vertex(tri.v[0],1);
-    const Vec3fa& b0 = mesh->vertex(tri.v[1],0);
-    const Vec3fa& b1 = mesh->vertex(tri.v[1],1);
-    const Vec3fa& c0 = mesh->vertex(tri.v[2],0);
-    const Vec3fa& c1 = mesh->vertex(tri.v[2],1);
-    new (dst) Triangle1vMB(a0,a1,b0,b1,c0,c1,mesh->id,primID,mesh->mask);
+    packMB(dst,(TriangleMesh*) geom,prim.primID(),0.0f,1.0f);
     prims++;
   }
 
-  std::pair<BBox3fa,BBox3fa> TriangleMeshTriangle1vMB::update2(char* prim, size_t num, void* geom) const 
+  std::pair<BBox3fa,BBox3fa> TriangleMeshTriangle1vMB::update2(char* prim, size_t num, void* geom, float time0, float time1) const 
   {
-    BBox3fa bounds0 = empty, bounds1 = empty;
-    
-    for (size_t j=0; j<num; j++) 
-    {
-      const Triangle1vMB& tri = ((Triangle1vMB*) prim)[j];
-      bounds0.extend(merge(BBox3fa(tri.v0),BBox3fa(tri.v1),BBox3fa(tri.v2)));
-      bounds1.extend(merge(BBox3fa(tri.v0+tri.d0),BBox3fa(tri.v1+tri.d1),BBox3fa(tri.v2+tri.d2)));
+    const TriangleMesh* mesh = (const TriangleMesh*) geom;
+    Triangle1vMB* tris = (Triangle1vMB*) prim;
+
+    /* meshes with more than two time steps move differently in each time segment */
+    if (mesh->numTimeSteps > 2) {
+      for (size_t j=0; j<num; j++) 
+        packMB((char*)&tris[j],mesh,tris[j].primID(),time0,time1);
     }
-    return std::pair<BBox3fa,BBox3fa>(bounds0,bounds1);
+    return boundsMB(tris,num,time0,time1);
   }
 }
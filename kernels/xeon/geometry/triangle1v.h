@@ -89,12 +89,12 @@ namespace embree
     __forceinline unsigned mask  () const { return v2.a; }
     
   public:
-    Vec3fa v0;          //!< first vertex at t0 (and primitive ID)
-    Vec3fa v1;          //!< second vertex at t0 (and geometry ID)
-    Vec3fa v2;          //!< third vertex at t0 (and geometry mask)
-    Vec3fa d0;          //!< difference vector between time steps t0 and t1 for first vertex
-    Vec3fa d1;          //!< difference vector between time steps t0 and t1 for second vertex
-    Vec3fa d2;          //!< difference vector between time steps t0 and t1 for third vertex
+    Vec3fa v0;          //!< first vertex at time 0 (and primitive ID)
+    Vec3fa v1;          //!< second vertex at time 0 (and geometry ID)
+    Vec3fa v2;          //!< third vertex at time 0 (and geometry mask)
+    Vec3fa d0;          //!< difference vector between time 0 and time 1 for first vertex
+    Vec3fa d1;          //!< difference vector between time 0 and time 1 for second vertex
+    Vec3fa d2;          //!< difference vector between time 0 and time 1 for third vertex
   };
 
   struct Triangle1vMBType : public PrimitiveType {
@@ -108,7 +108,7 @@ namespace embree
     static SceneTriangle1vMB type;
     void pack(char* dst, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
     void pack(char* dst, const PrimRef* prims, size_t num, void* geom) const;
-    std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom) const;
+    std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom, float time0, float time1) const;
   };
 
   struct TriangleMeshTriangle1vMB : public Triangle1vMBType
@@ -116,6 +116,6 @@ namespace embree
     static TriangleMeshTriangle1vMB type;
     void pack(char* dst, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
     void pack(char* dst, const PrimRef* prims, size_t num, void* geom) const;
-    std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom) const;
+    std::pair<BBox3fa,BBox3fa> update2(char* prim, size_t num, void* geom, float time0, float time1) const;
   };
 }
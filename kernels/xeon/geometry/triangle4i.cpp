@@ -65,4 +65,45 @@ namespace embree
     
     new (This) Triangle4i(v0,v1,v2,geomID,primID);
   }
+
+  bool Triangle4iType::store(char* This, size_t num, void* geom) const 
+  {
+    /* vertex pointers are only valid in this process, restore recomputes them from the triangles */
+    Triangle4i* prims = (Triangle4i*) This;
+    for (size_t j=0; j<num; j++) 
+      for (size_t i=0; i<4; i++) 
+        prims[j].v0[i] = NULL;
+    return true;
+  }
+
+  bool Triangle4iType::restore(char* This, size_t num, void* geom) const 
+  {
+    Scene* scene = (Scene*) geom;
+    Triangle4i* prims = (Triangle4i*) This;
+    for (size_t j=0; j<num; j++) 
+    {
+      Triangle4i& prim = prims[j];
+      for (size_t i=0; i<4; i++)
+      {
+        /* invalid triangles repeat the previous vertex, the first triangle is always valid */
+        if (prim.geomID[i] == -1) {
+          if (i == 0 || prim.primID[i] != -1) return false;
+          prim.v0[i] = prim.v0[i-1]; prim.v1[i] = 0; prim.v2[i] = 0;
+          continue;
+        }
+
+        /* the stored IDs have to reference existing triangles */
+        const int geomID = prim.geomID[i], primID = prim.primID[i];
+        if (geomID < 0 || size_t(geomID) >= scene->size()) return false;
+        const TriangleMesh* mesh = scene->getTriangleMeshSafe(geomID);
+        if (mesh == NULL || primID < 0 || size_t(primID) >= mesh->numTriangles) return false;
+
+        const TriangleMesh::Triangle& tri = mesh->triangle(primID);
+        prim.v0[i] = (const Vec3f*) &mesh->vertex(tri.v[0]);
+        prim.v1[i] = (int*)&mesh->vertex(tri.v[1])-(int*)prim.v0[i];
+        prim.v2[i] = (int*)&mesh->vertex(tri.v[2])-(int*)prim.v0[i];
+      }
+    }
+    return true;
+  }
 }
@@ -68,5 +68,7 @@ namespace embree
     size_t blocks(size_t x) const;
     size_t size(const char* This) const;
     void pack(char* This, atomic_set<PrimRefBlock>::block_iterator_unsafe& prims, void* geom) const;
+    bool store(char* This, size_t num, void* geom) const;
+    bool restore(char* This, size_t num, void* geom) const;
   };
 }
@@ -19,6 +19,7 @@
 #include "triangle4i.h"
 #include "common/ray.h"
 #include "common/scene_triangle_mesh.h"
+#include "geometry/filter.h"
 
 namespace embree
 {
@@ -18,6 +18,7 @@
 
 #include "triangle4i.h"
 #include "common/ray4.h"
+#include "geometry/filter.h"
 
 namespace embree
 {
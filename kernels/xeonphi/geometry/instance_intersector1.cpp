@@ -22,19 +22,31 @@ namespace embree
   {
     void InstanceBoundsFunction(const UserGeometryScene::Instance* instance, size_t item, BBox3fa& bounds_o)
     {
+      /* an empty instantiated scene does not contribute to the bounds */
+      if (instance->object->bounds.empty()) {
+        bounds_o = empty;
+        return;
+      }
+      /* the bounds of the transformed object at each time step bound
+         the motion in between, as the corners of the object bounds
+         move linearly between neighbouring time steps */
       Vec3fa lower = instance->object->bounds.lower;
       Vec3fa upper = instance->object->bounds.upper;
-      AffineSpace3fa local2world = instance->local2world;
-      Vec3fa p000 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,lower.z));
-      Vec3fa p001 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,upper.z));
-      Vec3fa p010 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,lower.z));
-      Vec3fa p011 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,upper.z));
-      Vec3fa p100 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,lower.z));
-      Vec3fa p101 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,upper.z));
-      Vec3fa p110 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,lower.z));
-      Vec3fa p111 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,upper.z));
-      bounds_o.lower = min(min(min(p000,p001),min(p010,p011)),min(min(p100,p101),min(p110,p111)));
-      bounds_o.upper = max(max(max(p000,p001),max(p010,p011)),max(max(p100,p101),max(p110,p111)));
+      bounds_o = empty;
+      for (size_t t=0; t<instance->numTimeSteps; t++)
+      {
+        const AffineSpace3fa& local2world = instance->local2world[t];
+        Vec3fa p000 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,lower.z));
+        Vec3fa p001 = xfmPoint(local2world,Vec3fa(lower.x,lower.y,upper.z));
+        Vec3fa p010 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,lower.z));
+        Vec3fa p011 = xfmPoint(local2world,Vec3fa(lower.x,upper.y,upper.z));
+        Vec3fa p100 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,lower.z));
+        Vec3fa p101 = xfmPoint(local2world,Vec3fa(upper.x,lower.y,upper.z));
+        Vec3fa p110 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,lower.z));
+        Vec3fa p111 = xfmPoint(local2world,Vec3fa(upper.x,upper.y,upper.z));
+        bounds_o.lower = min(bounds_o.lower,min(min(min(p000,p001),min(p010,p011)),min(min(p100,p101),min(p110,p111))));
+        bounds_o.upper = max(bounds_o.upper,max(max(max(p000,p001),max(p010,p011)),max(max(p100,p101),max(p110,p111))));
+      }
     }
 
     RTCBoundsFunc InstanceBoundsFunc = (RTCBoundsFunc) InstanceBoundsFunction;
@@ -45,16 +57,31 @@ namespace embree
       const Vec3fa ray_dir = ray.dir;
       const int ray_geomID = ray.geomID;
       const int ray_instID = ray.instID;
-      ray.org = xfmPoint (instance->world2local,ray_org);
-      ray.dir = xfmVector(instance->world2local,ray_dir);
+      int ray_subInstID[RTC_MAX_INSTANCE_LEVELS-1];
+      for (size_t i=0; i<RTC_MAX_INSTANCE_LEVELS-1; i++) {
+        ray_subInstID[i] = ray.subInstID[i];
+        ray.subInstID[i] = -1;
+      }
+      const AffineSpace3fa world2local = instance->getWorld2Local(ray.time);
+      ray.org = xfmPoint (world2local,ray_org);
+      ray.dir = xfmVector(world2local,ray_dir);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      ray.instID = -1;
       instance->object->intersect((RTCRay&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
       if (ray.geomID == -1) {
         ray.geomID = ray_geomID;
         ray.instID = ray_instID;
+        for (size_t i=0; i<RTC_MAX_INSTANCE_LEVELS-1; i++)
+          ray.subInstID[i] = ray_subInstID[i];
+      }
+      /* the instantiated scene reports the instances below this one */
+      else {
+        for (size_t i=RTC_MAX_INSTANCE_LEVELS-2; i>0; i--)
+          ray.subInstID[i] = ray.subInstID[i-1];
+        ray.subInstID[0] = ray.instID;
+        ray.instID = instance->id;
       }
     }
     
@@ -62,11 +89,13 @@ namespace embree
     {
       const Vec3fa ray_org = ray.org;
       const Vec3fa ray_dir = ray.dir;
-      ray.org = xfmPoint (instance->world2local,ray_org);
-      ray.dir = xfmVector(instance->world2local,ray_dir);
+      const AffineSpace3fa world2local = instance->getWorld2Local(ray.time);
+      ray.org = xfmPoint (world2local,ray_org);
+      ray.dir = xfmVector(world2local,ray_dir);
       instance->object->occluded((RTCRay&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      if (ray.geomID == 0) ray.instID = instance->id;
     }
     
     DEFINE_SET_INTERSECTOR1(InstanceIntersector1,FastInstanceIntersector1);
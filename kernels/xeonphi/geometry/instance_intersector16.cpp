@@ -21,6 +21,41 @@ namespace embree
   namespace isa
   {
     typedef AffineSpaceT<LinearSpace3<mic3f> > AffineSpace3faMIC;
+
+    /*! transforms the rays into the local space of the instance, for
+     *  motion blurred instances the transformation gets interpolated
+     *  at the time of each ray */
+    static __forceinline void transformRays(const mic_m& valid_i, const UserGeometryScene::Instance* instance, Ray16& ray, const mic3f& ray_org, const mic3f& ray_dir)
+    {
+      if (likely(instance->numTimeSteps == 1)) {
+        const AffineSpace3faMIC world2local(instance->world2local);
+        ray.org = xfmPoint (world2local,ray_org);
+        ray.dir = xfmVector(world2local,ray_dir);
+        return;
+      }
+
+      /* the rays of each time segment share the transformations they interpolate */
+      mic_i segments;
+      for (size_t i=0; i<16; i++) segments[i] = (int)instance->timeSegment(ray.time[i]);
+      mic_m todo = valid_i;
+      while (any(todo))
+      {
+        const int segment = segments[__bsf(toInt(todo))];
+        const mic_m valid = todo & (segments == mic_i(segment));
+        const AffineSpace3faMIC xfm0(instance->local2world[segment+0]);
+        const AffineSpace3faMIC xfm1(instance->local2world[segment+1]);
+        mic_f f = ray.time*float(instance->numTimeSteps-1)-float(segment);
+        /* rays where the blend becomes singular use the nearest time step */
+        const mic_f det = (xfm0 + f*(xfm1-xfm0)).l.det();
+        f = select(abs(det) < mic_f(instance->singularDet(segment)),select(f < 0.5f,mic_f(0.0f),mic_f(1.0f)),f);
+        const AffineSpace3faMIC world2local = rcp(xfm0 + f*(xfm1-xfm0));
+        const mic3f org = xfmPoint (world2local,ray_org);
+        const mic3f dir = xfmVector(world2local,ray_dir);
+        ray.org = mic3f(select(valid,org.x,ray.org.x),select(valid,org.y,ray.org.y),select(valid,org.z,ray.org.z));
+        ray.dir = mic3f(select(valid,dir.x,ray.dir.x),select(valid,dir.y,ray.dir.y),select(valid,dir.z,ray.dir.z));
+        todo = todo & !valid;
+      }
+    }
     
     void FastInstanceIntersector16::intersect(mic_i* valid, const UserGeometryScene::Instance* instance, Ray16& ray, size_t item)
     {
@@ -28,31 +63,36 @@ namespace embree
       const mic3f ray_dir = ray.dir;
       const mic_i ray_geomID = ray.geomID;
       const mic_i ray_instID = ray.instID;
-      const AffineSpace3faMIC world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
+      mic_i ray_subInstID[RTC_MAX_INSTANCE_LEVELS-1];
+      for (size_t i=0; i<RTC_MAX_INSTANCE_LEVELS-1; i++) {
+        ray_subInstID[i] = ray.subInstID[i];
+        ray.subInstID[i] = -1;
+      }
+      transformRays(*valid,instance,ray,ray_org,ray_dir);
       ray.geomID = -1;
-      ray.instID = instance->id;
+      ray.instID = -1;
       instance->object->intersect16(valid,(RTCRay16&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      /* the instantiated scene reports the instances below this one */
       mic_m nohit = ray.geomID == mic_i(-1);
       ray.geomID = select(nohit,ray_geomID,ray.geomID);
-      ray.instID = select(nohit,ray_instID,ray.instID);
+      for (size_t i=RTC_MAX_INSTANCE_LEVELS-2; i>0; i--)
+        ray.subInstID[i] = select(nohit,ray_subInstID[i],ray.subInstID[i-1]);
+      ray.subInstID[0] = select(nohit,ray_subInstID[0],ray.instID);
+      ray.instID = select(nohit,ray_instID,mic_i(instance->id));
     }
     
     void FastInstanceIntersector16::occluded (mic_i* valid, const UserGeometryScene::Instance* instance, Ray16& ray, size_t item)
     {
       const mic3f ray_org = ray.org;
       const mic3f ray_dir = ray.dir;
-      const mic_i ray_geomID = ray.geomID;
-      const AffineSpace3faMIC world2local(instance->world2local);
-      ray.org = xfmPoint (world2local,ray_org);
-      ray.dir = xfmVector(world2local,ray_dir);
-      ray.instID = instance->id;
+      const mic_i ray_instID = ray.instID;
+      transformRays(*valid,instance,ray,ray_org,ray_dir);
       instance->object->occluded16(valid,(RTCRay16&)ray);
       ray.org = ray_org;
       ray.dir = ray_dir;
+      ray.instID = select(ray.geomID == mic_i(0),mic_i(instance->id),ray_instID);
     }
     
     DEFINE_SET_INTERSECTOR16(InstanceIntersector16,FastInstanceIntersector16);
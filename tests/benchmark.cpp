@@ -28,6 +28,8 @@ namespace embree
 
   /* configuration */
   static std::string g_rtcore = "";
+  static bool g_schedulers = false;  //!< compare the task schedulers
+  static bool g_traversers = false;  //!< compare the packet traversal kernels
   
   /* vertex and triangle layout */
   struct Vertex   { float x,y,z,a; };
@@ -163,6 +165,46 @@ namespace embree
     fflush(stdout);
   }
 
+  size_t g_num_task_spawns = 100;
+  size_t g_task_spawn_depth = 12;
+  size_t g_num_task_set_elements = 1000000;
+
+  void benchmark_task_spawn_run(void* ptr, size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) 
+  {
+    size_t depth = (size_t) ptr;
+    if (depth == 0) return;
+    TaskScheduler::executeTask(threadIndex,threadCount,benchmark_task_spawn_run,(void*)(depth-1),2,"benchmark_task_spawn");
+  }
+
+  void benchmark_task_set_run(void* ptr, size_t threadIndex, size_t threadCount, size_t taskIndex, size_t taskCount, TaskScheduler::Event* event) {
+  }
+
+  double benchmark_task_spawn ()
+  {
+    double t0 = getSeconds();
+    for (size_t i=0; i<g_num_task_spawns; i++) 
+    {
+      TaskScheduler::EventSync event;
+      TaskScheduler::Task task(&event,benchmark_task_spawn_run,(void*)g_task_spawn_depth,1,NULL,NULL,"benchmark_task_spawn");
+      TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_FRONT,&task);
+      event.sync();
+    }
+    double t1 = getSeconds();
+    size_t numTasks = g_num_task_spawns*((size_t(2) << g_task_spawn_depth)-1);
+    return double(numTasks)/(t1-t0);
+  }
+
+  double benchmark_task_set ()
+  {
+    double t0 = getSeconds();
+    TaskScheduler::EventSync event;
+    TaskScheduler::Task task(&event,benchmark_task_set_run,NULL,g_num_task_set_elements,NULL,NULL,"benchmark_task_set");
+    TaskScheduler::addTask(-1,TaskScheduler::GLOBAL_FRONT,&task);
+    event.sync();
+    double t1 = getSeconds();
+    return double(g_num_task_set_elements)/(t1-t0);
+  }
+
   RTCRay makeRay(Vec3f org, Vec3f dir) 
   {
     RTCRay ray;
@@ -248,6 +290,16 @@ namespace embree
         g_rtcore = argv[++i];
       }
 
+      /* compare task schedulers */
+      else if (tag == "-schedulers") {
+        g_schedulers = true;
+      }
+
+      /* compare packet traversal kernels */
+      else if (tag == "-traversers") {
+        g_traversers = true;
+      }
+
       /* skip unknown command line parameter */
       else {
         std::cerr << "unknown command line parameter: " << tag << " ";
@@ -540,6 +592,24 @@ namespace embree
 	fflush(stdout);
   }
 
+  void rtcore_incoherent_intersectN(RTCScene scene, Vec3f* numbers, size_t N)
+  {
+    const size_t streamSize = 4096;
+    RTCRay* rays = (RTCRay*) alignedMalloc(streamSize*sizeof(RTCRay),16);
+    double t0 = getSeconds();
+    for (size_t i=0; i<N; i+=streamSize) {
+      const size_t n = min(streamSize,N-i);
+      for (size_t j=0; j<n; j++) 
+        rays[j] = makeRay(zero,numbers[i+j]);
+      rtcIntersectN(scene,rays,n,sizeof(RTCRay));
+    }
+    double t1 = getSeconds();
+    alignedFree(rays);
+
+    printf("%30s ... %f Mrps\n","incoherent_intersectN",1E-6*(double)N/(t1-t0));
+	fflush(stdout);
+  }
+
   void rtcore_intersect_benchmark(RTCSceneFlags flags, size_t numPhi)
   {
     RTCScene scene = rtcNewScene(flags,aflags);
@@ -585,17 +655,62 @@ namespace embree
     rtcore_incoherent_intersect16(scene,numbers,N);
 #endif
 
+    rtcore_incoherent_intersectN(scene,numbers,N);
+
     delete numbers;
 
     rtcDeleteScene(scene);
   }
 
+  /* compares task throughput and build performance of a task scheduler */
+  void benchmark_task_scheduler (const std::string& scheduler)
+  {
+    std::string cfg = g_rtcore == "" ? "scheduler="+scheduler : g_rtcore+",scheduler="+scheduler;
+    rtcInit(cfg.c_str());
+
+    double spawn = benchmark_task_spawn();
+    printf("%30s ... %f M/s\n",("task_spawn_"+scheduler).c_str(),1E-6*spawn);
+    double set = benchmark_task_set();
+    printf("%30s ... %f M/s\n",("task_set_"+scheduler).c_str(),1E-6*set);
+    fflush(stdout);
+
+    BUILD(("create_static_geometry_1000k_1_"+scheduler).c_str(), rtcore_create_geometry(RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC,501,1));
+    BUILD(("create_static_geometry_1k_1000_"+scheduler).c_str(), rtcore_create_geometry(RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC,17,1000));
+    BUILD(("create_dynamic_geometry_1000k_1_"+scheduler).c_str(), rtcore_create_geometry(RTC_SCENE_DYNAMIC,RTC_GEOMETRY_STATIC,501,1));
+
+    rtcExit();
+  }
+
+  /* compares the packet traversal kernels of the BVH4 on coherent and incoherent rays */
+  void benchmark_traverser (const std::string& traverser)
+  {
+    std::string cfg = "triaccel=bvh4.triangle4,traverser="+traverser;
+    if (g_rtcore != "") cfg = g_rtcore+","+cfg;
+    rtcInit(cfg.c_str());
+    printf("traverser %s\n",traverser.c_str());
+    rtcore_intersect_benchmark(RTC_SCENE_STATIC, 501);
+    rtcExit();
+  }
+
   /* main function in embree namespace */
   int main(int argc, char** argv) 
   {
     /* parse command line */  
     parseCommandLine(argc,argv);
 
+    /* compare task schedulers */
+    if (g_schedulers) {
+      benchmark_task_scheduler("default");
+      benchmark_task_scheduler("stealing");
+    }
+
+    /* compare packet traversal kernels */
+    if (g_traversers) {
+      benchmark_traverser("chunk");
+      benchmark_traverser("hybrid");
+      benchmark_traverser("trail");
+    }
+
     /* perform tests */
     rtcInit(g_rtcore.c_str());
 
@@ -1,6 +1,17 @@
 #!/bin/bash
 ./verify
+./verify -rtcore triaccel=bvh4.triangle4,traverser=trail
+./verify -rtcore hugepages=1,numa=firsttouch
+./verify -rtcore numa=interleave
+./verify -rtcore mortonbits=64
+./verify -rtcore restructure=2
+./verify -rtcore triaccel=bvh4.triangle4,builder=ploc
+./verify -rtcore triaccel=bvh8.triangle4
+./verify -rtcore triaccel=bvh8.triangle8
+./verify -rtcore hairaccel=bvh8.bezier1i
+./verify -rtcore hairaccel=bvh4hair.bezier1
 ./benchmark
+./benchmark -rtcore hugepages=1,numa=firsttouch
 ./tutorial00
 ./tutorial00_ispc
 ./tutorial01
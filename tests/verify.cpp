@@ -27,6 +27,7 @@
 #include "embree2/rtcore_ray.h"
 #include "../kernels/common/default.h"
 #include <vector>
+#include <sstream>
 
 namespace embree
 {
@@ -127,6 +128,8 @@ namespace embree
     ray_o.geomID[i] = ray_i.geomID;
     ray_o.primID[i] = ray_i.primID;
     ray_o.instID[i] = ray_i.instID;
+    for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+      ray_o.subInstID[l][i] = ray_i.subInstID[l];
   }
 
   void setRay(RTCRay8& ray_o, int i, const RTCRay& ray_i)
@@ -147,6 +150,8 @@ namespace embree
     ray_o.geomID[i] = ray_i.geomID;
     ray_o.primID[i] = ray_i.primID;
     ray_o.instID[i] = ray_i.instID;
+    for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+      ray_o.subInstID[l][i] = ray_i.subInstID[l];
   }
 
   void setRay(RTCRay16& ray_o, int i, const RTCRay& ray_i)
@@ -167,6 +172,8 @@ namespace embree
     ray_o.geomID[i] = ray_i.geomID;
     ray_o.primID[i] = ray_i.primID;
     ray_o.instID[i] = ray_i.instID;
+    for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+      ray_o.subInstID[l][i] = ray_i.subInstID[l];
   }
 
   RTCRay getRay(RTCRay4& ray_i, int i)
@@ -188,6 +195,8 @@ namespace embree
     ray_o.geomID = ray_i.geomID[i];
     ray_o.primID = ray_i.primID[i];
     ray_o.instID = ray_i.instID[i];
+    for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+      ray_o.subInstID[l] = ray_i.subInstID[l][i];
     return ray_o;
   }
 
@@ -210,6 +219,8 @@ namespace embree
     ray_o.geomID = ray_i.geomID[i];
     ray_o.primID = ray_i.primID[i];
     ray_o.instID = ray_i.instID[i];
+    for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+      ray_o.subInstID[l] = ray_i.subInstID[l][i];
     return ray_o;
   }
 
@@ -232,6 +243,8 @@ namespace embree
     ray_o.geomID = ray_i.geomID[i];
     ray_o.primID = ray_i.primID[i];
     ray_o.instID = ray_i.instID[i];
+    for (size_t l=0; l<RTC_MAX_INSTANCE_LEVELS-1; l++)
+      ray_o.subInstID[l] = ray_i.subInstID[l][i];
     return ray_o;
   }
 
@@ -1499,6 +1512,622 @@ namespace embree
 	  fflush(stdout);
   }
 
+  bool rtcore_ray_stream(RTCSceneFlags sflags)
+  {
+    RTCScene scene = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) {
+      Vec3fa pos = 4.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(2.0f);
+      addSphere(scene,RTC_GEOMETRY_STATIC,pos,1.0f,50);
+    }
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* the stream has to be traced in multiple blocks, the last of them partially filled */
+    const size_t N = 2*1024+13;
+    RTCRay* rays  = (RTCRay*) alignedMalloc(N*sizeof(RTCRay),16);
+    RTCRay* rays1 = (RTCRay*) alignedMalloc(N*sizeof(RTCRay),16);
+    RTCRay* raysN = (RTCRay*) alignedMalloc(N*sizeof(RTCRay),16);
+    for (size_t i=0; i<N; i++) {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      rays[i] = rays1[i] = raysN[i] = makeRay(org,dir);
+    }
+
+    /* SOA copy of the stream */
+    std::vector<float> orgx(N), orgy(N), orgz(N), dirx(N), diry(N), dirz(N), tnear(N), tfar(N), time(N);
+    std::vector<float> Ngx(N), Ngy(N), Ngz(N), u(N), v(N);
+    std::vector<int> mask(N), geomID(N), primID(N), instID(N);
+    for (size_t i=0; i<N; i++) {
+      orgx[i] = rays[i].org[0]; orgy[i] = rays[i].org[1]; orgz[i] = rays[i].org[2];
+      dirx[i] = rays[i].dir[0]; diry[i] = rays[i].dir[1]; dirz[i] = rays[i].dir[2];
+      tnear[i] = rays[i].tnear; tfar[i] = rays[i].tfar; time[i] = rays[i].time; mask[i] = rays[i].mask;
+      geomID[i] = primID[i] = instID[i] = -1;
+    }
+    RTCRayNp soa;
+    soa.orgx = &orgx[0]; soa.orgy = &orgy[0]; soa.orgz = &orgz[0];
+    soa.dirx = &dirx[0]; soa.diry = &diry[0]; soa.dirz = &dirz[0];
+    soa.tnear = &tnear[0]; soa.tfar = &tfar[0]; soa.time = &time[0]; soa.mask = &mask[0];
+    soa.Ngx = &Ngx[0]; soa.Ngy = &Ngy[0]; soa.Ngz = &Ngz[0]; soa.u = &u[0]; soa.v = &v[0];
+    soa.geomID = &geomID[0]; soa.primID = &primID[0]; soa.instID = &instID[0];
+
+    /* compare closest hits against single ray traversal */
+    for (size_t i=0; i<N; i++) rtcIntersect(scene,rays1[i]);
+    ::rtcIntersectN(scene,raysN,N,sizeof(RTCRay));
+    AssertNoError();
+    ::rtcIntersectNp(scene,soa,N,sizeof(float));
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<N; i++) {
+      passed &= raysN[i].geomID == rays1[i].geomID;
+      passed &= geomID[i] == rays1[i].geomID;
+      if (rays1[i].geomID == -1) continue;
+      passed &= abs(raysN[i].tfar-rays1[i].tfar) <= 1E-4f*rays1[i].tfar;
+      passed &= abs(tfar[i]-rays1[i].tfar) <= 1E-4f*rays1[i].tfar;
+    }
+
+    /* compare occlusion against single ray traversal */
+    for (size_t i=0; i<N; i++) {
+      rays1[i] = raysN[i] = rays[i];
+      geomID[i] = -1; tfar[i] = rays[i].tfar;
+    }
+    for (size_t i=0; i<N; i++) rtcOccluded(scene,rays1[i]);
+    ::rtcOccludedN(scene,raysN,N,sizeof(RTCRay));
+    AssertNoError();
+    ::rtcOccludedNp(scene,soa,N,sizeof(float));
+    AssertNoError();
+
+    for (size_t i=0; i<N; i++) {
+      passed &= (raysN[i].geomID == 0) == (rays1[i].geomID == 0);
+      passed &= (geomID[i] == 0) == (rays1[i].geomID == 0);
+    }
+
+    alignedFree(rays);
+    alignedFree(rays1);
+    alignedFree(raysN);
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  void rtcore_ray_stream_all()
+  {
+    printf("%30s ... ","ray_stream");
+    bool passed = true;
+    for (int i=0; i<numSceneFlags; i++) 
+    {
+      RTCSceneFlags flag = getSceneFlag(i);
+      bool ok0 = rtcore_ray_stream(flag);
+      if (ok0) printf("\033[32m+\033[0m"); else printf("\033[31m-\033[0m");
+      passed &= ok0;
+    }
+    printf(" %s\n",passed ? "\033[32m[PASSED]\033[0m" : "\033[31m[FAILED]\033[0m");
+    fflush(stdout);
+  }
+
+  bool rtcore_save_load_scene(RTCSceneFlags sflags)
+  {
+    const char* filename = "verify_scene.bvh";
+    Vec3fa pos[8];
+    for (size_t i=0; i<8; i++) 
+      pos[i] = 4.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(2.0f);
+
+    /* build scene and store it */
+    RTCScene scene0 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) addSphere(scene0,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+    rtcCommit (scene0);
+    AssertNoError();
+    rtcSaveScene (scene0,filename);
+    AssertNoError();
+
+    /* load identical scene */
+    RTCScene scene1 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) addSphere(scene1,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+    rtcLoadScene (scene1,filename);
+    AssertNoError();
+
+    /* compare hits against the built scene */
+    bool passed = true;
+    for (size_t i=0; i<10000; i++) 
+    {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      RTCRay ray0 = makeRay(org,dir); rtcIntersect(scene0,ray0);
+      RTCRay ray1 = makeRay(org,dir); rtcIntersect(scene1,ray1);
+      passed &= ray0.geomID == ray1.geomID && ray0.primID == ray1.primID && ray0.tfar == ray1.tfar;
+      RTCRay ray2 = makeRay(org,dir); rtcOccluded(scene1,ray2);
+      passed &= (ray2.geomID == 0) == (ray0.geomID != -1);
+    }
+
+    /* a scene with different geometry cannot get loaded, but committed */
+#if !defined(__EXIT_ON_ERROR__)
+    RTCScene scene2 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) addSphere(scene2,RTC_GEOMETRY_STATIC,pos[i],1.0f,40);
+    rtcLoadScene (scene2,filename);
+    AssertError(RTC_INVALID_OPERATION);
+    rtcCommit (scene2);
+    AssertNoError();
+    rtcDeleteScene (scene2);
+    AssertNoError();
+#endif
+
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    rtcDeleteScene (scene1);
+    AssertNoError();
+    remove(filename);
+    return passed;
+  }
+
+  bool rtcore_load_truncated_scene(RTCSceneFlags sflags)
+  {
+    const char* filename = "verify_scene.bvh";
+    Vec3fa pos[8];
+    for (size_t i=0; i<8; i++) 
+      pos[i] = 4.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(2.0f);
+
+    RTCScene scene0 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) addSphere(scene0,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+    rtcCommit (scene0);
+    AssertNoError();
+    rtcSaveScene (scene0,filename);
+    AssertNoError();
+
+    /* cut the stored scene in half */
+    std::vector<char> data;
+    FILE* file = fopen(filename,"rb");
+    if (file == NULL) return false;
+    for (int c; (c = fgetc(file)) != EOF; ) data.push_back(char(c));
+    fclose(file);
+    file = fopen(filename,"wb");
+    if (file == NULL) return false;
+    fwrite(&data[0],1,data.size()/2,file);
+    fclose(file);
+
+    /* loading fails and leaves a scene that can get committed */
+    bool passed = true;
+#if !defined(__EXIT_ON_ERROR__)
+    RTCScene scene1 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) addSphere(scene1,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+    rtcLoadScene (scene1,filename);
+    AssertError(RTC_INVALID_OPERATION);
+    rtcCommit (scene1);
+    AssertNoError();
+
+    for (size_t i=0; i<1000; i++) 
+    {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      RTCRay ray0 = makeRay(org,dir); rtcIntersect(scene0,ray0);
+      RTCRay ray1 = makeRay(org,dir); rtcIntersect(scene1,ray1);
+      passed &= ray0.geomID == ray1.geomID && ray0.primID == ray1.primID;
+    }
+    rtcDeleteScene (scene1);
+    AssertNoError();
+#endif
+
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    remove(filename);
+    return passed;
+  }
+
+  /*! compares the hit of a ray against a reference hit */
+  bool compareHit(const RTCRay& ray, const RTCRay& ref) 
+  {
+    if (ref.geomID == -1) return ray.geomID == -1;
+    return ray.geomID == ref.geomID && abs(ray.tfar-ref.tfar) <= 1E-4f*ref.tfar;
+  }
+
+  bool rtcore_compact_scene(RTCSceneFlags sflags)
+  {
+    Vec3fa pos[8];
+    for (size_t i=0; i<8; i++) 
+      pos[i] = 4.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(2.0f);
+
+    /* reference scene and compact scene with quantized nodes */
+    RTCScene scene0 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    RTCScene scene1 = rtcNewScene(sflags | RTC_SCENE_COMPACT,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) {
+      addSphere(scene0,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+      addSphere(scene1,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+    }
+    rtcCommit (scene0);
+    AssertNoError();
+    rtcCommit (scene1);
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<10000; i+=8) 
+    {
+      RTCRay rays[8], refs[8];
+      for (size_t j=0; j<8; j++) {
+        Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+        Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+        rays[j] = refs[j] = makeRay(org,dir); 
+        rtcIntersect(scene0,refs[j]);
+      }
+
+      for (size_t j=0; j<8; j++) {
+        RTCRay ray1 = rays[j]; rtcIntersect(scene1,ray1);
+        passed &= compareHit(ray1,refs[j]);
+        RTCRay ray2 = rays[j]; rtcOccluded(scene1,ray2);
+        passed &= (ray2.geomID == 0) == (refs[j].geomID != -1);
+      }
+
+      for (size_t j=0; j<8; j+=4) {
+        RTCRay4 ray4; for (size_t k=0; k<4; k++) setRay(ray4,k,rays[j+k]);
+        __aligned(16) int valid4[4] = { -1,-1,-1,-1 };
+        rtcIntersect4(valid4,scene1,ray4);
+        for (size_t k=0; k<4; k++) passed &= compareHit(getRay(ray4,k),refs[j+k]);
+      }
+
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+      if (has_feature(AVX))
+      {
+        RTCRay8 ray8; for (size_t k=0; k<8; k++) setRay(ray8,k,rays[k]);
+        __aligned(32) int valid8[8] = { -1,-1,-1,-1,-1,-1,-1,-1 };
+        rtcIntersect8(valid8,scene1,ray8);
+        for (size_t k=0; k<8; k++) passed &= compareHit(getRay(ray8,k),refs[k]);
+      }
+#endif
+    }
+
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    rtcDeleteScene (scene1);
+    AssertNoError();
+    return passed;
+  }
+
+  static bool rtcore_config_hits(RTCSceneFlags sflags, RTCGeometryFlags gflags, std::vector<RTCRay>& rays)
+  {
+    /* spheres of different sizes that get created identically for each configuration */
+    RTCScene scene = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) {
+      const Vec3fa pos = 2.0f*Vec3fa(float(i%2),float((i/2)%2),float(i/4))-Vec3fa(1.0f);
+      addSphere(scene,gflags,pos,0.5f+0.1f*float(i),i == 0 ? 200 : 10+10*i);
+    }
+    rtcCommit (scene);
+    AssertNoError();
+
+    for (size_t i=0; i<rays.size(); i++) 
+      rtcIntersect(scene,rays[i]);
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return true;
+  }
+
+  bool rtcore_compare_config(const std::string& cfg, RTCSceneFlags sflags, RTCGeometryFlags gflags)
+  {
+    std::vector<RTCRay> rays;
+    for (size_t i=0; i<10000; i++) {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      rays.push_back(makeRay(org,dir));
+    }
+
+    /* the scene built with the additional configuration has to produce the same hits */
+    std::vector<RTCRay> refs = rays;
+    bool passed = rtcore_config_hits(sflags,gflags,refs);
+    rtcExit();
+    rtcInit((g_rtcore.empty() ? cfg : g_rtcore+","+cfg).c_str());
+    passed &= rtcore_config_hits(sflags,gflags,rays);
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+
+    for (size_t i=0; i<rays.size(); i++)
+      passed &= compareHit(rays[i],refs[i]);
+    return passed;
+  }
+
+  bool rtcore_progressive_scene(RTCSceneFlags sflags)
+  {
+    Vec3fa pos[8];
+    for (size_t i=0; i<8; i++) 
+      pos[i] = 4.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(2.0f);
+
+    /* meshes of the progressive scene get built while further meshes get added */
+    RTCScene scene0 = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    RTCScene scene1 = rtcNewScene(sflags | RTC_SCENE_PROGRESSIVE,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) {
+      addSphere(scene0,RTC_GEOMETRY_STATIC,pos[i],1.0f,50);
+      addSphere(scene1,RTC_GEOMETRY_STATIC,i == 0 ? Vec3fa(zero) : pos[i],1.0f,50);
+    }
+
+    /* move first mesh after its build got started */
+    Vertex* vertices = (Vertex*) rtcMapBuffer(scene1,0,RTC_VERTEX_BUFFER);
+    AssertNoError();
+    for (size_t i=0; i<100*51; i++) {
+      vertices[i].x += pos[0].x; vertices[i].y += pos[0].y; vertices[i].z += pos[0].z;
+    }
+    rtcUnmapBuffer(scene1,0,RTC_VERTEX_BUFFER);
+    AssertNoError();
+
+    rtcCommit (scene0);
+    AssertNoError();
+    rtcCommit (scene1);
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<10000; i+=4) 
+    {
+      RTCRay rays[4], refs[4];
+      for (size_t j=0; j<4; j++) {
+        Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+        Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+        rays[j] = refs[j] = makeRay(org,dir); 
+        rtcIntersect(scene0,refs[j]);
+      }
+
+      for (size_t j=0; j<4; j++) {
+        RTCRay ray1 = rays[j]; rtcIntersect(scene1,ray1);
+        passed &= compareHit(ray1,refs[j]);
+        RTCRay ray2 = rays[j]; rtcOccluded(scene1,ray2);
+        passed &= (ray2.geomID == 0) == (refs[j].geomID != -1);
+      }
+
+      RTCRay4 ray4; for (size_t k=0; k<4; k++) setRay(ray4,k,rays[k]);
+      __aligned(16) int valid4[4] = { -1,-1,-1,-1 };
+      rtcIntersect4(valid4,scene1,ray4);
+      for (size_t k=0; k<4; k++) passed &= compareHit(getRay(ray4,k),refs[k]);
+    }
+
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    rtcDeleteScene (scene1);
+    AssertNoError();
+    return passed;
+  }
+
+  static bool rtcore_refit_deformable_frames(size_t numPhi, float jitter)
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+    AssertNoError();
+    unsigned geom = addSphere(scene,RTC_GEOMETRY_DEFORMABLE,zero,1.0f,numPhi);
+    rtcCommit (scene);
+    AssertNoError();
+
+    bool passed = true;
+    const size_t numVertices = 2*numPhi*(numPhi+1);
+    for (size_t frame=0; frame<3; frame++)
+    {
+      /* swap random vertices to degrade the refitted BVH until it gets
+       * rebuilt, or slightly move all vertices */
+      Vertex* vertices = (Vertex*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+      AssertNoError();
+      if (jitter == 0.0f) {
+        for (size_t i=0; i<numVertices/10; i++) 
+          std::swap(vertices[i],vertices[size_t(drand48()*(numVertices-1))]);
+      } 
+      else {
+        for (size_t i=0; i<numVertices; i++) {
+          vertices[i].x += jitter*float(drand48()-0.5);
+          vertices[i].y += jitter*float(drand48()-0.5);
+          vertices[i].z += jitter*float(drand48()-0.5);
+        }
+      }
+      rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+      rtcUpdate(scene,geom);
+      rtcCommit (scene);
+      AssertNoError();
+
+      /* the refitted scene has to match a newly built scene */
+      RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+      unsigned geom0 = addSphere(scene0,RTC_GEOMETRY_STATIC,zero,1.0f,numPhi);
+      Vertex* vertices0 = (Vertex*) rtcMapBuffer(scene0,geom0,RTC_VERTEX_BUFFER);
+      vertices = (Vertex*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+      for (size_t i=0; i<numVertices; i++) vertices0[i] = vertices[i];
+      rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+      rtcUnmapBuffer(scene0,geom0,RTC_VERTEX_BUFFER);
+      rtcCommit (scene0);
+      AssertNoError();
+
+      for (size_t i=0; i<1000; i++) {
+        Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+        Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+        RTCRay ray0 = makeRay(org,dir); rtcIntersect(scene0,ray0);
+        RTCRay ray1 = makeRay(org,dir); rtcIntersect(scene,ray1);
+        passed &= compareHit(ray0,ray1);
+      }
+      rtcDeleteScene (scene0);
+      AssertNoError();
+    }
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  static bool rtcore_refit_verbose(size_t numPhi, float jitter, const std::string& cfg, std::string& output)
+  {
+    /* run with verbose output to observe how the refitted BVH gets updated */
+    rtcExit();
+    rtcInit((g_rtcore.empty() ? cfg : g_rtcore+","+cfg).c_str());
+    std::stringstream log;
+    std::streambuf* cout = std::cout.rdbuf(log.rdbuf());
+    bool passed = rtcore_refit_deformable_frames(numPhi,jitter);
+    std::cout.rdbuf(cout);
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+    output = log.str();
+    return passed;
+  }
+
+  bool rtcore_refit_deformable(size_t numPhi)
+  {
+    /* the heavy deformation has to trigger a rebuild if the BVH got refitted */
+    std::string output;
+    bool passed = rtcore_refit_verbose(numPhi,0.0f,"verbose=2",output);
+    if (output.find("refitting BVH4") != std::string::npos)
+      passed &= output.find("rebuilding BVH4") != std::string::npos;
+    return passed;
+  }
+
+  bool rtcore_refit_optimize(size_t numPhi)
+  {
+    /* the refitted BVH has to get optimized within the budget of each commit */
+    std::string output;
+    bool passed = rtcore_refit_verbose(numPhi,0.01f,"verbose=2,refitbudget=100000",output);
+    if (output.find("refitting BVH4") != std::string::npos)
+      passed &= output.find("rotated ") != std::string::npos;
+    return passed;
+  }
+
+  bool rtcore_alloc_reuse()
+  {
+    /* the memory blocks of deleted scenes get reused and released by later builds */
+    bool passed = true;
+    for (size_t round=0; round<6; round++)
+    {
+      const size_t numPhi = round%2 ? 200 : 50;
+      RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+      AssertNoError();
+      RTCScene scene1 = rtcNewScene(RTC_SCENE_DYNAMIC,aflags);
+      AssertNoError();
+      for (size_t i=0; i<4; i++) {
+        const Vec3fa pos = 2.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(1.0f);
+        addSphere(scene0,RTC_GEOMETRY_STATIC,pos,1.0f,numPhi);
+        addSphere(scene1,RTC_GEOMETRY_STATIC,pos,1.0f,numPhi);
+      }
+      rtcCommit (scene0);
+      AssertNoError();
+      rtcCommit (scene1);
+      AssertNoError();
+
+      for (size_t i=0; i<1000; i++) 
+      {
+        Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+        Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+        RTCRay ray0 = makeRay(org,dir); rtcIntersect(scene0,ray0);
+        RTCRay ray1 = makeRay(org,dir); rtcIntersect(scene1,ray1);
+        passed &= compareHit(ray1,ray0);
+      }
+
+      rtcDeleteScene (scene0);
+      AssertNoError();
+      rtcDeleteScene (scene1);
+      AssertNoError();
+    }
+    return passed;
+  }
+
+  bool rtcore_high_quality_scene(size_t numPhi)
+  {
+    /* overlapping spheres make the builder duplicate primitives */
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    AssertNoError();
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_STATIC | RTC_SCENE_HIGH_QUALITY,aflags);
+    AssertNoError();
+    for (size_t i=0; i<8; i++) {
+      const Vec3fa pos = 2.0f*Vec3fa(drand48(),drand48(),drand48())-Vec3fa(1.0f);
+      addSphere(scene0,RTC_GEOMETRY_STATIC,pos,1.0f,numPhi);
+      addSphere(scene1,RTC_GEOMETRY_STATIC,pos,1.0f,numPhi);
+    }
+    rtcCommit (scene0);
+    AssertNoError();
+    rtcCommit (scene1);
+    AssertNoError();
+
+    bool passed = true;
+    for (size_t i=0; i<10000; i++) 
+    {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      RTCRay ray0 = makeRay(org,dir); rtcIntersect(scene0,ray0);
+      RTCRay ray1 = makeRay(org,dir); rtcIntersect(scene1,ray1);
+      passed &= compareHit(ray0,ray1);
+      RTCRay ray2 = makeRay(org,dir); rtcOccluded(scene1,ray2);
+      passed &= (ray2.geomID == 0) == (ray0.geomID != -1);
+    }
+
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    rtcDeleteScene (scene1);
+    AssertNoError();
+    return passed;
+  }
+
+  static MutexSys g_commitMutex;
+  static bool g_committed = false;
+
+  void commitCallback(void* userPtr, RTCScene scene) {
+    Lock<MutexSys> lock(g_commitMutex);
+    g_committed = true;
+  }
+
+  static bool isCommitted() {
+    Lock<MutexSys> lock(g_commitMutex);
+    return g_committed;
+  }
+
+  static void resetCommitted() {
+    Lock<MutexSys> lock(g_commitMutex);
+    g_committed = false;
+  }
+
+  bool rtcore_commit_async(RTCSceneFlags sflags)
+  {
+    RTCScene scene = rtcNewScene(sflags,aflags);
+    AssertNoError();
+    addSphere(scene,RTC_GEOMETRY_DYNAMIC,Vec3fa(-2,0,0),1.0f,50);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* the first asynchronous commit of a committed scene must not
+     * overlap with ray queries, the commit function has to get
+     * called within a reasonable time */
+    const double timeout = 60.0;
+    resetCommitted();
+    rtcCommitAsync (scene,commitCallback,NULL);
+    double t0 = getSeconds();
+    while (!isCommitted() && getSeconds()-t0 < timeout) yield();
+    if (!isCommitted()) return false;
+    AssertNoError();
+
+    /* rays see the old or new scene while it gets built in the background */
+    rtcDeleteGeometry(scene,0);
+    addSphere(scene,RTC_GEOMETRY_DYNAMIC,Vec3fa(+2,0,0),1.0f,50);
+    resetCommitted();
+    rtcCommitAsync (scene,commitCallback,NULL);
+    bool passed = true;
+    t0 = getSeconds();
+    while (!isCommitted() && getSeconds()-t0 < timeout) {
+      RTCRay ray = makeRay(Vec3fa(-2,0,-10),Vec3fa(0,0,1)); rtcIntersect(scene,ray);
+      passed &= ray.geomID == 0 || ray.geomID == -1;
+    }
+    if (!isCommitted()) return false;
+    AssertNoError();
+
+    for (size_t i=0; i<2; i++)
+    {
+      RTCRay ray0 = makeRay(Vec3fa(-2,0,-10),Vec3fa(0,0,1)); rtcIntersect(scene,ray0);
+      RTCRay ray1 = makeRay(Vec3fa(+2,0,-10),Vec3fa(0,0,1)); rtcIntersect(scene,ray1);
+      passed &= ray0.geomID == -1 && ray1.geomID == 1;
+
+      /* the next commit deletes the erased geometry */
+      rtcCommit (scene);
+      AssertNoError();
+    }
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
   void rtcore_watertight_sphere1(float pos)
   {
     RTCScene scene = rtcNewScene(RTC_SCENE_STATIC | RTC_SCENE_ROBUST,aflags);
@@ -1991,6 +2620,546 @@ namespace embree
 #endif
   }
 
+  bool rtcore_nested_instancing()
+  {
+    bool passed = true;
+
+    /* sphere at (2,0,2) that is reached through two levels of instances */
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(scene0,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),1.0f,50);
+    rtcCommit (scene0);
+
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned inst1 = rtcNewInstance(scene1,scene0);
+    const float xfm1[12] = { 1,0,0, 0,1,0, 0,0,1, 2,0,0 };
+    rtcSetTransform(scene1,inst1,RTC_MATRIX_COLUMN_MAJOR,xfm1);
+    rtcCommit (scene1);
+
+    RTCScene scene2 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned geom2 = addSphere(scene2,RTC_GEOMETRY_STATIC,Vec3fa(-2,0,-2),1.0f,50);
+    unsigned inst2 = rtcNewInstance(scene2,scene1);
+    const float xfm2[12] = { 1,0,0, 0,1,0, 0,0,1, 0,0,2 };
+    rtcSetTransform(scene2,inst2,RTC_MATRIX_COLUMN_MAJOR,xfm2);
+    rtcCommit (scene2);
+    AssertNoError();
+
+    /* a scene cannot instantiate itself, neither directly nor nested */
+    rtcNewInstance(scene2,scene2);
+    AssertError(RTC_INVALID_ARGUMENT);
+    rtcNewInstance(scene0,scene2);
+    AssertError(RTC_INVALID_ARGUMENT);
+
+    RTCRay ray0 = makeRay(Vec3fa(+2.1f,10,+2.05f),Vec3fa(0,-1,0));
+    RTCRay ray1 = makeRay(Vec3fa(-2.1f,10,-2.05f),Vec3fa(0,-1,0));
+    RTCRay ray2 = makeRay(Vec3fa(+2.1f,10,-2.05f),Vec3fa(0,-1,0));
+    rtcIntersect(scene2,ray0);
+    rtcIntersect(scene2,ray1);
+    rtcIntersect(scene2,ray2);
+    passed &= ray0.geomID == 0 && ray0.instID == inst2 && ray0.subInstID[0] == inst1 && ray0.subInstID[1] == -1;
+    passed &= ray0.tfar > 8.9f && ray0.tfar < 9.1f;
+    passed &= ray1.geomID == geom2 && ray1.instID == -1;
+    passed &= ray2.geomID == -1;
+
+#if !defined(__MIC__)
+    RTCRay4 ray4;
+    setRay(ray4,0,makeRay(Vec3fa(+2.1f,10,+2.05f),Vec3fa(0,-1,0)));
+    setRay(ray4,1,makeRay(Vec3fa(-2.1f,10,-2.05f),Vec3fa(0,-1,0)));
+    setRay(ray4,2,makeRay(Vec3fa(+2.1f,10,-2.05f),Vec3fa(0,-1,0)));
+    setRay(ray4,3,makeRay(Vec3fa(+2.1f,10,-2.05f),Vec3fa(0,-1,0)));
+    __aligned(16) int valid4[4] = { -1,-1,-1,0 };
+    rtcIntersect4(valid4,scene2,ray4);
+    passed &= ray4.geomID[0] == 0 && ray4.instID[0] == inst2 && ray4.subInstID[0][0] == inst1 && ray4.subInstID[1][0] == -1;
+    passed &= ray4.geomID[1] == geom2 && ray4.instID[1] == -1;
+    passed &= ray4.geomID[2] == -1 && ray4.geomID[3] == -1;
+
+    setRay(ray4,0,makeRay(Vec3fa(+2.1f,10,+2.05f),Vec3fa(0,-1,0)));
+    setRay(ray4,1,makeRay(Vec3fa(-2.1f,10,-2.05f),Vec3fa(0,-1,0)));
+    setRay(ray4,2,makeRay(Vec3fa(+2.1f,10,-2.05f),Vec3fa(0,-1,0)));
+    setRay(ray4,3,makeRay(Vec3fa(+2.1f,10,-2.05f),Vec3fa(0,-1,0)));
+    rtcOccluded4(valid4,scene2,ray4);
+    passed &= ray4.geomID[0] == 0 && ray4.geomID[1] == 0 && ray4.geomID[2] == -1;
+#endif
+
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+    if (has_feature(AVX)) 
+    {
+      RTCRay8 ray8;
+      for (size_t j=0; j<8; j++) {
+        const float x = j%3 == 1 ? -2.1f : +2.1f, z = j%3 == 0 ? +2.05f : -2.05f;
+        setRay(ray8,j,makeRay(Vec3fa(x,10,z),Vec3fa(0,-1,0)));
+      }
+      __aligned(32) int valid8[8] = { -1,-1,-1,-1,-1,-1,-1,0 };
+      rtcIntersect8(valid8,scene2,ray8);
+      for (size_t j=0; j<7; j++) {
+        if      (j%3 == 0) passed &= ray8.geomID[j] == 0 && ray8.instID[j] == inst2 && ray8.subInstID[0][j] == inst1 && ray8.subInstID[1][j] == -1;
+        else if (j%3 == 1) passed &= ray8.geomID[j] == geom2 && ray8.instID[j] == -1;
+        else               passed &= ray8.geomID[j] == -1;
+      }
+      passed &= ray8.geomID[7] == -1;
+
+      for (size_t j=0; j<8; j++) {
+        const float x = j%3 == 1 ? -2.1f : +2.1f, z = j%3 == 0 ? +2.05f : -2.05f;
+        setRay(ray8,j,makeRay(Vec3fa(x,10,z),Vec3fa(0,-1,0)));
+      }
+      rtcOccluded8(valid8,scene2,ray8);
+      for (size_t j=0; j<8; j++)
+        passed &= ray8.geomID[j] == (j%3 != 2 && j != 7 ? 0 : -1);
+    }
+#endif
+
+    /* occlusion through nested instances */
+    ray0 = makeRay(Vec3fa(+2.1f,10,+2.05f),Vec3fa(0,-1,0));
+    ray2 = makeRay(Vec3fa(+2.1f,10,-2.05f),Vec3fa(0,-1,0));
+    rtcOccluded(scene2,ray0);
+    rtcOccluded(scene2,ray2);
+    passed &= ray0.geomID == 0 && ray2.geomID == -1;
+
+    /* ray streams only write the nested instance IDs of the levels that got requested */
+    float orgx[2] = { +2.1f, -2.1f }, orgy[2] = { 10, 10 }, orgz[2] = { +2.05f, -2.05f };
+    float dirx[2] = { 0, 0 }, diry[2] = { -1, -1 }, dirz[2] = { 0, 0 };
+    float tnear[2] = { 0, 0 }, tfar[2] = { inf, inf }, time[2] = { 0, 0 };
+    float Ngx[2], Ngy[2], Ngz[2], u[2], v[2];
+    int mask[2] = { -1, -1 }, geomID[2] = { -1, -1 }, primID[2] = { -1, -1 }, instID[2] = { -1, -1 }, subInstID0[2] = { 7, 7 };
+    RTCRayNp soa;
+    soa.orgx = orgx; soa.orgy = orgy; soa.orgz = orgz;
+    soa.dirx = dirx; soa.diry = diry; soa.dirz = dirz;
+    soa.tnear = tnear; soa.tfar = tfar; soa.time = time; soa.mask = mask;
+    soa.Ngx = Ngx; soa.Ngy = Ngy; soa.Ngz = Ngz; soa.u = u; soa.v = v;
+    soa.geomID = geomID; soa.primID = primID; soa.instID = instID;
+    soa.subInstID[0] = subInstID0;
+    rtcIntersectNp(scene2,soa,2,sizeof(float));
+    passed &= geomID[0] == 0 && instID[0] == inst2 && subInstID0[0] == inst1;
+    passed &= geomID[1] == geom2 && instID[1] == -1 && subInstID0[1] == -1;
+
+    rtcDeleteScene (scene2);
+    rtcDeleteScene (scene1);
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    return passed;
+  }
+
+  RTCRay makeRay(const Vec3fa& org, const Vec3fa& dir, float time) 
+  {
+    RTCRay ray = makeRay(org,dir);
+    ray.time = time;
+    return ray;
+  }
+
+  bool rtcore_motion_blur_time_steps()
+  {
+    bool passed = true;
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+
+    /* meshes support up to RTC_MAX_TIME_STEPS time steps */
+    rtcNewTriangleMesh(scene,RTC_GEOMETRY_STATIC,2,4,RTC_MAX_TIME_STEPS+1);
+    AssertError(RTC_INVALID_OPERATION);
+
+    /* curves support up to RTC_MAX_TIME_STEPS time steps */
+    rtcNewBezierCurves(scene,RTC_GEOMETRY_STATIC,1,4,RTC_MAX_TIME_STEPS+1);
+    AssertError(RTC_INVALID_OPERATION);
+
+#if !defined(__MIC__)
+    /* quad that moves to x=4 at time 0.5 and back to x=0 at time 1 */
+    const float offset[3] = { 0.0f, 4.0f, 0.0f };
+    unsigned mesh = rtcNewTriangleMesh(scene,RTC_GEOMETRY_STATIC,2,4,3);
+    Triangle* triangles = (Triangle*) rtcMapBuffer(scene,mesh,RTC_INDEX_BUFFER);
+    triangles[0].v0 = 0; triangles[0].v1 = 1; triangles[0].v2 = 2;
+    triangles[1].v0 = 0; triangles[1].v1 = 2; triangles[1].v2 = 3;
+    rtcUnmapBuffer(scene,mesh,RTC_INDEX_BUFFER);
+    for (size_t t=0; t<3; t++) 
+    {
+      Vertex* vertices = (Vertex*) rtcMapBuffer(scene,mesh,RTCBufferType(RTC_VERTEX_BUFFER0+t));
+      vertices[0].x = offset[t]-0.5f; vertices[0].y = 0.0f; vertices[0].z = -0.5f;
+      vertices[1].x = offset[t]+0.5f; vertices[1].y = 0.0f; vertices[1].z = -0.5f;
+      vertices[2].x = offset[t]+0.5f; vertices[2].y = 0.0f; vertices[2].z = +0.5f;
+      vertices[3].x = offset[t]-0.5f; vertices[3].y = 0.0f; vertices[3].z = +0.5f;
+      rtcUnmapBuffer(scene,mesh,RTCBufferType(RTC_VERTEX_BUFFER0+t));
+    }
+
+    /* 2 and RTC_MAX_TIME_STEPS-1 time segments would require too many time segments in total */
+    rtcNewTriangleMesh(scene,RTC_GEOMETRY_STATIC,2,4,RTC_MAX_TIME_STEPS);
+    AssertError(RTC_INVALID_OPERATION);
+
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* the quad is at x=2 at time 0.25 and time 0.75 only when interpolating in the right time segment */
+    RTCRay rays[5] = {
+      makeRay(Vec3fa(2,1,0),Vec3fa(0,-1,0),0.25f),
+      makeRay(Vec3fa(2,1,0),Vec3fa(0,-1,0),0.75f),
+      makeRay(Vec3fa(4,1,0),Vec3fa(0,-1,0),0.5f),
+      makeRay(Vec3fa(2,1,0),Vec3fa(0,-1,0),0.0f),
+      makeRay(Vec3fa(2,1,0),Vec3fa(0,-1,0),0.5f)
+    };
+    const bool hit[5] = { true, true, true, false, false };
+    for (size_t i=0; i<5; i++) {
+      RTCRay ray = rays[i];
+      rtcIntersect(scene,ray);
+      passed &= (ray.geomID == mesh) == hit[i];
+      ray = rays[i];
+      rtcOccluded(scene,ray);
+      passed &= (ray.geomID == 0) == hit[i];
+    }
+
+    /* packets with rays in different time segments */
+    RTCRay4 ray4;
+    for (size_t i=0; i<4; i++) setRay(ray4,i,rays[i+1]);
+    __aligned(16) int valid4[4] = { -1,-1,-1,-1 };
+    rtcIntersect4(valid4,scene,ray4);
+    for (size_t i=0; i<4; i++) 
+      passed &= (ray4.geomID[i] == mesh) == hit[i+1];
+#endif
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_motion_blur_instance()
+  {
+    bool passed = true;
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    addSphere(scene0,RTC_GEOMETRY_STATIC,Vec3fa(0,0,0),0.5f,50);
+    rtcCommit (scene0);
+
+    /* instance of the sphere that moves to x=4 at time 0.5 and back to x=0 at time 1 */
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    rtcNewInstance2(scene1,scene0,RTC_MAX_TIME_STEPS+1);
+    AssertError(RTC_INVALID_OPERATION);
+    unsigned inst = rtcNewInstance2(scene1,scene0,3);
+    const float offset[3] = { 0.0f, 4.0f, 0.0f };
+    for (size_t t=0; t<3; t++) {
+      const float xfm[12] = { 1,0,0, 0,1,0, 0,0,1, offset[t],0,0 };
+      rtcSetTransform2(scene1,inst,RTC_MATRIX_COLUMN_MAJOR,xfm,t);
+    }
+    const float xfm[12] = { 1,0,0, 0,1,0, 0,0,1, 0,0,0 };
+    rtcSetTransform2(scene1,inst,RTC_MATRIX_COLUMN_MAJOR,xfm,3);
+    AssertError(RTC_INVALID_ARGUMENT);
+    rtcCommit (scene1);
+    AssertNoError();
+
+    /* the sphere is at x=2 at time 0.25 and time 0.75 only when interpolating in the right time segment */
+    RTCRay rays[5] = {
+      makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.25f),
+      makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.75f),
+      makeRay(Vec3fa(4,10,0),Vec3fa(0,-1,0),0.5f),
+      makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.0f),
+      makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.5f)
+    };
+    const bool hit[5] = { true, true, true, false, false };
+    for (size_t i=0; i<5; i++) {
+      RTCRay ray = rays[i];
+      rtcIntersect(scene1,ray);
+      passed &= (ray.instID == inst) == hit[i];
+      passed &= !hit[i] || (ray.tfar > 9.4f && ray.tfar < 9.6f);
+      ray = rays[i];
+      rtcOccluded(scene1,ray);
+      passed &= (ray.geomID == 0) == hit[i];
+    }
+
+#if !defined(__MIC__)
+    /* packets with rays in different time segments */
+    RTCRay4 ray4;
+    for (size_t i=0; i<4; i++) setRay(ray4,i,rays[i+1]);
+    __aligned(16) int valid4[4] = { -1,-1,-1,-1 };
+    rtcIntersect4(valid4,scene1,ray4);
+    for (size_t i=0; i<4; i++) 
+      passed &= (ray4.instID[i] == inst) == hit[i+1];
+#endif
+
+    /* instance at x=2 that rotates by 180 degrees around the y-axis, the blend at time 0.5 is singular */
+    RTCScene scene2 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned rot = rtcNewInstance2(scene2,scene0,2);
+    const float xfm0[12] = { +1,0,0, 0,1,0, 0,0,+1, 2,0,0 };
+    const float xfm1[12] = { -1,0,0, 0,1,0, 0,0,-1, 2,0,0 };
+    rtcSetTransform2(scene2,rot,RTC_MATRIX_COLUMN_MAJOR,xfm0,0);
+    rtcSetTransform2(scene2,rot,RTC_MATRIX_COLUMN_MAJOR,xfm1,1);
+    rtcCommit (scene2);
+    AssertNoError();
+
+    RTCRay ray = makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.5f);
+    rtcIntersect(scene2,ray);
+    passed &= ray.instID == rot && ray.tfar > 9.4f && ray.tfar < 9.6f;
+    ray = makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.5f);
+    rtcOccluded(scene2,ray);
+    passed &= ray.geomID == 0;
+
+#if !defined(__MIC__)
+    for (size_t i=0; i<4; i++) setRay(ray4,i,makeRay(Vec3fa(2,10,0),Vec3fa(0,-1,0),0.25f*float(i+1)));
+    rtcIntersect4(valid4,scene2,ray4);
+    for (size_t i=0; i<4; i++) 
+      passed &= ray4.instID[i] == rot && ray4.tfar[i] > 9.4f && ray4.tfar[i] < 9.6f;
+#endif
+
+    rtcDeleteScene (scene2);
+    rtcDeleteScene (scene1);
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    return passed;
+  }
+
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+  /* curves are only supported on AVX, thus only tested there */
+  unsigned addStraightCurve (RTCScene scene, RTCCurveType type)
+  {
+    /* straight curve along the x-axis with radius 0.1 */
+    unsigned geom = rtcNewBezierCurves2(scene,RTC_GEOMETRY_STATIC,type,1,4);
+    Vertex* vertices = (Vertex*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    for (size_t i=0; i<4; i++) {
+      vertices[i].x = -1.0f+2.0f*float(i)/3.0f;
+      vertices[i].y = 0.0f;
+      vertices[i].z = 0.0f;
+      vertices[i].a = 0.1f;
+    }
+    rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    int* curves = (int*) rtcMapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    curves[0] = 0;
+    rtcUnmapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    return geom;
+  }
+
+  bool rtcore_packet_curves()
+  {
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned geom = addStraightCurve(scene,RTC_CURVE_RIBBON);
+    rtcCommit (scene);
+    AssertNoError();
+
+    bool passed = true;
+    const float xs[4] = { -0.5f, 0.0f, 0.5f, 3.0f };
+    const bool hit[4] = { true, true, true, false };
+    for (size_t i=0; i<4; i++)
+    {
+      const int Ns[3] = { 1, 4, 8 };
+      for (size_t j=0; j<3; j++)
+      {
+        const int N = Ns[j];
+        RTCRay ray = makeRay(Vec3fa(xs[i],10,0),Vec3fa(0,-1,0));
+        rtcIntersectN(scene,ray,N);
+        passed &= (ray.geomID == geom) == hit[i];
+        passed &= !hit[i] || (ray.tfar > 9.8f && ray.tfar < 10.2f);
+
+        ray = makeRay(Vec3fa(xs[i],10,0),Vec3fa(0,-1,0));
+        rtcOccludedN(scene,ray,N);
+        passed &= (ray.geomID == 0) == hit[i];
+      }
+    }
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_curve_types()
+  {
+    RTCScene scene0 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    rtcNewBezierCurves2(scene0,RTC_GEOMETRY_STATIC,(RTCCurveType)2,1,4);
+    AssertError(RTC_INVALID_ARGUMENT);
+    unsigned ribbon = addStraightCurve(scene0,RTC_CURVE_RIBBON);
+    rtcCommit (scene0);
+    AssertNoError();
+
+    RTCScene scene1 = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned tube = addStraightCurve(scene1,RTC_CURVE_ROUND);
+    rtcCommit (scene1);
+    AssertNoError();
+
+    /* the ribbon is hit at the curve center, the tube at its surface,
+       a ray passing the tube at distance 0.06 enters it at height 0.08 */
+    bool passed = true;
+    const int Ns[3] = { 1, 4, 8 };
+    for (size_t j=0; j<3; j++)
+    {
+      const int N = Ns[j];
+      RTCRay ray = makeRay(Vec3fa(0.5f,10,0),Vec3fa(0,-1,0));
+      rtcIntersectN(scene0,ray,N);
+      passed &= ray.geomID == ribbon && fabsf(ray.tfar-10.0f) < 0.01f;
+
+      ray = makeRay(Vec3fa(0.5f,10,0),Vec3fa(0,-1,0));
+      rtcIntersectN(scene1,ray,N);
+      passed &= ray.geomID == tube && fabsf(ray.tfar-9.9f) < 0.01f;
+
+      ray = makeRay(Vec3fa(0.5f,10,0.06f),Vec3fa(0,-1,0));
+      rtcIntersectN(scene1,ray,N);
+      passed &= ray.geomID == tube && fabsf(ray.tfar-9.92f) < 0.01f;
+      passed &= fabsf(ray.Ng[0]) < 0.01f && ray.Ng[1] > 0.0f && ray.Ng[2] > 0.0f;
+
+      ray = makeRay(Vec3fa(0.5f,10,0.2f),Vec3fa(0,-1,0));
+      rtcIntersectN(scene1,ray,N);
+      passed &= ray.geomID == RTC_INVALID_GEOMETRY_ID;
+
+      ray = makeRay(Vec3fa(0.5f,10,0.06f),Vec3fa(0,-1,0));
+      rtcOccludedN(scene1,ray,N);
+      passed &= ray.geomID == 0;
+    }
+
+    rtcDeleteScene (scene1);
+    rtcDeleteScene (scene0);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_curve_types_config(const std::string& cfg)
+  {
+    /* round curves have to be intersected as tubes by each hair acceleration structure */
+    rtcExit();
+    rtcInit((g_rtcore.empty() ? cfg : g_rtcore+","+cfg).c_str());
+    bool passed = rtcore_curve_types();
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+    return passed;
+  }
+
+  bool rtcore_motion_blur_curves()
+  {
+    /* straight curve along the x-axis that moves to z=4 at time 0.5 and back to z=0 at time 1 */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    const float offset[3] = { 0.0f, 4.0f, 0.0f };
+    unsigned geom = rtcNewBezierCurves(scene,RTC_GEOMETRY_STATIC,1,4,3);
+    for (size_t t=0; t<3; t++) 
+    {
+      Vertex* vertices = (Vertex*) rtcMapBuffer(scene,geom,RTCBufferType(RTC_VERTEX_BUFFER0+t));
+      for (size_t i=0; i<4; i++) {
+        vertices[i].x = -1.0f+2.0f*float(i)/3.0f;
+        vertices[i].y = 0.0f;
+        vertices[i].z = offset[t];
+        vertices[i].a = 0.1f;
+      }
+      rtcUnmapBuffer(scene,geom,RTCBufferType(RTC_VERTEX_BUFFER0+t));
+    }
+    int* curves = (int*) rtcMapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    curves[0] = 0;
+    rtcUnmapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* the curve is at z=2 at time 0.25 and time 0.75 only when interpolating in the right time segment */
+    bool passed = true;
+    const RTCRay rays[5] = {
+      makeRay(Vec3fa(0,10,2),Vec3fa(0,-1,0),0.25f),
+      makeRay(Vec3fa(0,10,2),Vec3fa(0,-1,0),0.75f),
+      makeRay(Vec3fa(0,10,4),Vec3fa(0,-1,0),0.5f),
+      makeRay(Vec3fa(0,10,2),Vec3fa(0,-1,0),0.0f),
+      makeRay(Vec3fa(0,10,2),Vec3fa(0,-1,0),0.5f)
+    };
+    const bool hit[5] = { true, true, true, false, false };
+    for (size_t i=0; i<5; i++)
+    {
+      const int Ns[3] = { 1, 4, 8 };
+      for (size_t j=0; j<3; j++)
+      {
+        const int N = Ns[j];
+        RTCRay ray = rays[i];
+        rtcIntersectN(scene,ray,N);
+        passed &= (ray.geomID == geom) == hit[i];
+        passed &= !hit[i] || (ray.tfar > 9.8f && ray.tfar < 10.2f);
+
+        ray = rays[i];
+        rtcOccludedN(scene,ray,N);
+        passed &= (ray.geomID == 0) == hit[i];
+      }
+    }
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_packet_hair_hits(size_t numCurves, std::vector<RTCRay>& rays, std::vector<RTCRay>& rays4, std::vector<RTCRay>& rays8)
+  {
+    /* random hair strands inside the unit cube */
+    RTCScene scene = rtcNewScene(RTC_SCENE_STATIC,aflags);
+    unsigned geom = rtcNewBezierCurves(scene,RTC_GEOMETRY_STATIC,numCurves,4*numCurves);
+    Vertex* vertices = (Vertex*) rtcMapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    int* curves = (int*) rtcMapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    for (size_t i=0; i<numCurves; i++) 
+    {
+      const Vec3fa p(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      const Vec3fa d(0.2f*drand48()-0.1f,0.2f*drand48()-0.1f,0.2f*drand48()-0.1f);
+      for (size_t j=0; j<4; j++) {
+        const Vec3fa v = p + float(j)*d + Vec3fa(0.02f*drand48(),0.02f*drand48(),0.02f*drand48());
+        vertices[4*i+j].x = v.x;
+        vertices[4*i+j].y = v.y;
+        vertices[4*i+j].z = v.z;
+        vertices[4*i+j].a = 0.01f;
+      }
+      curves[i] = 4*i;
+    }
+    rtcUnmapBuffer(scene,geom,RTC_INDEX_BUFFER);
+    rtcUnmapBuffer(scene,geom,RTC_VERTEX_BUFFER);
+    rtcCommit (scene);
+    AssertNoError();
+
+    /* the rays of a packet diverge and some are invalid */
+    bool passed = true;
+    for (size_t i=0; i<rays.size(); i+=8)
+    {
+      for (size_t k=0; k<8; k++) 
+        rtcIntersect(scene,rays[i+k]);
+
+      for (size_t j=0; j<8; j+=4) {
+        RTCRay4 ray4; __aligned(16) int valid4[4];
+        for (size_t k=0; k<4; k++) { setRay(ray4,k,rays4[i+j+k]); valid4[k] = k == 2 ? 0 : -1; }
+        rtcIntersect4(valid4,scene,ray4);
+        for (size_t k=0; k<4; k++) rays4[i+j+k] = getRay(ray4,k);
+        passed &= ray4.geomID[2] == -1;
+      }
+
+      RTCRay8 ray8; __aligned(32) int valid8[8];
+      for (size_t k=0; k<8; k++) { setRay(ray8,k,rays8[i+k]); valid8[k] = k == 5 ? 0 : -1; }
+      rtcIntersect8(valid8,scene,ray8);
+      for (size_t k=0; k<8; k++) rays8[i+k] = getRay(ray8,k);
+      passed &= ray8.geomID[5] == -1;
+
+      /* occluded rays have to be the intersected ones */
+      RTCRay shadows[8];
+      for (size_t k=0; k<8; k++) {
+        const RTCRay& ray = rays[i+k];
+        shadows[k] = makeRay(Vec3fa(ray.org[0],ray.org[1],ray.org[2]),Vec3fa(ray.dir[0],ray.dir[1],ray.dir[2]));
+      }
+      for (size_t k=0; k<8; k++) { setRay(ray8,k,shadows[k]); valid8[k] = -1; }
+      rtcOccluded8(valid8,scene,ray8);
+      for (size_t k=0; k<8; k++) passed &= (ray8.geomID[k] == 0) == (rays[i+k].geomID != -1);
+
+      RTCRay4 ray4; __aligned(16) int valid4[4] = { -1,-1,-1,-1 };
+      for (size_t k=0; k<4; k++) setRay(ray4,k,shadows[k]);
+      rtcOccluded4(valid4,scene,ray4);
+      for (size_t k=0; k<4; k++) passed &= (ray4.geomID[k] == 0) == (rays[i+k].geomID != -1);
+    }
+
+    rtcDeleteScene (scene);
+    AssertNoError();
+    return passed;
+  }
+
+  bool rtcore_packet_hair(size_t numCurves)
+  {
+    std::vector<RTCRay> rays;
+    for (size_t i=0; i<1024; i++) {
+      Vec3fa org(4.0f*drand48()-2.0f,4.0f*drand48()-2.0f,4.0f*drand48()-2.0f);
+      Vec3fa dir(2.0f*drand48()-1.0f,2.0f*drand48()-1.0f,2.0f*drand48()-1.0f);
+      rays.push_back(makeRay(org,normalize(dir)));
+    }
+
+    /* the packets traversing the hair BVH have to find the hits of the single rays */
+    std::vector<RTCRay> rays4 = rays, rays8 = rays;
+    rtcExit();
+    rtcInit((g_rtcore.empty() ? std::string("hairaccel=bvh4hair.bezier1") : g_rtcore+",hairaccel=bvh4hair.bezier1").c_str());
+    bool passed = rtcore_packet_hair_hits(numCurves,rays,rays4,rays8);
+    rtcExit();
+    rtcInit(g_rtcore.c_str());
+
+    for (size_t i=0; i<rays.size(); i++) 
+    {
+      if (i%8 == 2 || i%8 == 6) passed &= rays4[i].geomID == -1;
+      else                      passed &= compareHit(rays4[i],rays[i]) && rays4[i].primID == rays[i].primID;
+      if (i%8 == 5)             passed &= rays8[i].geomID == -1;
+      else                      passed &= compareHit(rays8[i],rays[i]) && rays8[i].primID == rays[i].primID;
+    }
+    return passed;
+  }
+#endif
+
   bool rtcore_regression_static()
   {
     for (size_t i=0; i<200; i++) 
@@ -2161,9 +3330,41 @@ namespace embree
 
     POSITIVE("dynamic_enable_disable",    rtcore_dynamic_enable_disable());
     POSITIVE("update_deformable",         rtcore_update(RTC_GEOMETRY_DEFORMABLE));
+    POSITIVE("presplits_dynamic",         rtcore_compare_config("presplits=50",RTC_SCENE_DYNAMIC,RTC_GEOMETRY_STATIC));
+    POSITIVE("presplits_fast",            rtcore_compare_config("triaccel=bvh4.triangle4,builder=fast,presplits=50",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+    POSITIVE("morton64_dynamic",          rtcore_compare_config("mortonbits=64",RTC_SCENE_DYNAMIC,RTC_GEOMETRY_DYNAMIC));
+    POSITIVE("morton64_static",           rtcore_compare_config("triaccel=bvh4.triangle4,builder=morton,mortonbits=64",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+    POSITIVE("restructure_dynamic",       rtcore_compare_config("restructure=2",RTC_SCENE_DYNAMIC,RTC_GEOMETRY_DYNAMIC));
+    POSITIVE("restructure_static",        rtcore_compare_config("triaccel=bvh4.triangle4,builder=morton,restructure=2",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+    POSITIVE("ploc_static",               rtcore_compare_config("triaccel=bvh4.triangle4,builder=ploc",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+    POSITIVE("refit_deformable",          rtcore_refit_deformable(50));
+    POSITIVE("refit_deformable_parallel", rtcore_refit_deformable(120));
+    POSITIVE("refit_optimize",            rtcore_refit_optimize(50));
+    POSITIVE("refit_optimize_parallel",   rtcore_refit_optimize(120));
+    POSITIVE("high_quality_scene",        rtcore_high_quality_scene(20));
+    POSITIVE("high_quality_scene_large",  rtcore_high_quality_scene(100));
     POSITIVE("update_dynamic",            rtcore_update(RTC_GEOMETRY_DYNAMIC));
     POSITIVE("overlapping_geometry",      rtcore_overlapping(100000));
     POSITIVE("new_delete_geometry",       rtcore_new_delete_geometry());
+    POSITIVE("alloc_reuse",               rtcore_alloc_reuse());
+    POSITIVE("nested_instancing",         rtcore_nested_instancing());
+    POSITIVE("motion_blur_time_steps",    rtcore_motion_blur_time_steps());
+    POSITIVE("motion_blur_instance",      rtcore_motion_blur_instance());
+#if defined(__TARGET_AVX__) || defined(__TARGET_AVX2__)
+    if (has_feature(AVX))
+    {
+      POSITIVE("ploc_bvh4i",              rtcore_compare_config("triaccel=bvh4i.triangle1,builder=ploc",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+      POSITIVE("bvh8_triangle4",          rtcore_compare_config("triaccel=bvh8.triangle4",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+      POSITIVE("bvh8_triangle8",          rtcore_compare_config("triaccel=bvh8.triangle8",RTC_SCENE_STATIC,RTC_GEOMETRY_STATIC));
+      POSITIVE("bvh8_spatialsplit",       rtcore_compare_config("triaccel=bvh4.triangle4",RTC_SCENE_STATIC | RTC_SCENE_HIGH_QUALITY,RTC_GEOMETRY_STATIC));
+      POSITIVE("packet_curves",           rtcore_packet_curves());
+      POSITIVE("curve_types",             rtcore_curve_types());
+      POSITIVE("curve_types_bvh4hair",    rtcore_curve_types_config("hairaccel=bvh4hair.bezier1"));
+      POSITIVE("motion_blur_curves",      rtcore_motion_blur_curves());
+      POSITIVE("packet_hair",             rtcore_packet_hair(1000));
+      POSITIVE("packet_hair_large",       rtcore_packet_hair(300*1024));
+    }
+#endif
 
 #if defined(__USE_RAY_MASK__)
     rtcore_ray_masks_all();
@@ -2178,6 +3379,23 @@ namespace embree
 #endif
 
     rtcore_packet_write_test_all();
+    rtcore_ray_stream_all();
+
+#if !defined(__MIC__)
+    POSITIVE("save_load_scene",           rtcore_save_load_scene(RTC_SCENE_STATIC));
+    POSITIVE("save_load_scene_coherent",  rtcore_save_load_scene(RTC_SCENE_STATIC | RTC_SCENE_COHERENT));
+    POSITIVE("save_load_scene_robust",    rtcore_save_load_scene(RTC_SCENE_STATIC | RTC_SCENE_ROBUST));
+    POSITIVE("save_load_scene_hq",        rtcore_save_load_scene(RTC_SCENE_STATIC | RTC_SCENE_HIGH_QUALITY));
+    POSITIVE("save_load_scene_compact",   rtcore_save_load_scene(RTC_SCENE_STATIC | RTC_SCENE_COMPACT));
+    POSITIVE("load_truncated_scene",      rtcore_load_truncated_scene(RTC_SCENE_STATIC));
+    POSITIVE("compact_scene",             rtcore_compact_scene(RTC_SCENE_STATIC));
+    POSITIVE("compact_scene_robust",      rtcore_compact_scene(RTC_SCENE_STATIC | RTC_SCENE_ROBUST));
+    POSITIVE("compact_scene_coherent",    rtcore_compact_scene(RTC_SCENE_STATIC | RTC_SCENE_COHERENT));
+    POSITIVE("progressive_scene",         rtcore_progressive_scene(RTC_SCENE_STATIC));
+    POSITIVE("progressive_scene_robust",  rtcore_progressive_scene(RTC_SCENE_STATIC | RTC_SCENE_ROBUST));
+    POSITIVE("commit_async",              rtcore_commit_async(RTC_SCENE_DYNAMIC));
+    POSITIVE("commit_async_robust",       rtcore_commit_async(RTC_SCENE_DYNAMIC | RTC_SCENE_ROBUST));
+#endif
 
     rtcore_watertight_sphere1(100000);
     rtcore_watertight_plane1(100000);
@@ -65,6 +65,7 @@
     int geomID;           //!< geometry ID
     int primID;           //!< primitive ID
     int instID;           //!< instance ID
+    int subInstID[RTC_MAX_INSTANCE_LEVELS-1]; //!< IDs of nested instances below instID
   };
 
   /*! Outputs ray to stream. */